@@ -8,17 +8,24 @@
 #
 # USAGE
 #
-# scattergun.sh
+# scattergun.sh [ STAGE ... ]
 #
 # EXAMPLES
 #
 # dd if=/dev/random | scattergun.sh
+# dd if=/dev/random | scattergun.sh ent sp800
 #
 # ABSTRACT
 #
 # Runs a battery of tests on a random number generator by
 # reading ramdom bits from standard input. Saves generated
 # data files and other artifacts in the current directory.
+# The battery is made of the stages png, rngtest, ent, sp800,
+# and dieharder, run in that order; if any STAGEs are given,
+# only those are run. The png stage captures PNGBYTES bytes
+# (default 16777216) if visualize is installed, which sizes
+# its pictures to the capture, and otherwise just the 196608
+# bytes netpbm uses, which are the first of the capture.
 # 
 
 RC=0
@@ -28,6 +35,12 @@ HOSTNAME=$(uname -n)
 SYSTEM=$(uname -r)
 ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
 ROOT=$(basename $(pwd))
+STAGES=${*:-"png rngtest ent sp800 dieharder"}
+PNGBYTES=${PNGBYTES:-16777216}
+
+selected() {
+	[[ " ${STAGES} " == *" ${1} "* ]]
+}
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ${ROOT}"
 
@@ -36,16 +49,36 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ${ROOT}"
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin png"
 
 # sudo apt-get install netpbm
+# Or make common, which builds visualize.
+
+NETPBM=false
+if [[ -x /usr/bin/rawtoppm ]] && [[ -x /usr/bin/pnmtopng ]]; then
+	NETPBM=true
+fi
 
-if [[ ! -x /usr/bin/rawtoppm ]]; then
+VISUALIZE=false
+if type visualize > /dev/null 2>&1; then
+	VISUALIZE=true
+fi
+
+if ! selected png; then
 	:
-elif [[ ! -x /usr/bin/pnmtopng ]]; then
+elif ! ${NETPBM} && ! ${VISUALIZE}; then
 	:
 else
 	DATA="rawtoppm.dat"
 	IMAGE="rawtoppm.png"
-	time dd of=${DATA} bs=3 count=65536 iflag=fullblock
-	/usr/bin/rawtoppm -rgb 256 256 < ${DATA} | /usr/bin/pnmtopng > ${IMAGE}
+	if ${VISUALIZE}; then
+		time dd of=${DATA} bs=65536 count=${PNGBYTES} iflag=fullblock,count_bytes
+	else
+		time dd of=${DATA} bs=3 count=65536 iflag=fullblock
+	fi
+	if ${NETPBM}; then
+		head -c 196608 ${DATA} | /usr/bin/rawtoppm -rgb 256 256 | /usr/bin/pnmtopng > ${IMAGE}
+	fi
+	if ${VISUALIZE}; then
+		time visualize -v -l lag.png -b bias.png -m bitmap.png ${DATA}
+	fi
 fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end png"
@@ -58,7 +91,7 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin rngtest"
 # ${EDITOR} /etc/default/rng-tools
 # sudo /etc/init.d/rng-tools start
 
-if [[ -x /usr/bin/rngtest ]]; then
+if selected rngtest && [[ -x /usr/bin/rngtest ]]; then
 	DATA="rngtest.dat"
 	time dd of=${DATA} bs=2508 count=1000 iflag=fullblock
 	time /usr/bin/rngtest -c 1000 < ${DATA}
@@ -73,7 +106,9 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ent"
 # sudo apt-get install ent
 # http://www.fourmilab.ch/random/random.zip
 
-if [[ -x /usr/bin/ent ]]; then
+if ! selected ent; then
+	:
+elif [[ -x /usr/bin/ent ]]; then
 	DATA="ent.dat"
 	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
 	time /usr/bin/ent ${DATA}
@@ -95,7 +130,7 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin SP800-90B"
 # export PATH=$PATH:$(pwd)/SP800-90B_EntropyAssessment
 
 NISTCODE=$(which iid_main.py)
-if [[ -n "${NISTCODE}" ]]; then
+if selected sp800 && [[ -n "${NISTCODE}" ]]; then
 	NISTPATH=$(dirname ${NISTCODE})
 	DATA="$(pwd)/sp800.dat"
 	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
@@ -104,7 +139,7 @@ if [[ -n "${NISTCODE}" ]]; then
 fi
 
 NISTCODE=$(which ea_iid)
-if [[ -n "${NISTCODE}" ]]; then
+if selected sp800 && [[ -n "${NISTCODE}" ]]; then
 	NISTPATH=$(dirname ${NISTCODE})
 	DATA="$(pwd)/sp800.dat"
 	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
@@ -120,7 +155,7 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin dieharder"
 
 # sudo apt-get install dieharder
 
-if [[ -x /usr/bin/dieharder ]]; then
+if selected dieharder && [[ -x /usr/bin/dieharder ]]; then
 	dieharder -a -g 200
 fi
 
@@ -0,0 +1,104 @@
+#!/bin/bash
+# vi: set ts=4:
+# Copyright 2020 Digital Aggregates Corporation, Colorado, USA.
+# "Digital Aggregates Corporation" is a registered trademark.
+# Licensed under the terms of the GNU GPL v2.
+# mailto:coverclock@diag.com
+# https://github.com/coverclock/com-diag-scattergun
+#
+# USAGE
+#
+# bench.sh [ DURATION [ SIZES [ DIRECTORY ] ] ]
+#
+# EXAMPLES
+#
+# bench.sh
+# bench.sh 30 "4 4096 65536 1048576" ${HOME}/bench
+#
+# ABSTRACT
+#
+# Measures the throughput of every source available on this host,
+# the generators built here, seventool if the processor has rdrand or
+# rdseed, /dev/urandom, and /dev/hwrng if it is readable, by running
+# each through rate for DURATION seconds (default 10) at each of the
+# read sizes in SIZES (default "4 4096 65536"); devices are also read
+# with that size, since some fill each read before returning it. A size
+# too large for a slow source to fill in the duration reports nothing.
+# The per second CSV from rate for each run is kept in a time stamped
+# directory, and a summary line for each run is appended to
+# bench-HOSTNAME.csv in DIRECTORY (default the current directory), which
+# records the kernel release and the compiler version so that a host's
+# throughput can be tracked across upgrades. Rates are in kilobits per
+# second, as rate reports them.
+#
+
+ZERO=$(basename $0)
+DURATION=${1:-"10"}
+SIZES=${2:-"4 4096 65536"}
+DIRECTORY=${3:-"."}
+HOSTNAME=$(uname -n)
+SYSTEM=$(uname -r)
+MACHINE=$(uname -m)
+COMPILER=$(${CC:-cc} -dumpfullversion 2>/dev/null || ${CC:-cc} -dumpversion 2>/dev/null || echo unknown)
+ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
+SUMMARY=${DIRECTORY}/bench-${HOSTNAME}.csv
+RAW=${DIRECTORY}/bench-${HOSTNAME}-${ISO8601}
+
+NAMES=()
+COMMANDS=()
+
+candidate() {
+	NAMES+=("${1}")
+	COMMANDS+=("${2}")
+}
+
+for GENERATOR in bytes crandom cmrand48 getrandom prng; do
+	if command -v ${GENERATOR} > /dev/null; then
+		candidate ${GENERATOR} ${GENERATOR}
+	fi
+done
+
+if command -v seventool > /dev/null; then
+	if grep -qw rdrand /proc/cpuinfo; then
+		candidate rdrand "seventool -R"
+	fi
+	if grep -qw rdseed /proc/cpuinfo; then
+		candidate rdseed "seventool -S"
+	fi
+fi
+
+for DEVICE in /dev/urandom /dev/hwrng; do
+	if [[ -r ${DEVICE} ]] && dd if=${DEVICE} of=/dev/null bs=1 count=1 2> /dev/null; then
+		candidate $(basename ${DEVICE}) "dd if=${DEVICE} bs=%s status=none"
+	fi
+done
+
+mkdir -p ${RAW} || exit 1
+
+if [[ ! -s ${SUMMARY} ]]; then
+	echo "Timestamp,Host,Machine,Kernel,Compiler,Source,Size,Duration,Bytes,Reads,Sustained,Peak,Minimum,Maximum" > ${SUMMARY}
+fi
+
+echo "${ZERO}: ${HOSTNAME} ${MACHINE} ${SYSTEM} ${COMPILER} ${DURATION} ${SIZES} ${NAMES[*]}"
+
+for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+	NAME=${NAMES[${II}]}
+	COMMAND=${COMMANDS[${II}]}
+	for SIZE in ${SIZES}; do
+		CSV=${RAW}/${NAME}-${SIZE}.csv
+		LOG=${RAW}/${NAME}-${SIZE}.log
+		timeout -s INT ${DURATION} $(printf "${COMMAND}" ${SIZE}) 2> /dev/null | rate -c 1000000000 -r ${SIZE} > ${CSV} 2> ${LOG}
+		BYTES=$(awk '/ bytes total$/ { print $2 }' ${LOG})
+		READS=$(awk '/ reads$/ { print $2 }' ${LOG})
+		SUSTAINED=$(awk '/ kilobits\/second sustained$/ { print $2 }' ${LOG})
+		PEAK=$(awk '/ kilobits\/second peak$/ { print $2 }' ${LOG})
+		RANGE=$(awk -F, 'NR > 1 { if ((n == 0) || ($4 < lo)) { lo = $4 } if ((n == 0) || ($4 > hi)) { hi = $4 } ++n } END { if (n > 0) { printf("%f,%f", lo, hi) } else { printf(",") } }' ${CSV})
+		LINE="${ISO8601},${HOSTNAME},${MACHINE},${SYSTEM},${COMPILER},${NAME},${SIZE},${DURATION},${BYTES},${READS},${SUSTAINED},${PEAK},${RANGE}"
+		echo ${LINE} >> ${SUMMARY}
+		echo "${ZERO}: ${NAME} ${SIZE} ${SUSTAINED:-0} kilobits/second sustained"
+	done
+done
+
+echo "${ZERO}: ${SUMMARY}"
+
+exit 0
@@ -0,0 +1,250 @@
+#!/bin/bash
+# vi: set ts=4:
+# Copyright 2020 Digital Aggregates Corporation, Colorado, USA.
+# "Digital Aggregates Corporation" is a registered trademark.
+# Licensed under the terms of the GNU GPL v2.
+# mailto:coverclock@diag.com
+# https://github.com/coverclock/com-diag-scattergun
+#
+# USAGE
+#
+# campaign.sh [ -j CORES ] [ -m MEGABYTES ] [ -d DIRECTORY ] [ -s "STAGE ..." ] [ -p SECONDS ] CAMPAIGN
+#
+# EXAMPLES
+#
+# campaign.sh campaign.txt
+# campaign.sh -j 4 -m 6144 -d ${HOME}/campaign -s "ent sp800" campaign.txt
+#
+# where campaign.txt contains lines like
+#
+# TrueRNGpro	dd if=/dev/TrueRNGpro
+# quantis		quantistool -v
+# TPMWEC		dd if=/dev/hwrng
+#
+# ABSTRACT
+#
+# Runs the scattergun.sh battery on every source listed in the CAMPAIGN
+# file, one source per line as a name followed by the command that writes
+# its output to standard output, concurrently, without exceeding a budget
+# of CORES processor cores (default all of them) and MEGABYTES megabytes
+# of memory (default what /proc/meminfo says is available). Each stage of
+# the battery (png, rngtest, ent, sp800, and dieharder, or just those
+# given with -s) is run as a separate invocation of scattergun.sh reading
+# the source anew, and the stages of a source are run one after another,
+# since a device can be read by only one of them at a time. A stage is
+# started only when its core count and its estimated peak resident set
+# size fit within what is left of the budget; otherwise it waits in the
+# queue while other sources' stages that do fit go ahead. A stage whose
+# estimate exceeds the whole budget is run alone. The estimate of a stage
+# is the largest peak it has been measured to have on this host in an
+# earlier campaign, or a conservative default if it has never been run.
+# Peaks are measured by sampling the resident set size of the whole
+# process tree of the stage every SECONDS seconds (default 1), so a brief
+# spike may be missed. Each source gets its own directory under DIRECTORY
+# (default the current directory) named as the Makefile names them, with
+# a log per stage, and a line per stage with its start and end times, its
+# estimate, its measured peak, and its exit status is appended to
+# campaign-HOSTNAME.csv in DIRECTORY.
+#
+
+ZERO=$(basename $0)
+HOSTNAME=$(uname -n)
+ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
+CORES=$(nproc)
+MEMORY=$(awk '/^MemAvailable:/ { print int($2 / 1024) }' /proc/meminfo)
+DIRECTORY="."
+STAGES="png rngtest ent sp800 dieharder"
+PERIOD=1
+
+# Estimated peak megabytes and cores of each stage when it has no history.
+# The SP800-90B non-IID assessment is what got TPMWEC killed by the OOM
+# killer.
+
+declare -A ESTIMATE=( [png]=32 [rngtest]=16 [ent]=16 [sp800]=4096 [dieharder]=64 )
+declare -A THREADS=( [png]=1 [rngtest]=1 [ent]=1 [sp800]=1 [dieharder]=1 )
+
+usage() {
+	echo "usage: ${ZERO} [ -j CORES ] [ -m MEGABYTES ] [ -d DIRECTORY ] [ -s \"STAGE ...\" ] [ -p SECONDS ] CAMPAIGN" 1>&2
+}
+
+while getopts "j:m:d:s:p:h" OPT; do
+	case ${OPT} in
+	j) CORES=${OPTARG};;
+	m) MEMORY=${OPTARG};;
+	d) DIRECTORY=${OPTARG};;
+	s) STAGES=${OPTARG};;
+	p) PERIOD=${OPTARG};;
+	*) usage; exit 1;;
+	esac
+done
+shift $(( ${OPTIND} - 1 ))
+
+CAMPAIGN=${1}
+if [[ -z "${CAMPAIGN}" ]] || [[ ! -r ${CAMPAIGN} ]]; then
+	usage
+	exit 1
+fi
+
+for STAGE in ${STAGES}; do
+	if [[ -z "${ESTIMATE[${STAGE}]}" ]]; then
+		echo "${ZERO}: ${STAGE}: no such stage" 1>&2
+		exit 1
+	fi
+done
+
+mkdir -p ${DIRECTORY} || exit 1
+
+RECORD=${DIRECTORY}/campaign-${HOSTNAME}.csv
+
+if [[ ! -s ${RECORD} ]]; then
+	echo "Campaign,Host,Source,Stage,Start,End,Seconds,Cores,Estimate,Peak,Status" > ${RECORD}
+fi
+
+# Replace the defaults with the largest peak measured on this host by a
+# stage that succeeded and lasted long enough to be measured.
+
+while IFS=, read STAGE PEAK; do
+	if [[ -n "${ESTIMATE[${STAGE}]}" ]]; then
+		ESTIMATE[${STAGE}]=${PEAK}
+	fi
+done < <(awk -F, '(NR > 1) && ($11 == 0) && ($10 > 0) { if ($10 > peak[$4]) { peak[$4] = $10 } } END { for (stage in peak) { printf("%s,%d\n", stage, peak[stage]) } }' ${RECORD})
+
+NAMES=()
+COMMANDS=()
+
+while read NAME COMMAND; do
+	if [[ -z "${NAME}" ]] || [[ "${NAME}" == \#* ]]; then
+		continue
+	fi
+	NAMES+=("${NAME}")
+	COMMANDS+=("${COMMAND}")
+done < ${CAMPAIGN}
+
+# Sum the resident set size in megabytes of the process tree under each of
+# the PIDs given, one PID and size per line.
+
+footprint() {
+	ps -e -o pid=,ppid=,rss= | awk -v roots="$*" '
+		{ parent[$1] = $2; rss[$1] = $3 }
+		END {
+			n = split(roots, root, " ")
+			for (p in parent) {
+				q = p
+				while ((q in parent) && (q > 1)) {
+					for (i = 1; i <= n; ++i) {
+						if (q == root[i]) { total[root[i]] += rss[p]; q = 0; break }
+					}
+					if (q > 1) { q = parent[q] }
+				}
+			}
+			for (i = 1; i <= n; ++i) { printf("%s %d\n", root[i], int((total[root[i]] + 1023) / 1024)) }
+		}'
+}
+
+declare -a NEXT PID BEGIN START PEAK RESERVED WAITING
+STAGELIST=(${STAGES})
+USEDCORES=0
+USEDMEMORY=0
+REMAINING=$(( ${#NAMES[@]} * ${#STAGELIST[@]} ))
+
+for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+	NEXT[${II}]=0
+	PID[${II}]=""
+	WAITING[${II}]=""
+done
+
+# Run each stage in its own process group, so that an interrupt can kill
+# the whole pipeline of a stage and not just the shell that started it.
+
+set -m
+
+trap 'for P in ${PID[*]}; do kill -- -${P} 2> /dev/null; done; exit 2' INT TERM
+
+echo "${ZERO}: ${ISO8601} ${HOSTNAME} cores=${CORES} megabytes=${MEMORY} stages=\"${STAGES}\" sources=\"${NAMES[*]}\""
+
+while (( ${REMAINING} > 0 )); do
+
+	# Start every stage that fits, in the order of the campaign.
+
+	for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+		if [[ -n "${PID[${II}]}" ]] || (( ${NEXT[${II}]} >= ${#STAGELIST[@]} )); then
+			continue
+		fi
+		NAME=${NAMES[${II}]}
+		STAGE=${STAGELIST[${NEXT[${II}]}]}
+		NEED=${ESTIMATE[${STAGE}]}
+		USE=${THREADS[${STAGE}]}
+		if (( ${USEDCORES} > 0 )) && (( (${USEDCORES} + ${USE} > ${CORES}) || (${USEDMEMORY} + ${NEED} > ${MEMORY}) )); then
+			if [[ -z "${WAITING[${II}]}" ]]; then
+				echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) queue ${NAME} ${STAGE} cores=${USE} megabytes=${NEED}"
+				WAITING[${II}]=${STAGE}
+			fi
+			continue
+		fi
+		if (( ${NEED} > ${MEMORY} )); then
+			echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) alone ${NAME} ${STAGE} megabytes=${NEED}"
+		fi
+		WORK=${DIRECTORY}/scattergun_${HOSTNAME}_${NAME}
+		mkdir -p ${WORK}
+		( cd ${WORK} && exec bash -c "${COMMANDS[${II}]} | scattergun.sh ${STAGE}" ) > ${WORK}/${STAGE}.log 2>&1 &
+		PID[${II}]=$!
+		BEGIN[${II}]=$(date -u +%Y-%m-%dT%H:%M:%S)
+		START[${II}]=$(date +%s)
+		PEAK[${II}]=0
+		RESERVED[${II}]=${NEED}
+		WAITING[${II}]=""
+		USEDCORES=$(( ${USEDCORES} + ${USE} ))
+		USEDMEMORY=$(( ${USEDMEMORY} + ${NEED} ))
+		echo "${ZERO}: ${BEGIN[${II}]} start ${NAME} ${STAGE} pid=${PID[${II}]} cores=${USEDCORES}/${CORES} megabytes=${USEDMEMORY}/${MEMORY}"
+	done
+
+	sleep ${PERIOD}
+
+	# Measure the stages still running and retire those that are done.
+
+	RUNNING=()
+	for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+		if [[ -n "${PID[${II}]}" ]]; then
+			RUNNING+=(${PID[${II}]})
+		fi
+	done
+
+	if (( ${#RUNNING[@]} > 0 )); then
+		while read ROOT MEGABYTES; do
+			for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+				if [[ "${PID[${II}]}" == "${ROOT}" ]] && (( ${MEGABYTES} > ${PEAK[${II}]} )); then
+					PEAK[${II}]=${MEGABYTES}
+				fi
+			done
+		done < <(footprint ${RUNNING[*]})
+	fi
+
+	for (( II = 0; II < ${#NAMES[@]}; ++II )); do
+		if [[ -z "${PID[${II}]}" ]] || kill -0 ${PID[${II}]} 2> /dev/null; then
+			continue
+		fi
+		wait ${PID[${II}]}
+		STATUS=$?
+		NAME=${NAMES[${II}]}
+		STAGE=${STAGELIST[${NEXT[${II}]}]}
+		NEED=${RESERVED[${II}]}
+		USE=${THREADS[${STAGE}]}
+		END=$(date -u +%Y-%m-%dT%H:%M:%S)
+		ELAPSED=$(( $(date +%s) - ${START[${II}]} ))
+		echo "${ISO8601},${HOSTNAME},${NAME},${STAGE},${BEGIN[${II}]},${END},${ELAPSED},${USE},${NEED},${PEAK[${II}]},${STATUS}" >> ${RECORD}
+		echo "${ZERO}: ${END} end ${NAME} ${STAGE} seconds=${ELAPSED} peak=${PEAK[${II}]} status=${STATUS}"
+		if (( ${PEAK[${II}]} > ${ESTIMATE[${STAGE}]} )); then
+			ESTIMATE[${STAGE}]=${PEAK[${II}]}
+		fi
+		USEDCORES=$(( ${USEDCORES} - ${USE} ))
+		USEDMEMORY=$(( ${USEDMEMORY} - ${NEED} ))
+		PID[${II}]=""
+		NEXT[${II}]=$(( ${NEXT[${II}]} + 1 ))
+		REMAINING=$(( ${REMAINING} - 1 ))
+	done
+
+done
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ${RECORD}"
+
+exit 0
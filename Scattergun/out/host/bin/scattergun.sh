@@ -0,0 +1,168 @@
+#!/bin/bash
+# vi: set ts=4:
+# Copyright 2015-2016 Digital Aggregates Corporation, Colorado, USA.
+# "Digital Aggregates Corporation" is a registered trademark.
+# Licensed under the terms of the GNU GPL v2.
+# mailto:coverclock@diag.com
+# https://github.com/coverclock/com-diag-scattergun
+#
+# USAGE
+#
+# scattergun.sh [ STAGE ... ]
+#
+# EXAMPLES
+#
+# dd if=/dev/random | scattergun.sh
+# dd if=/dev/random | scattergun.sh ent sp800
+#
+# ABSTRACT
+#
+# Runs a battery of tests on a random number generator by
+# reading ramdom bits from standard input. Saves generated
+# data files and other artifacts in the current directory.
+# The battery is made of the stages png, rngtest, ent, sp800,
+# and dieharder, run in that order; if any STAGEs are given,
+# only those are run. The png stage captures PNGBYTES bytes
+# (default 16777216) if visualize is installed, which sizes
+# its pictures to the capture, and otherwise just the 196608
+# bytes netpbm uses, which are the first of the capture.
+# 
+
+RC=0
+ZERO=$(basename $0)
+LABEL=${ZERO%\.sh}
+HOSTNAME=$(uname -n)
+SYSTEM=$(uname -r)
+ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
+ROOT=$(basename $(pwd))
+STAGES=${*:-"png rngtest ent sp800 dieharder"}
+PNGBYTES=${PNGBYTES:-16777216}
+
+selected() {
+	[[ " ${STAGES} " == *" ${1} "* ]]
+}
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ${ROOT}"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin png"
+
+# sudo apt-get install netpbm
+# Or make common, which builds visualize.
+
+NETPBM=false
+if [[ -x /usr/bin/rawtoppm ]] && [[ -x /usr/bin/pnmtopng ]]; then
+	NETPBM=true
+fi
+
+VISUALIZE=false
+if type visualize > /dev/null 2>&1; then
+	VISUALIZE=true
+fi
+
+if ! selected png; then
+	:
+elif ! ${NETPBM} && ! ${VISUALIZE}; then
+	:
+else
+	DATA="rawtoppm.dat"
+	IMAGE="rawtoppm.png"
+	if ${VISUALIZE}; then
+		time dd of=${DATA} bs=65536 count=${PNGBYTES} iflag=fullblock,count_bytes
+	else
+		time dd of=${DATA} bs=3 count=65536 iflag=fullblock
+	fi
+	if ${NETPBM}; then
+		head -c 196608 ${DATA} | /usr/bin/rawtoppm -rgb 256 256 | /usr/bin/pnmtopng > ${IMAGE}
+	fi
+	if ${VISUALIZE}; then
+		time visualize -v -l lag.png -b bias.png -m bitmap.png ${DATA}
+	fi
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end png"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin rngtest"
+
+# sudo apt-get install rng-tools
+# ${EDITOR} /etc/default/rng-tools
+# sudo /etc/init.d/rng-tools start
+
+if selected rngtest && [[ -x /usr/bin/rngtest ]]; then
+	DATA="rngtest.dat"
+	time dd of=${DATA} bs=2508 count=1000 iflag=fullblock
+	time /usr/bin/rngtest -c 1000 < ${DATA}
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end rngtest"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ent"
+
+# sudo apt-get install ent
+# http://www.fourmilab.ch/random/random.zip
+
+if ! selected ent; then
+	:
+elif [[ -x /usr/bin/ent ]]; then
+	DATA="ent.dat"
+	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
+	time /usr/bin/ent ${DATA}
+elif [[ -x ${HOME}/bin/ent ]]; then
+	DATA="ent.dat"
+	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
+	time ${HOME}/bin/ent ${DATA}
+else
+	:
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ent"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin SP800-90B"
+
+# git clone http://github.com/usnistgov/SP800-90B_EntropyAssessment
+# export PATH=$PATH:$(pwd)/SP800-90B_EntropyAssessment
+
+NISTCODE=$(which iid_main.py)
+if selected sp800 && [[ -n "${NISTCODE}" ]]; then
+	NISTPATH=$(dirname ${NISTCODE})
+	DATA="$(pwd)/sp800.dat"
+	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
+	( cd ${NISTPATH}; time python iid_main.py    -v ${DATA} 8 )
+	( cd ${NISTPATH}; time python noniid_main.py -v ${DATA} 8 )
+fi
+
+NISTCODE=$(which ea_iid)
+if selected sp800 && [[ -n "${NISTCODE}" ]]; then
+	NISTPATH=$(dirname ${NISTCODE})
+	DATA="$(pwd)/sp800.dat"
+	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
+	( cd ${NISTPATH}; time ea_iid     -v ${DATA} 8 )
+	( cd ${NISTPATH}; time ea_non_iid -v ${DATA} 8 )
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end SP800-90B"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin dieharder"
+
+# sudo apt-get install dieharder
+
+if selected dieharder && [[ -x /usr/bin/dieharder ]]; then
+	dieharder -a -g 200
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end dieharder"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ${ROOT} ${RC}"
+
+exit ${RC}
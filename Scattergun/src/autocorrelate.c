@@ -0,0 +1,740 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Autocorrelate<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * autocorrelate [ -h ] [ -v ] [ -c ] [ -k LAGS ] [ -m METHOD ] [ -t THREADS ] [ -a ALPHA | -s SIGMAS ] FILE
+ *
+ * OPTIONS
+ *
+ * -a ALPHA         Flag lags with this chance of any false alarm (default 0.01).
+ * -c               Write every lag as CSV to stdout.
+ * -h               Display this menu.
+ * -k LAGS          Scan lags from 1 to this many bits (default 65536).
+ * -m METHOD        Use "popcount" or "fft" (default popcount for 4096 lags or fewer).
+ * -s SIGMAS        Flag lags this many standard deviations from zero instead.
+ * -t THREADS       Use this many threads (default one per online processor).
+ * -v               Report sizes, times, and the most significant lag to stderr.
+ *
+ * EXAMPLES
+ *
+ * autocorrelate -v rdrand.dat
+ *
+ * autocorrelate -k 8192 -c quantis.dat > quantis.csv
+ *
+ * ABSTRACT
+ *
+ * Computes the bit level autocorrelation of a capture at every lag from one
+ * bit up to LAGS bits, so that periodicities that the lag one serial
+ * correlation of ent cannot see, like the reseed interval of the rdrand
+ * DRNG or the packet size of a USB device, can be found. The capture is
+ * taken as a sequence of bits, most significant bit of each byte first, any
+ * trailing partial eight-byte word ignored. For each lag k the number of
+ * the n = bits - k pairs of bits k apart that differ, D, gives the
+ * correlation (n - 2D) / n, which for an ideal source is normally
+ * distributed about zero with a standard deviation of one over the square
+ * root of n. Lags whose deviation is significant, after a Bonferroni
+ * correction for the number of lags scanned, are listed, with the lag in
+ * bytes when it is a whole number of bytes. The exit code is 2 if any lag is
+ * flagged.
+ *
+ * There are two methods. The popcount method counts D directly, sixty-four
+ * pairs at a time, as the population count of the exclusive OR of each word
+ * and the word k bits later, a tile of words at a time so that the words
+ * stay in the cache across all the lags, with kernels cloned for AVX2 and
+ * POPCNT and selected at run time on x86_64. Its cost grows with the
+ * product of the bits and the lags. The FFT method takes each bit as plus or
+ * minus one and computes the sum of the products of every pair, which is
+ * n - 2D, for all lags at once as the cross correlation of each block of
+ * bits with itself and the next block, by a fast Fourier transform twice the
+ * length of the block, also cloned for AVX2. Each thread takes a run of
+ * consecutive blocks, so the spectrum of each block is computed once and
+ * reused for the block before it, and blocks are transformed two at a time,
+ * forward and inverse, as the real and imaginary parts of one transform,
+ * for about one transform per block. Its cost grows with the bits
+ * times the logarithm of the lags, so it is used for long scans. Both are
+ * parallelized over the capture, which is mapped into memory and copied
+ * once into words, and both give exactly the same counts.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <complex.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#if defined(__x86_64__)
+#   define AUTOCORRELATE_CLONES __attribute__((target_clones("avx2","popcnt","default")))
+#else
+#   define AUTOCORRELATE_CLONES
+#endif
+
+enum {
+    TILE = 2048,                /* Words each popcount pass keeps cached. */
+    AUTOMATIC = 4096,           /* Most lags for which popcount is the default. */
+};
+
+enum method { POPCOUNT = 0, FFT = 1, };
+static const char * METHODS[] = { "popcount", "fft", };
+
+static const char * program = "autocorrelate";
+
+/**
+ * These describe the capture and the scan, and are shared by every thread.
+ */
+static uint64_t * words = (uint64_t *)0;
+static uint64_t nwords = 0;
+static uint64_t nbits = 0;
+static uint64_t lags = 65536;
+static uint64_t length = 0;
+static long threads = 0;
+static complex double * twiddles = (complex double *)0;
+static uint32_t * reversals = (uint32_t *)0;
+
+/**
+ * This is the work of one thread and its counts of differing pairs (for
+ * popcount) or its sums of products (for FFT), indexed by lag.
+ */
+typedef struct Work {
+    pthread_t thread;
+    long index;
+    int64_t * totals;
+} work_t;
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -c ] [ -k LAGS ] [ -m METHOD ] [ -t THREADS ] [ -a ALPHA | -s SIGMAS ] FILE\n", program);
+    fprintf(stderr, "       -a ALPHA         Flag lags with this chance of any false alarm.\n");
+    fprintf(stderr, "       -c               Write every lag as CSV to stdout.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -k LAGS          Scan lags from 1 to this many bits.\n");
+    fprintf(stderr, "       -m METHOD        Use \"popcount\" or \"fft\".\n");
+    fprintf(stderr, "       -s SIGMAS        Flag lags this many standard deviations from zero.\n");
+    fprintf(stderr, "       -t THREADS       Use this many threads.\n");
+    fprintf(stderr, "       -v               Report sizes, times, and the most significant lag.\n");
+}
+
+/*******************************************************************************
+ * POPCOUNT
+ ******************************************************************************/
+
+/**
+ * Count, for every lag, the differing pairs whose first bit is in a tile of
+ * words. The second bit of a pair is in the word q = k / 64 later, or the
+ * one after; the last word with a partner at all has only some of its
+ * bits paired, and is masked.
+ * @param begin is the first word of the tile.
+ * @param end is the word past the last word of the tile.
+ * @param totals points to the counts indexed by lag.
+ */
+AUTOCORRELATE_CLONES
+static void differ(uint64_t begin, uint64_t end, int64_t * totals)
+{
+    const uint64_t * w = words;
+    uint64_t lag;
+    uint64_t q;
+    uint64_t last;
+    uint64_t jj;
+    uint64_t sum;
+    unsigned int r;
+
+    for (lag = 1; lag <= lags; ++lag) {
+
+        q = lag / 64;
+        r = lag % 64;
+        if ((q + 1) > nwords) {
+            break;
+        }
+
+        last = nwords - q - 1;  /* The last word with a partner. */
+        sum = 0;
+
+        if (r == 0) {
+            for (jj = begin; (jj < end) && (jj <= last); ++jj) {
+                sum += __builtin_popcountll(w[jj] ^ w[jj + q]);
+            }
+        } else {
+            for (jj = begin; (jj < end) && (jj < last); ++jj) {
+                sum += __builtin_popcountll(w[jj] ^ ((w[jj + q] << r) | (w[jj + q + 1] >> (64 - r))));
+            }
+            if ((begin <= last) && (last < end)) {
+                sum += __builtin_popcountll((w[last] ^ (w[last + q] << r)) & (~(uint64_t)0 << r));
+            }
+        }
+
+        totals[lag] += sum;
+
+    }
+}
+
+static void * popcount(void * arg)
+{
+    work_t * wp = (work_t *)arg;
+    uint64_t tile;
+    uint64_t begin;
+    uint64_t end;
+
+    for (tile = wp->index; (tile * TILE) < nwords; tile += threads) {
+        begin = tile * TILE;
+        end = ((begin + TILE) < nwords) ? (begin + TILE) : nwords;
+        differ(begin, end, wp->totals);
+    }
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * FFT
+ ******************************************************************************/
+
+/**
+ * Prepare the twiddle factors and the bit reversal permutation for
+ * transforms of twice the block length, shared by every thread.
+ */
+static int prepare(void)
+{
+    uint64_t size = 2 * length;
+    uint64_t ii;
+    uint32_t reversed;
+    uint64_t bit;
+
+    twiddles = (complex double *)malloc((size / 2) * sizeof(complex double));
+    reversals = (uint32_t *)malloc(size * sizeof(uint32_t));
+    if ((twiddles == (complex double *)0) || (reversals == (uint32_t *)0)) {
+        return -1;
+    }
+
+    for (ii = 0; ii < (size / 2); ++ii) {
+        twiddles[ii] = cexp(-2.0 * M_PI * I * (double)ii / (double)size);
+    }
+
+    for (ii = 0; ii < size; ++ii) {
+        reversed = 0;
+        for (bit = 1; bit < size; bit <<= 1) {
+            reversed = (reversed << 1) | ((ii & bit) ? 1 : 0);
+        }
+        reversals[ii] = reversed;
+    }
+
+    return 0;
+}
+
+/**
+ * An in place iterative radix two forward transform of twice the block
+ * length.
+ */
+AUTOCORRELATE_CLONES
+static void transform(complex double * z)
+{
+    uint64_t size = 2 * length;
+    uint64_t half;
+    uint64_t stride;
+    uint64_t ii;
+    uint64_t jj;
+    complex double t;
+
+    for (ii = 0; ii < size; ++ii) {
+        jj = reversals[ii];
+        if (ii < jj) {
+            t = z[ii];
+            z[ii] = z[jj];
+            z[jj] = t;
+        }
+    }
+
+    for (half = 1; half < size; half <<= 1) {
+        stride = size / (2 * half);
+        for (ii = 0; ii < size; ii += 2 * half) {
+            for (jj = 0; jj < half; ++jj) {
+                t = twiddles[jj * stride] * z[ii + jj + half];
+                z[ii + jj + half] = z[ii + jj] - t;
+                z[ii + jj] += t;
+            }
+        }
+    }
+}
+
+static double bit(uint64_t index)
+{
+    return ((words[index / 64] >> (63 - (index % 64))) & 1) ? 1.0 : -1.0;
+}
+
+/**
+ * Load block first as the real part and block second as the imaginary
+ * part, each followed by as many zeros, and zero past the end.
+ */
+static void load(complex double * z, uint64_t first, uint64_t second)
+{
+    uint64_t size = 2 * length;
+    uint64_t ii;
+
+    for (ii = 0; ii < size; ++ii) {
+        z[ii] = 0.0;
+    }
+
+    for (ii = 0; (ii < length) && (((first * length) + ii) < nbits); ++ii) {
+        z[ii] += bit((first * length) + ii);
+    }
+
+    for (ii = 0; (ii < length) && (((second * length) + ii) < nbits); ++ii) {
+        z[ii] += bit((second * length) + ii) * I;
+    }
+}
+
+static void * fft(void * arg)
+{
+    work_t * wp = (work_t *)arg;
+    uint64_t size = 2 * length;
+    uint64_t blocks = (nbits + length - 1) / length;
+    uint64_t begin = (blocks * wp->index) / threads;
+    uint64_t end = (blocks * (wp->index + 1)) / threads;
+    complex double * z;
+    complex double * prior;
+    complex double a;
+    complex double b;
+    complex double x;
+    complex double p;
+    complex double q;
+    double sign;
+    uint64_t block;
+    uint64_t ii;
+    uint64_t lag;
+
+    if (begin >= end) {
+        return (void *)0;
+    }
+
+    z = (complex double *)malloc(size * sizeof(complex double));
+    prior = (complex double *)malloc(size * sizeof(complex double));
+    if ((z == (complex double *)0) || (prior == (complex double *)0)) {
+        free(z);
+        free(prior);
+        return (void *)0;
+    }
+
+    /*
+     * Each thread takes a run of consecutive blocks, so that the spectrum
+     * of each block, zero padded to twice its length, is transformed once
+     * and kept for the block before it. The first has no partner.
+     */
+
+    load(prior, begin, blocks);
+    transform(prior);
+
+    for (block = begin; block < end; block += 2) {
+
+        /*
+         * Transform the next two blocks at once, as the real and the
+         * imaginary parts, and separate their spectra a and b.
+         */
+
+        load(z, block + 1, block + 2);
+        transform(z);
+
+        /*
+         * Block k followed by block k + 1 is x + (-1)^f a, since a delay of
+         * the block length multiplies frequency f by (-1)^f, so the cross
+         * correlation of block k with the two is conj(x) (x + (-1)^f a), and
+         * that of block k + 1 is conj(a) (a + (-1)^f b). Both products are
+         * Hermitian, so only their lower halves are computed, and they are
+         * combined as the real and the imaginary parts of one inverse
+         * transform. It is conjugated so that the forward transform computes
+         * the inverse. The spectrum b is kept for the next pair.
+         */
+
+        for (ii = 0; ii <= (size / 2); ++ii) {
+            a = (z[ii] + conj(z[(size - ii) % size])) / 2.0;
+            b = (z[ii] - conj(z[(size - ii) % size])) / (2.0 * I);
+            x = prior[ii];
+            sign = (ii & 1) ? -1.0 : 1.0;
+            p = conj(x) * (x + (sign * a));
+            q = conj(a) * (a + (sign * b));
+            z[ii] = conj(p + (I * q));
+            prior[ii] = b;
+            if ((ii > 0) && (ii < (size / 2))) {
+                z[size - ii] = p - (I * q);
+                prior[size - ii] = conj(b);
+            }
+        }
+
+        transform(z);
+
+        for (lag = 1; lag <= lags; ++lag) {
+            wp->totals[lag] += (int64_t)llround(creal(z[lag]) / size);
+        }
+
+        if ((block + 1) < end) {
+            for (lag = 1; lag <= lags; ++lag) {
+                wp->totals[lag] -= (int64_t)llround(cimag(z[lag]) / size);
+            }
+        }
+
+    }
+
+    free(z);
+    free(prior);
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+/**
+ * Return the deviation beyond which a lag is flagged, so that the chance
+ * that any of the lags is flagged for an ideal source is alpha.
+ */
+static double threshold(double alpha, uint64_t count)
+{
+    double low = 0.0;
+    double high = 40.0;
+    double middle;
+    double target;
+    int ii;
+
+    target = alpha / count;
+
+    for (ii = 0; ii < 100; ++ii) {
+        middle = (low + high) / 2.0;
+        if (erfc(middle / M_SQRT2) > target) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return high;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int csv = 0;
+    int automatic = !0;
+    enum method method = POPCOUNT;
+    double alpha = 0.01;
+    double sigmas = 0.0;
+    work_t * works = (work_t *)0;
+    int64_t * totals = (int64_t *)0;
+    struct stat status;
+    void * pointer = MAP_FAILED;
+    const unsigned char * data;
+    uint64_t epoch;
+    uint64_t elapsed;
+    uint64_t lag;
+    uint64_t pairs;
+    int64_t agreement;
+    double correlation;
+    double z;
+    double worst = 0.0;
+    uint64_t worstlag = 0;
+    uint64_t flagged = 0;
+    uint64_t ii;
+    long started = 0;
+    long tt;
+    char * end = (char *)0;
+    int fd = -1;
+    int rc = 0;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "a:chk:m:s:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'a':
+            alpha = strtod(optarg, &end);
+            if ((*end != '\0') || (!(alpha > 0.0)) || (!(alpha < 1.0))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'c':
+            csv = !0;
+            break;
+
+        case 'k':
+            lags = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (lags == 0) || (lags > (1ULL << 24))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            automatic = 0;
+            if (strcmp(optarg, METHODS[POPCOUNT]) == 0) {
+                method = POPCOUNT;
+            } else if (strcmp(optarg, METHODS[FFT]) == 0) {
+                method = FFT;
+            } else {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            sigmas = strtod(optarg, &end);
+            if ((*end != '\0') || (!(sigmas > 0.0))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error || ((optind + 1) != argc)) {
+            usage();
+            break;
+        }
+
+        /*
+         * Map the capture and copy it into words whose most significant
+         * bit is the earliest.
+         */
+
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[optind]);
+            break;
+        }
+
+        if (fstat(fd, &status) < 0) {
+            perror(argv[optind]);
+            break;
+        }
+
+        nwords = status.st_size / sizeof(uint64_t);
+        nbits = nwords * 64;
+        if (nbits <= lags) {
+            errno = ENODATA;
+            perror(argv[optind]);
+            break;
+        }
+
+        pointer = mmap((void *)0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (pointer == MAP_FAILED) {
+            perror("mmap");
+            break;
+        }
+        (void)madvise(pointer, status.st_size, MADV_SEQUENTIAL);
+        data = (const unsigned char *)pointer;
+
+        words = (uint64_t *)malloc((nwords + 1) * sizeof(uint64_t));
+        if (words == (uint64_t *)0) {
+            perror("malloc");
+            break;
+        }
+
+        for (ii = 0; ii < nwords; ++ii) {
+            memcpy(&words[ii], &data[ii * sizeof(uint64_t)], sizeof(uint64_t));
+            words[ii] = __builtin_bswap64(words[ii]);
+        }
+        words[nwords] = 0;
+
+        munmap(pointer, status.st_size);
+        pointer = MAP_FAILED;
+
+        if (automatic) {
+            method = (lags <= AUTOMATIC) ? POPCOUNT : FFT;
+        }
+
+        if (sigmas == 0.0) {
+            sigmas = threshold(alpha, lags);
+        }
+
+        if (threads == 0) {
+            threads = sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads <= 0) {
+                threads = 1;
+            }
+        }
+
+        if (method == FFT) {
+            for (length = 64; length < lags; length <<= 1) {
+                /* Do nothing. */
+            }
+            if (prepare() < 0) {
+                perror("malloc");
+                break;
+            }
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: file=\"%s\" bits=%llu lags=%llu method=%s threads=%ld threshold=%.2f\n", program, argv[optind], (unsigned long long)nbits, (unsigned long long)lags, METHODS[method], threads, sigmas);
+        }
+
+        /*
+         * Scan in parallel, each thread with its own totals.
+         */
+
+        works = (work_t *)calloc(threads, sizeof(work_t));
+        totals = (int64_t *)calloc(lags + 1, sizeof(int64_t));
+        if ((works == (work_t *)0) || (totals == (int64_t *)0)) {
+            perror("calloc");
+            break;
+        }
+
+        for (tt = 0; tt < threads; ++tt) {
+            works[tt].index = tt;
+            works[tt].totals = (int64_t *)calloc(lags + 1, sizeof(int64_t));
+            if (works[tt].totals == (int64_t *)0) {
+                break;
+            }
+        }
+        if (tt < threads) {
+            perror("calloc");
+            break;
+        }
+
+        epoch = now();
+
+        for (started = 0; started < threads; ++started) {
+            rc = pthread_create(&works[started].thread, (pthread_attr_t *)0, (method == FFT) ? fft : popcount, &works[started]);
+            if (rc != 0) {
+                errno = rc;
+                perror("pthread_create");
+                break;
+            }
+        }
+
+        for (tt = 0; tt < started; ++tt) {
+            pthread_join(works[tt].thread, (void **)0);
+            for (lag = 1; lag <= lags; ++lag) {
+                totals[lag] += works[tt].totals[lag];
+            }
+        }
+
+        elapsed = now() - epoch;
+
+        if (rc != 0) {
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: seconds=%.3f bits/second=%.0f\n", program, elapsed / 1000000000.0, nbits / (elapsed / 1000000000.0));
+        }
+
+        /*
+         * Report. Popcount totals the pairs that differ; FFT totals the
+         * products, which are the pairs that agree less those that differ.
+         */
+
+        if (csv) {
+            printf("%s,%s,%s,%s,%s\n", "Lag", "Pairs", "Different", "Correlation", "Z");
+        }
+
+        for (lag = 1; lag <= lags; ++lag) {
+            pairs = nbits - lag;
+            agreement = (method == FFT) ? totals[lag] : (int64_t)pairs - (2 * totals[lag]);
+            correlation = (double)agreement / pairs;
+            z = (double)agreement / sqrt((double)pairs);
+            if (fabs(z) > fabs(worst)) {
+                worst = z;
+                worstlag = lag;
+            }
+            if (csv) {
+                printf("%llu,%llu,%llu,%.9f,%.3f\n", (unsigned long long)lag, (unsigned long long)pairs, (unsigned long long)((pairs - agreement) / 2), correlation, z);
+            } else if (fabs(z) < sigmas) {
+                /* Do nothing. */
+            } else if ((lag % 8) == 0) {
+                printf("%s: lag=%llu bytes=%llu correlation=%.6f z=%.2f\n", program, (unsigned long long)lag, (unsigned long long)(lag / 8), correlation, z);
+            } else {
+                printf("%s: lag=%llu correlation=%.6f z=%.2f\n", program, (unsigned long long)lag, correlation, z);
+            }
+            if (fabs(z) >= sigmas) {
+                ++flagged;
+            }
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: flagged=%llu worst=%llu z=%.2f\n", program, (unsigned long long)flagged, (unsigned long long)worstlag, worst);
+        }
+
+        xc = (flagged > 0) ? 2 : 0;
+
+    } while (0);
+
+    if (works != (work_t *)0) {
+        for (tt = 0; tt < threads; ++tt) {
+            free(works[tt].totals);
+        }
+    }
+    free(works);
+    free(totals);
+    free(words);
+    free(twiddles);
+    free(reversals);
+
+    if (pointer != MAP_FAILED) {
+        munmap(pointer, status.st_size);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return xc;
+}
@@ -30,10 +30,14 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <errno.h>
+#include <unistd.h>
+#include "output.h"
 
 int main(int argc, char * argv[])
 {
     uint8_t value = 0;
+    output_t * op;
+    int rc;
 	if (argc >= 2) {
         char * end;
         value = strtoul(argv[1], &end, 0);
@@ -43,11 +47,17 @@ int main(int argc, char * argv[])
             return 1;
         }
     }
+    op = output_open(STDOUT_FILENO, 0, 0, (const volatile int *)0);
+    if (op == (output_t *)0) {
+        perror("output_open");
+        return 1;
+    }
     while (!0) {
-        if (fwrite(&value, sizeof(value), 1, stdout) == 1) {
+        rc = output_write(op, &value, sizeof(value));
+        if (rc == 0) {
             /* Do nothing. */
-        } else if (ferror(stdout)) {
-            perror("fwrite");
+        } else if (rc < 0) {
+            perror("output_write");
             return 1;
         } else {
             return 0;
@@ -34,10 +34,14 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include "output.h"
 
 int main(int argc, char * argv[])
 {
     int32_t value;
+    output_t * op;
+    int rc;
     if ((argc >= 2) && (strcmp(argv[1], "-v") == 0)) {
         const char * program;
         fprintf(stderr, "%s: RAND_MAX=%u\n", ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1, RAND_MAX);
@@ -55,12 +59,18 @@ int main(int argc, char * argv[])
         }
         srandom((unsigned int)seed);
     }
+    op = output_open(STDOUT_FILENO, 0, 0, (const volatile int *)0);
+    if (op == (output_t *)0) {
+        perror("output_open");
+        return 1;
+    }
     while (!0) {
         value = random();
-        if (fwrite(&value, sizeof(value), 1, stdout) == 1) {
+        rc = output_write(op, &value, sizeof(value));
+        if (rc == 0) {
             /* Do nothing. */
-        } else if (ferror(stdout)) {
-            perror("fwrite");
+        } else if (rc < 0) {
+            perror("output_write");
             return 1;
         } else {
             return 0;
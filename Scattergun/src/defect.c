@@ -0,0 +1,591 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Defect<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * defect [ -h ] [ -v ] -d DEFECT [ -o OFFSET ] [ -n BYTES ] [ -r RATE ] [ -p PARAMETER ] [ -s SEED ] [ -m PATH ] [ -b BYTES ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Read and write this many bytes at a time (default 4096).
+ * -d DEFECT       Inject this defect.
+ * -h              Display this menu.
+ * -m PATH         Write the injection metadata to this sidecar file.
+ * -n BYTES        Inject for this many bytes (default 0 for unlimited).
+ * -o OFFSET       Begin injecting at this byte offset (default 0).
+ * -p PARAMETER    Use this defect parameter (see below).
+ * -r RATE         Use this defect rate between 0.0 and 1.0 (see below).
+ * -s SEED         Seed the injection generator (default 1).
+ * -v              Display verbose output to stderr.
+ *
+ * DEFECTS
+ *
+ * bias            Each bit is forced to one with probability RATE (default
+ *                 0.05), biasing the stream toward ones.
+ * stuck0          The bits in mask PARAMETER (default 0x01) of each byte are
+ *                 forced to zero with probability RATE (default 1.0).
+ * stuck1          The bits in mask PARAMETER (default 0x01) of each byte are
+ *                 forced to one with probability RATE (default 1.0).
+ * repeat          The PARAMETER (default 16) bytes at OFFSET are repeated;
+ *                 each subsequent period is a repeat with probability RATE
+ *                 (default 1.0) and passes through otherwise.
+ * correlation     Each bit repeats the previous output bit with probability
+ *                 RATE (default 0.05), introducing serial correlation.
+ * dropout         Each byte begins a run of PARAMETER (default 64) zero bytes
+ *                 with probability RATE (default 0.0001), as when a device
+ *                 briefly delivers nothing but zeros.
+ *
+ * EXAMPLES
+ *
+ * prng | defect -d stuck1 -p 0x80 -o 1048576 -m defect.csv | detect -m defect.csv -b rct -b apt
+ *
+ * dd if=/dev/TrueRNG | defect -d bias -r 0.01 -o 10000000 -n 1000000 > biased.dat
+ *
+ * ABSTRACT
+ *
+ * Copies a known good stream from standard input to standard output, injecting
+ * a configurable defect beginning at a chosen offset, for a chosen length, at
+ * a chosen rate, so that we can measure how quickly our health tests and
+ * monitors notice realistic failures. The injection is driven by its own
+ * seeded xoshiro256** generator so that a run can be reproduced exactly given
+ * the same input. The metadata for each injection (the defect, its offset and
+ * length in bytes, the rate, the parameter and the seed) is written as a CSV
+ * file to the sidecar, one line for a defect that is continuous over its
+ * window and one line per episode for the repeat and dropout defects, each
+ * flushed as it happens. A repeat episode is a run of consecutive repeated
+ * periods, the first beginning with the captured period; its line is written
+ * when the run starts and rewritten with the length of the whole run when it
+ * stops, so that the sidecar has a line per run rather than per period. The
+ * detect harness reads the sidecar to learn where the defect begins.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+static const char * program = "defect";
+
+enum defect { NONE, BIAS, STUCK0, STUCK1, REPEAT, CORRELATION, DROPOUT, };
+
+static const char * DEFECTS[] = { "none", "bias", "stuck0", "stuck1", "repeat", "correlation", "dropout", };
+
+static const double RATES[] = { 0.0, 0.05, 1.0, 1.0, 1.0, 0.05, 0.0001, };
+
+static const unsigned long PARAMETERS[] = { 0, 0, 0x01, 0x01, 16, 0, 64, };
+
+static uint64_t state[4];
+
+static uint64_t splitmix64(uint64_t * xp)
+{
+    uint64_t z = (*xp += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t next(void)
+{
+    const uint64_t result = rotl64(state[1] * 5, 7) * 9;
+    const uint64_t t = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl64(state[3], 45);
+
+    return result;
+}
+
+/**
+ * Return true with the probability represented by the threshold, which is
+ * the probability scaled to 2^32.
+ */
+static inline int chance(uint64_t threshold)
+{
+    return (next() >> 32) < threshold;
+}
+
+/**
+ * Return a byte in which each bit is set with the probability represented
+ * by the threshold, which is the probability scaled to 2^16.
+ */
+static inline uint8_t mask(uint32_t threshold)
+{
+    uint64_t word;
+    uint8_t result = 0;
+    int ii;
+
+    word = next();
+    for (ii = 0; ii < 4; ++ii) {
+        if ((word & 0xffff) < threshold) { result |= 1 << ii; }
+        word >>= 16;
+    }
+    word = next();
+    for (ii = 4; ii < 8; ++ii) {
+        if ((word & 0xffff) < threshold) { result |= 1 << ii; }
+        word >>= 16;
+    }
+
+    return result;
+}
+
+/**
+ * Append an episode to the sidecar.
+ * @return the position of its line in the sidecar, or <0 if there is none.
+ */
+static long record(FILE * sidecar, enum defect defect, uint64_t offset, uint64_t length, double rate, unsigned long parameter, uint64_t seed)
+{
+    long where = -1;
+
+    if (sidecar != (FILE *)0) {
+        where = ftell(sidecar);
+        fprintf(sidecar, "%s,%lu,%lu,%lf,0x%lx,0x%lx\n", DEFECTS[defect], offset, length, rate, parameter, seed);
+        fflush(sidecar);
+    }
+
+    return where;
+}
+
+/**
+ * Rewrite the last episode in the sidecar, whose line begins at where, with
+ * its final length, truncating anything left of the old line.
+ */
+static void rewrite(FILE * sidecar, long where, enum defect defect, uint64_t offset, uint64_t length, double rate, unsigned long parameter, uint64_t seed)
+{
+    if ((sidecar != (FILE *)0) && (where >= 0) && (fseek(sidecar, where, SEEK_SET) == 0)) {
+        fprintf(sidecar, "%s,%lu,%lu,%lf,0x%lx,0x%lx\n", DEFECTS[defect], offset, length, rate, parameter, seed);
+        fflush(sidecar);
+        (void)ftruncate(fileno(sidecar), ftell(sidecar));
+    }
+}
+
+static void usage(void)
+{
+    int ii;
+
+    fprintf(stderr, "usage: %s [ -b BYTES ] -d DEFECT [ -h ] [ -m PATH ] [ -n BYTES ] [ -o OFFSET ] [ -p PARAMETER ] [ -r RATE ] [ -s SEED ] [ -v ]\n", program);
+    fprintf(stderr, "       -b BYTES        Read and write this many bytes at a time.\n");
+    fprintf(stderr, "       -d DEFECT       Inject this defect.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -m PATH         Write the injection metadata to this sidecar file.\n");
+    fprintf(stderr, "       -n BYTES        Inject for this many bytes (0 for unlimited).\n");
+    fprintf(stderr, "       -o OFFSET       Begin injecting at this byte offset.\n");
+    fprintf(stderr, "       -p PARAMETER    Use this defect parameter.\n");
+    fprintf(stderr, "       -r RATE         Use this defect rate between 0.0 and 1.0.\n");
+    fprintf(stderr, "       -s SEED         Seed the injection generator.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    for (ii = 1; ii < (sizeof(DEFECTS) / sizeof(DEFECTS[0])); ++ii) {
+        fprintf(stderr, "       DEFECT          %s\n", DEFECTS[ii]);
+    }
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    enum defect defect = NONE;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    double rate = -1.0;
+    unsigned long parameter = 0;
+    int haveparameter = 0;
+    uint64_t seed = 1;
+    const char * path = (const char *)0;
+    size_t size = 4096;
+    FILE * sidecar = (FILE *)0;
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t * history = (uint8_t *)0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    int ii;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:d:hm:n:o:p:r:s:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'd':
+            for (ii = 1; ii < (sizeof(DEFECTS) / sizeof(DEFECTS[0])); ++ii) {
+                if (strcmp(optarg, DEFECTS[ii]) == 0) {
+                    defect = (enum defect)ii;
+                    break;
+                }
+            }
+            if (defect == NONE) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'm':
+            path = optarg;
+            break;
+
+        case 'n':
+            length = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            offset = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            parameter = strtoul(optarg, &end, 0);
+            haveparameter = !0;
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            rate = strtod(optarg, &end);
+            if ((*end != '\0') || (rate < 0.0) || (rate > 1.0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            seed = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+        uint64_t position = 0;
+        uint64_t limit = 0;
+        uint64_t threshold32 = 0;
+        uint32_t threshold16 = 0;
+        uint64_t injected = 0;
+        uint64_t episodes = 0;
+        uint64_t run = 0;
+        uint64_t scratch = 0;
+        uint64_t start = 0;
+        uint64_t span = 0;
+        uint64_t spanned = 0;
+        uint64_t period = 0;
+        long where = -1;
+        int repeating = 0;
+        int previous = -1;
+        ssize_t bytes = 0;
+        size_t index = 0;
+        uint8_t byte = 0;
+        uint8_t bits = 0;
+        int bb;
+
+        if (error) {
+            break;
+        }
+
+        if (defect == NONE) {
+            usage();
+            break;
+        }
+
+        if (rate < 0.0) {
+            rate = RATES[defect];
+        }
+        if (!haveparameter) {
+            parameter = PARAMETERS[defect];
+        }
+        if ((defect == REPEAT) && (parameter == 0)) {
+            errno = EINVAL;
+            perror("-p");
+            break;
+        }
+
+        threshold32 = (uint64_t)(rate * 4294967296.0);
+        threshold16 = (uint32_t)(rate * 65536.0);
+        limit = (length == 0) ? ~(uint64_t)0 : offset + length;
+
+        scratch = seed;
+        for (ii = 0; ii < 4; ++ii) {
+            state[ii] = splitmix64(&scratch);
+        }
+
+        signal(SIGPIPE, SIG_IGN);
+
+        if (path != (const char *)0) {
+            sidecar = fopen(path, "w");
+            if (sidecar == (FILE *)0) {
+                perror(path);
+                break;
+            }
+            fprintf(sidecar, "%s,%s,%s,%s,%s,%s\n", "Defect", "Offset", "Length", "Rate", "Parameter", "Seed");
+            fflush(sidecar);
+        }
+
+        buffer = (uint8_t *)malloc(size);
+        if (buffer == (uint8_t *)0) {
+            perror("malloc");
+            break;
+        }
+
+        if (defect == REPEAT) {
+            history = (uint8_t *)malloc(parameter);
+            if (history == (uint8_t *)0) {
+                perror("malloc");
+                break;
+            }
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: defect %s\n", program, DEFECTS[defect]);
+            fprintf(stderr, "%s: offset %lu\n", program, offset);
+            fprintf(stderr, "%s: length %lu\n", program, length);
+            fprintf(stderr, "%s: rate %lf\n", program, rate);
+            fprintf(stderr, "%s: parameter 0x%lx\n", program, parameter);
+            fprintf(stderr, "%s: seed 0x%lx\n", program, seed);
+        }
+
+        if ((defect != REPEAT) && (defect != DROPOUT)) {
+            record(sidecar, defect, offset, length, rate, parameter, seed);
+            episodes = 1;
+        }
+
+        xc = 0;
+
+        while ((bytes = read(STDIN_FILENO, buffer, size)) != 0) {
+
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("read");
+                xc = 1;
+                break;
+            }
+
+            for (index = 0; index < bytes; ++index, ++position) {
+
+                if (position < offset) {
+                    continue;
+                }
+
+                if (position >= limit) {
+                    break;
+                }
+
+                byte = buffer[index];
+
+                switch (defect) {
+
+                case BIAS:
+                    byte |= mask(threshold16);
+                    break;
+
+                case STUCK0:
+                    if (chance(threshold32)) {
+                        byte &= ~parameter;
+                    }
+                    break;
+
+                case STUCK1:
+                    if (chance(threshold32)) {
+                        byte |= parameter;
+                    }
+                    break;
+
+                case REPEAT:
+                    /*
+                     * The first period is captured as is and begins the
+                     * first episode; each subsequent period is decided at
+                     * its first byte, and extends the episode if the
+                     * previous period was also a repeat.
+                     */
+                    period = (limit - position < parameter) ? (limit - position) : parameter;
+                    if (position == offset) {
+                        history[0] = byte;
+                        repeating = !0;
+                        start = position;
+                        span = period;
+                        spanned = span;
+                        where = record(sidecar, defect, start, span, rate, parameter, seed);
+                        ++episodes;
+                    } else if ((position - offset) < parameter) {
+                        history[position - offset] = byte;
+                    } else if (((position - offset) % parameter) != 0) {
+                        if (repeating) {
+                            byte = history[(position - offset) % parameter];
+                        }
+                    } else if (chance(threshold32)) {
+                        byte = history[0];
+                        if (repeating) {
+                            span += period;
+                        } else {
+                            repeating = !0;
+                            start = position;
+                            span = period;
+                            spanned = span;
+                            where = record(sidecar, defect, start, span, rate, parameter, seed);
+                            ++episodes;
+                        }
+                    } else {
+                        if (repeating && (span != spanned)) {
+                            rewrite(sidecar, where, defect, start, span, rate, parameter, seed);
+                        }
+                        repeating = 0;
+                    }
+                    break;
+
+                case CORRELATION:
+                    bits = 0;
+                    for (bb = 7; bb >= 0; --bb) {
+                        int bit = (byte >> bb) & 1;
+                        if (previous < 0) {
+                            /* Do nothing. */
+                        } else if (chance(threshold32)) {
+                            bit = previous;
+                        } else {
+                            /* Do nothing. */
+                        }
+                        bits = (bits << 1) | bit;
+                        previous = bit;
+                    }
+                    byte = bits;
+                    break;
+
+                case DROPOUT:
+                    if (run > 0) {
+                        --run;
+                        byte = 0;
+                    } else if (chance(threshold32)) {
+                        run = (parameter > 0) ? parameter - 1 : 0;
+                        byte = 0;
+                        record(sidecar, defect, position, (limit - position < parameter) ? (limit - position) : parameter, rate, parameter, seed);
+                        ++episodes;
+                    } else {
+                        /* Do nothing. */
+                    }
+                    break;
+
+                default:
+                    break;
+
+                }
+
+                if (byte != buffer[index]) {
+                    ++injected;
+                }
+
+                buffer[index] = byte;
+
+            }
+
+            /*
+             * The loop above may have stopped early at the end of the
+             * window, so position is recomputed from what was read.
+             */
+
+            position += bytes - index;
+
+            if (fwrite(buffer, bytes, 1, stdout) == 1) {
+                /* Do nothing. */
+            } else if (errno == EPIPE) {
+                break;
+            } else {
+                perror("fwrite");
+                xc = 1;
+                break;
+            }
+
+        }
+
+        if (repeating && (span != spanned)) {
+            rewrite(sidecar, where, defect, start, span, rate, parameter, seed);
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: total %lu bytes\n", program, position);
+            fprintf(stderr, "%s: altered %lu bytes\n", program, injected);
+            fprintf(stderr, "%s: episodes %lu\n", program, episodes);
+        }
+
+    } while (0);
+
+    if (sidecar != (FILE *)0) {
+        fclose(sidecar);
+    }
+
+    free(history);
+    free(buffer);
+
+    return xc;
+}
@@ -0,0 +1,859 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Detect<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * detect [ -h ] [ -v ] [ -o OFFSET | -m PATH ] [ -b DETECTOR ... ] [ -x COMMAND ... ] [ -e PATTERN ] [ -H BITS ] [ -a ALPHA ] [ -l BYTES ] [ -z BYTES ]
+ *
+ * OPTIONS
+ *
+ * -a ALPHA        Use a false alarm probability of 2^-ALPHA (default 30).
+ * -b DETECTOR     Run this built in detector (may be repeated).
+ * -e PATTERN      Detect when a command outputs a line matching this extended
+ *                 regular expression (default "[Ff]ail|FAIL").
+ * -H BITS         Assume this much min-entropy per byte (default 8.0).
+ * -h              Display this menu.
+ * -l BYTES        Stop after reading this many bytes (default 0 for unlimited).
+ * -m PATH         Read the defect offset from this defect sidecar file.
+ * -o OFFSET       The defect begins at this byte offset (default 0).
+ * -v              Display verbose output to stderr.
+ * -x COMMAND      Run this shell command as a detector (may be repeated).
+ * -z BYTES        Read this many bytes at a time (default 4096).
+ *
+ * DETECTORS
+ *
+ * rct             SP800-90B Repetition Count Test on byte samples.
+ * apt             SP800-90B Adaptive Proportion Test on byte samples with
+ *                 a window of 512 samples.
+ * monobit         Proportion of ones in each block of 20000 bits.
+ * serial          Proportion of bit transitions in each block of 20000 bits.
+ *
+ * EXAMPLES
+ *
+ * prng | defect -d dropout -o 1048576 -m defect.csv | detect -m defect.csv -b rct -b apt -b monobit -b serial
+ *
+ * prng | defect -d bias -r 0.01 -o 1048576 | detect -o 1048576 -b monobit -x "rngtest" -l 104857600
+ *
+ * ABSTRACT
+ *
+ * Reads a stream into which the defect program has injected a defect at a
+ * known offset, feeds it to each detector under test, and reports for each
+ * detector the position at which it first detected a failure, the number of
+ * bytes and the number of nanoseconds from the start of the defect to its
+ * detection, as a CSV file with one line per detector. A detector that
+ * alarms before the defect begins is reported as a false alarm; one that
+ * never alarms is reported as a miss. The built in detectors are the
+ * continuous health tests from NIST SP800-90B plus two simple block tests,
+ * with cutoffs computed from the assumed min-entropy and the false alarm
+ * probability. An external detector is a shell command that reads the stream
+ * on its standard input; it is considered to have detected a failure when it
+ * exits with a non-zero status or writes a line matching the pattern to its
+ * standard output or standard error. Because an external detector buffers
+ * its input, the position reported for it is the number of bytes delivered
+ * to it when its detection was observed, which is an upper bound. The
+ * harness stops when every detector has alarmed, when it reaches its limit,
+ * or at end of file.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <regex.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "sp80090b.h"
+
+static const char * program = "detect";
+
+enum type { NONE, RCT, APT, MONOBIT, SERIAL, };
+
+static const char * TYPES[] = { "none", "rct", "apt", "monobit", "serial", };
+
+enum { DETECTORS = 16, APTWINDOW = 512, BLOCKBITS = 20000, };
+
+enum { SKEW = 1, }; /* Seconds a sidecar may predate us and still be current. */
+
+static time_t since = 0;
+
+typedef struct Builtin {
+    enum type type;
+    uint64_t cutoff;
+    uint64_t count;
+    uint64_t samples;
+    uint64_t ones;
+    uint64_t transitions;
+    int previous;
+    uint8_t sample;
+    int64_t detected;
+    uint64_t nanoseconds;
+} builtin_t;
+
+typedef struct External {
+    const char * command;
+    pid_t pid;
+    int in;
+    int out;
+    size_t used;
+    uint64_t delivered;
+    int64_t detected;
+    uint64_t nanoseconds;
+    char line[512];
+} external_t;
+
+static builtin_t builtins[DETECTORS];
+
+static external_t externals[DETECTORS];
+
+static regex_t regex;
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/**
+ * Return the number of standard deviations from the mean beyond which a
+ * normally distributed statistic occurs with probability 2^-alpha.
+ */
+static double zcutoff(double alpha)
+{
+    double limit = pow(2.0, -alpha);
+    double lo = 0.0;
+    double hi = 40.0;
+    double mid;
+    int ii;
+
+    for (ii = 0; ii < 100; ++ii) {
+        mid = (lo + hi) / 2.0;
+        if (erfc(mid / sqrt(2.0)) > limit) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return hi;
+}
+
+/**
+ * Run a built in detector over a buffer, returning true if it alarms.
+ */
+static int examine(builtin_t * bp, const uint8_t * buffer, size_t bytes, uint64_t position, double z)
+{
+    size_t ii;
+    int bb;
+
+    for (ii = 0; ii < bytes; ++ii) {
+
+        uint8_t byte = buffer[ii];
+
+        switch (bp->type) {
+
+        case RCT:
+            if ((bp->samples > 0) && (byte == bp->sample)) {
+                if ((++bp->count) >= bp->cutoff) {
+                    bp->detected = position + ii;
+                    return !0;
+                }
+            } else {
+                bp->sample = byte;
+                bp->count = 1;
+            }
+            ++bp->samples;
+            break;
+
+        case APT:
+            if ((bp->samples % APTWINDOW) == 0) {
+                bp->sample = byte;
+                bp->count = 0;
+            } else if (byte == bp->sample) {
+                if ((++bp->count) >= bp->cutoff) {
+                    bp->detected = position + ii;
+                    return !0;
+                }
+            } else {
+                /* Do nothing. */
+            }
+            ++bp->samples;
+            break;
+
+        case MONOBIT:
+        case SERIAL:
+            for (bb = 7; bb >= 0; --bb) {
+                int bit = (byte >> bb) & 1;
+                bp->ones += bit;
+                if ((bp->previous >= 0) && (bit != bp->previous)) {
+                    ++bp->transitions;
+                }
+                bp->previous = bit;
+                if ((++bp->samples) < BLOCKBITS) {
+                    continue;
+                }
+                if (bp->type == MONOBIT) {
+                    if (fabs(((double)bp->ones - (BLOCKBITS / 2.0)) / sqrt(BLOCKBITS / 4.0)) > z) {
+                        bp->detected = position + ii;
+                        return !0;
+                    }
+                } else {
+                    if (fabs(((double)bp->transitions - ((BLOCKBITS - 1) / 2.0)) / sqrt((BLOCKBITS - 1) / 4.0)) > z) {
+                        bp->detected = position + ii;
+                        return !0;
+                    }
+                }
+                bp->samples = 0;
+                bp->ones = 0;
+                bp->transitions = 0;
+                bp->previous = -1;
+            }
+            break;
+
+        default:
+            break;
+
+        }
+
+    }
+
+    return 0;
+}
+
+static int spawn(external_t * xp)
+{
+    int inpipe[2] = { -1, -1 };
+    int outpipe[2] = { -1, -1 };
+    pid_t pid;
+
+    if (pipe(inpipe) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    if (pipe(outpipe) < 0) {
+        perror("pipe");
+        close(inpipe[0]);
+        close(inpipe[1]);
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(inpipe[0]);
+        close(inpipe[1]);
+        close(outpipe[0]);
+        close(outpipe[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        dup2(inpipe[0], STDIN_FILENO);
+        dup2(outpipe[1], STDOUT_FILENO);
+        dup2(outpipe[1], STDERR_FILENO);
+        close(inpipe[0]);
+        close(inpipe[1]);
+        close(outpipe[0]);
+        close(outpipe[1]);
+        signal(SIGPIPE, SIG_DFL);
+        execl("/bin/sh", "sh", "-c", xp->command, (char *)0);
+        _exit(127);
+    }
+
+    close(inpipe[0]);
+    close(outpipe[1]);
+    fcntl(inpipe[1], F_SETFL, fcntl(inpipe[1], F_GETFL) | O_NONBLOCK);
+    fcntl(outpipe[0], F_SETFL, fcntl(outpipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(inpipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(outpipe[0], F_SETFD, FD_CLOEXEC);
+
+    xp->pid = pid;
+    xp->in = inpipe[1];
+    xp->out = outpipe[0];
+
+    return 0;
+}
+
+static void detected(external_t * xp)
+{
+    if (xp->detected < 0) {
+        xp->detected = xp->delivered;
+        xp->nanoseconds = now();
+    }
+    if (xp->in >= 0) {
+        close(xp->in);
+        xp->in = -1;
+    }
+}
+
+/**
+ * Consume whatever an external detector has written, scanning it line by
+ * line, and check whether it has exited.
+ */
+static void collect(external_t * xp, int verbose)
+{
+    ssize_t bytes = -1;
+    char * nl;
+    int status;
+
+    while ((xp->out >= 0) && ((bytes = read(xp->out, xp->line + xp->used, sizeof(xp->line) - 1 - xp->used)) != 0)) {
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        xp->used += bytes;
+        xp->line[xp->used] = '\0';
+        while (((nl = strchr(xp->line, '\n')) != (char *)0) || (xp->used >= (sizeof(xp->line) - 1))) {
+            if (nl != (char *)0) {
+                *nl = '\0';
+            }
+            if (verbose) {
+                fprintf(stderr, "%s: \"%s\" \"%s\"\n", program, xp->command, xp->line);
+            }
+            if (regexec(&regex, xp->line, 0, (regmatch_t *)0, 0) == 0) {
+                detected(xp);
+            }
+            if (nl == (char *)0) {
+                xp->used = 0;
+            } else {
+                xp->used -= (nl + 1) - xp->line;
+                memmove(xp->line, nl + 1, xp->used + 1);
+            }
+        }
+    }
+
+    if (bytes == 0) {
+        close(xp->out);
+        xp->out = -1;
+    }
+
+    if ((xp->pid > 0) && (waitpid(xp->pid, &status, WNOHANG) == xp->pid)) {
+        xp->pid = 0;
+        if (!(WIFEXITED(status) && (WEXITSTATUS(status) == 0))) {
+            detected(xp);
+        }
+        if (xp->in >= 0) {
+            close(xp->in);
+            xp->in = -1;
+        }
+        if (verbose) {
+            fprintf(stderr, "%s: \"%s\" status %d\n", program, xp->command, status);
+        }
+    }
+}
+
+/**
+ * Deliver a buffer to every external detector still listening, servicing
+ * their output while waiting so that none of them can stall on a full pipe.
+ */
+static void deliver(int nexternals, const uint8_t * buffer, size_t bytes, int verbose)
+{
+    struct pollfd fds[DETECTORS * 2];
+    size_t offsets[DETECTORS];
+    int pending;
+    int nfds;
+    int ii;
+
+    for (ii = 0; ii < nexternals; ++ii) {
+        offsets[ii] = 0;
+    }
+
+    do {
+        pending = 0;
+        nfds = 0;
+        for (ii = 0; ii < nexternals; ++ii) {
+            if ((externals[ii].in >= 0) && (offsets[ii] < bytes)) {
+                fds[nfds].fd = externals[ii].in;
+                fds[nfds].events = POLLOUT;
+                ++nfds;
+                ++pending;
+            }
+            if (externals[ii].out >= 0) {
+                fds[nfds].fd = externals[ii].out;
+                fds[nfds].events = POLLIN;
+                ++nfds;
+            }
+        }
+        if (pending == 0) {
+            break;
+        }
+        if (poll(fds, nfds, 100) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        for (ii = 0; ii < nexternals; ++ii) {
+            if ((externals[ii].in >= 0) && (offsets[ii] < bytes)) {
+                ssize_t written = write(externals[ii].in, buffer + offsets[ii], bytes - offsets[ii]);
+                if (written > 0) {
+                    offsets[ii] += written;
+                    externals[ii].delivered += written;
+                } else if ((written < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+                    close(externals[ii].in);
+                    externals[ii].in = -1;
+                } else {
+                    /* Do nothing. */
+                }
+            }
+            collect(&externals[ii], verbose);
+        }
+    } while (!0);
+}
+
+/**
+ * Read the defect offset, the earliest offset in the sidecar, returning true
+ * if the sidecar has recorded any injection yet. A sidecar that does not
+ * exist yet, because the defect program has not yet created it, or that was
+ * last written well before we started, and so is left from an earlier run,
+ * has recorded nothing.
+ */
+static int sidecar(const char * path, uint64_t * offsetp)
+{
+    FILE * fp;
+    struct stat status;
+    char line[256];
+    unsigned long long value = 0;
+    uint64_t offset = 0;
+    int found = 0;
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        return 0;
+    }
+
+    if ((fstat(fileno(fp), &status) < 0) || (status.st_mtime < since)) {
+        fclose(fp);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), fp) != (char *)0) {
+        if (sscanf(line, "%*[^,],%llu,", &value) != 1) {
+            continue;
+        }
+        if ((!found) || (value < offset)) {
+            offset = value;
+        }
+        found = !0;
+    }
+
+    fclose(fp);
+
+    if (found) {
+        *offsetp = offset;
+    }
+
+    return found;
+}
+
+static void usage(void)
+{
+    int ii;
+
+    fprintf(stderr, "usage: %s [ -a ALPHA ] [ -b DETECTOR ... ] [ -e PATTERN ] [ -H BITS ] [ -h ] [ -l BYTES ] [ -m PATH | -o OFFSET ] [ -v ] [ -x COMMAND ... ] [ -z BYTES ]\n", program);
+    fprintf(stderr, "       -a ALPHA        Use a false alarm probability of 2^-ALPHA.\n");
+    fprintf(stderr, "       -b DETECTOR     Run this built in detector.\n");
+    fprintf(stderr, "       -e PATTERN      Detect when a command outputs a line matching this.\n");
+    fprintf(stderr, "       -H BITS         Assume this much min-entropy per byte.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -l BYTES        Stop after reading this many bytes.\n");
+    fprintf(stderr, "       -m PATH         Read the defect offset from this sidecar file.\n");
+    fprintf(stderr, "       -o OFFSET       The defect begins at this byte offset.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -x COMMAND      Run this shell command as a detector.\n");
+    fprintf(stderr, "       -z BYTES        Read this many bytes at a time.\n");
+    for (ii = 1; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
+        fprintf(stderr, "       DETECTOR        %s\n", TYPES[ii]);
+    }
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    double alpha = 30.0;
+    double entropy = 8.0;
+    const char * pattern = "[Ff]ail|FAIL";
+    const char * path = (const char *)0;
+    uint64_t offset = 0;
+    uint64_t limit = 0;
+    size_t size = 4096;
+    int nbuiltins = 0;
+    int nexternals = 0;
+    int compiled = 0;
+    uint8_t * buffer = (uint8_t *)0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    int ii;
+    int jj;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "H:a:b:e:hl:m:o:vx:z:")) >= 0) {
+
+        switch (opt) {
+
+        case 'H':
+            entropy = strtod(optarg, &end);
+            if ((*end != '\0') || (entropy <= 0.0) || (entropy > 8.0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'a':
+            alpha = strtod(optarg, &end);
+            if ((*end != '\0') || (alpha < 1.0) || (alpha > 64.0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'b':
+            if (nbuiltins >= DETECTORS) {
+                errno = E2BIG;
+                perror(optarg);
+                error = !0;
+                break;
+            }
+            for (ii = 1; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
+                if (strcmp(optarg, TYPES[ii]) == 0) {
+                    builtins[nbuiltins++].type = (enum type)ii;
+                    break;
+                }
+            }
+            if (ii >= (sizeof(TYPES) / sizeof(TYPES[0]))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'e':
+            pattern = optarg;
+            break;
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'l':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            path = optarg;
+            break;
+
+        case 'o':
+            offset = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'x':
+            if (nexternals >= DETECTORS) {
+                errno = E2BIG;
+                perror(optarg);
+                error = !0;
+                break;
+            }
+            externals[nexternals++].command = optarg;
+            break;
+
+        case 'z':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+        char line[256];
+        int found = 0;
+        uint64_t position = 0;
+        uint64_t started = 0;
+        uint64_t marked = 0;
+        int remaining = 0;
+        ssize_t bytes = 0;
+        double z = 0.0;
+        uint64_t rctcutoff = 0;
+        uint64_t aptcut = 0;
+        int rc;
+
+        if (error) {
+            break;
+        }
+
+        if ((nbuiltins + nexternals) == 0) {
+            usage();
+            break;
+        }
+
+        /*
+         * The sidecar may not exist yet when we start in a pipeline with
+         * the defect program, so it is polled until it appears.
+         */
+
+        since = time((time_t *)0) - SKEW;
+
+        if (path != (const char *)0) {
+            found = sidecar(path, &offset);
+        } else {
+            found = !0;
+        }
+
+        rc = regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB);
+        if (rc != 0) {
+            regerror(rc, &regex, line, sizeof(line));
+            fprintf(stderr, "%s: \"%s\" %s\n", program, pattern, line);
+            break;
+        }
+        compiled = !0;
+
+        rctcutoff = 1 + (uint64_t)ceil(alpha / entropy);
+        aptcut = sp80090b_aptcutoff(entropy, alpha, APTWINDOW);
+        z = zcutoff(alpha);
+
+        for (ii = 0; ii < nbuiltins; ++ii) {
+            builtins[ii].cutoff = (builtins[ii].type == RCT) ? rctcutoff : aptcut;
+            builtins[ii].previous = -1;
+            builtins[ii].detected = -1;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: offset %lu\n", program, offset);
+            fprintf(stderr, "%s: entropy %lf\n", program, entropy);
+            fprintf(stderr, "%s: alpha %lf\n", program, alpha);
+            fprintf(stderr, "%s: rct %lu\n", program, rctcutoff);
+            fprintf(stderr, "%s: apt %lu/%d\n", program, aptcut, APTWINDOW);
+            fprintf(stderr, "%s: z %lf\n", program, z);
+        }
+
+        buffer = (uint8_t *)malloc(size);
+        if (buffer == (uint8_t *)0) {
+            perror("malloc");
+            break;
+        }
+
+        signal(SIGPIPE, SIG_IGN);
+
+        for (ii = 0; ii < nexternals; ++ii) {
+            externals[ii].in = -1;
+            externals[ii].out = -1;
+            externals[ii].detected = -1;
+            if (spawn(&externals[ii]) < 0) {
+                break;
+            }
+        }
+        if (ii < nexternals) {
+            break;
+        }
+
+        started = now();
+        remaining = nbuiltins + nexternals;
+
+        while (remaining > 0) {
+
+            bytes = read(STDIN_FILENO, buffer, ((limit > 0) && ((limit - position) < size)) ? (limit - position) : size);
+            if (bytes == 0) {
+                break;
+            }
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("read");
+                break;
+            }
+
+            /*
+             * The defect program rewrites the sidecar before it writes
+             * anything, and records an injection before it writes the
+             * defective bytes, so the sidecar is current when they arrive.
+             */
+
+            if ((path != (const char *)0) && (marked == 0)) {
+                found = sidecar(path, &offset);
+            }
+
+            if (found && (marked == 0) && ((position + bytes) > offset)) {
+                marked = now();
+            }
+
+            for (ii = 0; ii < nbuiltins; ++ii) {
+                if (builtins[ii].detected >= 0) {
+                    continue;
+                }
+                if (examine(&builtins[ii], buffer, bytes, position, z)) {
+                    builtins[ii].nanoseconds = now();
+                }
+            }
+
+            deliver(nexternals, buffer, bytes, verbose);
+
+            position += bytes;
+
+            remaining = 0;
+            for (ii = 0; ii < nbuiltins; ++ii) {
+                if (builtins[ii].detected < 0) { ++remaining; }
+            }
+            for (ii = 0; ii < nexternals; ++ii) {
+                if (externals[ii].detected < 0) { ++remaining; }
+            }
+
+            if ((limit > 0) && (position >= limit)) {
+                break;
+            }
+
+        }
+
+        /*
+         * Give the external detectors end of file and wait for their verdict
+         * on whatever they have buffered.
+         */
+
+        for (ii = 0; ii < nexternals; ++ii) {
+            if (externals[ii].in >= 0) {
+                close(externals[ii].in);
+                externals[ii].in = -1;
+            }
+        }
+
+        do {
+            struct pollfd fds[DETECTORS];
+            int nfds = 0;
+            for (ii = 0; ii < nexternals; ++ii) {
+                if (externals[ii].out >= 0) {
+                    fds[nfds].fd = externals[ii].out;
+                    fds[nfds].events = POLLIN;
+                    ++nfds;
+                }
+            }
+            if (nfds > 0) {
+                (void)poll(fds, nfds, 100);
+            }
+            for (ii = 0, jj = 0; ii < nexternals; ++ii) {
+                collect(&externals[ii], verbose);
+                if ((externals[ii].out >= 0) || (externals[ii].pid > 0)) {
+                    ++jj;
+                }
+            }
+        } while (jj > 0);
+
+        if (path != (const char *)0) {
+            found = sidecar(path, &offset);
+        }
+
+        if (!found) {
+            errno = ENODATA;
+            perror(path);
+        }
+
+        if (marked == 0) {
+            marked = now();
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: total %lu bytes\n", program, position);
+            fprintf(stderr, "%s: elapsed %lu nanoseconds\n", program, now() - started);
+        }
+
+        printf("%s,%s,%s,%s,%s,%s\n", "Detector", "Offset", "Detected", "Bytes", "Nanoseconds", "Result");
+
+        for (ii = 0; ii < nbuiltins; ++ii) {
+            if (builtins[ii].detected < 0) {
+                printf("%s,%lu,%d,%d,%d,%s\n", TYPES[builtins[ii].type], offset, -1, -1, -1, "missed");
+            } else {
+                printf("%s,%lu,%ld,%ld,%ld,%s\n", TYPES[builtins[ii].type], offset, builtins[ii].detected, builtins[ii].detected - (int64_t)offset, (int64_t)(builtins[ii].nanoseconds - marked), (builtins[ii].detected < offset) ? "false" : "detected");
+            }
+        }
+
+        for (ii = 0; ii < nexternals; ++ii) {
+            if (externals[ii].detected < 0) {
+                printf("\"%s\",%lu,%d,%d,%d,%s\n", externals[ii].command, offset, -1, -1, -1, "missed");
+            } else {
+                printf("\"%s\",%lu,%ld,%ld,%ld,%s\n", externals[ii].command, offset, externals[ii].detected, externals[ii].detected - (int64_t)offset, (int64_t)(externals[ii].nanoseconds - marked), (externals[ii].detected < offset) ? "false" : "detected");
+            }
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    for (ii = 0; ii < nexternals; ++ii) {
+        if (externals[ii].pid > 0) {
+            kill(externals[ii].pid, SIGTERM);
+            waitpid(externals[ii].pid, (int *)0, 0);
+        }
+    }
+
+    if (compiled) {
+        regfree(&regex);
+    }
+
+    free(buffer);
+
+    return xc;
+}
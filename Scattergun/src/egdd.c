@@ -0,0 +1,1260 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * EGD Daemon<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * egdd [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u PATH ] [ -m MODE ] [ -s BYTES ] [ -l BYTES ] [ -q BYTES ] [ -c CLIENTS ] [ -r SECONDS ] [ -p SECONDS ] [ SOURCE ]
+ *
+ * EXAMPLES
+ *
+ * egdd -D -i egdd -v -u /var/run/egd-pool /dev/hwrng
+ *
+ * seventool -R | egdd -v -p 10 -u /tmp/egd-pool
+ *
+ * ABSTRACT
+ *
+ * Serves random bytes from one entropy source to any number of clients
+ * speaking the Entropy Gathering Daemon (EGD) protocol on a UNIX domain
+ * stream socket, as expected by OpenSSL's RAND_egd(), GnuPG, and other
+ * legacy clients. The source is SOURCE, a character device, FIFO, or file,
+ * or standard input if none is given; it is read into a pool, whose size is
+ * BYTES, whenever the pool is not full, so the pool is kept filled ahead of
+ * demand. The source and every client are served from a single epoll(7)
+ * loop with non-blocking sockets, so the number of clients is limited only
+ * by CLIENTS and the file descriptor limit, which is raised to fit.
+ *
+ * The EGD commands are 0x00, get the number of bits in the pool as a 32-bit
+ * big endian integer; 0x01 N, read up to N bytes without blocking, answered
+ * with a count byte and that many bytes; 0x02 N, read exactly N bytes,
+ * blocking until they are available; 0x03 BITS BITS N DATA, write entropy,
+ * which is accepted and discarded since only the source is trusted; and
+ * 0x04, get the process identifier as a count byte and a decimal string.
+ * A client with an unknown command is disconnected.
+ *
+ * The last RESERVE bytes of the pool are held back for short requests:
+ * non-blocking reads, and blocking reads of no more than QUANTUM bytes, are
+ * answered from the whole pool at once, so they never wait unless the
+ * source has fallen so far behind that the reserve is exhausted. Longer
+ * blocking reads, and any blocking read that cannot be answered at once,
+ * wait in a first come first served queue that is served round robin,
+ * QUANTUM bytes to each client in turn, from what is above the reserve, so
+ * that one client asking for many large reads cannot starve the others.
+ * Bytes are erased from the pool as they are served. A SOURCE that fails
+ * or reaches end of file is reopened periodically; standard input cannot
+ * be, so when it fails or ends the daemon exits with an error rather than
+ * go on accepting clients it can no longer serve. The counts of clients,
+ * requests of each kind, bytes served, queue depth, and the latency of
+ * blocking reads from request to answer, are reported on SIGHUP, at exit,
+ * and optionally periodically. This is part of the Scattergun project.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+static const char * program = "egdd";
+static const char * ident = "egdd";
+static int debug = 0;
+static int verbose = 0;
+static volatile int done = 0;
+static volatile int report = 0;
+static int daemonize = 0;
+
+enum {
+    EVENTS = 256,               /* Events handled per epoll_wait(2). */
+    READSIZE = 4096,            /* Bytes read from the source at a time. */
+    REQUEST = 4 + 255,          /* Longest request (write entropy). */
+    REPLY = 1 + 255,            /* Longest reply (non-blocking read). */
+    LATENCIES = 32,             /* Power of two microsecond buckets. */
+};
+
+enum {
+    EGD_COUNT = 0x00,
+    EGD_READ = 0x01,
+    EGD_BLOCK = 0x02,
+    EGD_WRITE = 0x03,
+    EGD_PID = 0x04,
+    EGD_COMMANDS = 0x05,
+};
+
+static const char * COMMANDS[EGD_COMMANDS] = { "count", "read", "block", "write", "pid", };
+
+/**
+ * This is the state of one client connection.
+ */
+typedef struct Client {
+    struct Client * next;       /* Next client waiting in the queue. */
+    int fd;
+    uint32_t events;            /* Events of interest registered. */
+    int waiting;                /* In the queue for a blocking read. */
+    size_t want;                /* Bytes of the blocking read. */
+    size_t got;                 /* Bytes of it answered so far. */
+    uint64_t started;           /* When the blocking read arrived. */
+    size_t inlen;
+    size_t outoff;
+    size_t outlen;
+    uint8_t in[REQUEST];
+    uint8_t out[REPLY];
+} client_t;
+
+/**
+ * This is the state and the counters of the entropy source.
+ */
+typedef struct Source {
+    const char * path;
+    int fd;
+    int device;
+    int relay;
+    int failing;
+    int reading;                /* Registered for EPOLLIN. */
+    uint64_t opens;
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t eofs;
+    uint64_t retry;
+} source_t;
+
+/**
+ * This is the pool, a ring of bytes read from the source.
+ */
+typedef struct Pool {
+    uint8_t * data;
+    size_t size;
+    size_t head;
+    size_t fill;
+} pool_t;
+
+/**
+ * These are the counters of the server.
+ */
+typedef struct Counters {
+    uint64_t accepts;
+    uint64_t closes;
+    uint64_t refusals;
+    uint64_t violations;
+    uint64_t clients;
+    uint64_t peak;
+    uint64_t requests[EGD_COMMANDS];
+    uint64_t served;
+    uint64_t discarded;
+    uint64_t immediate;
+    uint64_t queued;
+    uint64_t depth;
+    uint64_t deepest;
+    uint64_t completed;
+    uint64_t latency;
+    uint64_t minimum;
+    uint64_t maximum;
+    uint64_t latencies[LATENCIES];
+} counters_t;
+
+static source_t source = { "-", STDIN_FILENO, };
+static pool_t pool;
+static counters_t counters = { .minimum = ~0ULL, };
+static client_t * head = (client_t *)0;
+static client_t * tail = (client_t *)0;
+static size_t reserve = 4096;
+static size_t quantum = 64;
+static int efd = -1;
+
+/**
+ * Emit a formatting string to either the system log or to standard error.
+ * @param format is the printf format.
+ */
+static void lprintf(const char * format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (daemonize) {
+        vsyslog(LOG_DEBUG, format, ap);
+    } else {
+        vfprintf(stderr, format, ap);
+    }
+    va_end(ap);
+}
+
+/**
+ * Emit a formatting string to either the system log or to standard error
+ * if verbosity is enabled.
+ * @param format is the printf format.
+ */
+static void lverbosef(const char * format, ...)
+{
+    if (verbose) {
+        va_list ap;
+        va_start(ap, format);
+        if (daemonize) {
+            vsyslog(LOG_DEBUG, format, ap);
+        } else {
+            vfprintf(stderr, format, ap);
+        }
+        va_end(ap);
+    }
+}
+
+/**
+ * Emit a caller provider string and an error message string corresponding to
+ * the current value of the error number (errno) to either the system log or
+ * to standard error.
+ * @param string is the string.
+ */
+static void lerror(const char * string)
+{
+    if (daemonize) {
+        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
+    } else {
+        fprintf(stderr, "%s: %s\n", string, strerror(errno));
+    }
+}
+
+/**
+ * Handle a signal. In the event of a SIGTERM or a SIGINT, the program shuts
+ * down in an orderly fashion. In the event of a SIGHUP, it emits some
+ * statistics to standard error.
+ * @param signum is the number of the incoming signal.
+ */
+static void handler(int signum)
+{
+    if (signum == SIGTERM) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u PATH ] [ -m MODE ] [ -s BYTES ] [ -l BYTES ] [ -q BYTES ] [ -c CLIENTS ] [ -r SECONDS ] [ -p SECONDS ] [ SOURCE ]\n", program);
+    if (nomenu) { return; }
+    lprintf("       -d            Enable debug mode\n");
+    lprintf("       -v            Enable verbose mode\n");
+    lprintf("       -D            Run as a daemon\n");
+    lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    lprintf("       -u PATH       Listen on the UNIX socket PATH (default /var/run/egd-pool)\n");
+    lprintf("       -m MODE       Give the socket permissions MODE (default 0666)\n");
+    lprintf("       -s BYTES      Keep a pool of BYTES (default 65536)\n");
+    lprintf("       -l BYTES      Hold the last BYTES of the pool for short requests (default 4096)\n");
+    lprintf("       -q BYTES      Serve queued requests BYTES at a time (default 64)\n");
+    lprintf("       -c CLIENTS    Accept at most CLIENTS at once (default 4096)\n");
+    lprintf("       -r SECONDS    Reopen a failed source every SECONDS (default 1)\n");
+    lprintf("       -p SECONDS    Report statistics every SECONDS (default never)\n");
+    lprintf("       -h            Print help menu\n");
+    lprintf("       SOURCE        Read SOURCE instead of standard input\n");
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * POOL
+ ******************************************************************************/
+
+/**
+ * Move bytes from the pool to a buffer, erasing them from the pool.
+ * @param buffer points to the buffer.
+ * @param length is the number of bytes, no more than the pool holds.
+ */
+static void take(uint8_t * buffer, size_t length)
+{
+    size_t part;
+
+    while (length > 0) {
+        part = pool.size - pool.head;
+        if (part > length) {
+            part = length;
+        }
+        memcpy(buffer, pool.data + pool.head, part);
+        memset(pool.data + pool.head, 0, part);
+        pool.head = (pool.head + part) % pool.size;
+        pool.fill -= part;
+        counters.served += part;
+        buffer += part;
+        length -= part;
+    }
+}
+
+/*******************************************************************************
+ * SOURCE
+ ******************************************************************************/
+
+/**
+ * Copy a source that cannot be polled, such as the hw_random device or a
+ * regular file, into a pipe that can. The thread exits when either end fails.
+ * @param arg points to the source.
+ * @return NULL.
+ */
+static void * relay(void * arg)
+{
+    source_t * sp = (source_t *)arg;
+    int device = sp->device;
+    int fd = sp->relay;
+    uint8_t buffer[READSIZE];
+    ssize_t bytes;
+    ssize_t written;
+    ssize_t offset;
+
+    while ((bytes = read(device, buffer, sizeof(buffer))) != 0) {
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (offset = 0; offset < bytes; offset += written) {
+            written = write(fd, buffer + offset, bytes - offset);
+            if (written <= 0) {
+                break;
+            }
+        }
+        if (offset < bytes) {
+            break;
+        }
+    }
+
+    close(device);
+    close(fd);
+
+    return (void *)0;
+}
+
+static int reopen(source_t * sp)
+{
+    struct epoll_event event = { 0 };
+    int fds[2] = { -1, -1 };
+    pthread_attr_t attr;
+    pthread_t thread;
+    int rc;
+
+    if (sp->fd < 0) {
+        sp->fd = open(sp->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (sp->fd < 0) {
+            if (!sp->failing) {
+                lerror(sp->path);
+                sp->failing = !0;
+            }
+            return -1;
+        }
+    } else {
+        (void)fcntl(sp->fd, F_SETFL, fcntl(sp->fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = sp;
+
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, sp->fd, &event) == 0) {
+        /* Do nothing. */
+    } else if (errno != EPERM) {
+        lerror(sp->path);
+        close(sp->fd);
+        sp->fd = -1;
+        return -1;
+    } else if (pipe2(fds, O_CLOEXEC) < 0) {
+        lerror("pipe2");
+        close(sp->fd);
+        sp->fd = -1;
+        return -1;
+    } else {
+        /*
+         * The source does not support poll(2), so a thread reads it with
+         * blocking reads and relays what it reads through a pipe.
+         */
+        sp->device = sp->fd;
+        (void)fcntl(sp->device, F_SETFL, fcntl(sp->device, F_GETFL) & ~O_NONBLOCK);
+        (void)fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        sp->relay = fds[1];
+        sp->fd = fds[0];
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        rc = pthread_create(&thread, &attr, relay, sp);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            errno = rc;
+            lerror("pthread_create");
+            close(sp->device);
+            close(fds[0]);
+            close(fds[1]);
+            sp->fd = -1;
+            return -1;
+        }
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, sp->fd, &event) < 0) {
+            lerror(sp->path);
+            close(sp->fd);
+            sp->fd = -1;
+            return -1;
+        }
+        lverbosef("%s: relay        \"%s\"\n", program, sp->path);
+    }
+
+    ++sp->opens;
+    sp->failing = 0;
+    sp->reading = !0;
+    lverbosef("%s: open         \"%s\"\n", program, sp->path);
+
+    return 0;
+}
+
+static void shut(source_t * sp, uint64_t retry)
+{
+    (void)epoll_ctl(efd, EPOLL_CTL_DEL, sp->fd, (struct epoll_event *)0);
+    close(sp->fd);
+    sp->fd = -1;
+    sp->retry = retry;
+    lverbosef("%s: close        \"%s\"\n", program, sp->path);
+}
+
+/**
+ * Read the source into the free space of the pool.
+ */
+static void refill(source_t * sp, uint64_t interval)
+{
+    size_t tail;
+    size_t length;
+    ssize_t bytes;
+
+    tail = (pool.head + pool.fill) % pool.size;
+    length = pool.size - pool.fill;
+    if (length > (pool.size - tail)) {
+        length = pool.size - tail;
+    }
+    if (length > READSIZE) {
+        length = READSIZE;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    bytes = read(sp->fd, pool.data + tail, length);
+    if (bytes > 0) {
+        pool.fill += bytes;
+        ++sp->reads;
+        sp->bytes += bytes;
+    } else if (bytes == 0) {
+        ++sp->eofs;
+        shut(sp, now() + interval);
+    } else if ((errno == EAGAIN) || (errno == EINTR)) {
+        /* Do nothing. */
+    } else {
+        ++sp->errors;
+        lerror(sp->path);
+        shut(sp, now() + interval);
+    }
+}
+
+/**
+ * Read the source only while the pool has room, so that a source that is
+ * always ready does not keep the loop spinning.
+ */
+static void regulate(source_t * sp)
+{
+    struct epoll_event event = { 0 };
+    int reading;
+
+    if (sp->fd < 0) {
+        return;
+    }
+
+    reading = (pool.fill < pool.size);
+    if (reading == sp->reading) {
+        return;
+    }
+
+    event.events = reading ? EPOLLIN : 0;
+    event.data.ptr = sp;
+    if (epoll_ctl(efd, EPOLL_CTL_MOD, sp->fd, &event) == 0) {
+        sp->reading = reading;
+    }
+}
+
+/*******************************************************************************
+ * CLIENTS
+ ******************************************************************************/
+
+static void enqueue(client_t * cp)
+{
+    cp->next = (client_t *)0;
+    if (tail == (client_t *)0) {
+        head = cp;
+    } else {
+        tail->next = cp;
+    }
+    tail = cp;
+}
+
+static client_t * dequeue(void)
+{
+    client_t * cp = head;
+
+    if (cp != (client_t *)0) {
+        head = cp->next;
+        if (head == (client_t *)0) {
+            tail = (client_t *)0;
+        }
+        cp->next = (client_t *)0;
+    }
+
+    return cp;
+}
+
+static void unqueue(client_t * cp)
+{
+    client_t * prior = (client_t *)0;
+    client_t * here;
+
+    for (here = head; here != (client_t *)0; prior = here, here = here->next) {
+        if (here == cp) {
+            if (prior == (client_t *)0) {
+                head = here->next;
+            } else {
+                prior->next = here->next;
+            }
+            if (tail == here) {
+                tail = prior;
+            }
+            --counters.depth;
+            break;
+        }
+    }
+}
+
+static void disconnect(client_t * cp)
+{
+    if (cp->waiting) {
+        unqueue(cp);
+    }
+    (void)epoll_ctl(efd, EPOLL_CTL_DEL, cp->fd, (struct epoll_event *)0);
+    close(cp->fd);
+    memset(cp, 0, sizeof(*cp));
+    free(cp);
+    ++counters.closes;
+    --counters.clients;
+}
+
+/**
+ * Register interest in reading a client only when it is not waiting and
+ * has nothing left to write, so that it cannot run ahead of its replies,
+ * and in writing only when there is something left to write.
+ */
+static void interest(client_t * cp)
+{
+    struct epoll_event event = { 0 };
+
+    event.events = ((cp->waiting || (cp->outoff < cp->outlen)) ? 0 : EPOLLIN) | ((cp->outoff < cp->outlen) ? EPOLLOUT : 0);
+    if (event.events == cp->events) {
+        return;
+    }
+
+    event.data.ptr = cp;
+    if (epoll_ctl(efd, EPOLL_CTL_MOD, cp->fd, &event) == 0) {
+        cp->events = event.events;
+    }
+}
+
+/**
+ * Write what a client has not yet been sent.
+ * @return 0 for success, <0 if the client should be disconnected.
+ */
+static int flush(client_t * cp)
+{
+    ssize_t bytes;
+
+    while (cp->outoff < cp->outlen) {
+        bytes = send(cp->fd, cp->out + cp->outoff, cp->outlen - cp->outoff, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (bytes > 0) {
+            cp->outoff += bytes;
+        } else if ((bytes < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((bytes < 0) && (errno == EAGAIN)) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+
+    if (cp->outoff >= cp->outlen) {
+        memset(cp->out, 0, cp->outlen);
+        cp->outoff = 0;
+        cp->outlen = 0;
+    }
+
+    return 0;
+}
+
+static void complete(client_t * cp)
+{
+    uint64_t latency = (now() - cp->started) / 1000;
+    int bucket = 0;
+
+    while ((bucket < (LATENCIES - 1)) && ((1ULL << bucket) <= latency)) {
+        ++bucket;
+    }
+
+    ++counters.completed;
+    ++counters.latencies[bucket];
+    counters.latency += latency;
+    if (latency < counters.minimum) {
+        counters.minimum = latency;
+    }
+    if (latency > counters.maximum) {
+        counters.maximum = latency;
+    }
+
+    cp->waiting = 0;
+    cp->want = 0;
+    cp->got = 0;
+}
+
+/**
+ * Answer as many of the complete requests a client has sent as can be
+ * answered without waiting.
+ * @return 0 for success, <0 if the client should be disconnected.
+ */
+static int process(client_t * cp)
+{
+    size_t length;
+    size_t used;
+    uint32_t bits;
+    int command;
+
+    while ((!cp->waiting) && (cp->outlen == 0) && (cp->inlen > 0)) {
+
+        command = cp->in[0];
+        used = 0;
+
+        if (command == EGD_COUNT) {
+            bits = (pool.fill > (UINT32_MAX / 8)) ? UINT32_MAX : pool.fill * 8;
+            cp->out[0] = bits >> 24;
+            cp->out[1] = bits >> 16;
+            cp->out[2] = bits >> 8;
+            cp->out[3] = bits;
+            cp->outlen = 4;
+            used = 1;
+        } else if (command == EGD_READ) {
+            if (cp->inlen < 2) {
+                break;
+            }
+            length = (cp->in[1] < pool.fill) ? cp->in[1] : pool.fill;
+            cp->out[0] = length;
+            take(cp->out + 1, length);
+            cp->outlen = 1 + length;
+            used = 2;
+        } else if (command == EGD_BLOCK) {
+            if (cp->inlen < 2) {
+                break;
+            }
+            cp->want = cp->in[1];
+            cp->got = 0;
+            cp->started = now();
+            /*
+             * A short request may dip into the reserve even if others are
+             * waiting; a long one may not, and must not jump the queue.
+             */
+            if ((cp->want <= quantum) && (cp->want <= pool.fill)) {
+                take(cp->out, cp->want);
+                cp->outlen = cp->want;
+                ++counters.immediate;
+                complete(cp);
+            } else if ((head == (client_t *)0) && ((cp->want + reserve) <= pool.fill)) {
+                take(cp->out, cp->want);
+                cp->outlen = cp->want;
+                ++counters.immediate;
+                complete(cp);
+            } else {
+                cp->waiting = !0;
+                enqueue(cp);
+                ++counters.queued;
+                if ((++counters.depth) > counters.deepest) {
+                    counters.deepest = counters.depth;
+                }
+            }
+            used = 2;
+        } else if (command == EGD_WRITE) {
+            if ((cp->inlen < 4) || (cp->inlen < (4 + cp->in[3]))) {
+                break;
+            }
+            counters.discarded += cp->in[3];
+            used = 4 + cp->in[3];
+        } else if (command == EGD_PID) {
+            length = snprintf((char *)(cp->out + 1), sizeof(cp->out) - 1, "%d", getpid());
+            cp->out[0] = length;
+            cp->outlen = 1 + length;
+            used = 1;
+        } else {
+            ++counters.violations;
+            return -1;
+        }
+
+        ++counters.requests[command];
+        memmove(cp->in, cp->in + used, cp->inlen - used);
+        cp->inlen -= used;
+
+        if (flush(cp) < 0) {
+            return -1;
+        }
+
+    }
+
+    interest(cp);
+
+    return 0;
+}
+
+static void receive(client_t * cp)
+{
+    ssize_t bytes;
+
+    bytes = recv(cp->fd, cp->in + cp->inlen, sizeof(cp->in) - cp->inlen, MSG_DONTWAIT);
+    if (bytes > 0) {
+        cp->inlen += bytes;
+    } else if ((bytes < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+        return;
+    } else {
+        disconnect(cp);
+        return;
+    }
+
+    if (process(cp) < 0) {
+        disconnect(cp);
+    }
+}
+
+/**
+ * Serve the queue round robin from what is above the reserve.
+ */
+static void dispatch(void)
+{
+    client_t * cp;
+    size_t available;
+    size_t length;
+
+    while ((head != (client_t *)0) && (pool.fill > reserve)) {
+
+        available = pool.fill - reserve;
+        cp = dequeue();
+
+        length = cp->want - cp->got;
+        if (length > quantum) {
+            length = quantum;
+        }
+        if (length > available) {
+            length = available;
+        }
+
+        take(cp->out + cp->outlen, length);
+        cp->outlen += length;
+        cp->got += length;
+
+        if (cp->got < cp->want) {
+            enqueue(cp);
+        } else {
+            --counters.depth;
+            complete(cp);
+        }
+
+        if ((flush(cp) < 0) || (process(cp) < 0)) {
+            disconnect(cp);
+        }
+
+    }
+}
+
+static void admit(int lfd, size_t maximum)
+{
+    struct epoll_event event = { 0 };
+    client_t * cp;
+    int fd;
+
+    while ((fd = accept4(lfd, (struct sockaddr *)0, (socklen_t *)0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+
+        if (counters.clients >= maximum) {
+            ++counters.refusals;
+            close(fd);
+            continue;
+        }
+
+        cp = (client_t *)calloc(1, sizeof(*cp));
+        if (cp == (client_t *)0) {
+            lerror("calloc");
+            ++counters.refusals;
+            close(fd);
+            continue;
+        }
+
+        cp->fd = fd;
+        cp->events = EPOLLIN;
+        event.events = cp->events;
+        event.data.ptr = cp;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            lerror("epoll_ctl");
+            ++counters.refusals;
+            close(fd);
+            free(cp);
+            continue;
+        }
+
+        ++counters.accepts;
+        if ((++counters.clients) > counters.peak) {
+            counters.peak = counters.clients;
+        }
+
+    }
+
+    if ((errno != EAGAIN) && (errno != EINTR)) {
+        lerror("accept4");
+    }
+}
+
+static void statistics(uint64_t elapsed)
+{
+    double seconds = elapsed / 1000000000.0;
+    int ii;
+
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+
+    lprintf("%s: source=\"%s\" opens=%lu reads=%lu bytes=%lu errors=%lu eofs=%lu bytes/second=%.0lf\n", program, source.path, source.opens, source.reads, source.bytes, source.errors, source.eofs, source.bytes / seconds);
+
+    for (ii = 0; ii < EGD_COMMANDS; ++ii) {
+        lprintf("%s: command=%s requests=%lu requests/second=%.0lf\n", program, COMMANDS[ii], counters.requests[ii], counters.requests[ii] / seconds);
+    }
+
+    lprintf("%s: clients accepts=%lu closes=%lu refusals=%lu violations=%lu current=%lu peak=%lu\n", program, counters.accepts, counters.closes, counters.refusals, counters.violations, counters.clients, counters.peak);
+    lprintf("%s: blocking immediate=%lu queued=%lu depth=%lu deepest=%lu completed=%lu minimum=%luus mean=%.0lfus maximum=%luus\n", program, counters.immediate, counters.queued, counters.depth, counters.deepest, counters.completed, (counters.completed > 0) ? counters.minimum : 0, (counters.completed > 0) ? ((double)counters.latency / counters.completed) : 0.0, counters.maximum);
+
+    for (ii = 0; ii < LATENCIES; ++ii) {
+        if (counters.latencies[ii] > 0) {
+            lprintf("%s: latency<%luus=%lu\n", program, 1UL << ii, counters.latencies[ii]);
+        }
+    }
+
+    lprintf("%s: pool size=%zu fill=%zu reserve=%zu served=%lu discarded=%lu bytes/second=%.0lf elapsed=%.3lf\n", program, pool.size, pool.fill, reserve, counters.served, counters.discarded, counters.served / seconds, seconds);
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int rc = 0;
+    const char * path = "/var/run/egd-pool";
+    mode_t mode = 0666;
+    size_t size = 65536;
+    size_t maximum = 4096;
+    uint64_t interval = 1000000000ULL;
+    uint64_t period = 0;
+    int lfd = -1;
+    struct sockaddr_un address = { 0 };
+    struct rlimit limit = { 0 };
+    struct sigaction sigterm = { 0 };
+    struct sigaction sighup = { 0 };
+    struct sigaction sigint = { 0 };
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "dvDi:u:m:s:l:q:c:r:p:h")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'i':
+            ident = optarg;
+            break;
+
+        case 'u':
+            path = optarg;
+            if (strlen(path) >= sizeof(address.sun_path)) {
+                errno = ENAMETOOLONG;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            mode = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || ((mode & ~0777) != 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size < REPLY)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'l':
+            reserve = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'q':
+            quantum = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (quantum == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'c':
+            maximum = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (maximum == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            interval = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    if ((!error) && (optind < argc) && (strcmp(argv[optind], "-") != 0)) {
+        source.path = argv[optind];
+        source.fd = -1;
+    }
+
+    if ((!error) && ((argc - optind) > 1)) {
+        error = !0;
+    }
+
+    if ((!error) && (reserve >= size)) {
+        errno = EINVAL;
+        lerror("-l");
+        error = !0;
+    }
+
+    do {
+        uint64_t started = 0;
+        uint64_t reported = 0;
+        uint64_t timestamp = 0;
+        struct epoll_event events[EVENTS];
+        void * pointer = (void *)0;
+        int nevents = 0;
+        int jj;
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        if (daemonize) {
+            if (daemon(0, 0) < 0) {
+                perror("daemon");
+                break;
+            }
+            openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
+            lverbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        /*
+         * Install our signal handlers.
+         */
+
+        signal(SIGPIPE, SIG_IGN);
+
+        sigterm.sa_handler = handler;
+        sigterm.sa_flags = 0;
+        rc = sigaction(SIGTERM, &sigterm, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sighup.sa_handler = handler;
+        sighup.sa_flags = SA_RESTART;
+        rc = sigaction(SIGHUP, &sighup, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sigint.sa_handler = handler;
+        sigint.sa_flags = 0;
+        rc = sigaction(SIGINT, &sigint, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        /*
+         * Make room for every client, the listener, the source, and the
+         * usual descriptors.
+         */
+
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+            if (limit.rlim_cur < (maximum + 16)) {
+                limit.rlim_cur = ((maximum + 16) < limit.rlim_max) ? (maximum + 16) : limit.rlim_max;
+                if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+                    lerror("setrlimit");
+                }
+            }
+        }
+
+        pool.size = size;
+        pool.data = (uint8_t *)calloc(1, pool.size);
+        if (pool.data == (uint8_t *)0) {
+            lerror("calloc");
+            break;
+        }
+
+        efd = epoll_create1(EPOLL_CLOEXEC);
+        if (efd < 0) {
+            lerror("epoll_create1");
+            break;
+        }
+
+        /*
+         * Listen on the socket, replacing any left behind.
+         */
+
+        lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (lfd < 0) {
+            lerror("socket");
+            break;
+        }
+
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+        (void)unlink(path);
+
+        if (bind(lfd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            lerror(path);
+            break;
+        }
+
+        if (chmod(path, mode) < 0) {
+            lerror(path);
+            break;
+        }
+
+        if (listen(lfd, SOMAXCONN) < 0) {
+            lerror(path);
+            break;
+        }
+
+        events[0].events = EPOLLIN;
+        events[0].data.ptr = &lfd;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, lfd, &events[0]) < 0) {
+            lerror("epoll_ctl");
+            break;
+        }
+
+        lverbosef("%s: path         \"%s\"\n", program, path);
+        lverbosef("%s: mode         0%03o\n", program, mode);
+        lverbosef("%s: pool         %zu\n", program, size);
+        lverbosef("%s: reserve      %zu\n", program, reserve);
+        lverbosef("%s: quantum      %zu\n", program, quantum);
+        lverbosef("%s: clients      %zu\n", program, maximum);
+        lverbosef("%s: source       \"%s\"\n", program, source.path);
+
+        if (reopen(&source) < 0) {
+            source.retry = now() + interval;
+        }
+
+        started = now();
+        reported = started;
+
+        /*
+         * Enter our work loop.
+         */
+
+        xc = 0;
+
+        while (!done) {
+
+            timestamp = now();
+
+            if (report || ((period > 0) && ((timestamp - reported) >= period))) {
+                statistics(timestamp - started);
+                reported = timestamp;
+                report = 0;
+            }
+
+            if ((source.fd < 0) && (source.path[0] != '-') && (timestamp >= source.retry)) {
+                if (reopen(&source) < 0) {
+                    source.retry = timestamp + interval;
+                }
+            }
+
+            nevents = epoll_wait(efd, events, EVENTS, 1000);
+            if (nevents < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                lerror("epoll_wait");
+                xc = 2;
+                break;
+            }
+
+            for (jj = 0; jj < nevents; ++jj) {
+                pointer = events[jj].data.ptr;
+                if (pointer == &lfd) {
+                    admit(lfd, maximum);
+                } else if (pointer == &source) {
+                    if (source.fd >= 0) {
+                        refill(&source, interval);
+                    }
+                } else if ((events[jj].events & (EPOLLHUP | EPOLLERR)) != 0) {
+                    disconnect((client_t *)pointer);
+                } else if ((events[jj].events & EPOLLOUT) != 0) {
+                    if ((flush((client_t *)pointer) < 0) || (process((client_t *)pointer) < 0)) {
+                        disconnect((client_t *)pointer);
+                    }
+                } else if ((events[jj].events & EPOLLIN) != 0) {
+                    receive((client_t *)pointer);
+                } else {
+                    /* Do nothing. */
+                }
+            }
+
+            dispatch();
+            regulate(&source);
+
+            if ((source.fd < 0) && (source.path[0] == '-')) {
+                lprintf("%s: source \"%s\" ended and cannot be reopened\n", program, source.path);
+                xc = 2;
+                break;
+            }
+
+            if (debug) {
+                lprintf("%s: fill=%zu depth=%lu clients=%lu\n", program, pool.fill, counters.depth, counters.clients);
+            }
+
+        }
+
+        statistics(now() - started);
+
+    } while (0);
+
+    /*
+     * Clean up after ourselves. The clients are left for exit(2) to close.
+     */
+
+    if (lfd >= 0) {
+        close(lfd);
+        (void)unlink(path);
+    }
+
+    if (source.fd > STDIN_FILENO) {
+        close(source.fd);
+    }
+
+    if (efd >= 0) {
+        close(efd);
+    }
+
+    if (pool.data != (uint8_t *)0) {
+        memset(pool.data, 0, pool.size);
+        free(pool.data);
+    }
+
+    if (daemonize) {
+        closelog();
+    }
+
+    return xc;
+}
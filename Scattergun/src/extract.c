@@ -0,0 +1,689 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Extract<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * extract [ -h ] [ -v ] [ -P ] [ -x EXTRACTOR ] [ -d DEPTH ] [ -i BITS ] [ -o BITS ] [ -s SEED ] [ -b BYTES ] [ -n BYTES ] [ -f PATH ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Read this many bytes per block (default 65536).
+ * -d DEPTH        Iterate Peres this many levels deep (default 4).
+ * -f PATH         Read from here instead of stdin.
+ * -h              Display this menu.
+ * -i BITS         Hash this many input bits per Toeplitz block (default 1024).
+ * -n BYTES        Stop after reading this many bytes (default unlimited).
+ * -o BITS         Emit this many output bits per Toeplitz block (default 512).
+ * -P              Use the portable kernels even if BMI2 is available.
+ * -s SEED         Seed the Toeplitz matrix (default 1).
+ * -v              Report bits in, bits out, and throughput to stderr.
+ * -x EXTRACTOR    Use this extractor (default vonneumann).
+ *
+ * EXTRACTORS
+ *
+ * vonneumann      von Neumann debiasing: 01 and 10 emit a bit, 00 and 11 none.
+ * peres           Peres iterated von Neumann, recursing DEPTH levels deep.
+ * toeplitz        Toeplitz hashing, multiplying each BITS input bits by a
+ *                 seeded random binary Toeplitz matrix to get BITS output bits.
+ *
+ * EXAMPLES
+ *
+ * infnoise --raw | extract -v -x peres | rate
+ *
+ * seedd -o -c none | extract -x toeplitz -i 2048 -o 1024 | scattergun.sh
+ *
+ * extract -v -x vonneumann -f /dev/hwrng -n 10000000 > /dev/null
+ *
+ * ABSTRACT
+ *
+ * Reads raw bits from a source, runs them through a randomness extractor,
+ * and writes the result to standard output, so that an extractor can be
+ * inserted into any pipeline, such as one running a raw source with its own
+ * whitening turned off, and its cost measured. The report gives the bits
+ * read and written, their ratio, the wall clock throughput of the whole
+ * filter, and the throughput of the extraction kernels alone, excluding the
+ * reads and the writes.
+ *
+ * The bits of the input are taken least significant bit first. The von
+ * Neumann and Peres extractors work sixty-four bits at a time: the pairs
+ * of a word whose bits differ are found with one shift and one exclusive
+ * OR, and the bits they emit are gathered with a single parallel bit
+ * extract (PEXT) where the processor has BMI2, and with a table lookup
+ * per byte otherwise. Peres also gathers the exclusive OR of every pair and
+ * the value of every equal pair into two sequences and extracts them in
+ * turn, recursively; its output rate approaches the entropy of a biased
+ * but independent source as the depth grows. Because of the recursion, the
+ * Peres extraction is applied to each block, so a larger block yields
+ * slightly more output.
+ *
+ * The Toeplitz extractor is a universal hash: the output block is the
+ * product of the matrix and the input block, computed as the exclusive OR
+ * of the columns selected by the input bits, a vector of words at a time
+ * with kernels cloned for AVX2 and selected at run time on x86_64. By the
+ * leftover hash lemma its output is close to uniform when the input block
+ * carries somewhat more min-entropy than the number of output bits, so the
+ * ratio should be chosen from the measured min-entropy of the source. The
+ * matrix is public and fixed by the seed, which is fine for an extractor
+ * but means an adversary who controls the source could know it.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "output.h"
+#include "vonneumann.h"
+#if defined(__x86_64__)
+#   define EXTRACT_CLONES __attribute__((target_clones("avx2","default")))
+#else
+#   define EXTRACT_CLONES
+#endif
+
+enum {
+    DEPTHS = 16,                /* Maximum Peres depth. */
+};
+
+static const uint64_t EVEN = 0x5555555555555555ULL;
+
+/**
+ * This is a sequence of bits stored least significant bit first, with one
+ * spare word so that an append never needs to check for the end.
+ */
+typedef struct Bits {
+    uint64_t * words;
+    size_t count;
+    size_t capacity;
+} bits_t;
+
+enum extractor { VONNEUMANN = 0, PERES = 1, TOEPLITZ = 2, };
+static const char * EXTRACTORS[] = { "vonneumann", "peres", "toeplitz", };
+
+static const char * program = "extract";
+static volatile int done = 0;
+static vonneumann_compress_t * compress = (vonneumann_compress_t *)0;
+static bits_t scratch[DEPTHS][2];
+
+static void handler(int signum)
+{
+    done = !0;
+}
+
+static uint64_t now(void)
+{
+    struct timespec spec = { 0 };
+    uint64_t ticks;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
+    ticks = spec.tv_sec;
+    ticks *= 1000000000;
+    ticks += spec.tv_nsec;
+
+    return ticks;
+}
+
+static uint64_t splitmix64(uint64_t * xp)
+{
+    uint64_t z = (*xp += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*******************************************************************************
+ * BITS
+ ******************************************************************************/
+
+static int allocate(bits_t * bp, size_t capacity)
+{
+    bp->capacity = capacity;
+    bp->count = 0;
+    bp->words = (uint64_t *)calloc((capacity / 64) + 2, sizeof(uint64_t));
+
+    return (bp->words == (uint64_t *)0) ? -1 : 0;
+}
+
+/**
+ * Append the low order bits of a value to a sequence.
+ * @param bp points to the sequence.
+ * @param value contains the bits, and nothing above them.
+ * @param count is the number of bits, no more than sixty-four.
+ */
+static inline void append(bits_t * bp, uint64_t value, int count)
+{
+    size_t index = bp->count / 64;
+    int shift = bp->count % 64;
+
+    if (shift == 0) {
+        bp->words[index] = value;
+    } else {
+        bp->words[index] |= value << shift;
+        bp->words[index + 1] = value >> (64 - shift);
+    }
+    bp->count += count;
+}
+
+/*******************************************************************************
+ * VON NEUMANN AND PERES
+ ******************************************************************************/
+
+/**
+ * Apply the Peres extractor to a sequence, appending the result to the
+ * output. A depth of one is the von Neumann extractor.
+ * @param in points to the input words.
+ * @param count is the number of input bits.
+ * @param depth is the remaining depth of the recursion.
+ * @param out points to the output sequence.
+ */
+static void peres(const uint64_t * in, size_t count, int depth, bits_t * out)
+{
+    size_t pairs = count / 2;
+    bits_t * up;
+    bits_t * vp;
+    uint64_t word;
+    uint64_t differ;
+    uint64_t even;
+    uint64_t mask;
+    size_t kk;
+    size_t valid;
+
+    if ((depth <= 0) || (pairs == 0)) {
+        return;
+    }
+
+    up = &scratch[depth - 1][0];
+    vp = &scratch[depth - 1][1];
+    up->count = 0;
+    vp->count = 0;
+
+    for (kk = 0; (kk * 32) < pairs; ++kk) {
+        word = in[kk];
+        valid = pairs - (kk * 32);
+        even = (valid >= 32) ? EVEN : (EVEN & ((1ULL << (valid * 2)) - 1));
+        differ = word ^ (word >> 1);
+        mask = differ & even;
+        append(out, (*compress)(word, mask), __builtin_popcountll(mask));
+        if (depth > 1) {
+            append(up, (*compress)(differ, even), (valid >= 32) ? 32 : valid);
+            mask = ~differ & even;
+            append(vp, (*compress)(word, mask), __builtin_popcountll(mask));
+        }
+    }
+
+    if (depth > 1) {
+        peres(up->words, up->count, depth - 1, out);
+        peres(vp->words, vp->count, depth - 1, out);
+    }
+}
+
+/*******************************************************************************
+ * TOEPLITZ
+ ******************************************************************************/
+
+/**
+ * Build the columns of an m by n binary Toeplitz matrix, in which the
+ * element in row i and column j is bit i - j + n - 1 of the n + m - 1 bit
+ * seed, so that each column is an m bit window of the seed. The columns are
+ * stored in slices, the first holding the first word of every column, and
+ * so on.
+ * @param seed seeds the generator of the seed bits.
+ * @param n is the number of columns.
+ * @param m is the number of rows.
+ * @return (m + 63) / 64 slices of n words, or NULL.
+ */
+static uint64_t * matrix(uint64_t seed, size_t n, size_t m)
+{
+    size_t words = (m + 63) / 64;
+    size_t length = n + m - 1;
+    uint64_t * bits = (uint64_t *)0;
+    uint64_t * columns = (uint64_t *)0;
+    size_t ii;
+    size_t jj;
+    size_t kk;
+
+    do {
+
+        bits = (uint64_t *)calloc((length + 63) / 64, sizeof(uint64_t));
+        if (bits == (uint64_t *)0) {
+            break;
+        }
+
+        for (kk = 0; kk < ((length + 63) / 64); ++kk) {
+            bits[kk] = splitmix64(&seed);
+        }
+
+        columns = (uint64_t *)calloc(n * words, sizeof(uint64_t));
+        if (columns == (uint64_t *)0) {
+            break;
+        }
+
+        for (jj = 0; jj < n; ++jj) {
+            for (ii = 0; ii < m; ++ii) {
+                kk = ii + n - 1 - jj;
+                if (((bits[kk / 64] >> (kk % 64)) & 1) != 0) {
+                    columns[((ii / 64) * n) + jj] |= 1ULL << (ii % 64);
+                }
+            }
+        }
+
+    } while (0);
+
+    free(bits);
+
+    return columns;
+}
+
+/**
+ * Multiply an input block by the matrix over GF(2), appending the product
+ * to the output. The product is the exclusive OR of the columns selected by
+ * the input bits; each column is masked rather than skipped so that there
+ * are no unpredictable branches, and each word of the product is reduced
+ * from a contiguous slice so that the inner loop vectorizes.
+ * @param columns points to the slices of the columns of the matrix.
+ * @param n is the number of columns and input bits.
+ * @param m is the number of rows and output bits.
+ * @param in points to the input block.
+ * @param masks points to n words of scratch.
+ * @param out points to the output sequence.
+ */
+EXTRACT_CLONES
+static void toeplitz(const uint64_t * restrict columns, size_t n, size_t m, const uint64_t * restrict in, uint64_t * restrict masks, bits_t * out)
+{
+    size_t words = (m + 63) / 64;
+    uint64_t product;
+    size_t jj;
+    size_t kk;
+
+    for (jj = 0; jj < n; ++jj) {
+        masks[jj] = -((in[jj / 64] >> (jj % 64)) & 1);
+    }
+
+    for (kk = 0; kk < words; ++kk) {
+        product = 0;
+        for (jj = 0; jj < n; ++jj) {
+            product ^= columns[jj] & masks[jj];
+        }
+        append(out, product, ((m - (kk * 64)) < 64) ? (m - (kk * 64)) : 64);
+        columns += n;
+    }
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+static void usage(void)
+{
+    int ii;
+
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -P ] [ -x EXTRACTOR ] [ -d DEPTH ] [ -i BITS ] [ -o BITS ] [ -s SEED ] [ -b BYTES ] [ -n BYTES ] [ -f PATH ]\n", program);
+    fprintf(stderr, "       -b BYTES        Read this many bytes per block.\n");
+    fprintf(stderr, "       -d DEPTH        Iterate Peres this many levels deep.\n");
+    fprintf(stderr, "       -f PATH         Read from here instead of stdin.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -i BITS         Hash this many input bits per Toeplitz block.\n");
+    fprintf(stderr, "       -n BYTES        Stop after reading this many bytes.\n");
+    fprintf(stderr, "       -o BITS         Emit this many output bits per Toeplitz block.\n");
+    fprintf(stderr, "       -P              Use the portable kernels even if BMI2 is available.\n");
+    fprintf(stderr, "       -s SEED         Seed the Toeplitz matrix.\n");
+    fprintf(stderr, "       -v              Report bits in, bits out, and throughput.\n");
+    fprintf(stderr, "       -x EXTRACTOR    Use this extractor.\n");
+    for (ii = 0; ii < (sizeof(EXTRACTORS) / sizeof(EXTRACTORS[0])); ++ii) {
+        fprintf(stderr, "       EXTRACTOR       %s\n", EXTRACTORS[ii]);
+    }
+}
+
+/**
+ * Read until a block is full, the end of file, or an error.
+ * @return the number of bytes read or <0 for error.
+ */
+static ssize_t fill(int fd, uint8_t * buffer, size_t size)
+{
+    size_t total = 0;
+    ssize_t bytes;
+
+    while ((total < size) && (!done)) {
+        bytes = read(fd, buffer + total, size - total);
+        if (bytes > 0) {
+            total += bytes;
+        } else if (bytes == 0) {
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int portable = 0;
+    enum extractor extractor = VONNEUMANN;
+    int depth = 4;
+    size_t n = 1024;
+    size_t m = 512;
+    uint64_t seed = 1;
+    size_t size = 65536;
+    uint64_t limit = ~(uint64_t)0;
+    const char * path = (const char *)0;
+    int fd = STDIN_FILENO;
+    uint64_t * block = (uint64_t *)0;
+    uint64_t * columns = (uint64_t *)0;
+    uint64_t * masks = (uint64_t *)0;
+    bits_t out = { 0 };
+    output_t * op = (output_t *)0;
+    struct sigaction action = { 0 };
+    uint64_t bitsin = 0;
+    uint64_t bitsout = 0;
+    uint64_t epoch;
+    uint64_t elapsed = 0;
+    uint64_t busy = 0;
+    uint64_t then;
+    ssize_t bytes;
+    size_t kk;
+    size_t bytesout;
+    char * end = (char *)0;
+    int rc = 0;
+    int opt;
+    int ii;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:d:f:hi:n:o:Ps:vx:")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'd':
+            depth = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (depth < 1) || (depth > DEPTHS)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'f':
+            path = optarg;
+            break;
+
+        case 'i':
+            n = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (n == 0) || ((n % 64) != 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'n':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            m = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (m == 0) || ((m % 8) != 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'P':
+            portable = !0;
+            break;
+
+        case 's':
+            seed = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'x':
+            for (ii = 0; ii < (sizeof(EXTRACTORS) / sizeof(EXTRACTORS[0])); ++ii) {
+                if (strcmp(optarg, EXTRACTORS[ii]) == 0) {
+                    break;
+                }
+            }
+            if (ii < (sizeof(EXTRACTORS) / sizeof(EXTRACTORS[0]))) {
+                extractor = ii;
+            } else {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage();
+            break;
+        }
+
+        if ((extractor == TOEPLITZ) && (m > n)) {
+            errno = EINVAL;
+            perror("-o");
+            break;
+        }
+
+        if (extractor == VONNEUMANN) {
+            depth = 1;
+        }
+
+        /*
+         * Make the block a whole number of words, and for Toeplitz a whole
+         * number of matrix inputs.
+         */
+
+        kk = (extractor == TOEPLITZ) ? (n / 8) : sizeof(uint64_t);
+        size = ((size + kk - 1) / kk) * kk;
+
+        compress = vonneumann_initialize(portable);
+
+        if (verbose) {
+            fprintf(stderr, "%s: extractor %s\n", program, EXTRACTORS[extractor]);
+            fprintf(stderr, "%s: kernel %s\n", program, vonneumann_kernel());
+            fprintf(stderr, "%s: block %zu bytes\n", program, size);
+            if (extractor == PERES) {
+                fprintf(stderr, "%s: depth %d\n", program, depth);
+            }
+            if (extractor == TOEPLITZ) {
+                fprintf(stderr, "%s: input %zu bits\n", program, n);
+                fprintf(stderr, "%s: output %zu bits\n", program, m);
+                fprintf(stderr, "%s: seed 0x%16.16lx\n", program, seed);
+            }
+        }
+
+        block = (uint64_t *)calloc((size / sizeof(uint64_t)) + 1, sizeof(uint64_t));
+        if (block == (uint64_t *)0) {
+            perror("calloc");
+            break;
+        }
+
+        if (allocate(&out, (size * 8) + 8) < 0) {
+            perror("calloc");
+            break;
+        }
+
+        if (extractor == PERES) {
+            for (ii = 0; ii < depth; ++ii) {
+                if ((allocate(&scratch[ii][0], size * 4) < 0) || (allocate(&scratch[ii][1], size * 4) < 0)) {
+                    break;
+                }
+            }
+            if (ii < depth) {
+                perror("calloc");
+                break;
+            }
+        }
+
+        if (extractor == TOEPLITZ) {
+            columns = matrix(seed, n, m);
+            masks = (uint64_t *)calloc(n, sizeof(uint64_t));
+            if ((columns == (uint64_t *)0) || (masks == (uint64_t *)0)) {
+                perror("calloc");
+                break;
+            }
+        }
+
+        if (path != (const char *)0) {
+            fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                perror(path);
+                break;
+            }
+        }
+
+        action.sa_handler = handler;
+        sigaction(SIGINT, &action, (struct sigaction *)0);
+        sigaction(SIGTERM, &action, (struct sigaction *)0);
+        signal(SIGPIPE, SIG_IGN);
+
+        op = output_open(STDOUT_FILENO, 0, 0, &done);
+        if (op == (output_t *)0) {
+            perror("output_open");
+            break;
+        }
+
+        epoch = now();
+
+        while ((!done) && (limit > 0)) {
+
+            bytes = fill(fd, (uint8_t *)block, (limit < size) ? limit : size);
+            if (bytes < 0) {
+                perror("read");
+                rc = -1;
+                break;
+            } else if (bytes == 0) {
+                break;
+            } else {
+                /* Do nothing. */
+            }
+            limit -= bytes;
+            bitsin += bytes * 8;
+
+            then = now();
+            if (extractor != TOEPLITZ) {
+                memset((uint8_t *)block + bytes, 0, sizeof(uint64_t) - (bytes % sizeof(uint64_t)));
+                peres(block, bytes * 8, depth, &out);
+            } else {
+                for (kk = 0; ((kk + 1) * (n / 8)) <= bytes; ++kk) {
+                    toeplitz(columns, n, m, block + (kk * (n / 64)), masks, &out);
+                }
+            }
+            busy += now() - then;
+
+            bytesout = out.count / 8;
+            bitsout += bytesout * 8;
+            rc = output_write(op, out.words, bytesout);
+            if (rc < 0) {
+                perror("output_write");
+            }
+            if (rc != 0) {
+                break;
+            }
+
+            /*
+             * Carry the bits that don't make a whole byte over to the
+             * next block.
+             */
+
+            out.words[0] = (out.count % 8) ? ((((uint8_t *)out.words)[bytesout]) & ((1U << (out.count % 8)) - 1)) : 0;
+            out.count %= 8;
+
+        }
+
+        if (rc == 0) {
+            rc = output_flush(op);
+            if (rc < 0) {
+                perror("output_flush");
+            }
+        }
+
+        elapsed = now() - epoch;
+
+        xc = (rc < 0) ? 1 : 0;
+
+    } while (0);
+
+    output_close(op);
+
+    if ((fd != STDIN_FILENO) && (fd >= 0)) {
+        close(fd);
+    }
+
+    if (verbose) {
+        fprintf(stderr, "%s: in %lu bits\n", program, bitsin);
+        fprintf(stderr, "%s: out %lu bits\n", program, bitsout);
+        fprintf(stderr, "%s: ratio %lf\n", program, (bitsin > 0) ? ((double)bitsout / bitsin) : 0.0);
+        fprintf(stderr, "%s: elapsed %lu nanoseconds\n", program, elapsed);
+        fprintf(stderr, "%s: extracting %lu nanoseconds\n", program, busy);
+        fprintf(stderr, "%s: throughput %lf bytes/second in %lf bytes/second out\n", program, (elapsed > 0) ? (bitsin * 1000000000.0 / 8 / elapsed) : 0.0, (elapsed > 0) ? (bitsout * 1000000000.0 / 8 / elapsed) : 0.0);
+        fprintf(stderr, "%s: extraction %lf bytes/second in %lf nanoseconds/byte\n", program, (busy > 0) ? (bitsin * 1000000000.0 / 8 / busy) : 0.0, (bitsin > 0) ? (busy * 8.0 / bitsin) : 0.0);
+    }
+
+    for (ii = 0; ii < DEPTHS; ++ii) {
+        free(scratch[ii][0].words);
+        free(scratch[ii][1].words);
+    }
+    free(out.words);
+    free(masks);
+    free(columns);
+    free(block);
+
+    return xc;
+}
@@ -11,30 +11,99 @@
  *
  * USAGE
  *
- * getrandom [ -d ] [ -v ] [ -r ] [ -n ]
+ * getrandom [ -d ] [ -v ] [ -r ] [ -n ] [ -k ] [ -s ] [ -b BYTES ] [ -t THREADS ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Request this many bytes per call (default 65536).
+ * -d              Use a deterministic test pattern instead of getrandom(2).
+ * -k              Always use the system call, never the vDSO.
+ * -n              Use GRND_NONBLOCK.
+ * -r              Use GRND_RANDOM (which always uses the system call).
+ * -s              Report statistics to stderr at exit and on SIGHUP.
+ * -t THREADS      Fill buffers using this many generator threads.
+ * -v              Display every call to stderr.
  *
  * EXAMPLES
  *
  * getrandom -r | dd of=random.dat bs=4096 count=1024 iflag=fullblock
- * 
+ *
+ * getrandom -s -t 4 -b 1048576 | rate -r 1048576 -t 10000000000
+ *
+ * getrandom -b 4 -k
+ *
  * ABSTRACT
  *
- * Continuously output thirty-bit binary numbers generated by the Linux
- * getrandom(2) system call.
+ * Continuously output binary data generated by the Linux getrandom(2) system
+ * call. Each call fills an entire buffer rather than a single thirty-two bit
+ * word, and where the kernel exports getrandom from its vDSO (Linux 6.11 and
+ * later) the buffer is filled in user space without a system call at all
+ * unless GRND_RANDOM is specified. Optionally, several generator threads each
+ * fill buffers in a ring that is written to standard output strictly in
+ * order, so that the output is the same sequence of buffers regardless of
+ * which thread finishes first. The statistics report the number of calls,
+ * how many of them were system calls, how many system calls were avoided
+ * compared to making one per thirty-two bit word as this tool originally did,
+ * and the sustained output rate. Specifying -b 4 -k reproduces the original
+ * behavior.
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/random.h>
+#include "vgetrandom.h"
+#include "output.h"
+
+typedef ssize_t (getrandom_t)(void *, void *, size_t, unsigned int);
+
+/**
+ * A slot in the output ring. A slot is filled by a generator thread with
+ * the buffer having sequence number seq, and emptied by the writer, after
+ * which it may be filled with the buffer having sequence number seq plus
+ * the number of slots.
+ */
+typedef struct Slot {
+    uint8_t * buffer;
+    uint64_t seq;
+    int full;
+} slot_t;
+
+static const char * name = "getrandom";
+static int verbose = 0;
+static int stats = 0;
+static volatile int done = 0;
+static volatile int report = 0;
+static getrandom_t * fp = (getrandom_t *)0;
+static unsigned int flags = 0;
+static size_t size = 65536;
+static int novdso = 0;
+static output_t * op = (output_t *)0;
 
-static ssize_t mygetrandom(void * pp, size_t ss, unsigned int flags)
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t emptied = PTHREAD_COND_INITIALIZER;
+static slot_t * ring = (slot_t *)0;
+static size_t slots = 0;
+static int threads = 0;
+static int failed = 0;
+
+static uint64_t calls = 0;
+static uint64_t syscalls = 0;
+static uint64_t vdsocalls = 0;
+
+static ssize_t mygetrandom(void * vv, void * pp, size_t ss, unsigned int flags)
 {
     ssize_t rc = sizeof(uint8_t);
     uint8_t * bb = (uint8_t *)pp;
-    static int state = 0;
+    static __thread int state = 0;
     if (ss == 0) {
         rc = -1;
     } else {
@@ -63,61 +132,400 @@ static ssize_t mygetrandom(void * pp, size_t ss, unsigned int flags)
     return rc;
 }
 
+static ssize_t kgetrandom(void * vv, void * pp, size_t ss, unsigned int flags)
+{
+    return getrandom(pp, ss, flags);
+}
+
+static void handler(int signum)
+{
+    if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        done = !0;
+    }
+}
+
+static uint64_t watch(void)
+{
+    struct timespec spec = { 0 };
+    uint64_t ticks;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
+    ticks = spec.tv_sec;
+    ticks *= 1000000000;
+    ticks += spec.tv_nsec;
+
+    return ticks;
+}
+
+static void statistics(uint64_t epoch, uint64_t total)
+{
+    uint64_t elapsed = watch() - epoch;
+    uint64_t c = __atomic_load_n(&calls, __ATOMIC_RELAXED);
+    uint64_t s = __atomic_load_n(&syscalls, __ATOMIC_RELAXED);
+    uint64_t v = __atomic_load_n(&vdsocalls, __ATOMIC_RELAXED);
+    uint64_t words = total / sizeof(uint32_t);
+    output_statistics_t o = { 0 };
+    double rate = 0.0;
+
+    if (elapsed > 0) {
+        rate = total * 1000000000.0 / elapsed;
+    }
+
+    if (op != (output_t *)0) {
+        output_statistics(op, &o);
+    }
+
+    fprintf(stderr, "%s: calls=%lu syscalls=%lu vdso=%lu avoided=%lu bytes=%lu elapsed=%lu bytes/second=%lf pipe=%zu writes=%lu splices=%lu stalls=%lu stalled=%lu\n", name, c, s, v, (words > s) ? words - s : 0, total, elapsed, rate, o.pipesize, o.calls, o.splices, o.stalls, o.stalled);
+}
+
+/**
+ * Completely fill a buffer, making as many calls as it takes.
+ * @param state points to the vDSO opaque state or is NULL.
+ * @param buffer points to the buffer.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int fill(void * state, uint8_t * buffer)
+{
+    uint8_t * here = buffer;
+    size_t remaining = size;
+    ssize_t length;
+
+    while (remaining > 0) {
+        length = (*fp)(state, here, remaining, flags);
+        __atomic_add_fetch(&calls, 1, __ATOMIC_RELAXED);
+        if (fp == &kgetrandom) {
+            __atomic_add_fetch(&syscalls, 1, __ATOMIC_RELAXED);
+        } else if (fp != &vgetrandom) {
+            /* Do nothing. */
+        } else if ((state == (void *)0) || ((flags & GRND_RANDOM) != 0)) {
+            __atomic_add_fetch(&syscalls, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_add_fetch(&vdsocalls, 1, __ATOMIC_RELAXED);
+        }
+        if (verbose) fprintf(stderr, "%s: [%zd]\n", name, length);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("getrandom");
+            return -1;
+        } else if (length == 0) {
+            return 1;
+        } else if (length > remaining) {
+            errno = EINVAL;
+            perror("getrandom");
+            return -1;
+        } else {
+            /* Do nothing. */
+        }
+        here += length;
+        remaining -= length;
+    }
+
+    return 0;
+}
+
+/**
+ * Generator thread. Thread N of T fills the buffers with sequence numbers
+ * N, N+T, N+2T, and so on, each into the slot its sequence number selects.
+ */
+static void * body(void * arg)
+{
+    uint64_t seq = (uintptr_t)arg;
+    void * state = (void *)0;
+    slot_t * sp;
+    int rc;
+
+    if (fp == &vgetrandom) {
+        state = vgetrandom_allocate();
+    }
+
+    while (!0) {
+
+        sp = &ring[seq % slots];
+
+        pthread_mutex_lock(&mutex);
+        while ((!done) && (sp->full || (sp->seq != seq))) {
+            pthread_cond_wait(&emptied, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (done) {
+            break;
+        }
+
+        rc = fill(state, sp->buffer);
+
+        pthread_mutex_lock(&mutex);
+        if (rc != 0) {
+            failed = (rc < 0) ? -1 : 1;
+            done = !0;
+        } else {
+            sp->full = !0;
+        }
+        pthread_cond_broadcast(&filled);
+        pthread_mutex_unlock(&mutex);
+
+        if (rc != 0) {
+            break;
+        }
+
+        seq += threads;
+
+    }
+
+    vgetrandom_free(state);
+
+    return (void *)0;
+}
+
+/**
+ * Write a buffer to standard output.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int emit(const uint8_t * buffer)
+{
+    int rc;
+
+    rc = output_write(op, buffer, size);
+    if (rc < 0) {
+        perror("output_write");
+    }
+
+    return rc;
+}
+
 int main(int argc, char * argv[])
 {
-    ssize_t length = -1;
-    uint32_t value = 0;
-    uint8_t * here = (uint8_t *)0;
-    size_t size = 0;
-    ssize_t (*fp)(void *, size_t, unsigned int) = &getrandom;
-    unsigned int flags = 0;
-    int verbose = 0;
+    int xc = 1;
     int ndx = 0;
-    const char * name = (const char *)0;
+    int rc = 0;
+    char * end = (char *)0;
+    void * state = (void *)0;
+    uint8_t * buffer = (uint8_t *)0;
+    size_t available = 0;
+    pthread_t * pool = (pthread_t *)0;
+    int created = 0;
+    uint64_t epoch = 0;
+    uint64_t total = 0;
+    uint64_t seq = 0;
+    slot_t * sp = (slot_t *)0;
+    struct sigaction action = { 0 };
     name = ((name = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : name + 1;
+    fp = &kgetrandom;
     for (ndx = 1; ndx < argc; ++ndx) {
         if (strncmp(argv[ndx], "-d", sizeof("-d")) == 0) {
             fp = &mygetrandom;
+        } else if (strncmp(argv[ndx], "-k", sizeof("-k")) == 0) {
+            novdso = !0;
         } else if (strncmp(argv[ndx], "-n", sizeof("-n")) == 0) {
             flags |= GRND_NONBLOCK;
         } else if (strncmp(argv[ndx], "-r", sizeof("-r")) == 0) {
             flags |= GRND_RANDOM;
+        } else if (strncmp(argv[ndx], "-s", sizeof("-s")) == 0) {
+            stats = !0;
         } else if (strncmp(argv[ndx], "-v", sizeof("-v")) == 0) {
             verbose = !0;
+        } else if ((strncmp(argv[ndx], "-b", sizeof("-b")) == 0) && ((ndx + 1) < argc)) {
+            size = strtoul(argv[++ndx], &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(argv[ndx]);
+                return 1;
+            }
+        } else if ((strncmp(argv[ndx], "-t", sizeof("-t")) == 0) && ((ndx + 1) < argc)) {
+            threads = strtol(argv[++ndx], &end, 0);
+            if ((*end != '\0') || (threads < 0)) {
+                errno = EINVAL;
+                perror(argv[ndx]);
+                return 1;
+            }
         } else {
             errno = EINVAL;
             perror(argv[ndx]);
         }
     }
-    while (!0) {
-        value = 0;
-        here = (uint8_t *)&value;
-        size = sizeof(value);
-        while (size > 0) {
-            length = (*fp)(here, size, flags);
-            if (verbose) fprintf(stderr, "%s: [%zd]\n", name, length);
-            if (length < 0) {
-                perror("getrandom");
-                return 1;
-            } else if (length == 0) {
-                return 0;
-            } else if (length > size) {
-                errno = EINVAL;
-                perror("getrandom");
-                return 1;
-            } else {
-                /* Do nothing. */
-            }
-            here += length;
-            size -= length;
+
+    /*
+     * Keep the output a whole number of thirty-two bit words so that the
+     * test pattern stays aligned across buffers.
+     */
+
+    size = (size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+
+    /*
+     * The vDSO stands in for the system call only when we are using the
+     * kernel and haven't been told to avoid it.
+     */
+
+    if (fp != &kgetrandom) {
+        /* Do nothing. */
+    } else if (novdso) {
+        /* Do nothing. */
+    } else if (vgetrandom_available()) {
+        fp = &vgetrandom;
+    } else {
+        /* Do nothing. */
+    }
+
+    action.sa_handler = handler;
+    sigaction(SIGINT, &action, (struct sigaction *)0);
+    sigaction(SIGTERM, &action, (struct sigaction *)0);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &action, (struct sigaction *)0);
+    signal(SIGPIPE, SIG_IGN);
+
+    epoch = watch();
+
+    do {
+
+        /*
+         * Make each output chunk a whole number of buffers so that a
+         * single thread can fill its buffers in place in the chunks.
+         */
+
+        op = output_open(STDOUT_FILENO, 0, (size < 65536) ? (65536 / size) * size : size, &done);
+        if (op == (output_t *)0) {
+            perror("output_open");
+            break;
         }
-        if (fwrite(&value, sizeof(value), 1, stdout) == 1) {
-            /* Do nothing. */
-        } else if (ferror(stdout)) {
-            perror("fwrite");
-            return 1;
+
+        if (threads <= 0) {
+
+            if (fp == &vgetrandom) {
+                state = vgetrandom_allocate();
+            }
+
+            while (!done) {
+                if (report) {
+                    statistics(epoch, total);
+                    report = 0;
+                }
+                buffer = (uint8_t *)output_buffer(op, &available);
+                rc = fill(state, buffer);
+                if (rc != 0) {
+                    break;
+                }
+                rc = output_commit(op, size);
+                if (rc < 0) {
+                    perror("output_commit");
+                }
+                if (rc != 0) {
+                    break;
+                }
+                total += size;
+            }
+
         } else {
-            return 0;
+
+            slots = threads * 2;
+
+            ring = (slot_t *)calloc(slots, sizeof(slot_t));
+            if (ring == (slot_t *)0) {
+                perror("calloc");
+                break;
+            }
+
+            for (ndx = 0; ndx < slots; ++ndx) {
+                ring[ndx].seq = ndx;
+                ring[ndx].buffer = (uint8_t *)malloc(size);
+                if (ring[ndx].buffer == (uint8_t *)0) {
+                    perror("malloc");
+                    break;
+                }
+            }
+            if (ndx < slots) {
+                break;
+            }
+
+            pool = (pthread_t *)calloc(threads, sizeof(pthread_t));
+            if (pool == (pthread_t *)0) {
+                perror("calloc");
+                break;
+            }
+
+            for (created = 0; created < threads; ++created) {
+                rc = pthread_create(&pool[created], (pthread_attr_t *)0, body, (void *)(uintptr_t)created);
+                if (rc != 0) {
+                    errno = rc;
+                    perror("pthread_create");
+                    rc = -1;
+                    break;
+                }
+            }
+            if (created < threads) {
+                break;
+            }
+
+            while (!0) {
+                if (report) {
+                    statistics(epoch, total);
+                    report = 0;
+                }
+                sp = &ring[seq % slots];
+                pthread_mutex_lock(&mutex);
+                while ((!done) && (!(sp->full && (sp->seq == seq)))) {
+                    pthread_cond_wait(&filled, &mutex);
+                }
+                pthread_mutex_unlock(&mutex);
+                if (done) {
+                    rc = failed;
+                    break;
+                }
+                rc = emit(sp->buffer);
+                if (rc != 0) {
+                    break;
+                }
+                total += size;
+                pthread_mutex_lock(&mutex);
+                sp->full = 0;
+                sp->seq = seq + slots;
+                pthread_cond_broadcast(&emptied);
+                pthread_mutex_unlock(&mutex);
+                ++seq;
+            }
+
+        }
+
+        xc = (rc < 0) ? 1 : 0;
+
+    } while (0);
+
+    if (pool != (pthread_t *)0) {
+        pthread_mutex_lock(&mutex);
+        done = !0;
+        pthread_cond_broadcast(&emptied);
+        pthread_mutex_unlock(&mutex);
+        for (ndx = 0; ndx < created; ++ndx) {
+            pthread_join(pool[ndx], (void **)0);
+        }
+        free(pool);
+    }
+
+    if (ring != (slot_t *)0) {
+        for (ndx = 0; ndx < slots; ++ndx) {
+            free(ring[ndx].buffer);
+        }
+        free(ring);
+    }
+
+    vgetrandom_free(state);
+
+    if (op != (output_t *)0) {
+        rc = output_flush(op);
+        if (rc < 0) {
+            perror("output_flush");
+            xc = 1;
         }
     }
+
+    if (stats) {
+        statistics(epoch, total);
+    }
+
+    output_close(op);
+
+    return xc;
 }
@@ -0,0 +1,813 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Independence<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * independence [ -h ] [ -v ] [ -n BYTES ] [ -k OFFSETS ] [ -t THREADS ] [ -a ALPHA ] PATH PATH [ PATH ... ]
+ *
+ * OPTIONS
+ *
+ * -a ALPHA         Flag pairs with this chance of any false alarm (default 0.01).
+ * -h               Display this menu.
+ * -k OFFSETS       Cross correlate at offsets up to this many bits each way (default 64).
+ * -n BYTES         Capture this many bytes from every PATH at once instead of mapping files.
+ * -t THREADS       Use this many threads (default one per online processor).
+ * -v               Report sizes, times, and every statistic to stderr.
+ *
+ * EXAMPLES
+ *
+ * independence -v quantis0.dat quantis1.dat
+ *
+ * independence -n 16777216 /dev/hwrng /dev/qrandom0 /dev/qrandom1
+ *
+ * ABSTRACT
+ *
+ * Tests whether two or more sources are independent, as mixing them
+ * assumes, from aligned captures: byte t of one source is compared with
+ * byte t of every other. The captures are either files, which are mapped
+ * into memory, or, with -n, BYTES read from each PATH, which may be a
+ * device or a FIFO, by a thread per source, all released at once from a
+ * barrier and timestamped from the same monotonic clock, so that the bytes
+ * at the same index were produced at about the same time.
+ *
+ * For each pair of sources, for as many bytes as the shorter has, it
+ * computes the joint histogram of the byte pairs, the chi-square of that
+ * histogram against the product of its marginals (which is independent of
+ * any bias of either source alone), and the mutual information in bits per
+ * byte with the amount an independent pair would show by chance; and the
+ * bit level cross correlation of the two at every offset from -OFFSETS to
+ * +OFFSETS bits, counted sixty-four bits at a time as the population count
+ * of the exclusive OR of a word of one and the shifted words of the other,
+ * with kernels cloned for AVX2 and POPCNT and selected at run time. The
+ * histograms and counts are computed by a thread per processor over tiles
+ * of the captures and merged. Coupling through a shared clock, hub, or
+ * power supply shows as an excess chi-square or a correlation at some
+ * offset. A pair is flagged dependent if any of its statistics is beyond
+ * the Bonferroni threshold for ALPHA over the statistics of all pairs; the exit
+ * code is 2 if any pair is flagged. The cost of the correlation grows with
+ * OFFSETS, so a wide scan of a multi-gigabyte pair is best narrowed first.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#if defined(__x86_64__)
+#   define INDEPENDENCE_CLONES __attribute__((target_clones("avx2","popcnt","default")))
+#else
+#   define INDEPENDENCE_CLONES
+#endif
+
+enum {
+    TILE = 4096,                /* Words each pass keeps cached. */
+    CELLS = 256 * 256,          /* Cells in a joint histogram. */
+    BLOCK = 65536,              /* Most bytes in one read of a capture. */
+};
+
+static const char * program = "independence";
+
+/**
+ * This is one source and its capture.
+ */
+typedef struct Source {
+    const char * path;
+    unsigned char * data;
+    uint64_t size;
+    int mapped;
+    pthread_t thread;
+    pthread_barrier_t * barrier;
+    uint64_t first;             /* Monotonic time of the first read. */
+    uint64_t last;              /* Monotonic time of the last read. */
+    uint64_t reads;
+    int error;
+} source_t;
+
+/**
+ * These describe the pair being tested, and are shared by every thread.
+ */
+static const unsigned char * left = (const unsigned char *)0;
+static const unsigned char * right = (const unsigned char *)0;
+static uint64_t nbytes = 0;
+static uint64_t nwords = 0;
+static uint64_t offsets = 64;
+static long threads = 0;
+
+/**
+ * This is the work of one thread: its joint histogram, the words of the
+ * tile it is working on, and its counts of differing pairs of bits with the
+ * right source after the left (forward) and the left after the right
+ * (backward), indexed by offset.
+ */
+typedef struct Work {
+    pthread_t thread;
+    long index;
+    uint64_t * histogram;
+    uint64_t * lefts;
+    uint64_t * rights;
+    int64_t * forward;
+    int64_t * backward;
+} work_t;
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n BYTES ] [ -k OFFSETS ] [ -t THREADS ] [ -a ALPHA ] PATH PATH [ PATH ... ]\n", program);
+    fprintf(stderr, "       -a ALPHA         Flag pairs with this chance of any false alarm.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -k OFFSETS       Cross correlate at offsets up to this many bits each way.\n");
+    fprintf(stderr, "       -n BYTES         Capture this many bytes from every PATH at once.\n");
+    fprintf(stderr, "       -t THREADS       Use this many threads.\n");
+    fprintf(stderr, "       -v               Report sizes, times, and every statistic.\n");
+}
+
+/*******************************************************************************
+ * CAPTURE
+ ******************************************************************************/
+
+static void * capture(void * arg)
+{
+    source_t * sp = (source_t *)arg;
+    uint64_t count = 0;
+    ssize_t rc;
+    size_t want;
+    int fd;
+
+    fd = open(sp->path, O_RDONLY);
+    if (fd < 0) {
+        sp->error = errno;
+    }
+
+    /*
+     * Every thread waits here, opened or not, so that none is left behind.
+     */
+
+    pthread_barrier_wait(sp->barrier);
+
+    while ((fd >= 0) && (count < sp->size)) {
+        want = sp->size - count;
+        if (want > BLOCK) {
+            want = BLOCK;
+        }
+        rc = read(fd, sp->data + count, want);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sp->error = errno;
+            break;
+        }
+        if (rc == 0) {
+            break;
+        }
+        sp->last = now();
+        if (sp->reads == 0) {
+            sp->first = sp->last;
+        }
+        sp->reads += 1;
+        count += rc;
+    }
+
+    sp->size = count;
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * KERNELS
+ ******************************************************************************/
+
+static inline uint64_t load(const unsigned char * data, uint64_t index)
+{
+    uint64_t word;
+
+    memcpy(&word, &data[index * sizeof(word)], sizeof(word));
+
+    return __builtin_bswap64(word);
+}
+
+/**
+ * Count, for every offset, the differing pairs of bits whose first bit is
+ * in a tile of words of x and whose second is that many bits later in y.
+ * The second bit is in the word q = k / 64 later, or the one after; the
+ * last word with a partner at all has only some of its bits paired, and is
+ * masked.
+ * @param x points to the words of the tile of the earlier source.
+ * @param y points to the words of the same tile of the later source and
+ * as many words after it as the offsets reach.
+ * @param begin is the index in the capture of the first word of the tile.
+ * @param count is the number of words in the tile.
+ * @param first is the smallest offset to count.
+ * @param totals points to the counts indexed by offset.
+ */
+INDEPENDENCE_CLONES
+static void differ(const uint64_t * x, const uint64_t * y, uint64_t begin, uint64_t count, uint64_t first, int64_t * totals)
+{
+    uint64_t offset;
+    uint64_t q;
+    uint64_t last;
+    uint64_t limit;
+    uint64_t jj;
+    uint64_t sum;
+    unsigned int r;
+
+    for (offset = first; offset <= offsets; ++offset) {
+
+        q = offset / 64;
+        r = offset % 64;
+        if ((q + 1) > nwords) {
+            break;
+        }
+
+        last = nwords - q - 1;  /* The last word with a partner. */
+        if (last < begin) {
+            break;
+        }
+        last -= begin;
+        limit = (last < count) ? last : count;
+        sum = 0;
+
+        if (r == 0) {
+            for (jj = 0; jj < limit; ++jj) {
+                sum += __builtin_popcountll(x[jj] ^ y[jj + q]);
+            }
+            if (last < count) {
+                sum += __builtin_popcountll(x[last] ^ y[last + q]);
+            }
+        } else {
+            for (jj = 0; jj < limit; ++jj) {
+                sum += __builtin_popcountll(x[jj] ^ ((y[jj + q] << r) | (y[jj + q + 1] >> (64 - r))));
+            }
+            if (last < count) {
+                sum += __builtin_popcountll((x[last] ^ (y[last + q] << r)) & (~(uint64_t)0 << r));
+            }
+        }
+
+        totals[offset] += sum;
+
+    }
+}
+
+static void * worker(void * arg)
+{
+    work_t * wp = (work_t *)arg;
+    uint64_t * histogram = wp->histogram;
+    uint64_t tile;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t reach;
+    uint64_t ii;
+    uint64_t limit;
+
+    for (tile = wp->index; (tile * TILE) < nwords; tile += threads) {
+
+        begin = tile * TILE;
+        end = ((begin + TILE) < nwords) ? (begin + TILE) : nwords;
+
+        /*
+         * The last tile also takes the bytes past the last whole word.
+         */
+
+        limit = (end < nwords) ? (end * sizeof(uint64_t)) : nbytes;
+        for (ii = begin * sizeof(uint64_t); ii < limit; ++ii) {
+            histogram[(left[ii] << 8) | right[ii]] += 1;
+        }
+
+        /*
+         * Load the words of the tile, and those the offsets reach past it,
+         * once, earliest bit most significant.
+         */
+
+        reach = end + (offsets / 64) + 1;
+        if (reach > nwords) {
+            reach = nwords;
+        }
+        for (ii = begin; ii < reach; ++ii) {
+            wp->lefts[ii - begin] = load(left, ii);
+            wp->rights[ii - begin] = load(right, ii);
+        }
+
+        differ(wp->lefts, wp->rights, begin, end - begin, 0, wp->forward);
+        differ(wp->rights, wp->lefts, begin, end - begin, 1, wp->backward);
+
+    }
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * STATISTICS
+ ******************************************************************************/
+
+/**
+ * Return the deviation beyond which a statistic is flagged, so that the
+ * chance that any of count statistics is flagged for independent sources
+ * is alpha.
+ */
+static double threshold(double alpha, uint64_t count)
+{
+    double low = 0.0;
+    double high = 40.0;
+    double middle;
+    double target;
+    int ii;
+
+    target = alpha / count;
+
+    for (ii = 0; ii < 100; ++ii) {
+        middle = (low + high) / 2.0;
+        if (erfc(middle / M_SQRT2) > target) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return high;
+}
+
+/**
+ * Test one pair, whose totals are merged into the first work.
+ * @return !0 if the pair is flagged.
+ */
+static int report(const source_t * a, const source_t * b, work_t * works, double sigmas, int verbose)
+{
+    uint64_t * histogram = works[0].histogram;
+    uint64_t rows[256];
+    uint64_t columns[256];
+    uint64_t nrows = 0;
+    uint64_t ncolumns = 0;
+    double total = (double)nbytes;
+    double expected;
+    double chisquare = 0.0;
+    double mutual = 0.0;
+    double chance;
+    double df;
+    double wh;
+    double zchi;
+    double z;
+    double worst = 0.0;
+    int64_t worstoffset = 0;
+    int64_t signedoffset;
+    uint64_t pairs;
+    uint64_t different;
+    uint64_t offset;
+    int direction;
+    int flagged = 0;
+    int ii;
+    int jj;
+
+    memset(rows, 0, sizeof(rows));
+    memset(columns, 0, sizeof(columns));
+
+    for (ii = 0; ii < 256; ++ii) {
+        for (jj = 0; jj < 256; ++jj) {
+            rows[ii] += histogram[(ii << 8) | jj];
+            columns[jj] += histogram[(ii << 8) | jj];
+        }
+    }
+
+    for (ii = 0; ii < 256; ++ii) {
+        nrows += (rows[ii] > 0);
+        ncolumns += (columns[ii] > 0);
+    }
+
+    /*
+     * Chi-square against the product of the marginals, and mutual
+     * information, from the same histogram.
+     */
+
+    for (ii = 0; ii < 256; ++ii) {
+        for (jj = 0; jj < 256; ++jj) {
+            if ((rows[ii] == 0) || (columns[jj] == 0)) {
+                continue;
+            }
+            expected = ((double)rows[ii] * (double)columns[jj]) / total;
+            chisquare += ((histogram[(ii << 8) | jj] - expected) * (histogram[(ii << 8) | jj] - expected)) / expected;
+            if (histogram[(ii << 8) | jj] > 0) {
+                mutual += (histogram[(ii << 8) | jj] / total) * log2(histogram[(ii << 8) | jj] / expected);
+            }
+        }
+    }
+
+    df = (double)(nrows - 1) * (double)(ncolumns - 1);
+    if (df > 0.0) {
+        wh = 2.0 / (9.0 * df);
+        zchi = (cbrt(chisquare / df) - (1.0 - wh)) / sqrt(wh);
+    } else {
+        zchi = 0.0;
+    }
+    chance = df / (2.0 * total * M_LN2);
+
+    printf("%s: a=\"%s\" b=\"%s\" bytes=%llu chisquare=%.1f df=%.0f z=%.2f mutual=%.9f chance=%.9f\n", program, a->path, b->path, (unsigned long long)nbytes, chisquare, df, zchi, mutual, chance);
+
+    if (zchi >= sigmas) {
+        flagged = !0;
+    }
+
+    /*
+     * Cross correlation at every offset, negative when the left source
+     * lags the right.
+     */
+
+    for (direction = -1; direction <= 1; direction += 2) {
+        for (offset = (direction < 0) ? 1 : 0; offset <= offsets; ++offset) {
+            if (((nwords * 64) <= offset)) {
+                break;
+            }
+            pairs = (nwords * 64) - offset;
+            different = (direction < 0) ? works[0].backward[offset] : works[0].forward[offset];
+            z = ((double)pairs - (2.0 * different)) / sqrt((double)pairs);
+            signedoffset = direction * (int64_t)offset;
+            if (fabs(z) > fabs(worst)) {
+                worst = z;
+                worstoffset = signedoffset;
+            }
+            if (fabs(z) >= sigmas) {
+                printf("%s: a=\"%s\" b=\"%s\" offset=%lld correlation=%.6f z=%.2f\n", program, a->path, b->path, (long long)signedoffset, ((double)pairs - (2.0 * different)) / pairs, z);
+                flagged = !0;
+            }
+        }
+    }
+
+    if (verbose) {
+        fprintf(stderr, "%s: a=\"%s\" b=\"%s\" worst=%lld z=%.2f\n", program, a->path, b->path, (long long)worstoffset, worst);
+    }
+
+    printf("%s: a=\"%s\" b=\"%s\" %s\n", program, a->path, b->path, flagged ? "DEPENDENT" : "independent");
+
+    return flagged;
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    double alpha = 0.01;
+    double sigmas;
+    uint64_t capturing = 0;
+    source_t * sources = (source_t *)0;
+    work_t * works = (work_t *)0;
+    pthread_barrier_t barrier;
+    struct stat status;
+    uint64_t epoch;
+    uint64_t elapsed;
+    uint64_t offset;
+    uint64_t ii;
+    long started = 0;
+    long tt;
+    int nsources = 0;
+    int flagged = 0;
+    int aa;
+    int bb;
+    int fd;
+    char * end = (char *)0;
+    int rc = 0;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "a:hk:n:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'a':
+            alpha = strtod(optarg, &end);
+            if ((*end != '\0') || (!(alpha > 0.0)) || (!(alpha < 1.0))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'k':
+            offsets = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (offsets > (1ULL << 24))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'n':
+            capturing = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (capturing == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error || ((argc - optind) < 2)) {
+            usage();
+            break;
+        }
+
+        nsources = argc - optind;
+        sources = (source_t *)calloc(nsources, sizeof(source_t));
+        if (sources == (source_t *)0) {
+            perror("calloc");
+            break;
+        }
+
+        for (aa = 0; aa < nsources; ++aa) {
+            sources[aa].path = argv[optind + aa];
+        }
+
+        /*
+         * Either capture every source at once, or map every file.
+         */
+
+        if (capturing > 0) {
+
+            rc = pthread_barrier_init(&barrier, (pthread_barrierattr_t *)0, nsources);
+            if (rc != 0) {
+                errno = rc;
+                perror("pthread_barrier_init");
+                break;
+            }
+
+            for (aa = 0; aa < nsources; ++aa) {
+                sources[aa].data = (unsigned char *)malloc(capturing);
+                if (sources[aa].data == (unsigned char *)0) {
+                    break;
+                }
+                sources[aa].size = capturing;
+                sources[aa].barrier = &barrier;
+            }
+            if (aa < nsources) {
+                perror("malloc");
+                break;
+            }
+
+            /*
+             * A barrier must be reached by all of its threads, so if one
+             * cannot be started, none can be waited for.
+             */
+
+            for (aa = 0; aa < nsources; ++aa) {
+                rc = pthread_create(&sources[aa].thread, (pthread_attr_t *)0, capture, &sources[aa]);
+                if (rc != 0) {
+                    errno = rc;
+                    perror("pthread_create");
+                    exit(1);
+                }
+            }
+
+            for (aa = 0; aa < nsources; ++aa) {
+                pthread_join(sources[aa].thread, (void **)0);
+            }
+
+            pthread_barrier_destroy(&barrier);
+
+            epoch = sources[0].first;
+            for (aa = 0; aa < nsources; ++aa) {
+                if ((sources[aa].reads > 0) && (sources[aa].first < epoch)) {
+                    epoch = sources[aa].first;
+                }
+            }
+
+            for (aa = 0; aa < nsources; ++aa) {
+                if (sources[aa].error != 0) {
+                    errno = sources[aa].error;
+                    perror(sources[aa].path);
+                    rc = -1;
+                }
+                if (verbose && (sources[aa].reads > 0)) {
+                    fprintf(stderr, "%s: path=\"%s\" bytes=%llu reads=%llu start=%.6f end=%.6f bytes/second=%.0f\n", program, sources[aa].path, (unsigned long long)sources[aa].size, (unsigned long long)sources[aa].reads, (sources[aa].first - epoch) / 1000000000.0, (sources[aa].last - epoch) / 1000000000.0, sources[aa].size / ((sources[aa].last - sources[aa].first + 1) / 1000000000.0));
+                }
+            }
+            if (rc != 0) {
+                break;
+            }
+
+        } else {
+
+            for (aa = 0; aa < nsources; ++aa) {
+                fd = open(sources[aa].path, O_RDONLY);
+                if (fd < 0) {
+                    perror(sources[aa].path);
+                    break;
+                }
+                if (fstat(fd, &status) < 0) {
+                    perror(sources[aa].path);
+                    close(fd);
+                    break;
+                }
+                sources[aa].size = status.st_size;
+                if (sources[aa].size > 0) {
+                    sources[aa].data = (unsigned char *)mmap((void *)0, sources[aa].size, PROT_READ, MAP_SHARED, fd, 0);
+                    if (sources[aa].data == (unsigned char *)MAP_FAILED) {
+                        perror(sources[aa].path);
+                        sources[aa].data = (unsigned char *)0;
+                        close(fd);
+                        break;
+                    }
+                    sources[aa].mapped = !0;
+                    (void)madvise(sources[aa].data, sources[aa].size, MADV_SEQUENTIAL);
+                }
+                close(fd);
+            }
+            if (aa < nsources) {
+                break;
+            }
+
+        }
+
+        if (threads == 0) {
+            threads = sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads <= 0) {
+                threads = 1;
+            }
+        }
+
+        /*
+         * One chi-square and every offset each way for every pair.
+         */
+
+        sigmas = threshold(alpha, ((uint64_t)nsources * (nsources - 1) / 2) * (1 + (2 * offsets) + 1));
+
+        works = (work_t *)calloc(threads, sizeof(work_t));
+        if (works == (work_t *)0) {
+            perror("calloc");
+            break;
+        }
+
+        for (tt = 0; tt < threads; ++tt) {
+            works[tt].index = tt;
+            works[tt].histogram = (uint64_t *)malloc(CELLS * sizeof(uint64_t));
+            works[tt].forward = (int64_t *)malloc((offsets + 1) * sizeof(int64_t));
+            works[tt].backward = (int64_t *)malloc((offsets + 1) * sizeof(int64_t));
+            works[tt].lefts = (uint64_t *)malloc((TILE + (offsets / 64) + 1) * sizeof(uint64_t));
+            works[tt].rights = (uint64_t *)malloc((TILE + (offsets / 64) + 1) * sizeof(uint64_t));
+            if ((works[tt].histogram == (uint64_t *)0) || (works[tt].forward == (int64_t *)0) || (works[tt].backward == (int64_t *)0) || (works[tt].lefts == (uint64_t *)0) || (works[tt].rights == (uint64_t *)0)) {
+                break;
+            }
+        }
+        if (tt < threads) {
+            perror("malloc");
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: sources=%d offsets=%llu threads=%ld threshold=%.2f\n", program, nsources, (unsigned long long)offsets, threads, sigmas);
+        }
+
+        for (aa = 0; (rc == 0) && (aa < nsources); ++aa) {
+            for (bb = aa + 1; (rc == 0) && (bb < nsources); ++bb) {
+
+                nbytes = (sources[aa].size < sources[bb].size) ? sources[aa].size : sources[bb].size;
+                nwords = nbytes / sizeof(uint64_t);
+                if ((nwords * 64) <= offsets) {
+                    errno = ENODATA;
+                    perror(sources[(sources[aa].size < sources[bb].size) ? aa : bb].path);
+                    rc = -1;
+                    break;
+                }
+
+                left = sources[aa].data;
+                right = sources[bb].data;
+
+                for (tt = 0; tt < threads; ++tt) {
+                    memset(works[tt].histogram, 0, CELLS * sizeof(uint64_t));
+                    memset(works[tt].forward, 0, (offsets + 1) * sizeof(int64_t));
+                    memset(works[tt].backward, 0, (offsets + 1) * sizeof(int64_t));
+                }
+
+                epoch = now();
+
+                for (started = 0; started < threads; ++started) {
+                    rc = pthread_create(&works[started].thread, (pthread_attr_t *)0, worker, &works[started]);
+                    if (rc != 0) {
+                        errno = rc;
+                        perror("pthread_create");
+                        break;
+                    }
+                }
+
+                for (tt = 0; tt < started; ++tt) {
+                    pthread_join(works[tt].thread, (void **)0);
+                    if (tt == 0) {
+                        continue;
+                    }
+                    for (ii = 0; ii < CELLS; ++ii) {
+                        works[0].histogram[ii] += works[tt].histogram[ii];
+                    }
+                    for (offset = 0; offset <= offsets; ++offset) {
+                        works[0].forward[offset] += works[tt].forward[offset];
+                        works[0].backward[offset] += works[tt].backward[offset];
+                    }
+                }
+
+                elapsed = now() - epoch;
+
+                if (rc != 0) {
+                    break;
+                }
+
+                if (verbose) {
+                    fprintf(stderr, "%s: a=\"%s\" b=\"%s\" seconds=%.3f bytes/second=%.0f\n", program, sources[aa].path, sources[bb].path, elapsed / 1000000000.0, nbytes / (elapsed / 1000000000.0));
+                }
+
+                if (report(&sources[aa], &sources[bb], works, sigmas, verbose)) {
+                    flagged = !0;
+                }
+
+            }
+        }
+
+        if (rc != 0) {
+            break;
+        }
+
+        xc = flagged ? 2 : 0;
+
+    } while (0);
+
+    if (works != (work_t *)0) {
+        for (tt = 0; tt < threads; ++tt) {
+            free(works[tt].histogram);
+            free(works[tt].forward);
+            free(works[tt].backward);
+            free(works[tt].lefts);
+            free(works[tt].rights);
+        }
+    }
+    free(works);
+
+    if (sources != (source_t *)0) {
+        for (aa = 0; aa < nsources; ++aa) {
+            if (sources[aa].mapped) {
+                munmap(sources[aa].data, sources[aa].size);
+            } else {
+                free(sources[aa].data);
+            }
+        }
+    }
+    free(sources);
+
+    return xc;
+}
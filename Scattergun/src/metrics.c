@@ -0,0 +1,282 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Metrics Page<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The values are kept together, apart from the descriptions, so that the
+ * producer updating a handful of them touches only a few cache lines. The
+ * producer stores each value with relaxed ordering: a reader needs each
+ * value to be whole, not ordered with respect to the others. The count of
+ * metrics is stored with release ordering after a description is written
+ * and loaded with acquire ordering by readers, so that a reader never sees
+ * a metric before its description. Readers map the page read only, so a
+ * reader can never disturb the producer.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "metrics.h"
+
+enum {
+    MAGIC = 0x4d524753,         /* "SGRM" little endian. */
+    VERSION = 1,
+    LINE = 64,                  /* Bytes in a cache line. */
+};
+
+/**
+ * This is the layout of the shared memory object.
+ */
+typedef struct Page {
+    uint32_t magic;
+    uint32_t version;
+    int32_t producer;
+    int32_t count;
+    char program[32];
+    metrics_descriptor_t descriptors[METRICS_MAXIMUM];
+    uint64_t values[METRICS_MAXIMUM] __attribute__((aligned(LINE)));
+} page_t;
+
+struct Metrics {
+    page_t * page;
+    char * name;
+    int producer;
+};
+
+/*******************************************************************************
+ * HELPERS
+ ******************************************************************************/
+
+static metrics_t * map(const char * name, int fd, int prot)
+{
+    metrics_t * mp;
+    void * pointer;
+
+    pointer = mmap((void *)0, sizeof(page_t), prot, MAP_SHARED, fd, 0);
+    if (pointer == MAP_FAILED) {
+        return (metrics_t *)0;
+    }
+
+    mp = (metrics_t *)calloc(1, sizeof(*mp));
+    if (mp == (metrics_t *)0) {
+        munmap(pointer, sizeof(page_t));
+        return (metrics_t *)0;
+    }
+
+    mp->name = strdup(name);
+    if (mp->name == (char *)0) {
+        munmap(pointer, sizeof(page_t));
+        free(mp);
+        return (metrics_t *)0;
+    }
+
+    mp->page = (page_t *)pointer;
+
+    return mp;
+}
+
+/*******************************************************************************
+ * PRODUCER
+ ******************************************************************************/
+
+metrics_t * metrics_create(const char * name, const char * program, mode_t mode)
+{
+    metrics_t * mp = (metrics_t *)0;
+    page_t * page;
+    int fd;
+
+    (void)shm_unlink(name);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd < 0) {
+        return (metrics_t *)0;
+    }
+
+    do {
+
+        if (fchmod(fd, mode) < 0) {
+            break;
+        }
+
+        if (ftruncate(fd, sizeof(page_t)) < 0) {
+            break;
+        }
+
+        mp = map(name, fd, PROT_READ | PROT_WRITE);
+        if (mp == (metrics_t *)0) {
+            break;
+        }
+
+        page = mp->page;
+        page->version = VERSION;
+        page->producer = getpid();
+        strncpy(page->program, program, sizeof(page->program) - 1);
+        mp->producer = !0;
+
+        __atomic_store_n(&page->magic, MAGIC, __ATOMIC_RELEASE);
+
+    } while (0);
+
+    if (mp == (metrics_t *)0) {
+        (void)shm_unlink(name);
+    }
+
+    close(fd);
+
+    return mp;
+}
+
+int metrics_define(metrics_t * mp, const char * name, const char * labels, const char * help, int type, uint64_t scale)
+{
+    page_t * page;
+    metrics_descriptor_t * dp;
+    int index;
+
+    if (mp == (metrics_t *)0) {
+        return -1;
+    }
+
+    page = mp->page;
+    index = page->count;
+    if (index >= METRICS_MAXIMUM) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    dp = &page->descriptors[index];
+    strncpy(dp->name, name, sizeof(dp->name) - 1);
+    if (labels != (const char *)0) {
+        strncpy(dp->labels, labels, sizeof(dp->labels) - 1);
+    }
+    strncpy(dp->help, help, sizeof(dp->help) - 1);
+    dp->type = type;
+    dp->scale = (scale > 1) ? scale : 1;
+
+    __atomic_store_n(&page->count, index + 1, __ATOMIC_RELEASE);
+
+    return index;
+}
+
+void metrics_set(metrics_t * mp, int index, uint64_t value)
+{
+    if ((mp != (metrics_t *)0) && (index >= 0)) {
+        __atomic_store_n(&mp->page->values[index], value, __ATOMIC_RELAXED);
+    }
+}
+
+/*******************************************************************************
+ * READERS
+ ******************************************************************************/
+
+metrics_t * metrics_attach(const char * name)
+{
+    metrics_t * mp = (metrics_t *)0;
+    struct stat status;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return (metrics_t *)0;
+    }
+
+    do {
+
+        if (fstat(fd, &status) < 0) {
+            break;
+        }
+
+        if (status.st_size != sizeof(page_t)) {
+            errno = EPROTO;
+            break;
+        }
+
+        mp = map(name, fd, PROT_READ);
+        if (mp == (metrics_t *)0) {
+            break;
+        }
+
+        if ((__atomic_load_n(&mp->page->magic, __ATOMIC_ACQUIRE) != MAGIC) || (mp->page->version != VERSION)) {
+            metrics_detach(mp);
+            mp = (metrics_t *)0;
+            errno = EPROTO;
+            break;
+        }
+
+    } while (0);
+
+    close(fd);
+
+    return mp;
+}
+
+pid_t metrics_producer(metrics_t * mp, const char ** programp)
+{
+    pid_t pid;
+
+    if (programp != (const char **)0) {
+        *programp = mp->page->program;
+    }
+
+    pid = __atomic_load_n(&mp->page->producer, __ATOMIC_ACQUIRE);
+    if (pid == 0) {
+        /* Do nothing. */
+    } else if ((kill(pid, 0) < 0) && (errno == ESRCH)) {
+        pid = 0;
+    } else {
+        /* Do nothing. */
+    }
+
+    return pid;
+}
+
+int metrics_count(metrics_t * mp)
+{
+    return __atomic_load_n(&mp->page->count, __ATOMIC_ACQUIRE);
+}
+
+const metrics_descriptor_t * metrics_describe(metrics_t * mp, int index)
+{
+    return &mp->page->descriptors[index];
+}
+
+uint64_t metrics_get(metrics_t * mp, int index)
+{
+    return __atomic_load_n(&mp->page->values[index], __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+ * TEARDOWN
+ ******************************************************************************/
+
+void metrics_detach(metrics_t * mp)
+{
+    if (mp == (metrics_t *)0) {
+        return;
+    }
+
+    if (mp->producer) {
+        __atomic_store_n(&mp->page->producer, 0, __ATOMIC_RELEASE);
+        (void)shm_unlink(mp->name);
+    }
+
+    munmap(mp->page, sizeof(page_t));
+    free(mp->name);
+    free(mp);
+}
@@ -0,0 +1,146 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_METRICS_
+#define _H_COM_DIAG_SCATTERGUN_METRICS_
+
+/**
+ * @file
+ * Metrics Page<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * A page of named counters and gauges in POSIX shared memory, written by
+ * one process, such as seventool or quantistool, and read by any number of
+ * others, such as rngmetrics, so that the state of a daemon can be
+ * monitored continuously instead of only when it is sent a SIGHUP. Each
+ * value is a naturally aligned 64-bit word that the producer stores and a
+ * reader loads atomically, so neither ever waits for the other and a
+ * reader sees every value whole, though not necessarily all from the same
+ * instant. A metric is described once, by a name, optional Prometheus
+ * labels, a help string, a type, and a scale by which its value is divided
+ * to get the unit in its name; it is published to readers by advancing a
+ * count after its description is written. The functions return <0 or NULL
+ * with errno set for an error, like the system calls they wrap; those used
+ * by a producer do nothing if the page is NULL, so that a program can call
+ * them whether or not it was asked to publish metrics.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+enum {
+    METRICS_MAXIMUM = 512,      /* Maximum number of metrics in a page. */
+};
+
+/**
+ * These are the types of metrics, as Prometheus knows them.
+ */
+enum MetricsType {
+    METRICS_COUNTER = 0,        /* Only ever increases. */
+    METRICS_GAUGE = 1,          /* May go up or down. */
+};
+
+/**
+ * This is the opaque process local handle of a page.
+ */
+typedef struct Metrics metrics_t;
+
+/**
+ * This is the description of one metric in a page.
+ */
+typedef struct MetricsDescriptor {
+    char name[48];              /* E.g. "bytes_total". */
+    char labels[64];            /* E.g. "unit=\"USB:0\"" or empty. */
+    char help[96];              /* One line of description. */
+    uint32_t type;              /* METRICS_COUNTER or METRICS_GAUGE. */
+    uint32_t reserved;
+    uint64_t scale;             /* Divide the value by this, e.g. 1000000000 for ns to s. */
+} metrics_descriptor_t;
+
+/**
+ * Create a page, replacing any page of the same name, as its producer.
+ * @param name is the shared memory name, e.g. "/seventool".
+ * @param program is the name of the producing program.
+ * @param mode is the permission of the shared memory object; readers need
+ * only read permission.
+ * @return a handle or NULL with errno set.
+ */
+extern metrics_t * metrics_create(const char * name, const char * program, mode_t mode);
+
+/**
+ * Describe a new metric, whose value starts at zero.
+ * @param mp points to the handle, which may be NULL.
+ * @param name is the name of the metric.
+ * @param labels are the Prometheus labels of the metric or NULL.
+ * @param help is the help string of the metric.
+ * @param type is METRICS_COUNTER or METRICS_GAUGE.
+ * @param scale is the divisor of the value, or zero or one for none.
+ * @return the index of the metric, or <0 with errno set (ENOSPC if the
+ * page is full).
+ */
+extern int metrics_define(metrics_t * mp, const char * name, const char * labels, const char * help, int type, uint64_t scale);
+
+/**
+ * Set the value of a metric. This is a single store, with no system call
+ * and no lock.
+ * @param mp points to the handle, which may be NULL.
+ * @param index is the index of the metric, which may be <0.
+ * @param value is the value.
+ */
+extern void metrics_set(metrics_t * mp, int index, uint64_t value);
+
+/**
+ * Attach to an existing page as a reader.
+ * @param name is the shared memory name.
+ * @return a handle or NULL with errno set.
+ */
+extern metrics_t * metrics_attach(const char * name);
+
+/**
+ * Get the process identifier and the name of the producer of a page.
+ * @param mp points to the handle.
+ * @param programp points to where a pointer to the name is stored, or is
+ * NULL.
+ * @return the process identifier, or zero if the producer has detached or
+ * no longer exists.
+ */
+extern pid_t metrics_producer(metrics_t * mp, const char ** programp);
+
+/**
+ * Get the number of metrics described in a page.
+ * @param mp points to the handle.
+ * @return the number of metrics.
+ */
+extern int metrics_count(metrics_t * mp);
+
+/**
+ * Get the description of a metric.
+ * @param mp points to the handle.
+ * @param index is the index of the metric, less than metrics_count().
+ * @return a pointer to the description in the page.
+ */
+extern const metrics_descriptor_t * metrics_describe(metrics_t * mp, int index);
+
+/**
+ * Get the value of a metric.
+ * @param mp points to the handle.
+ * @param index is the index of the metric, less than metrics_count().
+ * @return the value.
+ */
+extern uint64_t metrics_get(metrics_t * mp, int index);
+
+/**
+ * Detach from a page. The producer marks the page as abandoned and removes
+ * its name.
+ * @param mp points to the handle, which may be NULL.
+ */
+extern void metrics_detach(metrics_t * mp);
+
+#endif
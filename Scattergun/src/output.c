@@ -0,0 +1,346 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Output Engine<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * A pipe holds at most its capacity divided by the page size buffers, each
+ * no larger than a page, so once chunks totaling the capacity of the pipe
+ * have been handed to it after a given chunk, none of that chunk's pages
+ * can still be in the pipe, and it may be refilled. The ring is twice that
+ * large in case the reader grows the pipe behind our back. The chunks are
+ * not gifted with SPLICE_F_GIFT, because gifted pages may never be modified
+ * again, and these are recycled. The pipe is written with SPLICE_F_NONBLOCK
+ * so that a full pipe can be detected, counted, and timed, and waited for
+ * with poll(2), without making the descriptor itself non-blocking, since it
+ * is often shared with a shell.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "output.h"
+
+enum {
+    PIPESIZE = 1024 * 1024,
+    CHUNK = 64 * 1024,
+    PATIENCE = 100, /* milliseconds */
+};
+
+struct Output {
+    int fd;
+    int splice;
+    const volatile int * donep;
+    unsigned char * base;
+    size_t stride;
+    size_t index;
+    size_t fill;
+    size_t sent;
+    output_statistics_t stats;
+    output_observer_t * observer;
+};
+
+static uint64_t now(void)
+{
+    struct timespec spec = { 0 };
+    uint64_t ticks;
+
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    ticks = spec.tv_sec;
+    ticks *= 1000000000;
+    ticks += spec.tv_nsec;
+
+    return ticks;
+}
+
+/**
+ * Grow a pipe to the requested capacity if we are permitted to, otherwise
+ * to the largest capacity an unprivileged process may ask for.
+ * @param fd is the pipe.
+ * @param pipesize is the requested capacity.
+ * @return the resulting capacity or 0 if it cannot be determined.
+ */
+static size_t grow(int fd, size_t pipesize)
+{
+    FILE * fp = (FILE *)0;
+    unsigned long maximum = 0;
+    int current = 0;
+
+    current = fcntl(fd, F_GETPIPE_SZ);
+    if (current < 0) {
+        return 0;
+    }
+
+    if (current >= pipesize) {
+        return current;
+    }
+
+    if (fcntl(fd, F_SETPIPE_SZ, (int)pipesize) >= 0) {
+        /* Do nothing. */
+    } else if (errno != EPERM) {
+        /* Do nothing. */
+    } else if ((fp = fopen("/proc/sys/fs/pipe-max-size", "r")) == (FILE *)0) {
+        /* Do nothing. */
+    } else {
+        if ((fscanf(fp, "%lu", &maximum) == 1) && (maximum > current)) {
+            (void)fcntl(fd, F_SETPIPE_SZ, (int)maximum);
+        }
+        fclose(fp);
+    }
+
+    current = fcntl(fd, F_GETPIPE_SZ);
+
+    return (current < 0) ? 0 : current;
+}
+
+/**
+ * Wait for the reader to make room in the pipe.
+ * @param op points to the output.
+ * @return 0 for success, >0 if the caller is done, <0 for error.
+ */
+static int await(output_t * op)
+{
+    struct pollfd pfd = { 0 };
+    uint64_t then;
+    int rc = 0;
+
+    ++op->stats.stalls;
+    then = now();
+
+    pfd.fd = op->fd;
+    pfd.events = POLLOUT;
+
+    while (!0) {
+        if ((op->donep != (const volatile int *)0) && (*op->donep)) {
+            rc = 1;
+            break;
+        }
+        rc = poll(&pfd, 1, (op->donep != (const volatile int *)0) ? PATIENCE : -1);
+        if (rc > 0) {
+            rc = 0;
+            break;
+        } else if (rc == 0) {
+            /* Do nothing. */
+        } else if (errno == EINTR) {
+            /* Do nothing. */
+        } else {
+            break;
+        }
+    }
+
+    op->stats.stalled += now() - then;
+
+    if (op->observer != (output_observer_t *)0) {
+        (*op->observer)(!0, 0, (rc < 0) ? -errno : rc, then);
+    }
+
+    return rc;
+}
+
+/**
+ * Hand the filled but unsent part of the current chunk to the descriptor,
+ * and when all of it has been sent move on to the next chunk.
+ * @param op points to the output.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int emit(output_t * op)
+{
+    unsigned char * chunk = op->base + (op->index * op->stride);
+    struct iovec iov;
+    ssize_t length;
+    uint64_t then = 0;
+    int error;
+    int rc = 0;
+
+    while (op->sent < op->fill) {
+
+        if (op->observer != (output_observer_t *)0) {
+            then = now();
+        }
+
+        if (op->splice) {
+            iov.iov_base = chunk + op->sent;
+            iov.iov_len = op->fill - op->sent;
+            length = vmsplice(op->fd, &iov, 1, SPLICE_F_NONBLOCK);
+        } else {
+            length = write(op->fd, chunk + op->sent, op->fill - op->sent);
+        }
+
+        if (op->observer != (output_observer_t *)0) {
+            error = errno;
+            (*op->observer)(0, op->fill - op->sent, (length < 0) ? -errno : length, then);
+            errno = error;
+        }
+
+        if (length > 0) {
+            ++op->stats.calls;
+            if (op->splice) {
+                ++op->stats.splices;
+            }
+            op->stats.bytes += length;
+            op->sent += length;
+        } else if (length == 0) {
+            return 1;
+        } else if (errno == EAGAIN) {
+            rc = await(op);
+            if (rc != 0) {
+                return rc;
+            }
+        } else if (errno == EINTR) {
+            if ((op->donep != (const volatile int *)0) && (*op->donep)) {
+                return 1;
+            }
+        } else if (errno == EPIPE) {
+            return 1;
+        } else if (op->splice && (op->stats.splices == 0) && ((errno == EINVAL) || (errno == ENOSYS))) {
+            op->splice = 0;
+        } else {
+            return -1;
+        }
+
+    }
+
+    op->index = (op->index + 1) % op->stats.chunks;
+    op->fill = 0;
+    op->sent = 0;
+
+    return 0;
+}
+
+output_t * output_open(int fd, size_t pipesize, size_t chunk, const volatile int * donep)
+{
+    output_t * op = (output_t *)0;
+    struct stat status;
+    long pagesize;
+    void * base = (void *)0;
+    int rc;
+
+    if (fstat(fd, &status) < 0) {
+        return (output_t *)0;
+    }
+
+    op = (output_t *)calloc(1, sizeof(output_t));
+    if (op == (output_t *)0) {
+        return (output_t *)0;
+    }
+
+    op->fd = fd;
+    op->donep = donep;
+    op->stats.chunk = (chunk > 0) ? chunk : CHUNK;
+
+    if (S_ISFIFO(status.st_mode)) {
+        op->stats.pipesize = grow(fd, (pipesize > 0) ? pipesize : PIPESIZE);
+        op->splice = (op->stats.pipesize > 0);
+    }
+
+    if (op->splice) {
+        op->stats.chunks = (2 * ((op->stats.pipesize + op->stats.chunk - 1) / op->stats.chunk)) + 2;
+    } else {
+        op->stats.chunks = 1;
+    }
+
+    pagesize = sysconf(_SC_PAGESIZE);
+    if (pagesize <= 0) {
+        pagesize = 4096;
+    }
+    op->stride = (op->stats.chunk + pagesize - 1) & ~(pagesize - 1);
+
+    rc = posix_memalign(&base, pagesize, op->stride * op->stats.chunks);
+    if (rc != 0) {
+        free(op);
+        errno = rc;
+        return (output_t *)0;
+    }
+    op->base = (unsigned char *)base;
+
+    return op;
+}
+
+void * output_buffer(output_t * op, size_t * availablep)
+{
+    *availablep = op->stats.chunk - op->fill;
+
+    return op->base + (op->index * op->stride) + op->fill;
+}
+
+int output_commit(output_t * op, size_t length)
+{
+    op->fill += length;
+
+    return (op->fill < op->stats.chunk) ? 0 : emit(op);
+}
+
+int output_write(output_t * op, const void * data, size_t length)
+{
+    const unsigned char * here = (const unsigned char *)data;
+    unsigned char * there;
+    size_t available;
+    int rc = 0;
+
+    while (length > 0) {
+        if (op->fill >= op->stats.chunk) {
+            rc = emit(op);
+            if (rc != 0) {
+                break;
+            }
+        }
+        there = (unsigned char *)output_buffer(op, &available);
+        if (available > length) {
+            available = length;
+        }
+        memcpy(there, here, available);
+        here += available;
+        length -= available;
+        rc = output_commit(op, available);
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    return rc;
+}
+
+int output_flush(output_t * op)
+{
+    return (op->fill > 0) ? emit(op) : 0;
+}
+
+void output_observe(output_t * op, output_observer_t * observer)
+{
+    op->observer = observer;
+}
+
+void output_statistics(const output_t * op, output_statistics_t * sp)
+{
+    *sp = op->stats;
+}
+
+int output_close(output_t * op)
+{
+    int rc = 0;
+
+    if (op != (output_t *)0) {
+        rc = output_flush(op);
+        free(op->base);
+        free(op);
+    }
+
+    return rc;
+}
@@ -0,0 +1,137 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_OUTPUT_
+#define _H_COM_DIAG_SCATTERGUN_OUTPUT_
+
+/**
+ * @file
+ * Output Engine<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Writes the output of a generator to a file descriptor in large chunks.
+ * If the descriptor is a pipe or a FIFO, the pipe is enlarged with
+ * F_SETPIPE_SZ and each chunk, which is page aligned, is handed to the pipe
+ * with vmsplice(2), so that the kernel references the pages instead of
+ * copying them; the chunks form a ring large enough that a chunk is never
+ * refilled while any of its pages can still be in the pipe. Otherwise, or
+ * if the kernel refuses vmsplice(2), each chunk is written with write(2).
+ * The engine counts the bytes and calls, and how often and for how long the
+ * pipe was full. It is not thread safe; each output must be used by one
+ * thread at a time. None of the functions print anything; they return 0 for
+ * success, >0 for end of file (the reader went away, or the caller's done
+ * flag was set while waiting for the reader), and <0 with errno set for an
+ * error, like the emit functions they replace. The reader of the pipe
+ * should read(2) it rather than splice(2) it, since spliced pages may still
+ * be referenced after the pipe is empty.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * This is the opaque type of an output.
+ */
+typedef struct Output output_t;
+
+/**
+ * These are the counters of an output.
+ */
+typedef struct OutputStatistics {
+    uint64_t bytes;     /* Bytes delivered to the descriptor. */
+    uint64_t calls;     /* Successful vmsplice(2) or write(2) calls. */
+    uint64_t splices;   /* Of those calls, how many were vmsplice(2). */
+    uint64_t stalls;    /* Times the pipe was full. */
+    uint64_t stalled;   /* Nanoseconds spent waiting for the pipe. */
+    size_t pipesize;    /* Capacity of the pipe or zero if not a pipe. */
+    size_t chunk;       /* Size of each chunk in bytes. */
+    size_t chunks;      /* Number of chunks in the ring. */
+} output_statistics_t;
+
+/**
+ * This is the type of a function called after every write(2) or vmsplice(2)
+ * of the output and every wait for the pipe to drain, for tracing.
+ * @param stall is true for a wait, false for a write.
+ * @param requested is the number of bytes offered to the descriptor.
+ * @param result is the number of bytes taken, or a negative error number.
+ * @param start is CLOCK_MONOTONIC nanoseconds at the start.
+ */
+typedef void (output_observer_t)(int stall, size_t requested, ssize_t result, uint64_t start);
+
+/**
+ * Create an output for a file descriptor, which is not closed by
+ * output_close(). If the descriptor is a pipe, it is grown to the requested
+ * capacity, or to the largest capacity the system allows if that is less.
+ * @param fd is the file descriptor.
+ * @param pipesize is the requested pipe capacity in bytes, or 0 for 1MiB.
+ * @param chunk is the chunk size in bytes, or 0 for 64KiB; callers that fill
+ * the chunks directly should make it a multiple of what they fill at once.
+ * @param donep points to the caller's done flag, or is NULL, which if set
+ * while waiting for the reader causes the wait to end as if at end of file.
+ * @return an output or NULL with errno set.
+ */
+extern output_t * output_open(int fd, size_t pipesize, size_t chunk, const volatile int * donep);
+
+/**
+ * Get the unfilled remainder of the current chunk so that the caller can
+ * fill it in place, avoiding a copy, and then call output_commit().
+ * @param op points to the output.
+ * @param availablep points to where the number of bytes available is stored.
+ * @return a pointer to the available bytes.
+ */
+extern void * output_buffer(output_t * op, size_t * availablep);
+
+/**
+ * Commit bytes filled in place in the buffer returned by output_buffer(),
+ * emitting the chunk if it is full.
+ * @param op points to the output.
+ * @param length is the number of bytes filled, no more than were available.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+extern int output_commit(output_t * op, size_t length);
+
+/**
+ * Copy data into the output, emitting each chunk as it fills.
+ * @param op points to the output.
+ * @param data points to the data.
+ * @param length is the length of the data in bytes.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+extern int output_write(output_t * op, const void * data, size_t length);
+
+/**
+ * Emit the current chunk even if it is only partly full.
+ * @param op points to the output.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+extern int output_flush(output_t * op);
+
+/**
+ * Install a function to be called after every write and every wait.
+ * @param op points to the output.
+ * @param observer points to the function, or is NULL to remove it.
+ */
+extern void output_observe(output_t * op, output_observer_t * observer);
+
+/**
+ * Get a snapshot of the counters of an output.
+ * @param op points to the output.
+ * @param sp points to where the counters are stored.
+ */
+extern void output_statistics(const output_t * op, output_statistics_t * sp);
+
+/**
+ * Flush and free an output. The file descriptor is left open.
+ * @param op points to the output, which may be NULL.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+extern int output_close(output_t * op);
+
+#endif
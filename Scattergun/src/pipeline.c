@@ -0,0 +1,700 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Pipeline Engine<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Each ring has exactly one producer and one consumer, so pushing and
+ * popping are a load and a store of 64 bit cursors that never wrap, with
+ * no compare and exchange; the cursors are on cache lines of their own so
+ * that the two ends do not slow each other. A ring has a slot for every
+ * buffer of its link and so can never overflow, which is why pushing never
+ * blocks. A filter that keeps a buffer trades an empty buffer of its
+ * downstream link for it, so the number of buffers in each link never
+ * changes even though the buffers themselves wander between links. A
+ * consumer that finds its ring empty spins briefly and then sleeps on a
+ * private futex that the producer wakes only when its waiter count says
+ * someone is sleeping, so the fast paths have no system calls; sleepers
+ * wake at least every tenth of a second to check the done flag. A stage
+ * that ends closes the two rings it produces, the full ring downstream and
+ * the empty ring upstream, so that its neighbors end in turn in both
+ * directions. A stage that ends holding an empty buffer it popped just
+ * drops it rather than push it back onto a ring it consumes, which would
+ * make it a second producer; the buffers of a link are freed together.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "pipeline.h"
+
+enum {
+    LINE = 64,                  /* Bytes in a cache line. */
+    SLICE = 100,                /* Longest sleep in milliseconds. */
+    SPIN = 64,                  /* Polls of an empty ring before sleeping. */
+};
+
+typedef struct Buffer {
+    unsigned char * data;
+    size_t length;
+} buffer_t;
+
+typedef struct Ring {
+    uint64_t tail __attribute__((aligned(LINE)));
+    uint64_t pushes;
+    uint64_t sum;
+    uint64_t peak;
+    uint64_t head __attribute__((aligned(LINE)));
+    uint32_t posted __attribute__((aligned(LINE)));
+    uint32_t sleepers;
+    int closed;
+    buffer_t ** slots;
+    uint64_t mask;
+} ring_t;
+
+typedef struct Link {
+    ring_t full;
+    ring_t empty;
+    buffer_t * buffers;
+    unsigned char * memory;
+} link_t;
+
+typedef struct Stage {
+    pipeline_t * pipeline;
+    const char * name;
+    int role;
+    const pipeline_operations_t * operations;
+    void * context;
+    int cpu;
+    int index;
+    int started;
+    int running;
+    int error;
+    pthread_t thread;
+    uint64_t buffers;
+    uint64_t bytes;
+    uint64_t waits;
+    uint64_t waited;
+} stage_t;
+
+struct Pipeline {
+    volatile int * donep;
+    size_t buffers;
+    size_t size;
+    int count;
+    int allocated;
+    stage_t ** stages;
+    link_t ** links;
+};
+
+/*******************************************************************************
+ * HELPERS
+ ******************************************************************************/
+
+static int futex_wait(uint32_t * word, uint32_t expected, int milliseconds)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_nsec = (milliseconds % 1000) * 1000000L;
+
+    return syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, &timeout, (uint32_t *)0, 0);
+}
+
+static void futex_wake(uint32_t * word)
+{
+    (void)syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, (struct timespec *)0, (uint32_t *)0, 0);
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static inline void relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+static inline void count(uint64_t * counter, uint64_t increment)
+{
+    __atomic_store_n(counter, *counter + increment, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+ * RINGS
+ ******************************************************************************/
+
+static int ring_init(ring_t * rp, size_t buffers)
+{
+    size_t size;
+
+    for (size = 1; size < buffers; size <<= 1) {
+        /* Do nothing. */
+    }
+
+    rp->slots = (buffer_t **)calloc(size, sizeof(buffer_t *));
+    if (rp->slots == (buffer_t **)0) {
+        return -1;
+    }
+
+    rp->mask = size - 1;
+
+    return 0;
+}
+
+static void ring_wake(ring_t * rp)
+{
+    __atomic_add_fetch(&rp->posted, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&rp->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        futex_wake(&rp->posted);
+    }
+}
+
+static void ring_push(ring_t * rp, buffer_t * bp)
+{
+    uint64_t tail = rp->tail;
+    uint64_t occupancy;
+
+    rp->slots[tail & rp->mask] = bp;
+    __atomic_store_n(&rp->tail, tail + 1, __ATOMIC_RELEASE);
+
+    occupancy = tail + 1 - __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+    count(&rp->pushes, 1);
+    count(&rp->sum, occupancy);
+    if (occupancy > rp->peak) {
+        __atomic_store_n(&rp->peak, occupancy, __ATOMIC_RELAXED);
+    }
+
+    ring_wake(rp);
+}
+
+static void ring_close(ring_t * rp)
+{
+    __atomic_store_n(&rp->closed, !0, __ATOMIC_RELEASE);
+
+    ring_wake(rp);
+}
+
+/**
+ * Pop a buffer, waiting if the ring is empty.
+ * @return a buffer or NULL if the ring is closed and empty or done is set.
+ */
+static buffer_t * ring_pop(pipeline_t * pp, ring_t * rp, stage_t * sp)
+{
+    buffer_t * bp = (buffer_t *)0;
+    uint64_t head = rp->head;
+    uint64_t start = 0;
+    uint32_t posted;
+    int ended = 0;
+    int spin = 0;
+
+    while (__atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE) == head) {
+        if (__atomic_load_n(&rp->closed, __ATOMIC_ACQUIRE)) {
+            ended = (__atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE) == head);
+            break;
+        }
+        if (*(pp->donep)) {
+            ended = !0;
+            break;
+        }
+        if (spin < SPIN) {
+            ++spin;
+            relax();
+            continue;
+        }
+        if (start == 0) {
+            start = now();
+            count(&sp->waits, 1);
+        }
+        __atomic_add_fetch(&rp->sleepers, 1, __ATOMIC_SEQ_CST);
+        posted = __atomic_load_n(&rp->posted, __ATOMIC_SEQ_CST);
+        if ((__atomic_load_n(&rp->tail, __ATOMIC_SEQ_CST) == head) && !__atomic_load_n(&rp->closed, __ATOMIC_SEQ_CST) && !*(pp->donep)) {
+            (void)futex_wait(&rp->posted, posted, SLICE);
+        }
+        __atomic_sub_fetch(&rp->sleepers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    if (start != 0) {
+        count(&sp->waited, now() - start);
+    }
+
+    if (!ended) {
+        bp = rp->slots[head & rp->mask];
+        __atomic_store_n(&rp->head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    return bp;
+}
+
+/*******************************************************************************
+ * STAGES
+ ******************************************************************************/
+
+static void stop(pipeline_t * pp)
+{
+    int ii;
+
+    *(pp->donep) = !0;
+
+    for (ii = 0; ii < (pp->count - 1); ++ii) {
+        ring_wake(&(pp->links[ii]->full));
+        ring_wake(&(pp->links[ii]->empty));
+    }
+}
+
+static int source(pipeline_t * pp, stage_t * sp, link_t * out)
+{
+    buffer_t * bp;
+    ssize_t length;
+
+    while ((bp = ring_pop(pp, &(out->empty), sp)) != (buffer_t *)0) {
+        length = (*(sp->operations->fill))(sp->context, bp->data, pp->size);
+        if (length <= 0) {
+            return (length < 0) ? -1 : 0;
+        }
+        bp->length = length;
+        ring_push(&(out->full), bp);
+        count(&sp->buffers, 1);
+        count(&sp->bytes, length);
+    }
+
+    return 0;
+}
+
+static int filter(pipeline_t * pp, stage_t * sp, link_t * in, link_t * out)
+{
+    buffer_t * bp;
+    buffer_t * ep;
+    ssize_t length;
+
+    while ((bp = ring_pop(pp, &(in->full), sp)) != (buffer_t *)0) {
+        length = (*(sp->operations->filter))(sp->context, bp->data, bp->length);
+        if (length <= 0) {
+            ring_push(&(in->empty), bp);
+            if (length < 0) {
+                return -1;
+            }
+            continue;
+        }
+        ep = ring_pop(pp, &(out->empty), sp);
+        if (ep == (buffer_t *)0) {
+            ring_push(&(in->empty), bp);
+            break;
+        }
+        bp->length = length;
+        ring_push(&(in->empty), ep);
+        ring_push(&(out->full), bp);
+        count(&sp->buffers, 1);
+        count(&sp->bytes, length);
+    }
+
+    return 0;
+}
+
+static int generator(pipeline_t * pp, stage_t * sp, link_t * in, link_t * out)
+{
+    buffer_t * bp;
+    buffer_t * ep;
+    ssize_t length;
+    int rc;
+
+    while ((ep = ring_pop(pp, &(out->empty), sp)) != (buffer_t *)0) {
+        while ((length = (*(sp->operations->generate))(sp->context, ep->data, pp->size)) == 0) {
+            bp = ring_pop(pp, &(in->full), sp);
+            if (bp == (buffer_t *)0) {
+                break;
+            }
+            rc = (*(sp->operations->seed))(sp->context, bp->data, bp->length);
+            ring_push(&(in->empty), bp);
+            if (rc < 0) {
+                return -1;
+            }
+        }
+        if (length <= 0) {
+            return (length < 0) ? -1 : 0;
+        }
+        ep->length = length;
+        ring_push(&(out->full), ep);
+        count(&sp->buffers, 1);
+        count(&sp->bytes, length);
+    }
+
+    return 0;
+}
+
+static int sink(pipeline_t * pp, stage_t * sp, link_t * in)
+{
+    buffer_t * bp;
+    size_t length;
+    int rc;
+
+    while ((bp = ring_pop(pp, &(in->full), sp)) != (buffer_t *)0) {
+        length = bp->length;
+        rc = (*(sp->operations->drain))(sp->context, bp->data, &length);
+        ring_push(&(in->empty), bp);
+        if (rc < 0) {
+            return -1;
+        }
+        count(&sp->buffers, 1);
+        count(&sp->bytes, length);
+        if (rc > 0) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void * body(void * argument)
+{
+    stage_t * sp = (stage_t *)argument;
+    pipeline_t * pp = sp->pipeline;
+    link_t * in = (sp->index > 0) ? pp->links[sp->index - 1] : (link_t *)0;
+    link_t * out = (sp->index < (pp->count - 1)) ? pp->links[sp->index] : (link_t *)0;
+    char name[16];
+    int rc = -1;
+
+    strncpy(name, sp->name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    (void)pthread_setname_np(pthread_self(), name);
+
+    errno = 0;
+
+    switch (sp->role) {
+    case PIPELINE_SOURCE:
+        rc = source(pp, sp, out);
+        break;
+    case PIPELINE_FILTER:
+        rc = filter(pp, sp, in, out);
+        break;
+    case PIPELINE_GENERATOR:
+        rc = generator(pp, sp, in, out);
+        break;
+    case PIPELINE_SINK:
+        rc = sink(pp, sp, in);
+        break;
+    }
+
+    if (rc < 0) {
+        __atomic_store_n(&sp->error, (errno != 0) ? errno : EIO, __ATOMIC_RELEASE);
+    }
+
+    if (out != (link_t *)0) {
+        ring_close(&(out->full));
+    }
+
+    if (in != (link_t *)0) {
+        ring_close(&(in->empty));
+    }
+
+    if ((rc < 0) || (out == (link_t *)0)) {
+        stop(pp);
+    }
+
+    __atomic_store_n(&sp->running, 0, __ATOMIC_RELEASE);
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * LINKS
+ ******************************************************************************/
+
+static void link_free(link_t * lp)
+{
+    if (lp != (link_t *)0) {
+        free(lp->full.slots);
+        free(lp->empty.slots);
+        free(lp->buffers);
+        free(lp->memory);
+        free(lp);
+    }
+}
+
+static link_t * link_alloc(size_t buffers, size_t size)
+{
+    link_t * lp = (link_t *)0;
+    void * pointer;
+    size_t ii;
+
+    do {
+
+        if (posix_memalign(&pointer, LINE, sizeof(link_t)) != 0) {
+            break;
+        }
+        lp = (link_t *)pointer;
+        memset(lp, 0, sizeof(*lp));
+
+        if ((ring_init(&(lp->full), buffers) < 0) || (ring_init(&(lp->empty), buffers) < 0)) {
+            break;
+        }
+
+        lp->buffers = (buffer_t *)calloc(buffers, sizeof(buffer_t));
+        if (lp->buffers == (buffer_t *)0) {
+            break;
+        }
+
+        if (posix_memalign(&pointer, LINE, buffers * size) != 0) {
+            break;
+        }
+        lp->memory = (unsigned char *)pointer;
+
+        for (ii = 0; ii < buffers; ++ii) {
+            lp->buffers[ii].data = lp->memory + (ii * size);
+            lp->empty.slots[ii] = &(lp->buffers[ii]);
+        }
+        lp->empty.tail = buffers;
+
+        return lp;
+
+    } while (0);
+
+    link_free(lp);
+
+    errno = ENOMEM;
+
+    return (link_t *)0;
+}
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+
+pipeline_t * pipeline_create(size_t buffers, size_t size, volatile int * donep)
+{
+    pipeline_t * pp;
+
+    if ((buffers == 0) || (size == 0) || (donep == (volatile int *)0)) {
+        errno = EINVAL;
+        return (pipeline_t *)0;
+    }
+
+    pp = (pipeline_t *)calloc(1, sizeof(*pp));
+    if (pp == (pipeline_t *)0) {
+        return (pipeline_t *)0;
+    }
+
+    pp->buffers = buffers;
+    pp->size = size;
+    pp->donep = donep;
+
+    return pp;
+}
+
+int pipeline_append(pipeline_t * pp, const char * name, int role, const pipeline_operations_t * operations, void * context, int cpu)
+{
+    stage_t ** stages;
+    stage_t * sp;
+
+    if ((role < PIPELINE_SOURCE) || (role > PIPELINE_SINK) || (operations == (const pipeline_operations_t *)0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pp->count >= pp->allocated) {
+        stages = (stage_t **)realloc(pp->stages, (pp->allocated + 8) * sizeof(stage_t *));
+        if (stages == (stage_t **)0) {
+            return -1;
+        }
+        pp->stages = stages;
+        pp->allocated += 8;
+    }
+
+    sp = (stage_t *)calloc(1, sizeof(*sp));
+    if (sp == (stage_t *)0) {
+        return -1;
+    }
+
+    sp->pipeline = pp;
+    sp->name = name;
+    sp->role = role;
+    sp->operations = operations;
+    sp->context = context;
+    sp->cpu = cpu;
+    sp->index = pp->count;
+
+    pp->stages[pp->count] = sp;
+
+    return pp->count++;
+}
+
+int pipeline_start(pipeline_t * pp)
+{
+    stage_t * sp;
+    const pipeline_operations_t * op;
+    pthread_attr_t attributes;
+    cpu_set_t cpus;
+    int valid;
+    int ii;
+    int rc;
+
+    if (pp->count < 2) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (ii = 0; ii < pp->count; ++ii) {
+        sp = pp->stages[ii];
+        op = sp->operations;
+        if (ii == 0) {
+            valid = (sp->role == PIPELINE_SOURCE) && (op->fill != 0);
+        } else if (ii == (pp->count - 1)) {
+            valid = (sp->role == PIPELINE_SINK) && (op->drain != 0);
+        } else if (sp->role == PIPELINE_FILTER) {
+            valid = (op->filter != 0);
+        } else if (sp->role == PIPELINE_GENERATOR) {
+            valid = (op->generate != 0) && (op->seed != 0);
+        } else {
+            valid = 0;
+        }
+        if (!valid) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    pp->links = (link_t **)calloc(pp->count - 1, sizeof(link_t *));
+    if (pp->links == (link_t **)0) {
+        return -1;
+    }
+
+    for (ii = 0; ii < (pp->count - 1); ++ii) {
+        pp->links[ii] = link_alloc(pp->buffers, pp->size);
+        if (pp->links[ii] == (link_t *)0) {
+            return -1;
+        }
+    }
+
+    for (ii = 0; ii < pp->count; ++ii) {
+        sp = pp->stages[ii];
+        pthread_attr_init(&attributes);
+        if (sp->cpu >= 0) {
+            CPU_ZERO(&cpus);
+            CPU_SET(sp->cpu, &cpus);
+            pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+        }
+        sp->running = !0;
+        rc = pthread_create(&(sp->thread), &attributes, body, sp);
+        pthread_attr_destroy(&attributes);
+        if (rc != 0) {
+            sp->running = 0;
+            stop(pp);
+            (void)pipeline_join(pp);
+            errno = rc;
+            return -1;
+        }
+        sp->started = !0;
+    }
+
+    return 0;
+}
+
+int pipeline_count(const pipeline_t * pp)
+{
+    return pp->count;
+}
+
+void pipeline_statistics(const pipeline_t * pp, int index, pipeline_statistics_t * sp)
+{
+    const stage_t * tp = pp->stages[index];
+    const ring_t * rp;
+    uint64_t pushes;
+
+    memset(sp, 0, sizeof(*sp));
+
+    sp->name = tp->name;
+    sp->role = tp->role;
+    sp->cpu = tp->cpu;
+    sp->running = __atomic_load_n(&tp->running, __ATOMIC_ACQUIRE);
+    sp->error = __atomic_load_n(&tp->error, __ATOMIC_ACQUIRE);
+    sp->buffers = __atomic_load_n(&tp->buffers, __ATOMIC_RELAXED);
+    sp->bytes = __atomic_load_n(&tp->bytes, __ATOMIC_RELAXED);
+    sp->waits = __atomic_load_n(&tp->waits, __ATOMIC_RELAXED);
+    sp->waited = __atomic_load_n(&tp->waited, __ATOMIC_RELAXED);
+
+    if ((index > 0) && (pp->links != (link_t **)0) && (pp->links[index - 1] != (link_t *)0)) {
+        rp = &(pp->links[index - 1]->full);
+        sp->capacity = pp->buffers;
+        sp->occupancy = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+        sp->peak = __atomic_load_n(&rp->peak, __ATOMIC_RELAXED);
+        pushes = __atomic_load_n(&rp->pushes, __ATOMIC_RELAXED);
+        sp->mean = (pushes > 0) ? (double)__atomic_load_n(&rp->sum, __ATOMIC_RELAXED) / pushes : 0.0;
+    }
+}
+
+int pipeline_join(pipeline_t * pp)
+{
+    int error = 0;
+    int ii;
+
+    for (ii = 0; ii < pp->count; ++ii) {
+        if (pp->stages[ii]->started) {
+            pthread_join(pp->stages[ii]->thread, (void **)0);
+            pp->stages[ii]->started = 0;
+        }
+    }
+
+    for (ii = 0; ii < pp->count; ++ii) {
+        if (pp->stages[ii]->error != 0) {
+            error = pp->stages[ii]->error;
+            break;
+        }
+    }
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+void pipeline_destroy(pipeline_t * pp)
+{
+    int ii;
+
+    if (pp == (pipeline_t *)0) {
+        return;
+    }
+
+    if (pp->links != (link_t **)0) {
+        for (ii = 0; ii < (pp->count - 1); ++ii) {
+            link_free(pp->links[ii]);
+        }
+        free(pp->links);
+    }
+
+    for (ii = 0; ii < pp->count; ++ii) {
+        free(pp->stages[ii]);
+    }
+    free(pp->stages);
+
+    free(pp);
+}
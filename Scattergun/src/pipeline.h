@@ -0,0 +1,175 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_PIPELINE_
+#define _H_COM_DIAG_SCATTERGUN_PIPELINE_
+
+/**
+ * @file
+ * Pipeline Engine<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Runs a chain of stages, a source, any number of filters and generators,
+ * and a sink, in one process, each stage on its own thread, optionally
+ * pinned to a processor, so that entropy moves from one stage to the next
+ * without the copy and the context switch of a shell pipe. Each pair of
+ * adjacent stages is joined by a link of two single producer single
+ * consumer rings of pointers to buffers, one carrying full buffers
+ * downstream and the other returning empty buffers upstream; every link
+ * starts with its own pool of empty buffers, all of the same size,
+ * allocated once. A source fills empty buffers. A filter works on each
+ * full buffer in place, possibly shortening it, and passes the same buffer
+ * downstream, returning an empty buffer of the downstream link upstream in
+ * its place, so that nothing is copied. A generator, like a DRBG, fills
+ * buffers of its downstream link itself and takes a full buffer from
+ * upstream only when it asks for more seed. A sink consumes full buffers.
+ * When the source reaches end of file the stages downstream finish the
+ * buffers in flight and end in turn; when the sink ends, any stage fails,
+ * or the caller's done flag is set, every stage stops. Each stage counts
+ * its buffers and bytes and how often and how long it waited, and each
+ * link counts its occupancy, so that the slowest stage can be found. The
+ * functions return <0 or NULL with errno set for an error, like the system
+ * calls they wrap.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * These are the roles of stages.
+ */
+enum PipelineRole {
+    PIPELINE_SOURCE = 0,        /* Fills buffers. */
+    PIPELINE_FILTER = 1,        /* Changes buffers in place. */
+    PIPELINE_GENERATOR = 2,     /* Fills buffers, drawing seed from upstream. */
+    PIPELINE_SINK = 3,          /* Consumes buffers. */
+};
+
+/**
+ * This is the opaque type of a pipeline.
+ */
+typedef struct Pipeline pipeline_t;
+
+/**
+ * These are the functions of a stage, of which those of its role are
+ * used. Each is passed the context given when the stage was appended, and
+ * is called only from the thread of the stage.
+ */
+typedef struct PipelineOperations {
+    /**
+     * Source: fill a buffer.
+     * @return the bytes filled, 0 for end of file, or <0 for an error.
+     */
+    ssize_t (*fill)(void * context, unsigned char * data, size_t size);
+    /**
+     * Filter: change a buffer in place.
+     * @return its new length, which may be 0 to drop it, or <0 for an error.
+     */
+    ssize_t (*filter)(void * context, unsigned char * data, size_t length);
+    /**
+     * Generator: absorb a buffer of seed.
+     * @return 0 for success or <0 for an error.
+     */
+    int (*seed)(void * context, const unsigned char * data, size_t length);
+    /**
+     * Generator: fill a buffer.
+     * @return the bytes filled, 0 if more seed is needed first, or <0 for an
+     * error.
+     */
+    ssize_t (*generate)(void * context, unsigned char * data, size_t size);
+    /**
+     * Sink: consume a buffer, storing through lengthp, which points to its
+     * length, the bytes actually consumed, which may be fewer.
+     * @return 0 for success, >0 for end of file, or <0 for an error.
+     */
+    int (*drain)(void * context, const unsigned char * data, size_t * lengthp);
+} pipeline_operations_t;
+
+/**
+ * These are the counters of a stage and of the link into it.
+ */
+typedef struct PipelineStatistics {
+    const char * name;          /* Name given when appended. */
+    int role;                   /* PIPELINE_SOURCE etc. */
+    int cpu;                    /* Processor pinned to, or <0. */
+    int running;                /* True until the thread of the stage ends. */
+    int error;                  /* The errno of a failure, or 0. */
+    uint64_t buffers;           /* Buffers produced, or consumed by a sink. */
+    uint64_t bytes;             /* Bytes produced, or consumed by a sink. */
+    uint64_t waits;             /* Times a buffer was not ready. */
+    uint64_t waited;            /* Nanoseconds spent waiting. */
+    size_t capacity;            /* Buffers in the link into the stage. */
+    size_t occupancy;           /* Full buffers in the link now. */
+    size_t peak;                /* Most full buffers in the link. */
+    double mean;                /* Mean full buffers in the link when one is added. */
+} pipeline_statistics_t;
+
+/**
+ * Create an empty pipeline.
+ * @param buffers is the number of buffers in each link.
+ * @param size is the size of each buffer in bytes.
+ * @param donep points to the caller's done flag, which the pipeline sets
+ * when it stops, and which the caller may set to stop it.
+ * @return a pipeline or NULL with errno set.
+ */
+extern pipeline_t * pipeline_create(size_t buffers, size_t size, volatile int * donep);
+
+/**
+ * Append a stage. The first must be a source, the last a sink, and those
+ * between filters or generators.
+ * @param pp points to the pipeline.
+ * @param name is the name of the stage, which must outlive the pipeline.
+ * @param role is PIPELINE_SOURCE etc.
+ * @param operations points to the functions of the stage.
+ * @param context is passed to each function.
+ * @param cpu is the processor to pin the thread of the stage to, or <0.
+ * @return the index of the stage or <0 with errno set.
+ */
+extern int pipeline_append(pipeline_t * pp, const char * name, int role, const pipeline_operations_t * operations, void * context, int cpu);
+
+/**
+ * Allocate the links and start a thread for every stage.
+ * @param pp points to the pipeline.
+ * @return 0 for success or <0 with errno set (EINVAL if the stages are not
+ * a source, filters and generators, and a sink), in which case no thread
+ * is left running.
+ */
+extern int pipeline_start(pipeline_t * pp);
+
+/**
+ * Get the number of stages.
+ * @param pp points to the pipeline.
+ * @return the number of stages.
+ */
+extern int pipeline_count(const pipeline_t * pp);
+
+/**
+ * Get a snapshot of the counters of a stage, which may be running.
+ * @param pp points to the pipeline.
+ * @param index is the index of the stage.
+ * @param sp points to where the counters are stored.
+ */
+extern void pipeline_statistics(const pipeline_t * pp, int index, pipeline_statistics_t * sp);
+
+/**
+ * Wait for every stage to end.
+ * @param pp points to the pipeline.
+ * @return 0 if every stage ended at end of file, or <0 with errno set to
+ * that of the first stage that failed.
+ */
+extern int pipeline_join(pipeline_t * pp);
+
+/**
+ * Free a pipeline whose stages have ended, or never started.
+ * @param pp points to the pipeline, which may be NULL.
+ */
+extern void pipeline_destroy(pipeline_t * pp);
+
+#endif
@@ -0,0 +1,199 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * PNG Writer<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * This follows the PNG specification (ISO/IEC 15948) and RFC 1950 and 1951
+ * for the zlib stream: one IHDR chunk, one IDAT chunk holding a zlib header,
+ * stored deflate blocks of at most 65535 bytes, and the Adler-32 of the
+ * filtered rows, and an IEND chunk. Every row uses filter type zero.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "png.h"
+
+enum {
+    STORED = 65535,             /* Most bytes in a stored deflate block. */
+};
+
+static uint32_t table[256];
+
+static void crc_init(void)
+{
+    uint32_t c;
+    int ii;
+    int jj;
+
+    for (ii = 0; ii < 256; ++ii) {
+        c = ii;
+        for (jj = 0; jj < 8; ++jj) {
+            c = (c & 1) ? (0xedb88320U ^ (c >> 1)) : (c >> 1);
+        }
+        table[ii] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const unsigned char * data, size_t length)
+{
+    while ((length--) > 0) {
+        crc = table[(crc ^ *(data++)) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static void put32(unsigned char * here, uint32_t value)
+{
+    here[0] = value >> 24;
+    here[1] = value >> 16;
+    here[2] = value >> 8;
+    here[3] = value;
+}
+
+static int chunk(FILE * fp, const char * type, const unsigned char * data, size_t length)
+{
+    unsigned char word[4];
+    uint32_t crc;
+
+    put32(word, length);
+    fwrite(word, sizeof(word), 1, fp);
+
+    crc = crc_update(0xffffffffU, (const unsigned char *)type, 4);
+    fwrite(type, 4, 1, fp);
+
+    if (length > 0) {
+        crc = crc_update(crc, data, length);
+        fwrite(data, length, 1, fp);
+    }
+
+    put32(word, crc ^ 0xffffffffU);
+    fwrite(word, sizeof(word), 1, fp);
+
+    return ferror(fp) ? -1 : 0;
+}
+
+int png_write(FILE * fp, const unsigned char * rgb, unsigned int width, unsigned int height)
+{
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', };
+    unsigned char header[13];
+    unsigned char * raw;
+    unsigned char * idat;
+    unsigned char * here;
+    size_t stride;
+    size_t total;
+    size_t blocks;
+    size_t length;
+    size_t offset;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    unsigned int row;
+    size_t ii;
+    int rc = -1;
+
+    if ((width == 0) || (height == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (table[1] == 0) {
+        crc_init();
+    }
+
+    /*
+     * The filtered image is each row preceded by its filter type.
+     */
+
+    stride = ((size_t)width * 3) + 1;
+    total = stride * height;
+    blocks = (total + STORED - 1) / STORED;
+
+    raw = (unsigned char *)malloc(total);
+    idat = (unsigned char *)malloc(2 + (blocks * 5) + total + 4);
+    if ((raw == (unsigned char *)0) || (idat == (unsigned char *)0)) {
+        free(raw);
+        free(idat);
+        return -1;
+    }
+
+    for (row = 0; row < height; ++row) {
+        raw[row * stride] = 0;
+        memcpy(&raw[(row * stride) + 1], &rgb[(size_t)row * width * 3], (size_t)width * 3);
+    }
+
+    /*
+     * The zlib stream: deflate with a 32K window, no dictionary, and the
+     * check bits that make the header a multiple of 31.
+     */
+
+    here = idat;
+    *(here++) = 0x78;
+    *(here++) = 0x01;
+
+    for (offset = 0; offset < total; offset += length) {
+        length = total - offset;
+        if (length > STORED) {
+            length = STORED;
+        }
+        *(here++) = ((offset + length) >= total) ? 1 : 0;
+        *(here++) = length & 0xff;
+        *(here++) = length >> 8;
+        *(here++) = ~length & 0xff;
+        *(here++) = (~length >> 8) & 0xff;
+        memcpy(here, &raw[offset], length);
+        here += length;
+    }
+
+    for (ii = 0; ii < total; ++ii) {
+        a += raw[ii];
+        if (a >= 65521) {
+            a -= 65521;
+        }
+        b += a;
+        if (b >= 65521) {
+            b -= 65521;
+        }
+    }
+    put32(here, (b << 16) | a);
+    here += 4;
+
+    put32(&header[0], width);
+    put32(&header[4], height);
+    header[8] = 8;              /* Bits per sample. */
+    header[9] = 2;              /* Truecolor. */
+    header[10] = 0;             /* Deflate. */
+    header[11] = 0;             /* Adaptive filtering. */
+    header[12] = 0;             /* No interlace. */
+
+    do {
+        if (fwrite(SIGNATURE, sizeof(SIGNATURE), 1, fp) != 1) {
+            break;
+        }
+        if (chunk(fp, "IHDR", header, sizeof(header)) < 0) {
+            break;
+        }
+        if (chunk(fp, "IDAT", idat, here - idat) < 0) {
+            break;
+        }
+        if (chunk(fp, "IEND", (const unsigned char *)0, 0) < 0) {
+            break;
+        }
+        rc = 0;
+    } while (0);
+
+    free(raw);
+    free(idat);
+
+    return rc;
+}
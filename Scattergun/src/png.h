@@ -0,0 +1,37 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_PNG_
+#define _H_COM_DIAG_SCATTERGUN_PNG_
+
+/**
+ * @file
+ * PNG Writer<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Writes an eight-bit RGB image as a PNG file, so that the tools that draw
+ * pictures of random data need neither netpbm nor zlib. The image data is
+ * wrapped in uncompressed deflate blocks: the images are at most a few
+ * megabytes, and random data would not compress anyway.
+ */
+
+#include <stdio.h>
+
+/**
+ * Write an image.
+ * @param fp points to the open file.
+ * @param rgb points to width * height pixels, each a red, green, and blue
+ * byte, row after row from the top.
+ * @param width is the width of the image in pixels.
+ * @param height is the height of the image in pixels.
+ * @return 0 for success or <0 with errno set.
+ */
+extern int png_write(FILE * fp, const unsigned char * rgb, unsigned int width, unsigned int height);
+
+#endif
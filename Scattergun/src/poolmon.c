@@ -0,0 +1,571 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Pool Monitor<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * poolmon [ -h ] [ -v ] [ -g ] [ -r ] [ -w ] [ -s NANOSECONDS ] [ -c NANOSECONDS ] [ -t BITS ] [ -l NANOSECONDS ]
+ *
+ * OPTIONS
+ *
+ * -c NANOSECONDS  Display CSV output to stdout with this period.
+ * -g              Display a bar graph to stdout at each CSV period.
+ * -h              Display this menu.
+ * -l NANOSECONDS  Run for no longer than this.
+ * -r              Also wake up and sample when /dev/random becomes readable.
+ * -s NANOSECONDS  Sample the pool with this period (default 1000000).
+ * -t BITS         Accumulate time spent below this many bits (default 128).
+ * -v              Display verbose output to stderr.
+ * -w              Also wake up and sample when /dev/random becomes writable.
+ *
+ * EXAMPLES
+ *
+ * poolmon -c 1000000000
+ *
+ * poolmon -s 100000 -w -t 64 -c 250000000 -l 60000000000 > pool.csv
+ *
+ * poolmon -g -c 250000000
+ *
+ * ABSTRACT
+ *
+ * Samples the amount of entropy in the kernel entropy pool, as reported by
+ * /proc/sys/kernel/random/entropy_avail, at up to kilohertz rates, and
+ * computes the rate at which the pool is depleted and refilled, and a
+ * histogram of how long the pool spends below a threshold. This is a native
+ * replacement for monitor.sh, which forks several processes per sample and
+ * so can neither sample fast enough to see the pool drain and refill under
+ * load nor avoid perturbing the pool it is measuring. The procfs file is
+ * opened once and reread in place, and the sampler sleeps until an absolute
+ * deadline so that the sample period does not drift. Optionally the sampler
+ * also waits on poll(2) events from /dev/random, readable when the pool rises
+ * above the read wakeup threshold with -r, writable when it falls below the
+ * write wakeup threshold with -w, so that crossings are sampled as they
+ * happen. Since the events are level triggered, the sampler waits for one
+ * only when it is not already pending, so that a device that is always
+ * readable or writable, as /dev/random is on recent kernels, adds no
+ * samples. The CSV
+ * output has the same form as that produced by rate -c: a header line, then
+ * one line per period beginning with the elapsed time in nanoseconds. A
+ * summary and the histogram are emitted to standard error at exit, and the
+ * running totals on SIGHUP. N.B. Beginning with Linux 5.18 the kernel
+ * reports a constant entropy_avail of 256 bits once the CRNG is initialized.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+static const char * program = "poolmon";
+
+static const char ENTROPYAVAIL[] = "/proc/sys/kernel/random/entropy_avail";
+static const char POOLSIZE[] = "/proc/sys/kernel/random/poolsize";
+static const char RANDOM[] = "/dev/random";
+
+static const char GRAPH[] = "====================================================================================================";
+
+enum { BUCKETS = 32, };
+
+static volatile sig_atomic_t done = 0;
+static volatile sig_atomic_t report = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        done = !0;
+    }
+}
+
+static int handle(int signum, int flags)
+{
+    int rc;
+    struct sigaction action = { 0 };
+
+    action.sa_handler = handler;
+    action.sa_flags = flags;
+    rc = sigaction(signum, &action, (struct sigaction *)0);
+    if (rc < 0) {
+        perror("sigaction");
+    }
+
+    return rc;
+}
+
+static uint64_t watch(void)
+{
+    int rc;
+    uint64_t ticks = ~0;
+    struct timespec spec = { 0 };
+
+    rc = clock_gettime(CLOCK_MONOTONIC, &spec);
+    if (rc == 0) {
+        ticks = spec.tv_sec;
+        ticks *= 1000000000;
+        ticks += spec.tv_nsec;
+    } else {
+        perror("clock_gettime");
+    }
+
+    return ticks;
+}
+
+/**
+ * Reread a procfs integer value from an already open file descriptor. The
+ * file is read in place at offset zero so that no open(2) or lseek(2) is
+ * necessary per sample.
+ * @param fd is the open file descriptor.
+ * @return the value or <0 if an error occurred.
+ */
+static long sample(int fd)
+{
+    long value = -1;
+    ssize_t bytes;
+    char buffer[32];
+
+    bytes = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytes > 0) {
+        buffer[bytes] = '\0';
+        value = strtol(buffer, (char **)0, 10);
+    } else if (bytes == 0) {
+        errno = ENODATA;
+        perror(ENTROPYAVAIL);
+    } else {
+        perror(ENTROPYAVAIL);
+    }
+
+    return value;
+}
+
+/**
+ * Return true if a poll event is already pending, in which case waiting for
+ * it would return at once rather than at a crossing.
+ * @param pfd points to the poll descriptor.
+ * @return true if an event is pending.
+ */
+static int pending(struct pollfd * pfd)
+{
+    pfd->revents = 0;
+
+    return poll(pfd, 1, 0) > 0;
+}
+
+/**
+ * Map a duration in nanoseconds to a histogram bucket. Bucket N counts
+ * durations of at least 2^N and less than 2^(N+1) microseconds, except
+ * that bucket zero also counts anything less than one microsecond.
+ * @param ns is the duration in nanoseconds.
+ * @return the bucket index.
+ */
+static int bucket(uint64_t ns)
+{
+    int index = 0;
+    uint64_t us;
+
+    for (us = ns / 1000; (us > 1) && (index < (BUCKETS - 1)); us >>= 1) {
+        ++index;
+    }
+
+    return index;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -c NANOSECONDS ] [ -g ] [ -h ] [ -l NANOSECONDS ] [ -r ] [ -s NANOSECONDS ] [ -t BITS ] [ -v ] [ -w ]\n", program);
+    fprintf(stderr, "       -c NANOSECONDS  Display CSV output to stdout with this period.\n");
+    fprintf(stderr, "       -g              Display a bar graph to stdout at each CSV period.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -l NANOSECONDS  Run for no longer than this.\n");
+    fprintf(stderr, "       -r              Also sample when /dev/random becomes readable.\n");
+    fprintf(stderr, "       -s NANOSECONDS  Sample the pool with this period.\n");
+    fprintf(stderr, "       -t BITS         Accumulate time spent below this many bits.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -w              Also sample when /dev/random becomes writable.\n");
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int graph = 0;
+    int wake = 0;
+    uint64_t period = 1000000;
+    uint64_t csv = 0;
+    uint64_t limit = 0;
+    long threshold = 128;
+    int fd = -1;
+    int rfd = -1;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "c:ghl:rs:t:vw")) >= 0) {
+
+        switch (opt) {
+
+        case 'c':
+            csv = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (csv == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'g':
+            graph = !0;
+            break;
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'l':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            period = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (period == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            threshold = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threshold < 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'r':
+            wake |= POLLIN;
+            break;
+
+        case 'w':
+            wake |= POLLOUT;
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+        uint64_t epoch = 0;
+        uint64_t deadline = 0;
+        uint64_t hence = 0;
+        uint64_t then = 0;
+        uint64_t now = 0;
+        uint64_t elapsed = 0;
+        uint64_t below = 0;
+        uint64_t interval_below = 0;
+        uint64_t episode = 0;
+        uint64_t longest = 0;
+        uint64_t falling = 0;
+        uint64_t rising = 0;
+        uint64_t depleted = 0;
+        uint64_t refilled = 0;
+        uint64_t interval_depleted = 0;
+        uint64_t interval_refilled = 0;
+        size_t samples = 0;
+        size_t interval_samples = 0;
+        size_t wakeups = 0;
+        size_t overruns = 0;
+        size_t histogram[BUCKETS] = { 0 };
+        long poolsize = 4096;
+        long previous = -1;
+        long current = -1;
+        long minimum = -1;
+        long maximum = -1;
+        int armed = 0;
+        int ii;
+        struct timespec spec = { 0 };
+        struct pollfd pfd = { 0 };
+
+        if (error) {
+            break;
+        }
+
+        if (handle(SIGINT, 0) < 0) { break; }
+        if (handle(SIGTERM, 0) < 0) { break; }
+        if (handle(SIGPIPE, 0) < 0) { break; }
+        if (handle(SIGHUP, SA_RESTART) < 0) { break; }
+
+        fd = open(POOLSIZE, O_RDONLY);
+        if (fd >= 0) {
+            poolsize = sample(fd);
+            close(fd);
+        }
+        if (poolsize <= 0) {
+            poolsize = 4096;
+        }
+
+        fd = open(ENTROPYAVAIL, O_RDONLY);
+        if (fd < 0) {
+            perror(ENTROPYAVAIL);
+            break;
+        }
+
+        if (wake) {
+            rfd = open(RANDOM, O_RDONLY | O_NONBLOCK);
+            if (rfd < 0) {
+                perror(RANDOM);
+                break;
+            }
+            pfd.fd = rfd;
+            pfd.events = wake;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: %ld bits poolsize\n", program, poolsize);
+            fprintf(stderr, "%s: %lu nanoseconds sample period\n", program, period);
+            fprintf(stderr, "%s: %ld bits threshold\n", program, threshold);
+            fprintf(stderr, "%s: %s%s poll events\n", program, ((wake & POLLIN) != 0) ? "POLLIN " : "", ((wake & POLLOUT) != 0) ? "POLLOUT" : "");
+        }
+
+        if ((csv > 0) && (!graph)) {
+            printf("%s,%s,%s,%s,%s,%s,%s,%s\n", "Elapsed", "Minimum", "Maximum", "Current", "Depletion", "Refill", "Below", "Samples");
+        }
+
+        epoch = watch();
+        deadline = epoch;
+        hence = epoch;
+        then = epoch;
+        armed = (wake != 0) && !pending(&pfd);
+
+        while (!done) {
+
+            current = sample(fd);
+            if (current < 0) {
+                break;
+            }
+            now = watch();
+            elapsed = now - epoch;
+
+            ++samples;
+            ++interval_samples;
+
+            if ((minimum < 0) || (current < minimum)) {
+                minimum = current;
+            }
+            if ((maximum < 0) || (current > maximum)) {
+                maximum = current;
+            }
+
+            /*
+             * The pool is assumed to have held its previous level until
+             * this sample, so the whole interval since the previous sample
+             * is attributed to the direction in which it moved.
+             */
+
+            if (previous < 0) {
+                /* Do nothing. */
+            } else if (current < previous) {
+                depleted += previous - current;
+                interval_depleted += previous - current;
+                falling += now - then;
+            } else if (current > previous) {
+                refilled += current - previous;
+                interval_refilled += current - previous;
+                rising += now - then;
+            } else {
+                /* Do nothing. */
+            }
+
+            if ((previous >= 0) && (previous < threshold)) {
+                below += now - then;
+                interval_below += now - then;
+                episode += now - then;
+            }
+
+            if (current < threshold) {
+                /* Do nothing. */
+            } else if (episode == 0) {
+                /* Do nothing. */
+            } else {
+                histogram[bucket(episode)] += 1;
+                if (episode > longest) {
+                    longest = episode;
+                }
+                episode = 0;
+            }
+
+            previous = current;
+            then = now;
+
+            if ((csv > 0) && ((now - hence) >= csv)) {
+                uint64_t duration = now - hence;
+                double depletion = interval_depleted * 1000000000.0 / duration;
+                double refill = interval_refilled * 1000000000.0 / duration;
+                if (graph) {
+                    int percent = (current * 100) / poolsize;
+                    if (percent > 100) { percent = 100; }
+                    printf("%3d%% %.*s\n", percent, percent, GRAPH);
+                } else {
+                    printf("%lu,%ld,%ld,%ld,%lf,%lf,%lu,%zu\n", elapsed, minimum, maximum, current, depletion, refill, interval_below, interval_samples);
+                }
+                fflush(stdout);
+                minimum = current;
+                maximum = current;
+                interval_depleted = 0;
+                interval_refilled = 0;
+                interval_below = 0;
+                interval_samples = 0;
+                hence = now;
+            }
+
+            if (report) {
+                fprintf(stderr, "%s: elapsed=%lu samples=%zu wakeups=%zu current=%ld depleted=%lu refilled=%lu below=%lu\n", program, elapsed, samples, wakeups, current, depleted, refilled, below);
+                report = 0;
+            }
+
+            if ((limit > 0) && (elapsed >= limit)) {
+                break;
+            }
+
+            /*
+             * Sleep until the next absolute deadline. If we have fallen
+             * behind, skip the missed deadlines rather than trying to catch
+             * up with a burst of samples. If waking on poll events, a single
+             * event may cut the sleep short once per period; the level
+             * triggered events would otherwise spin while the pool stays
+             * above or below the wakeup thresholds.
+             */
+
+            deadline += period;
+            if (deadline <= now) {
+                ++overruns;
+                deadline = now + period - ((now - deadline) % period);
+            }
+
+            if (armed) {
+                spec.tv_sec = (deadline - now) / 1000000000;
+                spec.tv_nsec = (deadline - now) % 1000000000;
+                pfd.revents = 0;
+                ii = ppoll(&pfd, 1, &spec, (const sigset_t *)0);
+                if (ii > 0) {
+                    ++wakeups;
+                    armed = 0;
+                    deadline -= period;
+                    continue;
+                } else if (ii == 0) {
+                    continue;
+                } else if (errno == EINTR) {
+                    continue;
+                } else {
+                    perror("ppoll");
+                    break;
+                }
+            }
+
+            armed = (wake != 0) && !pending(&pfd);
+
+            spec.tv_sec = deadline / 1000000000;
+            spec.tv_nsec = deadline % 1000000000;
+            ii = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, (struct timespec *)0);
+            if ((ii != 0) && (ii != EINTR)) {
+                errno = ii;
+                perror("clock_nanosleep");
+                break;
+            }
+
+        }
+
+        if (episode > 0) {
+            histogram[bucket(episode)] += 1;
+            if (episode > longest) {
+                longest = episode;
+            }
+        }
+
+        fprintf(stderr, "%s: %lf milliseconds elapsed\n", program, elapsed / 1000000.0);
+        fprintf(stderr, "%s: %zu samples\n", program, samples);
+        fprintf(stderr, "%s: %zu wakeups\n", program, wakeups);
+        fprintf(stderr, "%s: %zu overruns\n", program, overruns);
+        fprintf(stderr, "%s: %lu bits depleted\n", program, depleted);
+        fprintf(stderr, "%s: %lu bits refilled\n", program, refilled);
+
+        if (elapsed > 0) {
+            fprintf(stderr, "%s: %lf bits/second depletion average\n", program, depleted * 1000000000.0 / elapsed);
+            fprintf(stderr, "%s: %lf bits/second refill average\n", program, refilled * 1000000000.0 / elapsed);
+        }
+        if (falling > 0) {
+            fprintf(stderr, "%s: %lf bits/second depletion while falling\n", program, depleted * 1000000000.0 / falling);
+        }
+        if (rising > 0) {
+            fprintf(stderr, "%s: %lf bits/second refill while rising\n", program, refilled * 1000000000.0 / rising);
+        }
+
+        fprintf(stderr, "%s: %lf milliseconds below %ld bits\n", program, below / 1000000.0, threshold);
+        fprintf(stderr, "%s: %lf milliseconds longest below %ld bits\n", program, longest / 1000000.0, threshold);
+
+        for (ii = 0; ii < BUCKETS; ++ii) {
+            if (histogram[ii] > 0) {
+                fprintf(stderr, "%s: below [%luus..%luus) %zu\n", program, (ii == 0) ? 0UL : (1UL << ii), 1UL << (ii + 1), histogram[ii]);
+            }
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    if (rfd >= 0) {
+        close(rfd);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return xc;
+}
@@ -0,0 +1,1276 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * PRNG<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * prng [ -h ] [ -v ] [ -x ] [ -g GENERATOR ] [ -t THREADS ] [ -b BYTES ] [ -n BYTES ] [ SEED ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Generate this many bytes per block (default 1048576).
+ * -g GENERATOR    Use this generator (default xoshiro256).
+ * -h              Display this menu.
+ * -n BYTES        Stop after this many bytes (default unlimited).
+ * -t THREADS      Generate blocks using this many threads (default none).
+ * -v              Display verbose output to stderr.
+ * -x              Run the known answer tests and exit.
+ *
+ * GENERATORS
+ *
+ * xoshiro256      xoshiro256** (Blackman and Vigna)
+ * pcg64           PCG64 XSL-RR 128/64 (O'Neill)
+ * philox          Philox4x32-10 (Salmon et al.)
+ * chacha20        ChaCha20 with a 64-bit block counter (Bernstein)
+ * aes128          AES-128 in counter mode (x86 AES-NI only)
+ *
+ * EXAMPLES
+ *
+ * prng -g chacha20 0xDEADBEEF | dd of=random.dat bs=4096 count=1024 iflag=fullblock
+ *
+ * prng -g philox -t 4 | rate -r 1048576 -t 10000000000
+ *
+ * cmp <(prng -g pcg64 -n 100000000 42) <(prng -g pcg64 -t 8 -n 100000000 42)
+ *
+ * ABSTRACT
+ *
+ * Continuously outputs the stream produced by one of several well regarded
+ * pseudo-random number generators, as known-good control sources for the test
+ * battery and as sources fast enough that they never limit a benchmark. The
+ * C library generators used by crandom and cmrand48 are both statistically
+ * weak and, one thirty-two bit word at a time, slow. If an argument is
+ * specified, it is used to seed the generator, by way of SplitMix64, as with
+ * crandom and cmrand48; otherwise the seed is one.
+ *
+ * The stream is generated in fixed size blocks. In the multi-threaded mode,
+ * thread N of T generates blocks N, N+T, N+2T, and so on, into a ring of
+ * buffers that is written strictly in order, so that the output is bit for
+ * bit identical to that of the serial mode with the same seed regardless of
+ * the number of threads or the block size. The counter based generators
+ * (Philox, ChaCha20, AES-CTR) simply start each block at the appropriate
+ * counter. PCG64 jumps ahead using the logarithmic time LCG advance.
+ * xoshiro256** jumps ahead by an arbitrary distance by computing x^N modulo
+ * its characteristic polynomial, which is itself recovered at startup from
+ * the generator's own output using Berlekamp-Massey, and applying the result
+ * the same way the published jump() function applies its constant.
+ *
+ * ChaCha20 and Philox compute eight blocks at a time using the GCC vector
+ * extensions, which the compiler maps onto whatever SIMD instructions the
+ * target has (SSE2, AVX2, NEON); on x86_64 the kernels are also cloned for
+ * AVX2 and selected at run time. AES-CTR uses the AES-NI instructions,
+ * pipelined eight blocks deep, and is unavailable without them.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "output.h"
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#   define PRNG_CLONES __attribute__((target_clones("avx2","default")))
+#else
+#   define PRNG_CLONES
+#endif
+
+static const char * program = "prng";
+
+/*******************************************************************************
+ * SPLITMIX64
+ ******************************************************************************/
+
+/**
+ * SplitMix64 is used only to expand the seed into the generator state, as
+ * its authors recommend for xoshiro.
+ */
+static uint64_t splitmix64(uint64_t * xp)
+{
+    uint64_t z = (*xp += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*******************************************************************************
+ * CONTEXT
+ ******************************************************************************/
+
+/**
+ * Each thread (or the main thread in serial mode) has its own context. The
+ * position is the index of the next unit (the native output size of the
+ * generator) that the context will produce; the stateful generators use it
+ * to decide how far to jump.
+ */
+typedef struct Context {
+    uint64_t position;
+    union {
+        uint64_t xoshiro[4];
+        unsigned __int128 pcg[2];
+        uint32_t philox[2];
+        uint32_t chacha[8];
+        uint8_t aes[176];
+    } u;
+} context_t;
+
+typedef struct Generator {
+    const char * name;
+    size_t unit;
+    int (*available)(void);
+    void (*seed)(context_t * cp, uint64_t seed);
+    void (*generate)(context_t * cp, uint64_t position, uint8_t * buffer, size_t units);
+} generator_t;
+
+static int always(void)
+{
+    return !0;
+}
+
+/*******************************************************************************
+ * XOSHIRO256**
+ ******************************************************************************/
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro_next(uint64_t * s)
+{
+    const uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+
+    return result;
+}
+
+/**
+ * The low 256 bits of the characteristic polynomial of the xoshiro256 state
+ * transition; the x^256 term is implicit.
+ */
+static uint64_t characteristic[4];
+
+/**
+ * Recover the characteristic polynomial of the xoshiro256 linear engine
+ * with Berlekamp-Massey over GF(2), from the sequence of the low bit of
+ * the first state word. Because the engine has full period 2^256-1, the
+ * minimal polynomial of any such sequence is the characteristic polynomial.
+ */
+static void xoshiro_characteristic(void)
+{
+    enum { N = 512, L = 256, };
+    uint8_t sequence[N];
+    uint8_t c[N + 1] = { 0 };
+    uint8_t b[N + 1] = { 0 };
+    uint8_t t[N + 1];
+    uint64_t s[4] = { 1, 2, 3, 4 };
+    int length = 0;
+    int m = -1;
+    int n;
+    int ii;
+
+    for (n = 0; n < N; ++n) {
+        sequence[n] = s[0] & 1;
+        xoshiro_next(s);
+    }
+
+    c[0] = 1;
+    b[0] = 1;
+
+    for (n = 0; n < N; ++n) {
+        uint8_t d = sequence[n];
+        for (ii = 1; ii <= length; ++ii) {
+            d ^= c[ii] & sequence[n - ii];
+        }
+        if (d == 0) {
+            continue;
+        }
+        memcpy(t, c, sizeof(t));
+        for (ii = 0; (ii + n - m) <= N; ++ii) {
+            c[ii + n - m] ^= b[ii];
+        }
+        if ((2 * length) <= n) {
+            length = n + 1 - length;
+            m = n;
+            memcpy(b, t, sizeof(b));
+        }
+    }
+
+    /*
+     * The connection polynomial C(x) is the reciprocal of the characteristic
+     * polynomial P(x) = x^L C(1/x), so the coefficient of x^i in P is that
+     * of x^(L-i) in C.
+     */
+
+    memset(characteristic, 0, sizeof(characteristic));
+    for (ii = 0; ii < L; ++ii) {
+        if (c[L - ii]) {
+            characteristic[ii / 64] |= 1ULL << (ii % 64);
+        }
+    }
+}
+
+/**
+ * Multiply a polynomial of degree less than 256 by x modulo the
+ * characteristic polynomial.
+ */
+static void xoshiro_timesx(uint64_t * r)
+{
+    uint64_t carry = r[3] >> 63;
+
+    r[3] = (r[3] << 1) | (r[2] >> 63);
+    r[2] = (r[2] << 1) | (r[1] >> 63);
+    r[1] = (r[1] << 1) | (r[0] >> 63);
+    r[0] = (r[0] << 1);
+
+    if (carry) {
+        r[0] ^= characteristic[0];
+        r[1] ^= characteristic[1];
+        r[2] ^= characteristic[2];
+        r[3] ^= characteristic[3];
+    }
+}
+
+/**
+ * Multiply two polynomials modulo the characteristic polynomial.
+ */
+static void xoshiro_multiply(uint64_t * r, const uint64_t * a, const uint64_t * b)
+{
+    uint64_t p[4] = { 0, 0, 0, 0 };
+    int ii;
+
+    for (ii = 255; ii >= 0; --ii) {
+        xoshiro_timesx(p);
+        if ((b[ii / 64] >> (ii % 64)) & 1) {
+            p[0] ^= a[0];
+            p[1] ^= a[1];
+            p[2] ^= a[2];
+            p[3] ^= a[3];
+        }
+    }
+
+    memcpy(r, p, sizeof(p));
+}
+
+/**
+ * Compute x^n modulo the characteristic polynomial.
+ */
+static void xoshiro_power(uint64_t * r, uint64_t n)
+{
+    int ii;
+
+    r[0] = 1;
+    r[1] = 0;
+    r[2] = 0;
+    r[3] = 0;
+
+    for (ii = 63; ii >= 0; --ii) {
+        xoshiro_multiply(r, r, r);
+        if ((n >> ii) & 1) {
+            xoshiro_timesx(r);
+        }
+    }
+}
+
+/**
+ * Advance the state by n steps by evaluating the jump polynomial x^n at the
+ * state transition matrix, exactly as the published jump() does with its
+ * precomputed x^(2^128).
+ */
+static void xoshiro_jump(uint64_t * s, uint64_t n)
+{
+    uint64_t jump[4];
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    int ii;
+    int bb;
+
+    if (n == 0) {
+        return;
+    }
+
+    xoshiro_power(jump, n);
+
+    for (ii = 0; ii < 4; ++ii) {
+        for (bb = 0; bb < 64; ++bb) {
+            if ((jump[ii] >> bb) & 1) {
+                t[0] ^= s[0];
+                t[1] ^= s[1];
+                t[2] ^= s[2];
+                t[3] ^= s[3];
+            }
+            xoshiro_next(s);
+        }
+    }
+
+    memcpy(s, t, sizeof(t));
+}
+
+static void xoshiro_seed(context_t * cp, uint64_t seed)
+{
+    cp->u.xoshiro[0] = splitmix64(&seed);
+    cp->u.xoshiro[1] = splitmix64(&seed);
+    cp->u.xoshiro[2] = splitmix64(&seed);
+    cp->u.xoshiro[3] = splitmix64(&seed);
+    cp->position = 0;
+}
+
+static void xoshiro_generate(context_t * cp, uint64_t position, uint8_t * buffer, size_t units)
+{
+    uint64_t s[4];
+    uint64_t * wp = (uint64_t *)buffer;
+    size_t ii;
+
+    xoshiro_jump(cp->u.xoshiro, position - cp->position);
+
+    memcpy(s, cp->u.xoshiro, sizeof(s));
+    for (ii = 0; ii < units; ++ii) {
+        wp[ii] = xoshiro_next(s);
+    }
+    memcpy(cp->u.xoshiro, s, sizeof(s));
+
+    cp->position = position + units;
+}
+
+/*******************************************************************************
+ * PCG64
+ ******************************************************************************/
+
+#define PCG_MULTIPLIER_128 ((((unsigned __int128)2549297995355413924ULL) << 64) + 4865540595714422341ULL)
+
+static inline uint64_t pcg_output(unsigned __int128 state)
+{
+    uint64_t value = ((uint64_t)(state >> 64)) ^ (uint64_t)state;
+    unsigned int rot = state >> 122;
+    return (value >> rot) | (value << ((-rot) & 63));
+}
+
+static unsigned __int128 pcg_advance(unsigned __int128 state, unsigned __int128 delta, unsigned __int128 multiplier, unsigned __int128 increment)
+{
+    unsigned __int128 accmultiplier = 1;
+    unsigned __int128 accincrement = 0;
+
+    while (delta > 0) {
+        if (delta & 1) {
+            accmultiplier *= multiplier;
+            accincrement = (accincrement * multiplier) + increment;
+        }
+        increment = (multiplier + 1) * increment;
+        multiplier *= multiplier;
+        delta /= 2;
+    }
+
+    return (accmultiplier * state) + accincrement;
+}
+
+/**
+ * Seed the generator as pcg64_srandom_r() does.
+ */
+static void pcg_srandom(context_t * cp, unsigned __int128 initstate, unsigned __int128 initseq)
+{
+    cp->u.pcg[0] = 0;
+    cp->u.pcg[1] = (initseq << 1) | 1;
+    cp->u.pcg[0] = (cp->u.pcg[0] * PCG_MULTIPLIER_128) + cp->u.pcg[1];
+    cp->u.pcg[0] += initstate;
+    cp->u.pcg[0] = (cp->u.pcg[0] * PCG_MULTIPLIER_128) + cp->u.pcg[1];
+    cp->position = 0;
+}
+
+static void pcg_seed(context_t * cp, uint64_t seed)
+{
+    unsigned __int128 initstate;
+    unsigned __int128 initseq;
+
+    initstate = splitmix64(&seed);
+    initstate = (initstate << 64) | splitmix64(&seed);
+    initseq = splitmix64(&seed);
+    initseq = (initseq << 64) | splitmix64(&seed);
+
+    pcg_srandom(cp, initstate, initseq);
+}
+
+static void pcg_generate(context_t * cp, uint64_t position, uint8_t * buffer, size_t units)
+{
+    unsigned __int128 state;
+    unsigned __int128 increment = cp->u.pcg[1];
+    uint64_t * wp = (uint64_t *)buffer;
+    size_t ii;
+
+    state = pcg_advance(cp->u.pcg[0], position - cp->position, PCG_MULTIPLIER_128, increment);
+
+    for (ii = 0; ii < units; ++ii) {
+        state = (state * PCG_MULTIPLIER_128) + increment;
+        wp[ii] = pcg_output(state);
+    }
+
+    cp->u.pcg[0] = state;
+    cp->position = position + units;
+}
+
+/*******************************************************************************
+ * PHILOX4X32-10
+ ******************************************************************************/
+
+typedef uint64_t v8u64_t __attribute__((vector_size(64)));
+
+enum { LANES = 8, };
+
+/**
+ * Compute eight Philox4x32-10 blocks with consecutive counters beginning at
+ * the specified counter. Each thirty-two bit counter word is carried in a
+ * sixty-four bit lane so that the full product of the multiplications is
+ * available without widening.
+ */
+PRNG_CLONES
+static void philox_eight(const uint32_t * key, uint64_t counter, uint32_t * out)
+{
+    static const uint64_t M0 = 0xD2511F53;
+    static const uint64_t M1 = 0xCD9E8D57;
+    static const uint32_t W0 = 0x9E3779B9;
+    static const uint32_t W1 = 0xBB67AE85;
+    const v8u64_t mask = { 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, 0xffffffffULL, };
+    v8u64_t c0;
+    v8u64_t c1;
+    v8u64_t c2;
+    v8u64_t c3;
+    v8u64_t p0;
+    v8u64_t p1;
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    int ii;
+
+    for (ii = 0; ii < LANES; ++ii) {
+        c0[ii] = (uint32_t)(counter + ii);
+        c1[ii] = (uint32_t)((counter + ii) >> 32);
+        c2[ii] = 0;
+        c3[ii] = 0;
+    }
+
+    for (ii = 0; ii < 10; ++ii) {
+        p0 = c0 * M0;
+        p1 = c2 * M1;
+        c0 = (p1 >> 32) ^ c1 ^ k0;
+        c1 = p1 & mask;
+        c2 = (p0 >> 32) ^ c3 ^ k1;
+        c3 = p0 & mask;
+        k0 += W0;
+        k1 += W1;
+    }
+
+    for (ii = 0; ii < LANES; ++ii) {
+        out[(ii * 4) + 0] = c0[ii];
+        out[(ii * 4) + 1] = c1[ii];
+        out[(ii * 4) + 2] = c2[ii];
+        out[(ii * 4) + 3] = c3[ii];
+    }
+}
+
+static void philox_seed(context_t * cp, uint64_t seed)
+{
+    uint64_t word = splitmix64(&seed);
+    cp->u.philox[0] = word;
+    cp->u.philox[1] = word >> 32;
+    cp->position = 0;
+}
+
+static void philox_generate(context_t * cp, uint64_t position, uint8_t * buffer, size_t units)
+{
+    uint32_t block[LANES * 4];
+    size_t count;
+
+    while (units > 0) {
+        philox_eight(cp->u.philox, position, block);
+        count = (units < LANES) ? units : LANES;
+        memcpy(buffer, block, count * 16);
+        buffer += count * 16;
+        position += count;
+        units -= count;
+    }
+
+    cp->position = position;
+}
+
+/*******************************************************************************
+ * CHACHA20
+ ******************************************************************************/
+
+typedef uint32_t v8u32_t __attribute__((vector_size(32)));
+
+#define CHACHA_ROTL(_V_, _N_) (((_V_) << (_N_)) | ((_V_) >> (32 - (_N_))))
+
+#define CHACHA_QR(_A_, _B_, _C_, _D_) \
+    do { \
+        _A_ += _B_; _D_ ^= _A_; _D_ = CHACHA_ROTL(_D_, 16); \
+        _C_ += _D_; _B_ ^= _C_; _B_ = CHACHA_ROTL(_B_, 12); \
+        _A_ += _B_; _D_ ^= _A_; _D_ = CHACHA_ROTL(_D_, 8); \
+        _C_ += _D_; _B_ ^= _C_; _B_ = CHACHA_ROTL(_B_, 7); \
+    } while (0)
+
+/**
+ * Compute eight ChaCha20 blocks with consecutive sixty-four bit block
+ * counters beginning at the specified counter, one block per vector lane.
+ * Words fourteen and fifteen (the nonce) are zero unless specified.
+ */
+PRNG_CLONES
+static void chacha_eight(const uint32_t * key, uint64_t counter, uint32_t nonce0, uint32_t nonce1, uint32_t * out)
+{
+    static const uint32_t SIGMA[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, };
+    v8u32_t input[16];
+    v8u32_t x[16];
+    int ii;
+    int jj;
+
+    for (ii = 0; ii < 4; ++ii) {
+        for (jj = 0; jj < LANES; ++jj) { input[ii][jj] = SIGMA[ii]; }
+    }
+    for (ii = 0; ii < 8; ++ii) {
+        for (jj = 0; jj < LANES; ++jj) { input[4 + ii][jj] = key[ii]; }
+    }
+    for (jj = 0; jj < LANES; ++jj) {
+        input[12][jj] = (uint32_t)(counter + jj);
+        input[13][jj] = (uint32_t)((counter + jj) >> 32);
+        input[14][jj] = nonce0;
+        input[15][jj] = nonce1;
+    }
+
+    memcpy(x, input, sizeof(x));
+
+    for (ii = 0; ii < 10; ++ii) {
+        CHACHA_QR(x[0], x[4], x[8],  x[12]);
+        CHACHA_QR(x[1], x[5], x[9],  x[13]);
+        CHACHA_QR(x[2], x[6], x[10], x[14]);
+        CHACHA_QR(x[3], x[7], x[11], x[15]);
+        CHACHA_QR(x[0], x[5], x[10], x[15]);
+        CHACHA_QR(x[1], x[6], x[11], x[12]);
+        CHACHA_QR(x[2], x[7], x[8],  x[13]);
+        CHACHA_QR(x[3], x[4], x[9],  x[14]);
+    }
+
+    for (ii = 0; ii < 16; ++ii) {
+        x[ii] += input[ii];
+    }
+
+    for (jj = 0; jj < LANES; ++jj) {
+        for (ii = 0; ii < 16; ++ii) {
+            out[(jj * 16) + ii] = x[ii][jj];
+        }
+    }
+}
+
+static void chacha_seed(context_t * cp, uint64_t seed)
+{
+    int ii;
+
+    for (ii = 0; ii < 8; ii += 2) {
+        uint64_t word = splitmix64(&seed);
+        cp->u.chacha[ii] = word;
+        cp->u.chacha[ii + 1] = word >> 32;
+    }
+    cp->position = 0;
+}
+
+static void chacha_generate(context_t * cp, uint64_t position, uint8_t * buffer, size_t units)
+{
+    uint32_t block[LANES * 16];
+    size_t count;
+
+    while (units > 0) {
+        chacha_eight(cp->u.chacha, position, 0, 0, block);
+        count = (units < LANES) ? units : LANES;
+        memcpy(buffer, block, count * 64);
+        buffer += count * 64;
+        position += count;
+        units -= count;
+    }
+
+    cp->position = position;
+}
+
+/*******************************************************************************
+ * AES-128-CTR
+ ******************************************************************************/
+
+#if defined(__x86_64__)
+
+static int aes_available(void)
+{
+    return __builtin_cpu_supports("aes");
+}
+
+#define AES_EXPAND(_K_, _R_) aes_expand(_K_, _mm_aeskeygenassist_si128(_K_, _R_))
+
+__attribute__((target("aes")))
+static __m128i aes_expand(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+__attribute__((target("aes")))
+static void aes_schedule(uint8_t * schedule, const uint8_t * key)
+{
+    __m128i k[11];
+    int ii;
+
+    k[0] = _mm_loadu_si128((const __m128i *)key);
+    k[1] = AES_EXPAND(k[0], 0x01);
+    k[2] = AES_EXPAND(k[1], 0x02);
+    k[3] = AES_EXPAND(k[2], 0x04);
+    k[4] = AES_EXPAND(k[3], 0x08);
+    k[5] = AES_EXPAND(k[4], 0x10);
+    k[6] = AES_EXPAND(k[5], 0x20);
+    k[7] = AES_EXPAND(k[6], 0x40);
+    k[8] = AES_EXPAND(k[7], 0x80);
+    k[9] = AES_EXPAND(k[8], 0x1b);
+    k[10] = AES_EXPAND(k[9], 0x36);
+
+    for (ii = 0; ii < 11; ++ii) {
+        _mm_storeu_si128((__m128i *)(schedule + (ii * 16)), k[ii]);
+    }
+}
+
+/**
+ * Encrypt eight consecutive counter blocks. The counter is a 128-bit little
+ * endian integer whose high half is zero.
+ */
+__attribute__((target("aes")))
+static void aes_eight(const uint8_t * schedule, uint64_t counter, uint8_t * out)
+{
+    __m128i k[11];
+    __m128i b[LANES];
+    int ii;
+    int jj;
+
+    for (ii = 0; ii < 11; ++ii) {
+        k[ii] = _mm_loadu_si128((const __m128i *)(schedule + (ii * 16)));
+    }
+
+    for (jj = 0; jj < LANES; ++jj) {
+        b[jj] = _mm_xor_si128(_mm_set_epi64x(0, counter + jj), k[0]);
+    }
+
+    for (ii = 1; ii < 10; ++ii) {
+        for (jj = 0; jj < LANES; ++jj) {
+            b[jj] = _mm_aesenc_si128(b[jj], k[ii]);
+        }
+    }
+
+    for (jj = 0; jj < LANES; ++jj) {
+        b[jj] = _mm_aesenclast_si128(b[jj], k[10]);
+        _mm_storeu_si128((__m128i *)(out + (jj * 16)), b[jj]);
+    }
+}
+
+__attribute__((target("aes")))
+static void aes_one(const uint8_t * schedule, const uint8_t * in, uint8_t * out)
+{
+    __m128i b;
+    int ii;
+
+    b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)schedule));
+    for (ii = 1; ii < 10; ++ii) {
+        b = _mm_aesenc_si128(b, _mm_loadu_si128((const __m128i *)(schedule + (ii * 16))));
+    }
+    b = _mm_aesenclast_si128(b, _mm_loadu_si128((const __m128i *)(schedule + 160)));
+    _mm_storeu_si128((__m128i *)out, b);
+}
+
+#else
+
+static int aes_available(void)
+{
+    return 0;
+}
+
+static void aes_schedule(uint8_t * schedule, const uint8_t * key)
+{
+}
+
+static void aes_eight(const uint8_t * schedule, uint64_t counter, uint8_t * out)
+{
+}
+
+static void aes_one(const uint8_t * schedule, const uint8_t * in, uint8_t * out)
+{
+}
+
+#endif
+
+static void aes_seed(context_t * cp, uint64_t seed)
+{
+    uint64_t key[2];
+
+    key[0] = splitmix64(&seed);
+    key[1] = splitmix64(&seed);
+    aes_schedule(cp->u.aes, (const uint8_t *)key);
+    cp->position = 0;
+}
+
+static void aes_generate(context_t * cp, uint64_t position, uint8_t * buffer, size_t units)
+{
+    uint8_t block[LANES * 16];
+    size_t count;
+
+    while (units > 0) {
+        aes_eight(cp->u.aes, position, block);
+        count = (units < LANES) ? units : LANES;
+        memcpy(buffer, block, count * 16);
+        buffer += count * 16;
+        position += count;
+        units -= count;
+    }
+
+    cp->position = position;
+}
+
+/*******************************************************************************
+ * TABLE
+ ******************************************************************************/
+
+static const generator_t GENERATORS[] = {
+    { "xoshiro256", 8,  always,         xoshiro_seed,   xoshiro_generate,   },
+    { "pcg64",      8,  always,         pcg_seed,       pcg_generate,       },
+    { "philox",     16, always,         philox_seed,    philox_generate,    },
+    { "chacha20",   64, always,         chacha_seed,    chacha_generate,    },
+    { "aes128",     16, aes_available,  aes_seed,       aes_generate,       },
+};
+
+/*******************************************************************************
+ * KNOWN ANSWER TESTS
+ ******************************************************************************/
+
+static int check(const char * name, const void * got, const void * expected, size_t size)
+{
+    int rc = (memcmp(got, expected, size) == 0);
+    fprintf(stderr, "%s: %s %s\n", program, name, rc ? "passed" : "FAILED");
+    return rc;
+}
+
+/**
+ * Check each generator against published test vectors, and check that
+ * jumping ahead produces the same state as stepping.
+ * @return true if all tests pass, false otherwise.
+ */
+static int kat(void)
+{
+    int rc = !0;
+    context_t context;
+    uint64_t words[8];
+
+    /*
+     * xoshiro256**: the published jump() constant must equal x^(2^128)
+     * modulo the recovered characteristic polynomial, and jumping must
+     * agree with stepping.
+     */
+    {
+        static const uint64_t JUMP[4] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c, };
+        uint64_t jump[4];
+        uint64_t s[4] = { 1, 2, 3, 4 };
+        uint64_t t[4] = { 1, 2, 3, 4 };
+        uint64_t expected = 11520;
+        int ii;
+
+        jump[0] = 2; jump[1] = 0; jump[2] = 0; jump[3] = 0;
+        for (ii = 0; ii < 128; ++ii) {
+            xoshiro_multiply(jump, jump, jump);
+        }
+        rc = check("xoshiro256 jump", jump, JUMP, sizeof(JUMP)) && rc;
+
+        words[0] = xoshiro_next(s);
+        rc = check("xoshiro256 output", &words[0], &expected, sizeof(expected)) && rc;
+
+        for (ii = 0; ii < 1000; ++ii) {
+            xoshiro_next(s);
+        }
+        xoshiro_jump(t, 1001);
+        rc = check("xoshiro256 advance", s, t, sizeof(s)) && rc;
+    }
+
+    /*
+     * PCG64: pcg64_srandom_r(&rng, 42, 54) as in the pcg-c demo.
+     */
+    {
+        static const uint64_t EXPECTED[6] = { 0x86b1da1d72062b68ULL, 0x1304aa46c9853d39ULL, 0xa3670e9e0dd50358ULL, 0xf9090e529a7dae00ULL, 0xc85b9fd837996f2cULL, 0x606121f8e3919196ULL, };
+        context_t other;
+
+        pcg_srandom(&context, 42, 54);
+        other = context;
+        pcg_generate(&context, 0, (uint8_t *)words, 6);
+        rc = check("pcg64 output", words, EXPECTED, sizeof(EXPECTED)) && rc;
+
+        pcg_generate(&other, 3, (uint8_t *)words, 3);
+        rc = check("pcg64 advance", words, &EXPECTED[3], 3 * sizeof(uint64_t)) && rc;
+    }
+
+    /*
+     * Philox4x32-10: the Random123 known answer vector for a zero key and
+     * a zero counter.
+     */
+    {
+        static const uint32_t EXPECTED[4] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8, };
+        uint32_t block[LANES * 4];
+
+        context.u.philox[0] = 0;
+        context.u.philox[1] = 0;
+        philox_eight(context.u.philox, 0, block);
+        rc = check("philox output", block, EXPECTED, sizeof(EXPECTED)) && rc;
+    }
+
+    /*
+     * ChaCha20: the RFC 7539 section 2.3.2 block function test vector, in
+     * which the thirty-two bit counter and ninety-six bit nonce occupy the
+     * same words as our sixty-four bit counter and sixty-four bit nonce.
+     */
+    {
+        static const uint32_t EXPECTED[16] = {
+            0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+            0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+            0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+            0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2,
+        };
+        uint32_t key[8];
+        uint32_t block[LANES * 16];
+        int ii;
+
+        for (ii = 0; ii < 8; ++ii) {
+            key[ii] = ((4 * ii) + 0) | (((4 * ii) + 1) << 8) | (((4 * ii) + 2) << 16) | (((uint32_t)(4 * ii) + 3) << 24);
+        }
+        chacha_eight(key, 0x0900000000000001ULL, 0x4a000000, 0x00000000, block);
+        rc = check("chacha20 output", block, EXPECTED, sizeof(EXPECTED)) && rc;
+    }
+
+    /*
+     * AES-128: the FIPS-197 appendix C.1 example vector.
+     */
+    if (aes_available()) {
+        static const uint8_t KEY[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, };
+        static const uint8_t PLAINTEXT[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, };
+        static const uint8_t EXPECTED[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a, };
+        uint8_t block[16];
+
+        aes_schedule(context.u.aes, KEY);
+        aes_one(context.u.aes, PLAINTEXT, block);
+        rc = check("aes128 output", block, EXPECTED, sizeof(EXPECTED)) && rc;
+    }
+
+    return rc;
+}
+
+/*******************************************************************************
+ * OUTPUT RING
+ ******************************************************************************/
+
+typedef struct Slot {
+    uint8_t * buffer;
+    uint64_t seq;
+    int full;
+} slot_t;
+
+static volatile int done = 0;
+static const generator_t * generator = (const generator_t *)0;
+static uint64_t seed = 1;
+static size_t block = 1024 * 1024;
+static int threads = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t emptied = PTHREAD_COND_INITIALIZER;
+static slot_t * ring = (slot_t *)0;
+static size_t slots = 0;
+static output_t * op = (output_t *)0;
+
+static void handler(int signum)
+{
+    done = !0;
+}
+
+/**
+ * Generator thread. Thread N of T generates blocks N, N+T, N+2T, and so on,
+ * each into the slot its sequence number selects.
+ */
+static void * body(void * arg)
+{
+    uint64_t seq = (uintptr_t)arg;
+    uint64_t units = block / generator->unit;
+    context_t context;
+    slot_t * sp;
+
+    (*generator->seed)(&context, seed);
+
+    while (!0) {
+
+        sp = &ring[seq % slots];
+
+        pthread_mutex_lock(&mutex);
+        while ((!done) && (sp->full || (sp->seq != seq))) {
+            pthread_cond_wait(&emptied, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (done) {
+            break;
+        }
+
+        (*generator->generate)(&context, seq * units, sp->buffer, units);
+
+        pthread_mutex_lock(&mutex);
+        sp->full = !0;
+        pthread_cond_broadcast(&filled);
+        pthread_mutex_unlock(&mutex);
+
+        seq += threads;
+
+    }
+
+    return (void *)0;
+}
+
+/**
+ * Write a buffer to standard output.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int emit(const uint8_t * buffer, size_t size)
+{
+    int rc;
+
+    rc = output_write(op, buffer, size);
+    if (rc < 0) {
+        perror("output_write");
+    }
+
+    return rc;
+}
+
+static void usage(void)
+{
+    int ii;
+
+    fprintf(stderr, "usage: %s [ -b BYTES ] [ -g GENERATOR ] [ -h ] [ -n BYTES ] [ -t THREADS ] [ -v ] [ -x ] [ SEED ]\n", program);
+    fprintf(stderr, "       -b BYTES        Generate this many bytes per block.\n");
+    fprintf(stderr, "       -g GENERATOR    Use this generator.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n BYTES        Stop after this many bytes.\n");
+    fprintf(stderr, "       -t THREADS      Generate blocks using this many threads.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -x              Run the known answer tests and exit.\n");
+    for (ii = 0; ii < (sizeof(GENERATORS) / sizeof(GENERATORS[0])); ++ii) {
+        fprintf(stderr, "       GENERATOR       %s%s\n", GENERATORS[ii].name, (*GENERATORS[ii].available)() ? "" : " (unavailable)");
+    }
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int test = 0;
+    uint64_t limit = ~(uint64_t)0;
+    uint64_t total = 0;
+    uint64_t seq = 0;
+    uint8_t * buffer = (uint8_t *)0;
+    size_t available = 0;
+    output_statistics_t statistics = { 0 };
+    pthread_t * pool = (pthread_t *)0;
+    int created = 0;
+    char * end = (char *)0;
+    struct sigaction action = { 0 };
+    size_t size;
+    int rc = 0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+    int ii;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    generator = &GENERATORS[0];
+
+    while ((opt = getopt(argc, argv, "b:g:hn:t:vx")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            block = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (block == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'g':
+            for (ii = 0; ii < (sizeof(GENERATORS) / sizeof(GENERATORS[0])); ++ii) {
+                if (strcmp(optarg, GENERATORS[ii].name) == 0) {
+                    generator = &GENERATORS[ii];
+                    break;
+                }
+            }
+            if (ii >= (sizeof(GENERATORS) / sizeof(GENERATORS[0]))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'n':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads < 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'x':
+            test = !0;
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    if ((!error) && (optind < argc)) {
+        seed = strtoull(argv[optind], &end, 0);
+        if (*end != '\0') {
+            errno = EINVAL;
+            perror(argv[optind]);
+            error = !0;
+        }
+    }
+
+    do {
+
+        if (error) {
+            break;
+        }
+
+        xoshiro_characteristic();
+
+        if (test) {
+            xc = kat() ? 0 : 1;
+            break;
+        }
+
+        if (!(*generator->available)()) {
+            errno = ENOSYS;
+            perror(generator->name);
+            break;
+        }
+
+        /*
+         * Every generator's unit divides sixty-four, so rounding the block up
+         * to a multiple of sixty-four keeps every block a whole number of
+         * units and every block boundary at the same place in the stream.
+         */
+
+        block = (block + 63) & ~(size_t)63;
+
+        if (verbose) {
+            fprintf(stderr, "%s: generator %s\n", program, generator->name);
+            fprintf(stderr, "%s: seed 0x%16.16lx\n", program, seed);
+            fprintf(stderr, "%s: block %zu bytes\n", program, block);
+            fprintf(stderr, "%s: threads %d\n", program, threads);
+        }
+
+        action.sa_handler = handler;
+        sigaction(SIGINT, &action, (struct sigaction *)0);
+        sigaction(SIGTERM, &action, (struct sigaction *)0);
+        signal(SIGPIPE, SIG_IGN);
+
+        /*
+         * An output chunk is one block, so that the serial mode can
+         * generate each block in place in the chunk it is written from.
+         */
+
+        op = output_open(STDOUT_FILENO, 0, block, &done);
+        if (op == (output_t *)0) {
+            perror("output_open");
+            break;
+        }
+
+        if (threads <= 0) {
+
+            context_t context;
+            uint64_t units = block / generator->unit;
+
+            (*generator->seed)(&context, seed);
+
+            while ((!done) && (total < limit)) {
+                buffer = (uint8_t *)output_buffer(op, &available);
+                (*generator->generate)(&context, seq * units, buffer, units);
+                size = ((limit - total) < block) ? (limit - total) : block;
+                rc = output_commit(op, size);
+                if (rc < 0) {
+                    perror("output_commit");
+                }
+                if (rc != 0) {
+                    break;
+                }
+                total += size;
+                ++seq;
+            }
+
+        } else {
+
+            slots = threads * 2;
+
+            ring = (slot_t *)calloc(slots, sizeof(slot_t));
+            if (ring == (slot_t *)0) {
+                perror("calloc");
+                break;
+            }
+
+            for (ii = 0; ii < slots; ++ii) {
+                ring[ii].seq = ii;
+                ring[ii].buffer = (uint8_t *)malloc(block);
+                if (ring[ii].buffer == (uint8_t *)0) {
+                    perror("malloc");
+                    break;
+                }
+            }
+            if (ii < slots) {
+                break;
+            }
+
+            pool = (pthread_t *)calloc(threads, sizeof(pthread_t));
+            if (pool == (pthread_t *)0) {
+                perror("calloc");
+                break;
+            }
+
+            for (created = 0; created < threads; ++created) {
+                rc = pthread_create(&pool[created], (pthread_attr_t *)0, body, (void *)(uintptr_t)created);
+                if (rc != 0) {
+                    errno = rc;
+                    perror("pthread_create");
+                    rc = -1;
+                    break;
+                }
+            }
+            if (created < threads) {
+                break;
+            }
+
+            while ((!done) && (total < limit)) {
+                slot_t * sp = &ring[seq % slots];
+                pthread_mutex_lock(&mutex);
+                while ((!done) && (!(sp->full && (sp->seq == seq)))) {
+                    pthread_cond_wait(&filled, &mutex);
+                }
+                pthread_mutex_unlock(&mutex);
+                if (done) {
+                    break;
+                }
+                size = ((limit - total) < block) ? (limit - total) : block;
+                rc = emit(sp->buffer, size);
+                if (rc != 0) {
+                    break;
+                }
+                total += size;
+                pthread_mutex_lock(&mutex);
+                sp->full = 0;
+                sp->seq = seq + slots;
+                pthread_cond_broadcast(&emptied);
+                pthread_mutex_unlock(&mutex);
+                ++seq;
+            }
+
+        }
+
+        if (rc == 0) {
+            rc = output_flush(op);
+            if (rc < 0) {
+                perror("output_flush");
+            }
+        }
+
+        xc = (rc < 0) ? 1 : 0;
+
+    } while (0);
+
+    if (pool != (pthread_t *)0) {
+        pthread_mutex_lock(&mutex);
+        done = !0;
+        pthread_cond_broadcast(&emptied);
+        pthread_mutex_unlock(&mutex);
+        for (ii = 0; ii < created; ++ii) {
+            pthread_join(pool[ii], (void **)0);
+        }
+        free(pool);
+    }
+
+    if (ring != (slot_t *)0) {
+        for (ii = 0; ii < slots; ++ii) {
+            free(ring[ii].buffer);
+        }
+        free(ring);
+    }
+
+    if (verbose && (op != (output_t *)0)) {
+        output_statistics(op, &statistics);
+        fprintf(stderr, "%s: pipe %zu bytes\n", program, statistics.pipesize);
+        fprintf(stderr, "%s: writes %lu\n", program, statistics.calls);
+        fprintf(stderr, "%s: splices %lu\n", program, statistics.splices);
+        fprintf(stderr, "%s: stalls %lu\n", program, statistics.stalls);
+        fprintf(stderr, "%s: stalled %lu nanoseconds\n", program, statistics.stalled);
+    }
+
+    output_close(op);
+
+    if (verbose) {
+        fprintf(stderr, "%s: total %lu bytes\n", program, total);
+    }
+
+    return xc;
+}
@@ -0,0 +1,87 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Tuning Profile<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The profile is read a line at a time and parsed with sscanf, so a lookup
+ * costs one pass over a file of a few lines, once when a program starts.
+ * If a source appears more than once the last line wins, so that a line
+ * appended by hand overrides one written by rngprobe. Malformed lines, and
+ * lines with a read size or thread count of zero, are skipped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "profile.h"
+
+int profile_lookup(const char * path, const char * source, profile_entry_t * ep)
+{
+    FILE * fp;
+    char line[512];
+    char name[PROFILE_SOURCE];
+    char * here;
+    unsigned long size;
+    int threads;
+    double rate;
+    int found = 0;
+
+    if (path == (const char *)0) {
+        path = PROFILE_PATH;
+    }
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != (char *)0) {
+
+        for (here = line; (*here == ' ') || (*here == '\t'); ++here) {
+            /* Do nothing. */
+        }
+        if ((*here == '#') || (*here == '\n') || (*here == '\0')) {
+            continue;
+        }
+
+        if (sscanf(here, "%127s %lu %d %lf", name, &size, &threads, &rate) != 4) {
+            continue;
+        }
+
+        if ((strcmp(name, source) != 0) || (size == 0) || (threads <= 0)) {
+            continue;
+        }
+
+        strncpy(ep->source, name, sizeof(ep->source));
+        ep->source[sizeof(ep->source) - 1] = '\0';
+        ep->size = size;
+        ep->threads = threads;
+        ep->rate = rate;
+        found = !0;
+
+    }
+
+    fclose(fp);
+
+    if (found) {
+        return 0;
+    }
+
+    errno = ENODATA;
+
+    return -1;
+}
+
+int profile_print(FILE * fp, const profile_entry_t * ep)
+{
+    return (fprintf(fp, "%s %zu %d %.0f\n", ep->source, ep->size, ep->threads, ep->rate) < 0) ? -1 : 0;
+}
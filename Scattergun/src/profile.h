@@ -0,0 +1,67 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_PROFILE_
+#define _H_COM_DIAG_SCATTERGUN_PROFILE_
+
+/**
+ * @file
+ * Tuning Profile<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * A per-host tuning profile, written by rngprobe and read by rate and
+ * quantistool, that records for each source found on the host the read
+ * size and number of threads that gave it the most throughput, and that
+ * throughput. It is a text file of one line per source, its name (a path
+ * like /dev/hwrng, rdrand, rdseed, or quantis:USB:0), read size in bytes,
+ * threads, and bytes per second, separated by white space; blank lines and
+ * lines beginning with a # are ignored, so that it can be edited by hand.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * This is where a profile is kept by default.
+ */
+#define PROFILE_PATH "/usr/local/etc/scattergun.profile"
+
+enum {
+    PROFILE_SOURCE = 128,       /* Longest source name including the NUL. */
+};
+
+/**
+ * This is the tuning of one source.
+ */
+typedef struct ProfileEntry {
+    char source[PROFILE_SOURCE];
+    size_t size;                /* Bytes per read or per instruction. */
+    int threads;                /* Concurrent readers. */
+    double rate;                /* Bytes per second measured. */
+} profile_entry_t;
+
+/**
+ * Find the tuning of a source in a profile.
+ * @param path is the path of the profile, or NULL for PROFILE_PATH.
+ * @param source is the name of the source.
+ * @param ep points to where the tuning is stored.
+ * @return 0 for success or <0 with errno set (ENODATA if the source is not
+ * in the profile).
+ */
+extern int profile_lookup(const char * path, const char * source, profile_entry_t * ep);
+
+/**
+ * Write the tuning of a source as a line of a profile.
+ * @param fp points to the open profile.
+ * @param ep points to the tuning.
+ * @return 0 for success or <0 for an error.
+ */
+extern int profile_print(FILE * fp, const profile_entry_t * ep);
+
+#endif
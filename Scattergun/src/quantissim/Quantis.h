@@ -0,0 +1,81 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_QUANTIS_
+#define _H_COM_DIAG_SCATTERGUN_QUANTIS_
+
+/**
+ * @file
+ * Quantis Simulator<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Declares the subset of the ID Quantique Quantis library API that
+ * quantistool uses, with the same names, types, and values, so that
+ * quantistool can be built against the simulator in quantissim.c instead of
+ * libQuantis.a just by putting this directory on the include path.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUANTIS_MAX_READ_SIZE (16 * 1024 * 1024)
+
+typedef enum {
+    QUANTIS_DEVICE_PCI = 1,
+    QUANTIS_DEVICE_USB = 2,
+} QuantisDeviceType;
+
+typedef enum {
+    QUANTIS_SUCCESS = 0,
+    QUANTIS_ERROR_NO_DRIVER = -1,
+    QUANTIS_ERROR_INVALID_DEVICE_NUMBER = -2,
+    QUANTIS_ERROR_INVALID_READ_SIZE = -3,
+    QUANTIS_ERROR_INVALID_PARAMETER = -4,
+    QUANTIS_ERROR_INSUFFICIENT_BUFFER = -5,
+    QUANTIS_ERROR_NO_MODULE = -10,
+    QUANTIS_ERROR_MODULE = -11,
+    QUANTIS_ERROR_NO_MEMORY = -20,
+    QUANTIS_ERROR_OPERATION_NOT_SUPPORTED = -98,
+    QUANTIS_ERROR_OTHER = -99,
+} QuantisError;
+
+typedef struct QuantisDeviceHandle QuantisDeviceHandle;
+
+extern int QuantisCount(QuantisDeviceType deviceType);
+
+extern float QuantisGetDriverVersion(QuantisDeviceType deviceType);
+
+extern int QuantisGetBoardVersion(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern char * QuantisGetSerialNumber(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern char * QuantisGetManufacturer(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern int QuantisGetModulesPower(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern int QuantisGetModulesMask(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern int QuantisGetModulesStatus(QuantisDeviceType deviceType, unsigned int deviceNumber);
+
+extern int QuantisOpen(QuantisDeviceType deviceType, unsigned int deviceNumber, QuantisDeviceHandle ** deviceHandle);
+
+extern void QuantisClose(QuantisDeviceHandle * deviceHandle);
+
+extern int QuantisReadHandled(QuantisDeviceHandle * deviceHandle, void * buffer, size_t size);
+
+extern char * QuantisStrError(QuantisError errorNumber);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
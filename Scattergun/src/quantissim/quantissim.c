@@ -0,0 +1,400 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Quantis Simulator<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ENVIRONMENT
+ *
+ * QUANTISSIM_USB=UNITS         Simulate this many USB units (default 1).
+ * QUANTISSIM_PCI=UNITS         Simulate this many PCI units (default 0).
+ * QUANTISSIM_RATE=BITS         Each unit delivers this many bits per second
+ *                              (default 4000000, 0 for unlimited).
+ * QUANTISSIM_LATENCY=MICROS    Each read takes this many microseconds of
+ *                              latency on average in addition to its transfer
+ *                              time (default 0).
+ * QUANTISSIM_DISTRIBUTION=NAME The latency is "fixed", "uniform" from zero to
+ *                              twice the mean, or "exponential" with the mean
+ *                              (default fixed).
+ * QUANTISSIM_ERRORS=PROBABILITY Each read fails with this probability
+ *                              (default 0.0).
+ * QUANTISSIM_BURST=READS       Each failure lasts this many consecutive reads
+ *                              (default 1); two or more forces quantistool
+ *                              to close and reopen the unit.
+ * QUANTISSIM_SEED=SEED         Seed the data, latency, and error generators
+ *                              (default 1).
+ *
+ * ABSTRACT
+ *
+ * Implements the subset of the ID Quantique Quantis library API declared in
+ * Quantis.h that quantistool uses, so that quantistool's read, reopen, and
+ * output pipeline can be built, benchmarked, and regression tested on any
+ * Linux system without libQuantis.a or a physical card. Each simulated unit
+ * has its own schedule: a read of N bytes completes no earlier than N * 8 /
+ * RATE seconds after the previous read on that unit completed, plus a latency
+ * drawn from the configured distribution, so throughput is limited the way a
+ * real card limits it no matter how many handles or threads read the unit.
+ * Each unit has its own xoshiro256** generator seeded from the seed, the bus,
+ * and the unit number, which decides the data, the latencies, and the
+ * failures, so a run is reproducible. The configuration is read from the
+ * environment the first time any function is called.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "Quantis.h"
+
+enum { UNITS = 16, };
+
+typedef struct Unit {
+    pthread_mutex_t mutex;
+    uint64_t state[4];
+    uint64_t ready;
+    unsigned int burst;
+    int opens;
+    char serial[32];
+} unit_t;
+
+struct QuantisDeviceHandle {
+    unit_t * unit;
+};
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static unsigned int usbs = 1;
+static unsigned int pcis = 0;
+static double rate = 4000000.0;
+static double latency = 0.0;
+static enum { FIXED, UNIFORM, EXPONENTIAL, } distribution = FIXED;
+static double errors = 0.0;
+static unsigned int burst = 1;
+static uint64_t seed = 1;
+
+static unit_t usb[UNITS];
+static unit_t pci[UNITS];
+
+static uint64_t splitmix64(uint64_t * xp)
+{
+    uint64_t z = (*xp += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t next(uint64_t * s)
+{
+    const uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+
+    return result;
+}
+
+/**
+ * Return a uniformly distributed double in [0.0, 1.0).
+ */
+static double uniform(uint64_t * s)
+{
+    return (next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static const char * environment(const char * name, const char * fallback)
+{
+    const char * value;
+
+    value = getenv(name);
+
+    return (value != (const char *)0) ? value : fallback;
+}
+
+static void initialize(void)
+{
+    const char * value;
+    uint64_t scratch;
+    unsigned int ii;
+    int jj;
+
+    usbs = strtoul(environment("QUANTISSIM_USB", "1"), (char **)0, 0);
+    pcis = strtoul(environment("QUANTISSIM_PCI", "0"), (char **)0, 0);
+    rate = strtod(environment("QUANTISSIM_RATE", "4000000"), (char **)0);
+    latency = strtod(environment("QUANTISSIM_LATENCY", "0"), (char **)0) * 1000.0;
+    errors = strtod(environment("QUANTISSIM_ERRORS", "0"), (char **)0);
+    burst = strtoul(environment("QUANTISSIM_BURST", "1"), (char **)0, 0);
+    seed = strtoull(environment("QUANTISSIM_SEED", "1"), (char **)0, 0);
+
+    value = environment("QUANTISSIM_DISTRIBUTION", "fixed");
+    if (strcmp(value, "uniform") == 0) {
+        distribution = UNIFORM;
+    } else if (strcmp(value, "exponential") == 0) {
+        distribution = EXPONENTIAL;
+    } else {
+        distribution = FIXED;
+    }
+
+    if (usbs > UNITS) { usbs = UNITS; }
+    if (pcis > UNITS) { pcis = UNITS; }
+    if (burst < 1) { burst = 1; }
+
+    for (ii = 0; ii < UNITS; ++ii) {
+        pthread_mutex_init(&usb[ii].mutex, (pthread_mutexattr_t *)0);
+        scratch = seed ^ ((uint64_t)QUANTIS_DEVICE_USB << 32) ^ ii;
+        for (jj = 0; jj < 4; ++jj) {
+            usb[ii].state[jj] = splitmix64(&scratch);
+        }
+        snprintf(usb[ii].serial, sizeof(usb[ii].serial), "SIMUSB%04u", ii);
+        pthread_mutex_init(&pci[ii].mutex, (pthread_mutexattr_t *)0);
+        scratch = seed ^ ((uint64_t)QUANTIS_DEVICE_PCI << 32) ^ ii;
+        for (jj = 0; jj < 4; ++jj) {
+            pci[ii].state[jj] = splitmix64(&scratch);
+        }
+        snprintf(pci[ii].serial, sizeof(pci[ii].serial), "SIMPCI%04u", ii);
+    }
+}
+
+static unit_t * lookup(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    pthread_once(&once, initialize);
+
+    if (deviceType == QUANTIS_DEVICE_USB) {
+        return (deviceNumber < usbs) ? &usb[deviceNumber] : (unit_t *)0;
+    } else if (deviceType == QUANTIS_DEVICE_PCI) {
+        return (deviceNumber < pcis) ? &pci[deviceNumber] : (unit_t *)0;
+    } else {
+        return (unit_t *)0;
+    }
+}
+
+int QuantisCount(QuantisDeviceType deviceType)
+{
+    pthread_once(&once, initialize);
+
+    if (deviceType == QUANTIS_DEVICE_USB) {
+        return usbs;
+    } else if (deviceType == QUANTIS_DEVICE_PCI) {
+        return pcis;
+    } else {
+        return QUANTIS_ERROR_INVALID_PARAMETER;
+    }
+}
+
+float QuantisGetDriverVersion(QuantisDeviceType deviceType)
+{
+    return (QuantisCount(deviceType) >= 0) ? 0.0f : (float)QUANTIS_ERROR_INVALID_PARAMETER;
+}
+
+int QuantisGetBoardVersion(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    return (lookup(deviceType, deviceNumber) != (unit_t *)0) ? 0 : QUANTIS_ERROR_INVALID_DEVICE_NUMBER;
+}
+
+char * QuantisGetSerialNumber(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    unit_t * up;
+
+    up = lookup(deviceType, deviceNumber);
+
+    return (up != (unit_t *)0) ? up->serial : "S/N not available";
+}
+
+char * QuantisGetManufacturer(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    return (lookup(deviceType, deviceNumber) != (unit_t *)0) ? "Scattergun Simulator" : "Not available";
+}
+
+int QuantisGetModulesPower(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    return (lookup(deviceType, deviceNumber) != (unit_t *)0) ? 1 : QUANTIS_ERROR_INVALID_DEVICE_NUMBER;
+}
+
+int QuantisGetModulesMask(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    return (lookup(deviceType, deviceNumber) != (unit_t *)0) ? 0x00000001 : QUANTIS_ERROR_INVALID_DEVICE_NUMBER;
+}
+
+int QuantisGetModulesStatus(QuantisDeviceType deviceType, unsigned int deviceNumber)
+{
+    return (lookup(deviceType, deviceNumber) != (unit_t *)0) ? 0x00000001 : QUANTIS_ERROR_INVALID_DEVICE_NUMBER;
+}
+
+int QuantisOpen(QuantisDeviceType deviceType, unsigned int deviceNumber, QuantisDeviceHandle ** deviceHandle)
+{
+    unit_t * up;
+    QuantisDeviceHandle * hp;
+
+    if (deviceHandle == (QuantisDeviceHandle **)0) {
+        return QUANTIS_ERROR_INVALID_PARAMETER;
+    }
+
+    up = lookup(deviceType, deviceNumber);
+    if (up == (unit_t *)0) {
+        return QUANTIS_ERROR_INVALID_DEVICE_NUMBER;
+    }
+
+    hp = (QuantisDeviceHandle *)malloc(sizeof(*hp));
+    if (hp == (QuantisDeviceHandle *)0) {
+        return QUANTIS_ERROR_NO_MEMORY;
+    }
+    hp->unit = up;
+
+    pthread_mutex_lock(&up->mutex);
+    ++up->opens;
+    pthread_mutex_unlock(&up->mutex);
+
+    *deviceHandle = hp;
+
+    return QUANTIS_SUCCESS;
+}
+
+void QuantisClose(QuantisDeviceHandle * deviceHandle)
+{
+    unit_t * up;
+
+    if (deviceHandle == (QuantisDeviceHandle *)0) {
+        return;
+    }
+
+    up = deviceHandle->unit;
+
+    pthread_mutex_lock(&up->mutex);
+    --up->opens;
+    /*
+     * Closing the last handle on a unit clears a failure in progress, as
+     * resetting a real device does.
+     */
+    if (up->opens == 0) {
+        up->burst = 0;
+    }
+    pthread_mutex_unlock(&up->mutex);
+
+    free(deviceHandle);
+}
+
+int QuantisReadHandled(QuantisDeviceHandle * deviceHandle, void * buffer, size_t size)
+{
+    unit_t * up;
+    uint8_t * bp = (uint8_t *)buffer;
+    uint64_t word;
+    uint64_t delay = 0;
+    uint64_t ready;
+    struct timespec ts;
+    int rc = (int)size;
+    size_t ii;
+
+    if ((deviceHandle == (QuantisDeviceHandle *)0) || (buffer == (void *)0)) {
+        return QUANTIS_ERROR_INVALID_PARAMETER;
+    }
+
+    if (size > QUANTIS_MAX_READ_SIZE) {
+        return QUANTIS_ERROR_INVALID_READ_SIZE;
+    }
+
+    up = deviceHandle->unit;
+
+    /*
+     * The unit's schedule, its generator, and its failure state are all
+     * decided under its mutex so that concurrent readers of the same unit
+     * share its bandwidth and see a reproducible sequence.
+     */
+
+    pthread_mutex_lock(&up->mutex);
+
+    if (up->burst > 0) {
+        --up->burst;
+        rc = QUANTIS_ERROR_OTHER;
+    } else if ((errors > 0.0) && (uniform(up->state) < errors)) {
+        up->burst = burst - 1;
+        rc = QUANTIS_ERROR_OTHER;
+    } else {
+        for (ii = 0; (ii + sizeof(word)) <= size; ii += sizeof(word)) {
+            word = next(up->state);
+            memcpy(bp + ii, &word, sizeof(word));
+        }
+        if (ii < size) {
+            word = next(up->state);
+            memcpy(bp + ii, &word, size - ii);
+        }
+    }
+
+    if (rate > 0.0) {
+        delay += (uint64_t)((size * 8.0 * 1000000000.0) / rate);
+    }
+
+    switch (distribution) {
+    case FIXED:
+        delay += (uint64_t)latency;
+        break;
+    case UNIFORM:
+        delay += (uint64_t)(2.0 * latency * uniform(up->state));
+        break;
+    case EXPONENTIAL:
+        delay += (uint64_t)(-latency * log(1.0 - uniform(up->state)));
+        break;
+    }
+
+    ready = now();
+    if (up->ready > ready) {
+        ready = up->ready;
+    }
+    ready += delay;
+    up->ready = ready;
+
+    pthread_mutex_unlock(&up->mutex);
+
+    ts.tv_sec = ready / 1000000000ULL;
+    ts.tv_nsec = ready % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, (struct timespec *)0) == EINTR) {
+        continue;
+    }
+
+    return rc;
+}
+
+char * QuantisStrError(QuantisError errorNumber)
+{
+    switch (errorNumber) {
+    case QUANTIS_SUCCESS:                       return "No error";
+    case QUANTIS_ERROR_NO_DRIVER:               return "No driver";
+    case QUANTIS_ERROR_INVALID_DEVICE_NUMBER:   return "Invalid device number";
+    case QUANTIS_ERROR_INVALID_READ_SIZE:       return "Invalid size to read";
+    case QUANTIS_ERROR_INVALID_PARAMETER:       return "Invalid parameter";
+    case QUANTIS_ERROR_INSUFFICIENT_BUFFER:     return "Insufficient buffer size";
+    case QUANTIS_ERROR_NO_MODULE:               return "No module";
+    case QUANTIS_ERROR_MODULE:                  return "Module error";
+    case QUANTIS_ERROR_NO_MEMORY:               return "No memory";
+    case QUANTIS_ERROR_OPERATION_NOT_SUPPORTED: return "Operation not supported";
+    case QUANTIS_ERROR_OTHER:                   return "Simulated transient error";
+    default:                                    return "Unknown error";
+    }
+}
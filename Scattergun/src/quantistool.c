@@ -12,7 +12,7 @@
  *
  * USAGE
  *
- * quantistool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o PATH ]
+ * quantistool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -a | -u UNIT ... | -p UNIT ... ] [ -m MODE ] [ -r BYTES | -F PROFILE ] [ -b BUFFERS ] [ -f POLICY ] [ -c ] [ -T RESTARTS [ -M SAMPLES ] [ -L PATH ] ] [ -o PATH ] [ -E PATH ] [ -P NAME ]
  *
  * EXAMPLES
  *
@@ -24,6 +24,12 @@
  * chmod 666 quantis.fifo
  * quantistool -D -i QUANTIS -U 0 -c -o quantis.fifo &
  *
+ * quantistool -v -a -m interleave -o quantis.fifo
+ *
+ * quantistool -v -u 0 -T 1000 -M 1000 -L latency.csv -o restart.dat
+ *
+ * quantistool -v -a -E quantis.trace -o quantis.fifo
+ *
  * ABSTRACT
  *
  * Continuously reads data from a Quantis hardware entropy generator,
@@ -40,6 +46,49 @@
  * device is 512 bytes. There doesn't seem to be any mechanism to just "read
  * what you got" so that we get all available random bits without possibly
  * blocking to wait for more or leaving some behind.
+ *
+ * Reading the device and writing the output are done by separate threads
+ * connected by a bounded ring of preallocated buffers, so that the device
+ * continues to be drained while the output is blocked on a slow reader of a
+ * FIFO (like rngd), and vice versa. When the ring is full, the reader either
+ * blocks until the writer empties a buffer or, if so configured, drops the
+ * oldest full buffer and reuses it, so that the device is never left
+ * undrained. The SIGHUP report includes the ring occupancy, the time each
+ * thread has spent stalled waiting for the other, and the number of buffers
+ * and bytes dropped.
+ *
+ * Several units, all of those detected or a list of them, may be read at
+ * once, each by its own reader thread into its own ring, so that adding
+ * cards adds throughput. The single writer either concatenates their
+ * buffers in the order in which they were filled, or interleaves them one
+ * buffer from each unit in turn, skipping units that are not open. A unit
+ * whose reads fail is closed and reopened once a second for as long as it
+ * keeps failing; a unit that cannot be opened at all the first time is
+ * dropped. The report includes the rate and the ring statistics of each
+ * unit.
+ *
+ * With -T, instead writes the restart matrix needed by SP800-90B section 3.1.4
+ * for the first unit: for each of RESTARTS rows, the unit is closed and
+ * reopened with QuantisOpen and the first SAMPLES eight-bit samples read after
+ * the restart are written, row after row, so that the output can be handed
+ * directly to the NIST ea_restart tool. No threads or rings are used, so that
+ * nothing read before a restart can end up after it. A row whose open or
+ * read fails is retried. The time taken by each restart and by the read of
+ * its row, in nanoseconds, can be written to a CSV file with -L, and their
+ * extremes and mean are reported in verbose mode.
+ *
+ * With -E, every open and read of every unit, and every write to and stall
+ * of the output, is recorded with its start, duration, and result in a
+ * binary trace file, so that tracereport can show whether a stall came from
+ * the device, the library, or the reader of the output.
+ *
+ * With -P, the statistics that a SIGHUP reports are also published, ten
+ * times a second, in a page of shared memory that rngmetrics can read at
+ * any time, and export for Prometheus, without disturbing the readers or
+ * the writer. Each unit's metrics are labelled with the unit.
+ *
+ * With -F, the read size is the one that rngprobe chose for the first of
+ * the units that the tuning profile has, unless -r gives one.
  */
 
 #include <stdlib.h>
@@ -52,9 +101,15 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <syslog.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "Quantis.h"
+#include "output.h"
+#include "trace.h"
+#include "metrics.h"
+#include "profile.h"
 
 static const QuantisDeviceType TYPES[] = { QUANTIS_DEVICE_PCI, QUANTIS_DEVICE_USB };
 static const char * NAMES[] = { "PCI", "USB" };
@@ -63,10 +118,92 @@ static const char * program = "quantistool";
 static const char * ident = "quantistool";
 static int debug = 0;
 static int verbose = 0;
-static int done = 0;
-static int report = 0;
+static volatile int done = 0;
+static volatile int report = 0;
 static int daemonize = 0;
 
+/**
+ * A buffer in the ring between a reader and the writer. A slot is always
+ * in exactly one of three places: the stack of empty slots, the queue of
+ * full slots, or in the hands of the reader or the writer. Each slot is
+ * stamped with the order in which it was filled across all units.
+ */
+typedef struct Slot {
+    unsigned char * buffer;
+    size_t length;
+    uint64_t seq;
+} slot_t;
+
+/**
+ * A Quantis unit, the ring into which its reader thread reads, and its
+ * statistics.
+ */
+typedef struct Unit {
+    QuantisDeviceType type;
+    unsigned int number;
+    pthread_t thread;
+    int started;
+    int present;
+    int up;
+    slot_t * ring;
+    size_t * queue;
+    size_t head;
+    size_t count;
+    size_t * stack;
+    size_t spares;
+    size_t opens;
+    size_t failures;
+    size_t reads;
+    size_t total;
+    size_t peak;
+    uint64_t occupied;
+    size_t enqueues;
+    size_t drops;
+    size_t dropped;
+    size_t rstalls;
+    uint64_t rstalled;
+    int metric;
+} unit_t;
+
+enum policy { BLOCK = 0, DROP = 1, };
+static const char * POLICIES[] = { "block", "drop", };
+
+enum mode { CONCATENATE = 0, INTERLEAVE = 1, };
+static const char * MODES[] = { "concatenate", "interleave", };
+
+enum { UNITS = 32, };
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t emptied = PTHREAD_COND_INITIALIZER;
+static unit_t units[UNITS];
+static int nunits = 0;
+static int running = 0;
+static size_t slots = 16;
+static size_t size = 512;
+static enum policy policy = BLOCK;
+static enum mode mode = CONCATENATE;
+static FILE * fp = (FILE *)0;
+static output_t * op = (output_t *)0;
+static output_statistics_t output = { 0 };
+static uint64_t seq = 0;
+static uint64_t started = 0;
+
+static size_t wstalls = 0;
+static uint64_t wstalled = 0;
+static size_t writes = 0;
+static size_t written = 0;
+
+/**
+ * These are the offsets of the metrics of each unit from the first, and
+ * of the metrics of the writer from the first.
+ */
+enum { UP = 0, OPENS, FAILURES, READS, BYTES, OCCUPANCY, DROPS, DROPPED, RSTALLS, RSTALLED, PERUNIT, };
+enum { WRITES = 0, WRITTEN, WSTALLS, WSTALLED, CALLS, SPLICES, PSTALLS, PSTALLED, PERWRITER, };
+
+static metrics_t * mp = (metrics_t *)0;
+static int metric = -1;
+
 /**
  * Emit a formatting string to either the system log or to standard error.
  * @param format is the printf format.
@@ -142,30 +279,609 @@ static void handler(int signum)
  */
 static void usage(int nomenu)
 {
-    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o PATH ]\n", program);
+    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -a | -u UNIT ... | -p UNIT ... ] [ -m MODE ] [ -r BYTES | -F PROFILE ] [ -b BUFFERS ] [ -f POLICY ] [ -c ] [ -T RESTARTS [ -M SAMPLES ] [ -L PATH ] ] [ -o PATH ] [ -E PATH ] [ -P NAME ]\n", program);
     if (nomenu) { return; }
     lprintf("       -d            Enable debug mode\n");
     lprintf("       -v            Enable verbose mode\n");
     lprintf("       -D            Run as a daemon\n");
     lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
-    lprintf("       -u UNIT       Use USB card UNIT\n");
-    lprintf("       -p UNIT       Use PCI card UNIT\n");
+    lprintf("       -a            Use every card detected\n");
+    lprintf("       -u UNIT       Use USB card UNIT (may be repeated)\n");
+    lprintf("       -p UNIT       Use PCI card UNIT (may be repeated)\n");
+    lprintf("       -m MODE       Output units \"concatenate\"d (default) or \"interleave\"d\n");
     lprintf("       -r BYTES      Read at most BYTES bytes at a time (0 to exit)\n");
+    lprintf("       -F PROFILE    Read the size that rngprobe chose at a time\n");
+    lprintf("       -b BUFFERS    Ring BUFFERS buffers between each reader and writer (default 16)\n");
+    lprintf("       -f POLICY     When the ring is full \"block\" (default) or \"drop\" oldest\n");
     lprintf("       -c            Check for the requested device\n");
+    lprintf("       -T RESTARTS   Write a restart matrix of RESTARTS rows and exit\n");
+    lprintf("       -M SAMPLES    Write SAMPLES samples per row (default 1000)\n");
+    lprintf("       -L PATH       Write the latency of each restart to PATH as CSV\n");
     lprintf("       -o PATH       Write to PATH (which may be a fifo) instead of stdout\n");
+    lprintf("       -E PATH       Trace the timing of every read and write to PATH\n");
+    lprintf("       -P NAME       Publish metrics in the shared memory page NAME\n");
     lprintf("       -h            Print help menu\n");
 }
 
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/**
+ * Wait on a condition for no more than a tenth of a second, so that the
+ * waiter notices when a signal handler sets the done flag.
+ * @param cp points to the condition.
+ */
+static void waitfor(pthread_cond_t * cp)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_nsec -= 1000000000;
+        ts.tv_sec += 1;
+    }
+
+    (void)pthread_cond_timedwait(cp, &mutex, &ts);
+}
+
+static const char * bus(QuantisDeviceType type)
+{
+    int ii;
+
+    for (ii = 0; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
+        if (TYPES[ii] == type) {
+            return NAMES[ii];
+        }
+    }
+
+    return "UNKNOWN";
+}
+
+/**
+ * Acquire an empty slot for a reader. If there are none, either block
+ * until the writer empties one, or drop the oldest full slot and reuse it,
+ * depending on the policy.
+ * @param up points to the unit.
+ * @return a slot, or NULL if we are done.
+ */
+static slot_t * acquire(unit_t * up)
+{
+    slot_t * sp = (slot_t *)0;
+    uint64_t then = 0;
+    size_t index;
+
+    pthread_mutex_lock(&mutex);
+
+    if ((!done) && (up->spares == 0) && (policy == BLOCK)) {
+        ++up->rstalls;
+        then = now();
+        while ((!done) && (up->spares == 0)) {
+            waitfor(&emptied);
+        }
+        up->rstalled += now() - then;
+    }
+
+    if (done) {
+        /* Do nothing. */
+    } else if (up->spares > 0) {
+        sp = &up->ring[up->stack[--up->spares]];
+    } else if (up->count > 0) {
+        index = up->queue[up->head];
+        up->head = (up->head + 1) % slots;
+        --up->count;
+        ++up->drops;
+        up->dropped += up->ring[index].length;
+        sp = &up->ring[index];
+    } else {
+        /* Do nothing. */
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return sp;
+}
+
+/**
+ * Return a slot acquired by a reader, either to the tail of the queue of
+ * full slots if it has been filled, or to the stack of empty slots if not.
+ * @param up points to the unit.
+ * @param sp points to the slot.
+ * @param full is true if the slot has been filled.
+ */
+static void release(unit_t * up, slot_t * sp, int full)
+{
+    pthread_mutex_lock(&mutex);
+
+    if (full) {
+        sp->seq = seq++;
+        up->queue[(up->head + up->count) % slots] = sp - up->ring;
+        ++up->count;
+        ++up->enqueues;
+        up->occupied += up->count;
+        if (up->count > up->peak) {
+            up->peak = up->count;
+        }
+        ++up->reads;
+        up->total += sp->length;
+        pthread_cond_signal(&filled);
+    } else {
+        up->stack[up->spares++] = sp - up->ring;
+    }
+
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Mark a unit as open or closed, which the writer needs to know to
+ * interleave.
+ * @param up points to the unit.
+ * @param state is true if the unit is open.
+ */
+static void mark(unit_t * up, int state)
+{
+    pthread_mutex_lock(&mutex);
+    up->up = state;
+    if (state) {
+        ++up->opens;
+    }
+    pthread_cond_signal(&filled);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Read a unit into its ring, reopening it if its reads fail, until we are
+ * done. If the read fails we try it again, since sometimes the libusb data
+ * transfer seems to hiccup for no obvious reason. If it fails the second
+ * time, we close the device and reopen it. As long as the open succeeds, we
+ * soldier on. If it has never been opened successfully, we give up on it.
+ * @param arg points to the unit.
+ * @return NULL.
+ */
+static void * reader(void * arg)
+{
+    unit_t * up = (unit_t *)arg;
+    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
+    struct timespec request = { 1, 0 };
+    slot_t * sp = (slot_t *)0;
+    uint64_t start = 0;
+    int rc = 0;
+
+    while (!done) {
+
+        handle = (QuantisDeviceHandle *)0;
+        start = trace_start();
+        rc = QuantisOpen(up->type, up->number, &handle);
+        trace_event(TRACE_OPEN, 0, rc, start);
+        if (rc < QUANTIS_SUCCESS) {
+            lprintf("%s: QuantisOpen(%d,%d,%p)=%d=\"%s\"\n", program, up->type, up->number, handle,  rc, QuantisStrError(rc));
+            if (up->opens == 0) {
+                break;
+            }
+            ++up->failures;
+            nanosleep(&request, (struct timespec *)0);
+            continue;
+        }
+        mark(up, !0);
+        lverbosef("%s: handle       %s:%u %p\n", program, bus(up->type), up->number, handle);
+
+        while (!done) {
+            sp = acquire(up);
+            if (sp == (slot_t *)0) {
+                break;
+            }
+            start = trace_start();
+            rc = QuantisReadHandled(handle, sp->buffer, size);
+            trace_event(TRACE_READ, size, rc, start);
+            if (rc < QUANTIS_SUCCESS) {
+                lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=1\n", program, handle, sp->buffer, size, rc, QuantisStrError(rc));
+                start = trace_start();
+                rc = QuantisReadHandled(handle, sp->buffer, size);
+                trace_event(TRACE_READ, size, rc, start);
+                if (rc < QUANTIS_SUCCESS) {
+                    lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=2\n", program, handle, sp->buffer, size, rc, QuantisStrError(rc));
+                }
+            }
+            if (rc < QUANTIS_SUCCESS) {
+                release(up, sp, 0);
+                break;
+            }
+            sp->length = size;
+            release(up, sp, !0);
+            if (debug) {
+                lprintf("%s: unit=%s:%u opens=%zu size=%zu reads=%zu total=%zu\n", program, bus(up->type), up->number, up->opens, size, up->reads, up->total);
+            }
+        }
+
+        mark(up, 0);
+        QuantisClose(handle);
+
+        if (!done) {
+            ++up->failures;
+        }
+
+    }
+
+    pthread_mutex_lock(&mutex);
+    --running;
+    pthread_cond_signal(&filled);
+    pthread_mutex_unlock(&mutex);
+
+    return (void *)0;
+}
+
+/**
+ * Choose the unit whose oldest full slot the writer should write next. In
+ * concatenate mode, this is the unit holding the slot filled earliest. In
+ * interleave mode, it is the next unit in turn that has a full slot; if the
+ * next open unit has none, nothing is chosen, so that the writer waits for
+ * it. The mutex must be held.
+ * @param nextp points to the index of the next unit in turn.
+ * @return the unit, or NULL if none.
+ */
+static unit_t * choose(int * nextp)
+{
+    unit_t * up = (unit_t *)0;
+    unit_t * cp;
+    int ii;
+
+    if (mode == CONCATENATE) {
+        for (ii = 0; ii < nunits; ++ii) {
+            cp = &units[ii];
+            if (cp->count == 0) {
+                continue;
+            }
+            if ((up == (unit_t *)0) || (cp->ring[cp->queue[cp->head]].seq < up->ring[up->queue[up->head]].seq)) {
+                up = cp;
+            }
+        }
+    } else {
+        for (ii = 0; ii < nunits; ++ii) {
+            cp = &units[(*nextp + ii) % nunits];
+            if (cp->count > 0) {
+                up = cp;
+                *nextp = ((cp - units) + 1) % nunits;
+                break;
+            }
+            if (cp->up && (!done)) {
+                break;
+            }
+        }
+    }
+
+    return up;
+}
+
+/**
+ * Write full slots until every reader has finished and every ring has been
+ * drained, or until the write fails.
+ * @param arg is unused.
+ * @return NULL.
+ */
+static void * writer(void * arg)
+{
+    unit_t * up;
+    slot_t * sp;
+    uint64_t then;
+    size_t index;
+    int rc;
+    int next = 0;
+
+    while (!0) {
+
+        pthread_mutex_lock(&mutex);
+        up = choose(&next);
+        if ((up == (unit_t *)0) && (running > 0)) {
+            ++wstalls;
+            then = now();
+            while ((up == (unit_t *)0) && (running > 0)) {
+                waitfor(&filled);
+                up = choose(&next);
+            }
+            wstalled += now() - then;
+        }
+        if (up == (unit_t *)0) {
+            up = choose(&next);
+        }
+        if (up == (unit_t *)0) {
+            done = !0;
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        index = up->queue[up->head];
+        up->head = (up->head + 1) % slots;
+        --up->count;
+        pthread_mutex_unlock(&mutex);
+
+        sp = &up->ring[index];
+        rc = output_write(op, sp->buffer, sp->length);
+
+        pthread_mutex_lock(&mutex);
+        up->stack[up->spares++] = index;
+        if (rc == 0) {
+            ++writes;
+            written += sp->length;
+        } else {
+            done = !0;
+        }
+        output_statistics(op, &output);
+        pthread_cond_broadcast(&emptied);
+        pthread_mutex_unlock(&mutex);
+
+        if (rc < 0) {
+            lerror("output_write");
+        }
+        if (rc != 0) {
+            break;
+        }
+
+    }
+
+    return (void *)0;
+}
+
+/**
+ * Emit the per unit reader and ring statistics and the writer statistics.
+ */
+static void statistics(void)
+{
+    double seconds;
+    unit_t * up;
+    int ii;
+
+    pthread_mutex_lock(&mutex);
+
+    seconds = (now() - started) / 1000000000.0;
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+
+    for (ii = 0; ii < nunits; ++ii) {
+        up = &units[ii];
+        lprintf("%s: unit=%s:%u up=%d opens=%zu failures=%zu size=%zu reads=%zu total=%zu bytes/second=%.0lf buffers=%zu occupancy=%zu peak=%zu mean=%.2lf drops=%zu dropped=%zu rstalls=%zu rstalled=%.6lf\n", program, bus(up->type), up->number, up->up, up->opens, up->failures, size, up->reads, up->total, up->total / seconds, slots, up->count, up->peak, (up->enqueues > 0) ? ((double)up->occupied / up->enqueues) : 0.0, up->drops, up->dropped, up->rstalls, up->rstalled / 1000000000.0);
+    }
+
+    lprintf("%s: units=%d mode=%s writes=%zu written=%zu bytes/second=%.0lf wstalls=%zu wstalled=%.6lf pipe=%zu splices=%lu pstalls=%lu pstalled=%.6lf\n", program, nunits, MODES[mode], writes, written, written / seconds, wstalls, wstalled / 1000000000.0, output.pipesize, output.splices, output.stalls, output.stalled / 1000000000.0);
+
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Create the metrics page and describe the metrics of every unit and of
+ * the writer. The metrics of each are defined consecutively, so only the
+ * index of the first need be remembered, and none of them are published if
+ * any of them could not be defined.
+ * @param name is the shared memory name of the page.
+ * @return 0 for success or <0 with errno set.
+ */
+static int describe(const char * name)
+{
+    char labels[64];
+    unit_t * up;
+    int failed;
+    int ii;
+
+    mp = metrics_create(name, program, 0644);
+    if (mp == (metrics_t *)0) {
+        return -1;
+    }
+
+    for (ii = 0; ii < nunits; ++ii) {
+        up = &units[ii];
+        snprintf(labels, sizeof(labels), "unit=\"%s:%u\"", bus(up->type), up->number);
+        failed = ((up->metric = metrics_define(mp, "unit_up", labels, "Whether the unit is open.", METRICS_GAUGE, 1)) < 0);
+        failed |= (metrics_define(mp, "unit_opens_total", labels, "Successful opens of the unit.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_failures_total", labels, "Failed opens and reads of the unit, each followed by a reopen.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_reads_total", labels, "Successful reads of the unit.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_bytes_total", labels, "Bytes read from the unit.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_ring_buffers", labels, "Full buffers in the ring of the unit.", METRICS_GAUGE, 1) < 0);
+        failed |= (metrics_define(mp, "unit_drops_total", labels, "Full buffers dropped because the ring was full.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_dropped_bytes_total", labels, "Bytes in the buffers dropped.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_stalls_total", labels, "Times the reader found the ring full.", METRICS_COUNTER, 1) < 0);
+        failed |= (metrics_define(mp, "unit_stall_seconds_total", labels, "Time the reader spent waiting for the writer.", METRICS_COUNTER, 1000000000ULL) < 0);
+        if (failed) {
+            up->metric = -1;
+            lerror("metrics_define");
+        }
+    }
+
+    failed = ((metric = metrics_define(mp, "writer_writes_total", (const char *)0, "Buffers written to the output.", METRICS_COUNTER, 1)) < 0);
+    failed |= (metrics_define(mp, "writer_bytes_total", (const char *)0, "Bytes written to the output.", METRICS_COUNTER, 1) < 0);
+    failed |= (metrics_define(mp, "writer_stalls_total", (const char *)0, "Times the writer found every ring empty.", METRICS_COUNTER, 1) < 0);
+    failed |= (metrics_define(mp, "writer_stall_seconds_total", (const char *)0, "Time the writer spent waiting for the readers.", METRICS_COUNTER, 1000000000ULL) < 0);
+    failed |= (metrics_define(mp, "output_calls_total", (const char *)0, "Successful writes and splices to the output.", METRICS_COUNTER, 1) < 0);
+    failed |= (metrics_define(mp, "output_splices_total", (const char *)0, "Of those, splices.", METRICS_COUNTER, 1) < 0);
+    failed |= (metrics_define(mp, "output_stalls_total", (const char *)0, "Times the output was full.", METRICS_COUNTER, 1) < 0);
+    failed |= (metrics_define(mp, "output_stall_seconds_total", (const char *)0, "Time spent waiting for the output to drain.", METRICS_COUNTER, 1000000000ULL) < 0);
+    if (failed) {
+        metric = -1;
+        lerror("metrics_define");
+    }
+
+    return 0;
+}
+
+/**
+ * Copy the statistics of every unit and of the writer to the metrics page.
+ * Readers of the page never take the mutex, so they never slow the readers
+ * or the writer.
+ */
+static void publish(void)
+{
+    unit_t * up;
+    int ii;
+
+    pthread_mutex_lock(&mutex);
+
+    for (ii = 0; ii < nunits; ++ii) {
+        up = &units[ii];
+        if (up->metric < 0) {
+            continue;
+        }
+        metrics_set(mp, up->metric + UP, up->up);
+        metrics_set(mp, up->metric + OPENS, up->opens);
+        metrics_set(mp, up->metric + FAILURES, up->failures);
+        metrics_set(mp, up->metric + READS, up->reads);
+        metrics_set(mp, up->metric + BYTES, up->total);
+        metrics_set(mp, up->metric + OCCUPANCY, up->count);
+        metrics_set(mp, up->metric + DROPS, up->drops);
+        metrics_set(mp, up->metric + DROPPED, up->dropped);
+        metrics_set(mp, up->metric + RSTALLS, up->rstalls);
+        metrics_set(mp, up->metric + RSTALLED, up->rstalled);
+    }
+
+    if (metric >= 0) {
+        metrics_set(mp, metric + WRITES, writes);
+        metrics_set(mp, metric + WRITTEN, written);
+        metrics_set(mp, metric + WSTALLS, wstalls);
+        metrics_set(mp, metric + WSTALLED, wstalled);
+        metrics_set(mp, metric + CALLS, output.calls);
+        metrics_set(mp, metric + SPLICES, output.splices);
+        metrics_set(mp, metric + PSTALLS, output.stalls);
+        metrics_set(mp, metric + PSTALLED, output.stalled);
+    }
+
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Write an SP800-90B restart matrix from a unit: close and reopen the unit,
+ * read a row of eight-bit samples, write the row, and repeat, recording how
+ * long each restart and each read took. A row whose restart or read fails is
+ * tried again, up to a limit of consecutive failures.
+ * @param up points to the unit.
+ * @param lp points to the latency CSV file or is NULL.
+ * @param restarts is the number of rows.
+ * @param samples is the number of samples in each row.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int matrix(unit_t * up, FILE * lp, size_t restarts, size_t samples)
+{
+    static const size_t CONSECUTIVE = 10;
+    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
+    unsigned char * row = (unsigned char *)0;
+    uint64_t then = 0;
+    uint64_t latency = 0;
+    uint64_t duration = 0;
+    uint64_t minimum = ~(uint64_t)0;
+    uint64_t maximum = 0;
+    uint64_t sum = 0;
+    size_t consecutive = 0;
+    size_t rows = 0;
+    int rc = 0;
+
+    row = (unsigned char *)malloc(samples);
+    if (row == (unsigned char *)0) {
+        lerror("malloc");
+        return -1;
+    }
+
+    if (lp != (FILE *)0) {
+        fprintf(lp, "Restart,Latency,Duration\n");
+    }
+
+    started = now();
+
+    while ((!done) && (rows < restarts)) {
+
+        if (consecutive >= CONSECUTIVE) {
+            errno = EIO;
+            lerror("restart");
+            rc = -1;
+            break;
+        }
+
+        then = now();
+        if (handle != (QuantisDeviceHandle *)0) {
+            QuantisClose(handle);
+            handle = (QuantisDeviceHandle *)0;
+        }
+        rc = QuantisOpen(up->type, up->number, &handle);
+        latency = now() - then;
+        if (rc < QUANTIS_SUCCESS) {
+            lprintf("%s: QuantisOpen(%d,%d,%p)=%d=\"%s\"\n", program, up->type, up->number, handle,  rc, QuantisStrError(rc));
+            handle = (QuantisDeviceHandle *)0;
+            ++up->failures;
+            ++consecutive;
+            rc = 0;
+            continue;
+        }
+        ++up->opens;
+
+        then = now();
+        rc = QuantisReadHandled(handle, row, samples);
+        duration = now() - then;
+        if (rc < QUANTIS_SUCCESS) {
+            lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\"\n", program, handle, row, samples, rc, QuantisStrError(rc));
+            ++up->failures;
+            ++consecutive;
+            rc = 0;
+            continue;
+        }
+        ++up->reads;
+        up->total += samples;
+        consecutive = 0;
+
+        rc = output_write(op, row, samples);
+        if (rc < 0) {
+            lerror("output_write");
+        }
+        if (rc != 0) {
+            break;
+        }
+
+        if (lp != (FILE *)0) {
+            fprintf(lp, "%zu,%lu,%lu\n", rows, latency, duration);
+        }
+
+        if (latency < minimum) {
+            minimum = latency;
+        }
+        if (latency > maximum) {
+            maximum = latency;
+        }
+        sum += latency;
+        ++rows;
+
+        if (debug) {
+            lprintf("%s: restart=%zu latency=%lu duration=%lu\n", program, rows, latency, duration);
+        }
+
+    }
+
+    if (handle != (QuantisDeviceHandle *)0) {
+        QuantisClose(handle);
+    }
+
+    lverbosef("%s: unit=%s:%u restarts=%zu samples=%zu failures=%zu elapsed=%lu\n", program, bus(up->type), up->number, rows, samples, up->failures, now() - started);
+    if (rows > 0) {
+        lverbosef("%s: latency minimum=%lu mean=%lu maximum=%lu\n", program, minimum, sum / rows, maximum);
+    }
+
+    free(row);
+
+    return rc;
+}
+
 /**
  * Query the Quantis API for the kinds of ID Quantique hardware it finds on
  * the PCI or the USB busses and its nature and emit the results to standard
- * error.
- * @return true if the requested device is available, false otherwise.
+ * error. If all is true, every unit found is added to the list of units;
+ * otherwise each unit in the list is marked present if it was found.
+ * @param all if true adds every unit found to the list.
+ * @return the number of units in the list that are present.
  */
-static int query(QuantisDeviceType want, int unit)
+static int query(int all)
 {
     int rc = 0;
     int ii;
+    int kk;
 
     lverbosef("%s: device       detecting\n", program);
 
@@ -195,6 +911,7 @@ static int query(QuantisDeviceType want, int unit)
             int power = 0;
             int mask = 0;
             int status = 0;
+            int present = 0;
 
             hardware = QuantisGetBoardVersion(type, jj);
             serial = QuantisGetSerialNumber(type, jj);
@@ -211,17 +928,28 @@ static int query(QuantisDeviceType want, int unit)
             lverbosef("%s: modules      0x%8.8x\n", program, mask);
             lverbosef("%s: status       0x%8.8x\n", program, status);
 
-            if (want != type) {
-                /* Do nothing. */
-            } else if (unit != jj) {
-                /* Do nothing. */
-            } else if (status == 0x00000000) {
+            if (status == 0x00000000) {
                 /* Do  nothing. */
+            } else if (!all) {
+                for (kk = 0; kk < nunits; ++kk) {
+                    if ((units[kk].type == type) && (units[kk].number == jj)) {
+                        units[kk].present = !0;
+                        present = !0;
+                        ++rc;
+                    }
+                }
+            } else if (nunits < UNITS) {
+                units[nunits].type = type;
+                units[nunits].number = jj;
+                units[nunits].present = !0;
+                ++nunits;
+                present = !0;
+                ++rc;
             } else {
-                rc = !0;
+                /* Do nothing. */
             }
 
-            lverbosef("%s: device       %s\n", program, rc ? "present" : "absent");
+            lverbosef("%s: device       %s\n", program, present ? "present" : "absent");
         }
     }
     
@@ -237,28 +965,31 @@ int main(int argc, char * argv[])
 {
     int xc = 1;
     int error = 0;
-    QuantisDeviceType type = QUANTIS_DEVICE_USB;
-    unsigned int unit = 0;
-    size_t size = 512;
-    size_t written = 0;
     char * end = (char *)0;
-    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
-    unsigned char * buffer = (unsigned char *)0;
+    pthread_t thread;
+    int writing = 0;
     int rc = 0;
-    FILE * fp = stdout;
-    uintptr_t offset = 0;
     struct sigaction sigpipe = { 0 };
     struct sigaction sighup = { 0 };
     struct sigaction sigint = { 0 };
-    size_t opens = 0;
-    size_t total = 0;
-    size_t reads = 0;
-    int try = 0;
+    struct timespec request = { 0, 100000000 };
     const char * path = (const char *)0;
     int opt;
     extern char * optarg;
+    size_t jj;
     int ii;
+    int all = 0;
     int check = 0;
+    size_t restarts = 0;
+    size_t samples = 1000;
+    const char * latencies = (const char *)0;
+    const char * trace = (const char *)0;
+    const char * name = (const char *)0;
+    const char * profile = (const char *)0;
+    profile_entry_t entry;
+    char source[PROFILE_SOURCE];
+    int sized = 0;
+    FILE * lp = (FILE *)0;
 
     /*
      * Crack open the command line argument vector.
@@ -266,7 +997,9 @@ int main(int argc, char * argv[])
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "dvDu:p:r:co:i:h")) >= 0) {
+    fp = stdout;
+
+    while ((opt = getopt(argc, argv, "dvDau:p:m:r:b:f:co:i:hT:M:L:E:P:F:")) >= 0) {
 
         switch (opt) {
 
@@ -282,14 +1015,39 @@ int main(int argc, char * argv[])
             daemonize = !0;
             break;
 
-        case 'u':
-            type = QUANTIS_DEVICE_USB;
-            unit = strtoul(optarg, &end, 0);
+        case 'a':
+            all = !0;
             break;
 
+        case 'u':
         case 'p':
-            type = QUANTIS_DEVICE_PCI;
-            unit = strtoul(optarg, &end, 0);
+            if (nunits >= UNITS) {
+                errno = E2BIG;
+                lerror(optarg);
+                error = !0;
+                break;
+            }
+            units[nunits].type = (opt == 'u') ? QUANTIS_DEVICE_USB : QUANTIS_DEVICE_PCI;
+            units[nunits].number = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+                break;
+            }
+            ++nunits;
+            break;
+
+        case 'm':
+            if (strcmp(optarg, MODES[CONCATENATE]) == 0) {
+                mode = CONCATENATE;
+            } else if (strcmp(optarg, MODES[INTERLEAVE]) == 0) {
+                mode = INTERLEAVE;
+            } else {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
             break;
 
         case 'c':
@@ -303,12 +1061,68 @@ int main(int argc, char * argv[])
                 lerror(optarg);
                 error = !0;
             }
+            sized = !0;
+            break;
+
+        case 'F':
+            profile = optarg;
+            break;
+
+        case 'b':
+            slots = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (slots < 3)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'f':
+            if (strcmp(optarg, POLICIES[BLOCK]) == 0) {
+                policy = BLOCK;
+            } else if (strcmp(optarg, POLICIES[DROP]) == 0) {
+                policy = DROP;
+            } else {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
             break;
 
         case 'o':
             path = optarg;
             break;
 
+        case 'T':
+            restarts = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (restarts == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'M':
+            samples = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (samples == 0) || (samples > QUANTIS_MAX_READ_SIZE)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'L':
+            latencies = optarg;
+            break;
+
+        case 'E':
+            trace = optarg;
+            break;
+
+        case 'P':
+            name = optarg;
+            break;
+
         case 'i':
             ident = optarg;
             break;
@@ -351,29 +1165,79 @@ int main(int argc, char * argv[])
             lverbosef("%s: pid          %d\n", program, getpid());
         }
 
-        for (ii = 0; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
-            if (TYPES[ii] == type) {
-                lverbosef("%s: type         %s\n", program, NAMES[ii]);
-            }
+        /*
+         * By default we use the first USB unit, as we always have.
+         */
+
+        if (all) {
+            nunits = 0;
+        } else if (nunits == 0) {
+            units[0].type = QUANTIS_DEVICE_USB;
+            units[0].number = 0;
+            nunits = 1;
+        } else {
+            /* Do nothing. */
+        }
+
+        for (ii = 0; ii < nunits; ++ii) {
+            lverbosef("%s: type         %s\n", program, bus(units[ii].type));
+            lverbosef("%s: unit         %d\n", program, units[ii].number);
         }
-        lverbosef("%s: unit         %d\n", program, unit);
         lverbosef("%s: bytes        %zu\n", program, size);
         lverbosef("%s: maximum      %zu\n", program, (size_t)QUANTIS_MAX_READ_SIZE);
+        lverbosef("%s: buffers      %zu\n", program, slots);
+        lverbosef("%s: policy       %s\n", program, POLICIES[policy]);
+        lverbosef("%s: mode         %s\n", program, MODES[mode]);
 
         /*
          * See what kind of hardware we have, and if it matches what
-         * the user requested.
+         * the user requested. When checking, units that are absent are
+         * dropped, and if none are left we exit.
          */
 
-        rc = query(type, unit);
-        if (rc) {
+        rc = query(all);
+        if (rc == nunits) {
             /* Do nothing. */
         } else if (!check) {
             /* Do nothing. */
         } else {
+            for (ii = 0, rc = 0; ii < nunits; ++ii) {
+                if (units[ii].present) {
+                    units[rc++] = units[ii];
+                }
+            }
+            nunits = rc;
+            if (nunits == 0) {
+                break;
+            }
+        }
+
+        if (nunits == 0) {
+            errno = ENODEV;
+            lerror("query");
             break;
         }
 
+        /*
+         * Take the read size from the tuning profile, from the entry of the
+         * first unit that it has, unless the user specified one.
+         */
+
+        if ((profile != (const char *)0) && !sized) {
+            for (ii = 0; ii < nunits; ++ii) {
+                snprintf(source, sizeof(source), "quantis:%s:%u", bus(units[ii].type), units[ii].number);
+                if (profile_lookup(profile, source, &entry) == 0) {
+                    break;
+                }
+            }
+            if (ii >= nunits) {
+                lerror(profile);
+                break;
+            }
+            size = entry.size;
+            lverbosef("%s: profile      \"%s\" %s %zu\n", program, profile, source, size);
+        }
+
         /*
          * If the user specifies a read size of zero, we just exit. This
          * allows them to use the verbose option to query the Quantis
@@ -390,8 +1254,63 @@ int main(int argc, char * argv[])
             /* Do nothing. */
         }
 
-        buffer = malloc(size);
-        if (buffer == (unsigned char *)0) {
+        /*
+         * Write the restart matrix instead of a continuous stream if
+         * requested. This needs no rings and no threads.
+         */
+
+        if (restarts > 0) {
+            lverbosef("%s: restarts     %zu\n", program, restarts);
+            lverbosef("%s: samples      %zu\n", program, samples);
+            if (path != (const char *)0) {
+                lverbosef("%s: path         \"%s\"\n", program, path);
+                fp = fopen(path, "w");
+                if (fp == (FILE *)0) {
+                    lerror(path);
+                    break;
+                }
+            }
+            if (latencies != (const char *)0) {
+                lverbosef("%s: latencies    \"%s\"\n", program, latencies);
+                lp = fopen(latencies, "w");
+                if (lp == (FILE *)0) {
+                    lerror(latencies);
+                    break;
+                }
+            }
+            op = output_open(fileno(fp), 0, 0, &done);
+            if (op == (output_t *)0) {
+                lerror("output_open");
+                break;
+            }
+            rc = matrix(&units[0], lp, restarts, samples);
+            xc = (rc < 0) ? 1 : 0;
+            break;
+        }
+
+        /*
+         * Preallocate the rings. Every slot starts out empty.
+         */
+
+        for (ii = 0; ii < nunits; ++ii) {
+            units[ii].ring = (slot_t *)calloc(slots, sizeof(slot_t));
+            units[ii].queue = (size_t *)calloc(slots, sizeof(size_t));
+            units[ii].stack = (size_t *)calloc(slots, sizeof(size_t));
+            if ((units[ii].ring == (slot_t *)0) || (units[ii].queue == (size_t *)0) || (units[ii].stack == (size_t *)0)) {
+                break;
+            }
+            for (jj = 0; jj < slots; ++jj) {
+                units[ii].ring[jj].buffer = (unsigned char *)malloc(size);
+                if (units[ii].ring[jj].buffer == (unsigned char *)0) {
+                    break;
+                }
+                units[ii].stack[units[ii].spares++] = jj;
+            }
+            if (jj < slots) {
+                break;
+            }
+        }
+        if (ii < nunits) {
             lerror("malloc");
             break;
         }
@@ -437,79 +1356,152 @@ int main(int argc, char * argv[])
             }
         }
 
+        op = output_open(fileno(fp), 0, 0, &done);
+        if (op == (output_t *)0) {
+            lerror("output_open");
+            break;
+        }
+
         /*
-         * Enter our work loop.
+         * Trace the readers and the writer if so configured.
          */
 
-        while (!done) {
-
-            rc = QuantisOpen(type, unit, &handle);
-            if (rc < QUANTIS_SUCCESS) {
-                lprintf("%s: QuantisOpen(%d,%d,%p)=%d=\"%s\"\n", program, type, unit, handle,  rc, QuantisStrError(rc));
+        if (trace != (const char *)0) {
+            lverbosef("%s: trace        \"%s\"\n", program, trace);
+            if (trace_open(trace, program) < 0) {
+                lerror(trace);
                 break;
             }
-            ++opens;
-            lverbosef("%s: handle       %p\n", program, handle);
+            output_observe(op, trace_output);
+        }
 
-            /*
-             * Enter our input/output loop. If the read fails we try it again,
-             * since sometimes the libusb data transfer seems to hiccup for no
-             * obvious reason. If it fails the second time, we close the device
-             * and reopen it. As long as the open succeeds, we soldier on.
-             */
+        /*
+         * Publish metrics if so configured.
+         */
 
-            while (!done) {
-                if (report) {
-                    lprintf("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
-                    report = 0;
-                }
-                rc = QuantisReadHandled(handle, buffer, size);
-                if (rc < QUANTIS_SUCCESS) {
-                    lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=1\n", program, handle, buffer, size, rc, QuantisStrError(rc));
-                    rc = QuantisReadHandled(handle, buffer, size);
-                    if (rc < QUANTIS_SUCCESS) {
-                        lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=2\n", program, handle, buffer, size, rc, QuantisStrError(rc));
-                        break;
-                    }
-                }
-                if (rc < QUANTIS_SUCCESS) {
-                    break;
-                }
-                ++reads;
-                total += size;
-                written = fwrite(buffer, size, 1, fp);
-                if (written < 1) {
-                    lerror("fwrite");
-                    break;
-                }
-                if (debug) {
-                    lprintf("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
-                }
+        if (name != (const char *)0) {
+            lverbosef("%s: metrics      \"%s\"\n", program, name);
+            if (describe(name) < 0) {
+                lerror(name);
+                break;
             }
+        }
 
-            if (handle != (QuantisDeviceHandle *)0) {
-                QuantisClose(handle);
+        /*
+         * Start a reader for every unit and the writer.
+         */
+
+        started = now();
+
+        for (ii = 0; ii < nunits; ++ii) {
+            pthread_mutex_lock(&mutex);
+            ++running;
+            pthread_mutex_unlock(&mutex);
+            rc = pthread_create(&units[ii].thread, (pthread_attr_t *)0, reader, &units[ii]);
+            if (rc != 0) {
+                pthread_mutex_lock(&mutex);
+                --running;
+                pthread_mutex_unlock(&mutex);
+                errno = rc;
+                lerror("pthread_create");
+                break;
             }
+            units[ii].started = !0;
+        }
+        if (ii < nunits) {
+            break;
+        }
 
+        rc = pthread_create(&thread, (pthread_attr_t *)0, writer, (void *)0);
+        if (rc != 0) {
+            errno = rc;
+            lerror("pthread_create");
+            break;
+        }
+        writing = !0;
+
+        /*
+         * Enter our work loop, which just reports until the readers or
+         * the writer are done.
+         */
+
+        while (!done) {
+            if (report) {
+                statistics();
+                report = 0;
+            }
+            if (mp != (metrics_t *)0) {
+                publish();
+            }
+            nanosleep(&request, (struct timespec *)0);
         }
 
         xc = 0;
 
     } while (0);
 
+    /*
+     * Let the readers finish and the writer drain the rings, and wait for
+     * them.
+     */
+
+    pthread_mutex_lock(&mutex);
+    done = !0;
+    pthread_cond_broadcast(&emptied);
+    pthread_cond_signal(&filled);
+    pthread_mutex_unlock(&mutex);
+
+    for (ii = 0; ii < nunits; ++ii) {
+        if (units[ii].started) {
+            pthread_join(units[ii].thread, (void **)0);
+        }
+    }
+
+    if (writing) {
+        pthread_join(thread, (void **)0);
+    }
+
     /*
      * Clean up after ourselves.
      */
 
+    if (op == (output_t *)0) {
+        /* Do nothing. */
+    } else if (output_flush(op) < 0) {
+        lerror("output_flush");
+        xc = 1;
+    } else {
+        output_statistics(op, &output);
+    }
+
+    output_close(op);
+
+    trace_close();
+
+    metrics_detach(mp);
+
     if (fp != (FILE *)0) {
         fclose(fp);
     }
 
-    if (buffer != (unsigned char *)0) {
-        free(buffer);
+    if (lp != (FILE *)0) {
+        fclose(lp);
+    }
+
+    if (verbose && (started > 0) && (restarts == 0)) {
+        statistics();
     }
 
-    lverbosef("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
+    for (ii = 0; ii < nunits; ++ii) {
+        if (units[ii].ring != (slot_t *)0) {
+            for (jj = 0; jj < slots; ++jj) {
+                free(units[ii].ring[jj].buffer);
+            }
+            free(units[ii].ring);
+        }
+        free(units[ii].queue);
+        free(units[ii].stack);
+    }
 
     return xc;
 }
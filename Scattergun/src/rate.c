@@ -12,12 +12,14 @@
  *
  * USAGE
  *
- * rate [ -h ] [ -c NANOSECONDS ] [ -v ] [ -f PATH ] [ -r BYTES ] [ -t BYTES ]
+ * rate [ -h ] [ -c NANOSECONDS ] [ -v ] [ -f PATH ] [ -r BYTES | -F PROFILE ] [ -t BYTES ] [ -E PATH ]
  *
  * OPTIONS
  *
  * -c NANOSECONDS  Display CSV output to stdout.
+ * -E PATH         Trace the timing of every read to this file.
  * -f PATH         Read from here instead of stdin.
+ * -F PROFILE      Read the size that rngprobe chose for PATH at a time.
  * -h              Display this menu.
  * -r BYTES        Read no more than this at a time.
  * -t BYTES        Read no more than this total.
@@ -27,11 +29,17 @@
  *
  * rate -f /dev/TrueRNGpro -r 4096 -t 1000000000
  *
+ * rate -f /dev/TrueRNGpro -E rate.trace && tracereport rate.trace
+ *
+ * rate -f /dev/TrueRNGpro -F /usr/local/etc/scattergun.profile
+ *
  * ABSTRACT
  *
  * Measures the sustained and peak rates of a data source. Optionally outputs
  * a comma separated value (CSV) file of performance metrics with the specified
- * period.
+ * period. Optionally records the start, duration, and result of every read
+ * in a binary trace file for tracereport. Optionally takes the read size from
+ * the tuning profile that rngprobe writes for the host, unless one is given.
  */
 
 #include <stdlib.h>
@@ -47,6 +55,8 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <float.h>
+#include "trace.h"
+#include "profile.h"
 
 static const char * program = "rate";
 
@@ -115,9 +125,11 @@ static int alarmable(void)
 
 static void usage(void)
 {
-    fprintf(stderr, "usage: %s [ -c NANOSECONDS ] [ -f PATH ] [ -h ] [ -r BYTES ] [ -t BYTES ] [ -v ] \n", program);
+    fprintf(stderr, "usage: %s [ -c NANOSECONDS ] [ -f PATH ] [ -h ] [ -r BYTES | -F PROFILE ] [ -t BYTES ] [ -v ] [ -E PATH ]\n", program);
     fprintf(stderr, "       -c NANOSECONDS  Display CSV output to stdout.\n");
+    fprintf(stderr, "       -E PATH         Trace the timing of every read to this file.\n");
     fprintf(stderr, "       -f PATH         Read from here instead of stdin.\n");
+    fprintf(stderr, "       -F PROFILE      Read the size that rngprobe chose for PATH at a time.\n");
     fprintf(stderr, "       -h              Display this menu.\n");
     fprintf(stderr, "       -r BYTES        Read no more than this at a time.\n");
     fprintf(stderr, "       -t BYTES        Read no more than this total.\n");
@@ -135,6 +147,10 @@ int main(int argc, char * argv[])
     int error = 0;
     size_t size = 4096;
     const char * path = (const char *)0;
+    const char * trace = (const char *)0;
+    const char * profile = (const char *)0;
+    profile_entry_t entry;
+    int sized = 0;
     int fd = STDIN_FILENO;
     uint8_t * buffer = (uint8_t *)0;
     size_t limit = ~0;
@@ -148,7 +164,7 @@ int main(int argc, char * argv[])
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "c:f:ht:r:v")) >= 0) {
+    while ((opt = getopt(argc, argv, "c:E:f:F:ht:r:v")) >= 0) {
 
         switch (opt) {
 
@@ -161,10 +177,18 @@ int main(int argc, char * argv[])
             }
             break;
 
+        case 'E':
+            trace = optarg;
+            break;
+
         case 'f':
             path = optarg;
             break;
 
+        case 'F':
+            profile = optarg;
+            break;
+
         case 'h':
             usage();
             break;
@@ -176,6 +200,7 @@ int main(int argc, char * argv[])
                 perror(optarg);
                 error = !0;
             }
+            sized = !0;
             break;
 
         case 't':
@@ -211,6 +236,7 @@ int main(int argc, char * argv[])
         uint64_t now = ~0;
         uint64_t elapsed = 0;
         uint64_t duration = 0;
+        uint64_t start = 0;
         ssize_t bytes = 0;
         size_t reads = 0;
         size_t interval = 0;
@@ -226,6 +252,19 @@ int main(int argc, char * argv[])
             break;
         }
 
+        if ((profile == (const char *)0) || sized) {
+            /* Do nothing. */
+        } else if (path == (const char *)0) {
+            errno = EINVAL;
+            perror(profile);
+            break;
+        } else if (profile_lookup(profile, path, &entry) < 0) {
+            perror(profile);
+            break;
+        } else {
+            size = entry.size;
+        }
+
         buffer = malloc(size);
         if (buffer == (unsigned char *)0) {
             perror("malloc");
@@ -244,6 +283,11 @@ int main(int argc, char * argv[])
             size = limit;
         }
 
+        if ((trace != (const char *)0) && (trace_open(trace, program) < 0)) {
+            perror(trace);
+            break;
+        }
+
         fprintf(stderr, "%s: %zu bytes limit\n", program, limit);
         fprintf(stderr, "%s: %zu bytes requested\n", program, size);
 
@@ -262,7 +306,13 @@ int main(int argc, char * argv[])
             if (remaining < size) {
                 xc = 0;
                 break;
-            } else if ((bytes = read(fd, buffer, size)) == 0) {
+            }
+
+            start = trace_start();
+            bytes = read(fd, buffer, size);
+            trace_event(TRACE_READ, size, (bytes < 0) ? -errno : bytes, start);
+
+            if (bytes == 0) {
                 xc = 0;
                 break;
             } else if (bytes < 0) {
@@ -316,10 +366,15 @@ int main(int argc, char * argv[])
                     current *= 8;
                     current *= 1000000;
                     current /= duration;
-                    interval = 0;
                     printf("%lu,%zu,%zu,%lf,%lf,%lf\n", elapsed, minimum, maximum, current, sustained, peak);
                 }
 
+                /*
+                 * The first alarm only starts the first interval, so the
+                 * bytes read before it must not be counted in it.
+                 */
+
+                interval = 0;
                 hence = now;
                 alarmed = 0;
 
@@ -331,6 +386,8 @@ int main(int argc, char * argv[])
             perror("close");
         }
 
+        trace_close();
+
         fprintf(stderr, "%s: %zu bytes total\n", program, total);
         fprintf(stderr, "%s: %lf milliseconds elapsed\n", program, elapsed / 1000000.0);
         fprintf(stderr, "%s: %zu reads\n", program, reads);
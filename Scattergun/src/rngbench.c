@@ -0,0 +1,707 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Bench<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngbench [ -h ] [ -v ] [ -i INTERFACE ... ] [ -s BYTES ] [ -S BYTES ] [ -m FACTOR ] [ -t THREADS ] [ -l NANOSECONDS ]
+ *
+ * OPTIONS
+ *
+ * -h              Display this menu.
+ * -i INTERFACE    Benchmark this interface (may be repeated, default all).
+ * -l NANOSECONDS  Run each cell of the matrix for this long (default 250000000).
+ * -m FACTOR       Multiply the request size by this for each step (default 4).
+ * -S BYTES        Use this maximum request size (default 1048576).
+ * -s BYTES        Use this minimum request size (default 1).
+ * -t THREADS      Use at most this many threads (default all cores).
+ * -v              Display verbose output to stderr.
+ *
+ * INTERFACES
+ *
+ * random          read(2) from /dev/random
+ * urandom         read(2) from /dev/urandom
+ * getrandom       getrandom(2) with no flags
+ * getrandom-r     getrandom(2) with GRND_RANDOM
+ * getrandom-n     getrandom(2) with GRND_NONBLOCK
+ * getrandom-rn    getrandom(2) with GRND_RANDOM and GRND_NONBLOCK
+ * vgetrandom      vDSO getrandom with no flags (Linux 6.11 and later)
+ * vgetrandom-n    vDSO getrandom with GRND_NONBLOCK (Linux 6.11 and later)
+ * sgrandom        sg_random() refilled with rdrand (or getrandom if none)
+ * sgrandom-s      sg_random() refilled with rdseed (or getrandom if none)
+ * sgrandom-g      sg_random() refilled with getrandom(2)
+ *
+ * EXAMPLES
+ *
+ * rngbench > $(hostname)-$(uname -r).csv
+ *
+ * rngbench -i getrandom -i vgetrandom -s 16 -S 4096 -m 2 -t 1
+ *
+ * rngbench -i getrandom -i sgrandom -i sgrandom-g -s 8 -S 256 -m 2 -t 1
+ *
+ * ABSTRACT
+ *
+ * Measures how the kernel random number generator scales by sweeping a
+ * matrix of interface, thread count, and request size. For each cell of
+ * the matrix, the specified number of threads each repeatedly request the
+ * specified number of bytes from the specified interface for a fixed
+ * duration, timing every call. The thread counts are the powers of two up
+ * to, and including, the maximum. Latencies are accumulated in per-thread
+ * log-linear histograms (sixteen sub-buckets per power of two, so that the
+ * percentiles are accurate to about six percent) that are merged when the
+ * cell completes. Each cell is emitted to standard output as one line of a
+ * comma separated value (CSV) file that begins with the host name and kernel
+ * release, so that the output of many hosts can be concatenated and compared.
+ * The throughput is in kilobits per second, as with rate, and the latencies
+ * are in nanoseconds. Calls that return EAGAIN (only possible with
+ * GRND_NONBLOCK) are counted but not timed. This supersedes the
+ * characterize.sh and consume.sh scripts. N.B. Before Linux 5.6, reading
+ * /dev/random or using GRND_RANDOM blocks when the entropy pool is depleted;
+ * such a cell will run for as long as it takes its last call to return.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+#include <sys/utsname.h>
+#include "vgetrandom.h"
+#include "sgrandom.h"
+
+static const char * program = "rngbench";
+
+enum kind { DEVICE, SYSCALL, VDSO, LIBRARY, };
+
+typedef struct Interface {
+    const char * name;
+    enum kind kind;
+    const char * path;
+    unsigned int flags;
+} interface_t;
+
+static const interface_t INTERFACES[] = {
+    { "random",         DEVICE,     "/dev/random",  0, },
+    { "urandom",        DEVICE,     "/dev/urandom", 0, },
+    { "getrandom",      SYSCALL,    (const char *)0, 0, },
+    { "getrandom-r",    SYSCALL,    (const char *)0, GRND_RANDOM, },
+    { "getrandom-n",    SYSCALL,    (const char *)0, GRND_NONBLOCK, },
+    { "getrandom-rn",   SYSCALL,    (const char *)0, GRND_RANDOM | GRND_NONBLOCK, },
+    { "vgetrandom",     VDSO,       (const char *)0, 0, },
+    { "vgetrandom-n",   VDSO,       (const char *)0, GRND_NONBLOCK, },
+    { "sgrandom",       LIBRARY,    (const char *)0, SG_RANDOM_RDRAND, },
+    { "sgrandom-s",     LIBRARY,    (const char *)0, SG_RANDOM_RDSEED, },
+    { "sgrandom-g",     LIBRARY,    (const char *)0, SG_RANDOM_GETRANDOM, },
+};
+
+enum {
+    COUNT = sizeof(INTERFACES) / sizeof(INTERFACES[0]),
+    SUBBITS = 4,
+    SUBBUCKETS = 1 << SUBBITS,
+    BUCKETS = 64 * SUBBUCKETS,
+};
+
+typedef struct Worker {
+    pthread_t thread;
+    const interface_t * interface;
+    size_t size;
+    uint8_t * buffer;
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t again;
+    uint64_t errors;
+    uint64_t minimum;
+    uint64_t maximum;
+    uint64_t histogram[BUCKETS];
+} worker_t;
+
+static pthread_barrier_t barrier;
+static volatile int stop = 0;
+
+static uint64_t watch(void)
+{
+    int rc;
+    uint64_t ticks = ~0;
+    struct timespec spec = { 0 };
+
+    rc = clock_gettime(CLOCK_MONOTONIC, &spec);
+    if (rc == 0) {
+        ticks = spec.tv_sec;
+        ticks *= 1000000000;
+        ticks += spec.tv_nsec;
+    } else {
+        perror("clock_gettime");
+    }
+
+    return ticks;
+}
+
+/**
+ * Map a latency in nanoseconds to a log-linear histogram bucket: the
+ * position of the most significant bit selects one of sixty-four octaves,
+ * and the next four bits select one of sixteen linear sub-buckets in that
+ * octave. Values less than sixteen map directly onto the first octave.
+ * @param ns is the latency in nanoseconds.
+ * @return the bucket index.
+ */
+static unsigned int bucket(uint64_t ns)
+{
+    unsigned int octave;
+
+    if (ns < SUBBUCKETS) {
+        return ns;
+    }
+
+    octave = 63 - __builtin_clzll(ns);
+
+    return ((octave - SUBBITS + 1) * SUBBUCKETS) + ((ns >> (octave - SUBBITS)) & (SUBBUCKETS - 1));
+}
+
+/**
+ * Map a histogram bucket back to the midpoint of the latencies it counts.
+ * @param index is the bucket index.
+ * @return the latency in nanoseconds.
+ */
+static uint64_t unbucket(unsigned int index)
+{
+    unsigned int octave;
+    uint64_t low;
+
+    if (index < SUBBUCKETS) {
+        return index;
+    }
+
+    octave = (index / SUBBUCKETS) + SUBBITS - 1;
+    low = ((uint64_t)(SUBBUCKETS + (index % SUBBUCKETS))) << (octave - SUBBITS);
+
+    return low + ((1ULL << (octave - SUBBITS)) / 2);
+}
+
+/**
+ * Estimate a percentile from a histogram. Because a bucket is represented
+ * by its midpoint, the estimate is clamped to the observed extremes.
+ * @param histogram is the histogram.
+ * @param count is the number of values counted in the histogram.
+ * @param fraction is the percentile as a fraction, e.g. 0.99.
+ * @param minimum is the smallest value counted.
+ * @param maximum is the largest value counted.
+ * @return the estimated percentile.
+ */
+static uint64_t percentile(const uint64_t * histogram, uint64_t count, double fraction, uint64_t minimum, uint64_t maximum)
+{
+    uint64_t value;
+    uint64_t rank;
+    uint64_t sum = 0;
+    unsigned int ii;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    rank = (uint64_t)(fraction * count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+
+    for (ii = 0; ii < BUCKETS; ++ii) {
+        sum += histogram[ii];
+        if (sum > rank) {
+            break;
+        }
+    }
+
+    value = unbucket(ii);
+    if (value < minimum) {
+        value = minimum;
+    }
+    if (value > maximum) {
+        value = maximum;
+    }
+
+    return value;
+}
+
+static void * body(void * arg)
+{
+    worker_t * wp = (worker_t *)arg;
+    const interface_t * ip = wp->interface;
+    int fd = -1;
+    void * state = (void *)0;
+    ssize_t rc = 0;
+    uint64_t before;
+    uint64_t after;
+    uint64_t latency;
+
+    wp->minimum = ~(uint64_t)0;
+
+    if (ip->kind == DEVICE) {
+        fd = open(ip->path, O_RDONLY);
+        if (fd < 0) {
+            perror(ip->path);
+            ++wp->errors;
+        }
+    } else if (ip->kind == VDSO) {
+        state = vgetrandom_allocate();
+    } else {
+        /* Do nothing. */
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    while (!stop) {
+
+        if ((ip->kind == DEVICE) && (fd < 0)) {
+            break;
+        }
+
+        before = watch();
+        if (ip->kind == DEVICE) {
+            rc = read(fd, wp->buffer, wp->size);
+        } else if (ip->kind == SYSCALL) {
+            rc = getrandom(wp->buffer, wp->size, ip->flags);
+        } else if (ip->kind == LIBRARY) {
+            rc = sg_random(wp->buffer, wp->size);
+        } else {
+            rc = vgetrandom(state, wp->buffer, wp->size, ip->flags);
+        }
+        after = watch();
+
+        if (rc >= 0) {
+            latency = after - before;
+            ++wp->calls;
+            wp->bytes += rc;
+            wp->histogram[bucket(latency)] += 1;
+            if (latency < wp->minimum) {
+                wp->minimum = latency;
+            }
+            if (latency > wp->maximum) {
+                wp->maximum = latency;
+            }
+        } else if (errno == EAGAIN) {
+            ++wp->again;
+        } else if (errno == EINTR) {
+            /* Do nothing. */
+        } else {
+            perror(ip->name);
+            ++wp->errors;
+            break;
+        }
+
+    }
+
+    vgetrandom_free(state);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return (void *)0;
+}
+
+/**
+ * Run one cell of the matrix and emit its CSV line.
+ * @return 0 for success, <0 for failure.
+ */
+static int cell(const char * host, const char * kernel, const interface_t * ip, int threads, size_t size, uint64_t duration, worker_t * workers, int verbose)
+{
+    static uint64_t histogram[BUCKETS];
+    int result = -1;
+    int created = 0;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t again = 0;
+    uint64_t errors = 0;
+    uint64_t minimum = ~(uint64_t)0;
+    uint64_t maximum = 0;
+    uint64_t epoch;
+    uint64_t elapsed;
+    struct timespec spec = { 0 };
+    double throughput;
+    int rc;
+    int ii;
+    int jj;
+
+    memset(histogram, 0, sizeof(histogram));
+
+    do {
+
+        rc = pthread_barrier_init(&barrier, (pthread_barrierattr_t *)0, threads + 1);
+        if (rc != 0) {
+            errno = rc;
+            perror("pthread_barrier_init");
+            break;
+        }
+
+        stop = 0;
+
+        if (ip->kind == LIBRARY) {
+            (void)sg_random_select(ip->flags);
+        }
+
+        for (ii = 0; ii < threads; ++ii) {
+            uint8_t * buffer = workers[ii].buffer;
+            memset(&workers[ii], 0, sizeof(workers[ii]));
+            workers[ii].buffer = buffer;
+            workers[ii].interface = ip;
+            workers[ii].size = size;
+            rc = pthread_create(&workers[ii].thread, (pthread_attr_t *)0, body, &workers[ii]);
+            if (rc != 0) {
+                errno = rc;
+                perror("pthread_create");
+                break;
+            }
+            ++created;
+        }
+
+        if (created < threads) {
+            /*
+             * The barrier can never be satisfied, so there is no orderly way
+             * to recover the threads that were created.
+             */
+            exit(1);
+        }
+
+        pthread_barrier_wait(&barrier);
+        epoch = watch();
+
+        spec.tv_sec = duration / 1000000000;
+        spec.tv_nsec = duration % 1000000000;
+        while (nanosleep(&spec, &spec) < 0) {
+            if (errno != EINTR) {
+                perror("nanosleep");
+                break;
+            }
+        }
+
+        __atomic_store_n(&stop, !0, __ATOMIC_RELEASE);
+
+        for (ii = 0; ii < threads; ++ii) {
+            pthread_join(workers[ii].thread, (void **)0);
+        }
+
+        elapsed = watch() - epoch;
+
+        pthread_barrier_destroy(&barrier);
+
+        for (ii = 0; ii < threads; ++ii) {
+            calls += workers[ii].calls;
+            bytes += workers[ii].bytes;
+            again += workers[ii].again;
+            errors += workers[ii].errors;
+            if (workers[ii].minimum < minimum) {
+                minimum = workers[ii].minimum;
+            }
+            if (workers[ii].maximum > maximum) {
+                maximum = workers[ii].maximum;
+            }
+            for (jj = 0; jj < BUCKETS; ++jj) {
+                histogram[jj] += workers[ii].histogram[jj];
+            }
+        }
+
+        if (calls == 0) {
+            minimum = 0;
+        }
+
+        throughput = bytes;
+        throughput *= 8;
+        throughput *= 1000000;
+        throughput /= elapsed;
+
+        printf("%s,%s,%s,%d,%zu,%lu,%lu,%lu,%lu,%lu,%lf,%lu,%lu,%lu,%lu,%lu,%lu\n",
+            host, kernel, ip->name, threads, size,
+            calls, bytes, again, errors, elapsed, throughput,
+            minimum,
+            percentile(histogram, calls, 0.50, minimum, maximum),
+            percentile(histogram, calls, 0.90, minimum, maximum),
+            percentile(histogram, calls, 0.99, minimum, maximum),
+            percentile(histogram, calls, 0.999, minimum, maximum),
+            maximum);
+        fflush(stdout);
+
+        if (verbose) {
+            fprintf(stderr, "%s: %s threads=%d size=%zu calls=%lu kbps=%lf\n", program, ip->name, threads, size, calls, throughput);
+        }
+
+        result = (errors > 0) ? -1 : 0;
+
+    } while (0);
+
+    return result;
+}
+
+static void usage(void)
+{
+    int ii;
+
+    fprintf(stderr, "usage: %s [ -h ] [ -i INTERFACE ... ] [ -l NANOSECONDS ] [ -m FACTOR ] [ -S BYTES ] [ -s BYTES ] [ -t THREADS ] [ -v ]\n", program);
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -i INTERFACE    Benchmark this interface.\n");
+    fprintf(stderr, "       -l NANOSECONDS  Run each cell for this long.\n");
+    fprintf(stderr, "       -m FACTOR       Multiply the request size by this each step.\n");
+    fprintf(stderr, "       -S BYTES        Use this maximum request size.\n");
+    fprintf(stderr, "       -s BYTES        Use this minimum request size.\n");
+    fprintf(stderr, "       -t THREADS      Use at most this many threads.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    for (ii = 0; ii < COUNT; ++ii) {
+        fprintf(stderr, "       INTERFACE       %s\n", INTERFACES[ii].name);
+    }
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int selected[COUNT] = { 0 };
+    int any = 0;
+    size_t smallest = 1;
+    size_t largest = 1024 * 1024;
+    size_t factor = 4;
+    long cores = 1;
+    long maximum = 0;
+    uint64_t duration = 250000000;
+    worker_t * workers = (worker_t *)0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    int ii;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "hi:l:m:S:s:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'i':
+            for (ii = 0; ii < COUNT; ++ii) {
+                if (strcmp(optarg, INTERFACES[ii].name) == 0) {
+                    selected[ii] = !0;
+                    any = !0;
+                    break;
+                }
+            }
+            if (ii >= COUNT) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'l':
+            duration = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (duration == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            factor = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (factor < 2)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'S':
+            largest = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (largest == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            smallest = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (smallest == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            maximum = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (maximum <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+        struct utsname uts = { 0 };
+        size_t size;
+        int threads;
+        int failures = 0;
+
+        if (error) {
+            break;
+        }
+
+        if (smallest > largest) {
+            errno = EINVAL;
+            perror("-s");
+            break;
+        }
+
+        if (uname(&uts) < 0) {
+            perror("uname");
+            break;
+        }
+
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cores <= 0) {
+            cores = 1;
+        }
+        if (maximum <= 0) {
+            maximum = cores;
+        }
+
+        if (!any) {
+            for (ii = 0; ii < COUNT; ++ii) {
+                selected[ii] = !0;
+            }
+        }
+
+        if (!vgetrandom_available()) {
+            for (ii = 0; ii < COUNT; ++ii) {
+                if (INTERFACES[ii].kind != VDSO) {
+                    /* Do nothing. */
+                } else if (!selected[ii]) {
+                    /* Do nothing. */
+                } else {
+                    fprintf(stderr, "%s: %s unavailable (using getrandom(2) instead)\n", program, INTERFACES[ii].name);
+                }
+            }
+        }
+
+        for (ii = 0; ii < COUNT; ++ii) {
+            if (INTERFACES[ii].kind != LIBRARY) {
+                /* Do nothing. */
+            } else if (!selected[ii]) {
+                /* Do nothing. */
+            } else if (sg_random_select(INTERFACES[ii].flags) == INTERFACES[ii].flags) {
+                /* Do nothing. */
+            } else {
+                fprintf(stderr, "%s: %s unavailable (using getrandom(2) instead)\n", program, INTERFACES[ii].name);
+            }
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: host %s\n", program, uts.nodename);
+            fprintf(stderr, "%s: kernel %s\n", program, uts.release);
+            fprintf(stderr, "%s: %ld cores\n", program, cores);
+            fprintf(stderr, "%s: %ld threads maximum\n", program, maximum);
+            fprintf(stderr, "%s: %zu..%zu bytes by %zu\n", program, smallest, largest, factor);
+            fprintf(stderr, "%s: %lu nanoseconds per cell\n", program, duration);
+            fprintf(stderr, "%s: vgetrandom %savailable\n", program, vgetrandom_available() ? "" : "un");
+        }
+
+        workers = (worker_t *)calloc(maximum, sizeof(worker_t));
+        if (workers == (worker_t *)0) {
+            perror("calloc");
+            break;
+        }
+
+        for (ii = 0; ii < maximum; ++ii) {
+            workers[ii].buffer = (uint8_t *)malloc(largest);
+            if (workers[ii].buffer == (uint8_t *)0) {
+                perror("malloc");
+                break;
+            }
+        }
+        if (ii < maximum) {
+            break;
+        }
+
+        printf("%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
+            "Host", "Kernel", "Interface", "Threads", "Size",
+            "Calls", "Bytes", "Again", "Errors", "Elapsed", "Throughput",
+            "Minimum", "P50", "P90", "P99", "P999", "Maximum");
+
+        for (ii = 0; ii < COUNT; ++ii) {
+            if (!selected[ii]) {
+                continue;
+            }
+            threads = 1;
+            while (!0) {
+                for (size = smallest; size <= largest; size *= factor) {
+                    if (cell(uts.nodename, uts.release, &INTERFACES[ii], threads, size, duration, workers, verbose) < 0) {
+                        ++failures;
+                    }
+                    if (size > (largest / factor)) {
+                        break;
+                    }
+                }
+                if (threads >= maximum) {
+                    break;
+                }
+                threads *= 2;
+                if (threads > maximum) {
+                    threads = maximum;
+                }
+            }
+        }
+
+        xc = (failures > 0) ? 2 : 0;
+
+    } while (0);
+
+    if (workers != (worker_t *)0) {
+        for (ii = 0; ii < maximum; ++ii) {
+            free(workers[ii].buffer);
+        }
+        free(workers);
+    }
+
+    return xc;
+}
@@ -0,0 +1,350 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Metrics Exporter<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngmetrics [ -h ] [ -o PATH ] [ -p SECONDS ] NAME [ NAME ... ]
+ *
+ * OPTIONS
+ *
+ * -h               Display this menu.
+ * -o PATH          Replace this file atomically instead of writing to stdout.
+ * -p SECONDS       Export every this many seconds (default once).
+ *
+ * EXAMPLES
+ *
+ * seventool -R -P /seventool -o /var/run/rdrand.fifo &
+ * rngmetrics /seventool
+ *
+ * rngmetrics -p 15 -o /var/lib/node_exporter/scattergun.prom /seventool /quantistool
+ *
+ * ABSTRACT
+ *
+ * Reads the shared memory metrics pages published with the -P option of
+ * seventool or quantistool and writes them in the Prometheus text format,
+ * once to standard output, or periodically to a file for the textfile
+ * collector of the node exporter. The file is written under a temporary
+ * name and renamed, so the collector never sees it half written. Every
+ * sample is labelled with the page and the program that published it, and
+ * each page has a scattergun_up gauge that is zero if its producer is not
+ * running, in which case the page is attached again when it reappears.
+ * When exporting periodically, the rate of every counter over the last
+ * period is exported too, as a gauge whose name ends in _per_second instead
+ * of _total. Reading the pages never blocks the programs that publish them.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "metrics.h"
+
+static const char * program = "rngmetrics";
+static volatile int done = 0;
+
+/**
+ * A page being exported and the values of its counters at the last export.
+ */
+typedef struct Page {
+    const char * name;
+    metrics_t * mp;
+    uint64_t then;
+    uint64_t previous[METRICS_MAXIMUM];
+} page_t;
+
+/**
+ * One sample, collected so that the samples of each metric, from every
+ * page, can be written together as the text format requires.
+ */
+typedef struct Sample {
+    char name[64];
+    const char * help;
+    const char * type;
+    char labels[160];
+    double value;
+    size_t order;
+} sample_t;
+
+static void handler(int signum)
+{
+    done = !0;
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -o PATH ] [ -p SECONDS ] NAME [ NAME ... ]\n", program);
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -o PATH          Replace this file atomically instead of writing to stdout.\n");
+    fprintf(stderr, "       -p SECONDS       Export every this many seconds.\n");
+}
+
+static int byname(const void * one, const void * two)
+{
+    const sample_t * a = (const sample_t *)one;
+    const sample_t * b = (const sample_t *)two;
+    int rc;
+
+    rc = strcmp(a->name, b->name);
+    if (rc == 0) {
+        rc = (a->order < b->order) ? -1 : (a->order > b->order) ? 1 : 0;
+    }
+
+    return rc;
+}
+
+/**
+ * Collect the samples of one page, attaching to it if necessary.
+ * @return the number of samples collected.
+ */
+static size_t collect(page_t * pp, sample_t * samples, size_t order, uint64_t when)
+{
+    const metrics_descriptor_t * dp;
+    const char * producer = "";
+    sample_t * sp = samples;
+    pid_t pid = 0;
+    uint64_t value;
+    size_t length;
+    int count;
+    int ii;
+
+    if (pp->mp == (metrics_t *)0) {
+        pp->mp = metrics_attach(pp->name);
+        pp->then = 0;
+    }
+
+    if (pp->mp != (metrics_t *)0) {
+        pid = metrics_producer(pp->mp, &producer);
+    }
+
+    snprintf(sp->name, sizeof(sp->name), "scattergun_up");
+    sp->help = "Whether the program publishing the metrics page is running.";
+    sp->type = "gauge";
+    snprintf(sp->labels, sizeof(sp->labels), "page=\"%s\",program=\"%.32s\"", pp->name, producer);
+    sp->value = (pid != 0) ? 1.0 : 0.0;
+    sp->order = order++;
+    ++sp;
+
+    if (pid == 0) {
+        metrics_detach(pp->mp);
+        pp->mp = (metrics_t *)0;
+        return sp - samples;
+    }
+
+    count = metrics_count(pp->mp);
+
+    for (ii = 0; ii < count; ++ii) {
+
+        dp = metrics_describe(pp->mp, ii);
+        value = metrics_get(pp->mp, ii);
+
+        snprintf(sp->name, sizeof(sp->name), "scattergun_%.48s", dp->name);
+        sp->help = dp->help;
+        sp->type = (dp->type == METRICS_COUNTER) ? "counter" : "gauge";
+        snprintf(sp->labels, sizeof(sp->labels), "page=\"%s\",program=\"%.32s\"%s%.64s", pp->name, producer, (dp->labels[0] != '\0') ? "," : "", dp->labels);
+        sp->value = (double)value / dp->scale;
+        sp->order = order++;
+
+        if ((dp->type == METRICS_COUNTER) && (pp->then > 0) && (when > pp->then) && (value >= pp->previous[ii])) {
+            sp[1] = sp[0];
+            ++sp;
+            length = strlen(sp->name);
+            if ((length > 6) && (strcmp(&sp->name[length - 6], "_total") == 0)) {
+                sp->name[length - 6] = '\0';
+            }
+            strncat(sp->name, "_per_second", sizeof(sp->name) - strlen(sp->name) - 1);
+            sp->help = "The rate of the counter of the same name over the last period.";
+            sp->type = "gauge";
+            sp->value = ((double)(value - pp->previous[ii]) / dp->scale) / ((when - pp->then) / 1000000000.0);
+            sp->order = order++;
+        }
+
+        pp->previous[ii] = value;
+        ++sp;
+
+    }
+
+    pp->then = when;
+
+    return sp - samples;
+}
+
+static int export(FILE * fp, sample_t * samples, size_t count)
+{
+    const char * family = "";
+    size_t ii;
+
+    qsort(samples, count, sizeof(sample_t), byname);
+
+    for (ii = 0; ii < count; ++ii) {
+        if (strcmp(samples[ii].name, family) != 0) {
+            family = samples[ii].name;
+            fprintf(fp, "# HELP %s %s\n", family, samples[ii].help);
+            fprintf(fp, "# TYPE %s %s\n", family, samples[ii].type);
+        }
+        fprintf(fp, "%s{%s} %.17g\n", samples[ii].name, samples[ii].labels, samples[ii].value);
+    }
+
+    return ferror(fp) ? -1 : 0;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    const char * path = (const char *)0;
+    char * temporary = (char *)0;
+    unsigned long seconds = 0;
+    page_t * pages = (page_t *)0;
+    sample_t * samples = (sample_t *)0;
+    size_t npages = 0;
+    size_t count;
+    size_t ii;
+    struct sigaction action = { 0 };
+    struct timespec period = { 0 };
+    FILE * fp;
+    char * end = (char *)0;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "ho:p:")) >= 0) {
+
+        switch (opt) {
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'p':
+            seconds = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (seconds == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error || (optind >= argc)) {
+            usage();
+            break;
+        }
+
+        npages = argc - optind;
+        pages = (page_t *)calloc(npages, sizeof(page_t));
+        samples = (sample_t *)calloc(npages * ((2 * METRICS_MAXIMUM) + 1), sizeof(sample_t));
+        if ((pages == (page_t *)0) || (samples == (sample_t *)0)) {
+            perror("calloc");
+            break;
+        }
+        for (ii = 0; ii < npages; ++ii) {
+            pages[ii].name = argv[optind + ii];
+        }
+
+        if (path != (const char *)0) {
+            temporary = (char *)malloc(strlen(path) + 32);
+            if (temporary == (char *)0) {
+                perror("malloc");
+                break;
+            }
+            sprintf(temporary, "%s.%d", path, getpid());
+        }
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if ((sigaction(SIGINT, &action, (struct sigaction *)0) < 0) || (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0)) {
+            perror("sigaction");
+            break;
+        }
+
+        period.tv_sec = seconds;
+
+        xc = 0;
+
+        while (!done) {
+
+            for (ii = 0, count = 0; ii < npages; ++ii) {
+                count += collect(&pages[ii], &samples[count], count, now());
+            }
+
+            if (path == (const char *)0) {
+                if ((export(stdout, samples, count) < 0) || (fflush(stdout) == EOF)) {
+                    perror("stdout");
+                    xc = 1;
+                    break;
+                }
+            } else if ((fp = fopen(temporary, "w")) == (FILE *)0) {
+                perror(temporary);
+                xc = 1;
+                break;
+            } else if ((export(fp, samples, count) < 0) | (fclose(fp) == EOF)) {
+                perror(temporary);
+                (void)unlink(temporary);
+                xc = 1;
+                break;
+            } else if (rename(temporary, path) < 0) {
+                perror(path);
+                (void)unlink(temporary);
+                xc = 1;
+                break;
+            } else {
+                /* Do nothing. */
+            }
+
+            if (seconds == 0) {
+                break;
+            }
+
+            nanosleep(&period, (struct timespec *)0);
+
+        }
+
+    } while (0);
+
+    for (ii = 0; ii < npages; ++ii) {
+        metrics_detach(pages[ii].mp);
+    }
+
+    free(pages);
+    free(samples);
+    free(temporary);
+
+    return xc;
+}
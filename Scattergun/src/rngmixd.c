@@ -0,0 +1,829 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Mixer Daemon<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngmixd [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -b BYTES ] [ -f FACTOR ] [ -r SECONDS ] [ -p SECONDS ] [ -o PATH ] SOURCE[=BITS] [ SOURCE[=BITS] ... ]
+ *
+ * EXAMPLES
+ *
+ * rngmixd -D -i rngmixd -v /dev/TrueRNGpro=7.5 /dev/ChaosKey /dev/hwrng=4 /var/run/rdrand.fifo=6
+ *
+ * rngmixd -v -p 10 -o /tmp/mixed.fifo /dev/TrueRNG /var/run/quantis.fifo
+ *
+ * ABSTRACT
+ *
+ * Continuously reads many entropy sources concurrently from a single epoll(7)
+ * loop, conditions and mixes their output through a hash based mixer, and
+ * feeds the kernel entropy pool in batches using the RNDADDENTROPY ioctl(2),
+ * crediting it with entropy only for what the sources have earned. Each
+ * source is a character device, FIFO, or socket, optionally followed by the
+ * number of bits of min-entropy per byte to credit it with. The min-entropy
+ * of every source is also measured continuously with the SP800-90B most
+ * common value estimate; a source is credited with the lesser of its
+ * configured and its measured min-entropy, or with its measured min-entropy
+ * alone if none is configured, and with nothing until it has been measured
+ * over enough samples. The mixer is SHA-256: every read is absorbed along
+ * with the index of its source and a timestamp, and whenever the credit
+ * absorbed reaches FACTOR times 256 bits a 256-bit full entropy block is
+ * extracted and the mixer is rekeyed from its own state. Blocks are batched
+ * so that the kernel is written to no more often than necessary. A source
+ * that fails or reaches end of file is closed and reopened periodically, so
+ * devices may be unplugged and replugged. Per source throughput, min-entropy,
+ * and credit counters, and mixer counters, are reported on SIGHUP, at exit,
+ * and optionally periodically. This replaces truerngd.sh and rngd configured
+ * with a single HRNGDEVICE, neither of which can use more than one of the
+ * entropy sources on a host that has several. This is part of the Scattergun
+ * project.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <pthread.h>
+#include <linux/random.h>
+#include "sha256.h"
+
+static const char * program = "rngmixd";
+static const char * ident = "rngmixd";
+static int debug = 0;
+static int verbose = 0;
+static volatile int done = 0;
+static volatile int report = 0;
+static int daemonize = 0;
+
+enum {
+    SOURCES = 64,               /* Maximum number of sources. */
+    READSIZE = 4096,            /* Bytes read from a source at a time. */
+    BLOCKSIZE = 32,             /* Bytes in an extracted block. */
+    WARMUP = 4096,              /* Samples measured before any credit. */
+    DECAY = 1 << 20,            /* Samples after which the histogram decays. */
+};
+
+/**
+ * This is the state and the counters of one entropy source.
+ */
+typedef struct Source {
+    const char * path;
+    int fd;
+    int device;
+    int relay;
+    int failing;
+    double configured;
+    double measured;
+    uint64_t histogram[256];
+    uint64_t samples;
+    uint64_t opens;
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t eofs;
+    double credit;
+    uint64_t retry;
+} source_t;
+
+static source_t sources[SOURCES];
+
+/**
+ * Emit a formatting string to either the system log or to standard error.
+ * @param format is the printf format.
+ */
+static void lprintf(const char * format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (daemonize) {
+        vsyslog(LOG_DEBUG, format, ap);
+    } else {
+        vfprintf(stderr, format, ap);
+    }
+    va_end(ap);
+}
+
+/**
+ * Emit a formatting string to either the system log or to standard error
+ * if verbosity is enabled.
+ * @param format is the printf format.
+ */
+static void lverbosef(const char * format, ...)
+{
+    if (verbose) {
+        va_list ap;
+        va_start(ap, format);
+        if (daemonize) {
+            vsyslog(LOG_DEBUG, format, ap);
+        } else {
+            vfprintf(stderr, format, ap);
+        }
+        va_end(ap);
+    }
+}
+
+/**
+ * Emit a caller provider string and an error message string corresponding to
+ * the current value of the error number (errno) to either the system log or
+ * to standard error.
+ * @param string is the string.
+ */
+static void lerror(const char * string)
+{
+    if (daemonize) {
+        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
+    } else {
+        fprintf(stderr, "%s: %s\n", string, strerror(errno));
+    }
+}
+
+/**
+ * Handle a signal. In the event of a SIGTERM or a SIGINT, the program shuts
+ * down in an orderly fashion. In the event of a SIGHUP, it emits some
+ * statistics to standard error.
+ * @param signum is the number of the incoming signal.
+ */
+static void handler(int signum)
+{
+    if (signum == SIGTERM) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -b BYTES ] [ -f FACTOR ] [ -r SECONDS ] [ -p SECONDS ] [ -o PATH ] SOURCE[=BITS] [ SOURCE[=BITS] ... ]\n", program);
+    if (nomenu) { return; }
+    lprintf("       -d            Enable debug mode\n");
+    lprintf("       -v            Enable verbose mode\n");
+    lprintf("       -D            Run as a daemon\n");
+    lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    lprintf("       -b BYTES      Feed the kernel in batches of BYTES (default 512)\n");
+    lprintf("       -f FACTOR     Require FACTOR bits of credit per output bit (default 2.0)\n");
+    lprintf("       -r SECONDS    Reopen failed sources every SECONDS (default 1)\n");
+    lprintf("       -p SECONDS    Report statistics every SECONDS (default never)\n");
+    lprintf("       -o PATH       Write to PATH (which may be a fifo) instead of crediting /dev/random\n");
+    lprintf("       -h            Print help menu\n");
+    lprintf("       SOURCE[=BITS] Read SOURCE crediting at most BITS of min-entropy per byte\n");
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * MIXER
+ ******************************************************************************/
+
+/**
+ * Extract a block from the mixer and rekey it. The block and the chaining
+ * value are hashes of the mixer state under different domain separators, so
+ * the block reveals nothing about the state that carries forward.
+ * @param sp points to the mixer.
+ * @param block points to where the extracted block is stored.
+ */
+static void extract(sha256_t * sp, uint8_t * block)
+{
+    static const uint8_t OUTPUT = 0x01;
+    static const uint8_t CHAIN = 0x00;
+    uint8_t state[BLOCKSIZE];
+    sha256_t scratch;
+
+    sha256_final(sp, state);
+
+    sha256_init(&scratch);
+    sha256_update(&scratch, &OUTPUT, sizeof(OUTPUT));
+    sha256_update(&scratch, state, sizeof(state));
+    sha256_final(&scratch, block);
+
+    sha256_init(sp);
+    sha256_update(sp, &CHAIN, sizeof(CHAIN));
+    sha256_update(sp, state, sizeof(state));
+
+    memset(state, 0, sizeof(state));
+}
+
+/*******************************************************************************
+ * SOURCES
+ ******************************************************************************/
+
+/**
+ * Update the measured min-entropy of a source using the SP800-90B most
+ * common value estimate, the upper 99% confidence bound on the probability
+ * of the most common byte. The histogram is halved periodically so that
+ * the estimate follows a source that degrades.
+ * @param sp points to the source.
+ * @param buffer points to the bytes most recently read.
+ * @param bytes is the number of bytes.
+ */
+static void measure(source_t * sp, const uint8_t * buffer, size_t bytes)
+{
+    uint64_t maximum = 0;
+    double p;
+    size_t ii;
+
+    for (ii = 0; ii < bytes; ++ii) {
+        ++sp->histogram[buffer[ii]];
+    }
+    sp->samples += bytes;
+
+    if (sp->samples >= DECAY) {
+        sp->samples = 0;
+        for (ii = 0; ii < 256; ++ii) {
+            sp->histogram[ii] /= 2;
+            sp->samples += sp->histogram[ii];
+        }
+    }
+
+    for (ii = 0; ii < 256; ++ii) {
+        if (sp->histogram[ii] > maximum) {
+            maximum = sp->histogram[ii];
+        }
+    }
+
+    if (sp->samples < 2) {
+        return;
+    }
+
+    p = (double)maximum / sp->samples;
+    p += 2.576 * sqrt((p * (1.0 - p)) / (sp->samples - 1));
+    sp->measured = (p < 1.0) ? -log2(p) : 0.0;
+}
+
+/**
+ * Copy a source that cannot be polled, such as the hw_random device, into a
+ * pipe that can. The thread exits when either end fails.
+ * @param arg points to the source.
+ * @return NULL.
+ */
+static void * relay(void * arg)
+{
+    source_t * sp = (source_t *)arg;
+    int device = sp->device;
+    int fd = sp->relay;
+    uint8_t buffer[READSIZE];
+    ssize_t bytes;
+    ssize_t written;
+    ssize_t offset;
+
+    while ((bytes = read(device, buffer, sizeof(buffer))) != 0) {
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (offset = 0; offset < bytes; offset += written) {
+            written = write(fd, buffer + offset, bytes - offset);
+            if (written <= 0) {
+                break;
+            }
+        }
+        if (offset < bytes) {
+            break;
+        }
+    }
+
+    close(device);
+    close(fd);
+
+    return (void *)0;
+}
+
+static int reopen(source_t * sp, int efd)
+{
+    struct epoll_event event = { 0 };
+    int fds[2] = { -1, -1 };
+    pthread_attr_t attr;
+    pthread_t thread;
+    int rc;
+
+    sp->fd = open(sp->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (sp->fd < 0) {
+        if (!sp->failing) {
+            lerror(sp->path);
+            sp->failing = !0;
+        }
+        return -1;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = sp;
+
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, sp->fd, &event) == 0) {
+        /* Do nothing. */
+    } else if (errno != EPERM) {
+        lerror(sp->path);
+        close(sp->fd);
+        sp->fd = -1;
+        return -1;
+    } else if (pipe2(fds, O_CLOEXEC) < 0) {
+        lerror("pipe2");
+        close(sp->fd);
+        sp->fd = -1;
+        return -1;
+    } else {
+        /*
+         * The device does not support poll(2), so a thread reads it with
+         * blocking reads and relays what it reads through a pipe.
+         */
+        sp->device = sp->fd;
+        (void)fcntl(sp->device, F_SETFL, fcntl(sp->device, F_GETFL) & ~O_NONBLOCK);
+        (void)fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        sp->relay = fds[1];
+        sp->fd = fds[0];
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        rc = pthread_create(&thread, &attr, relay, sp);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            errno = rc;
+            lerror("pthread_create");
+            close(sp->device);
+            close(fds[0]);
+            close(fds[1]);
+            sp->fd = -1;
+            return -1;
+        }
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, sp->fd, &event) < 0) {
+            lerror(sp->path);
+            close(sp->fd);
+            sp->fd = -1;
+            return -1;
+        }
+        lverbosef("%s: relay        \"%s\"\n", program, sp->path);
+    }
+
+    ++sp->opens;
+    sp->failing = 0;
+    lverbosef("%s: open         \"%s\"\n", program, sp->path);
+
+    return 0;
+}
+
+static void shut(source_t * sp, int efd, uint64_t retry)
+{
+    (void)epoll_ctl(efd, EPOLL_CTL_DEL, sp->fd, (struct epoll_event *)0);
+    close(sp->fd);
+    sp->fd = -1;
+    sp->retry = retry;
+    lverbosef("%s: close        \"%s\"\n", program, sp->path);
+}
+
+static void statistics(int nsources, uint64_t elapsed, uint64_t blocks, uint64_t batches, uint64_t output, double pending)
+{
+    double seconds = elapsed / 1000000000.0;
+    int ii;
+
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+
+    for (ii = 0; ii < nsources; ++ii) {
+        lprintf("%s: source=\"%s\" opens=%lu reads=%lu bytes=%lu errors=%lu eofs=%lu bytes/second=%.0lf configured=%.3lf measured=%.3lf credit=%.0lf credit/second=%.0lf\n", program, sources[ii].path, sources[ii].opens, sources[ii].reads, sources[ii].bytes, sources[ii].errors, sources[ii].eofs, sources[ii].bytes / seconds, sources[ii].configured, sources[ii].measured, sources[ii].credit, sources[ii].credit / seconds);
+    }
+
+    lprintf("%s: mixer blocks=%lu batches=%lu bytes=%lu credit=%lu pending=%.0lf elapsed=%.3lf\n", program, blocks, batches, output, output * 8, pending, seconds);
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int rc = 0;
+    const char * path = (const char *)0;
+    size_t batchsize = 512;
+    double factor = 2.0;
+    uint64_t interval = 1000000000ULL;
+    uint64_t period = 0;
+    int nsources = 0;
+    int efd = -1;
+    int kfd = -1;
+    struct sigaction sigterm = { 0 };
+    struct sigaction sighup = { 0 };
+    struct sigaction sigint = { 0 };
+    struct rand_pool_info * info = (struct rand_pool_info *)0;
+    uint8_t buffer[READSIZE];
+    sha256_t mixer;
+    char * end = (char *)0;
+    char * equals = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+    int ii;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "dvDi:b:f:r:p:o:h")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'i':
+            ident = optarg;
+            break;
+
+        case 'b':
+            batchsize = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (batchsize < BLOCKSIZE)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            batchsize -= batchsize % BLOCKSIZE;
+            break;
+
+        case 'f':
+            factor = strtod(optarg, &end);
+            if ((*end != '\0') || (factor < 1.0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            interval = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    for (ii = optind; (!error) && (ii < argc); ++ii) {
+        if (nsources >= SOURCES) {
+            errno = E2BIG;
+            lerror(argv[ii]);
+            error = !0;
+            break;
+        }
+        sources[nsources].path = argv[ii];
+        sources[nsources].fd = -1;
+        sources[nsources].configured = 8.0;
+        equals = strrchr(argv[ii], '=');
+        if (equals != (char *)0) {
+            *(equals++) = '\0';
+            sources[nsources].configured = strtod(equals, &end);
+            if ((*end != '\0') || (sources[nsources].configured < 0.0) || (sources[nsources].configured > 8.0)) {
+                errno = EINVAL;
+                lerror(equals);
+                error = !0;
+                break;
+            }
+        }
+        ++nsources;
+    }
+
+    if ((!error) && (nsources == 0)) {
+        error = !0;
+    }
+
+    do {
+        uint8_t * batch = (uint8_t *)0;
+        size_t batched = 0;
+        double pending = 0.0;
+        double required = 0.0;
+        double entropy = 0.0;
+        double credit = 0.0;
+        uint64_t blocks = 0;
+        uint64_t batches = 0;
+        uint64_t output = 0;
+        uint64_t started = 0;
+        uint64_t reported = 0;
+        uint64_t timestamp = 0;
+        struct epoll_event events[SOURCES];
+        ssize_t bytes = 0;
+        source_t * sp = (source_t *)0;
+        uint8_t index = 0;
+        int nevents = 0;
+        int jj;
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        if (daemonize) {
+            if (daemon(0, 0) < 0) {
+                perror("daemon");
+                break;
+            }
+            openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
+            lverbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        /*
+         * Install our signal handlers.
+         */
+
+        signal(SIGPIPE, SIG_IGN);
+
+        sigterm.sa_handler = handler;
+        sigterm.sa_flags = 0;
+        rc = sigaction(SIGTERM, &sigterm, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sighup.sa_handler = handler;
+        sighup.sa_flags = SA_RESTART;
+        rc = sigaction(SIGHUP, &sighup, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sigint.sa_handler = handler;
+        sigint.sa_flags = 0;
+        rc = sigaction(SIGINT, &sigint, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        /*
+         * Open our sink: either the kernel entropy pool, which requires
+         * CAP_SYS_ADMIN to credit, or PATH.
+         */
+
+        if (path != (const char *)0) {
+            lverbosef("%s: path         \"%s\"\n", program, path);
+            kfd = (strcmp(path, "-") == 0) ? dup(STDOUT_FILENO) : open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0660);
+        } else {
+            kfd = open("/dev/random", O_WRONLY | O_CLOEXEC);
+        }
+        if (kfd < 0) {
+            lerror((path != (const char *)0) ? path : "/dev/random");
+            break;
+        }
+
+        info = (struct rand_pool_info *)malloc(sizeof(*info) + batchsize);
+        if (info == (struct rand_pool_info *)0) {
+            lerror("malloc");
+            break;
+        }
+        batch = (uint8_t *)(info->buf);
+
+        efd = epoll_create1(EPOLL_CLOEXEC);
+        if (efd < 0) {
+            lerror("epoll_create1");
+            break;
+        }
+
+        for (ii = 0; ii < nsources; ++ii) {
+            lverbosef("%s: source       \"%s\" %.3lf\n", program, sources[ii].path, sources[ii].configured);
+            if (reopen(&sources[ii], efd) < 0) {
+                sources[ii].retry = now() + interval;
+            }
+        }
+
+        lverbosef("%s: batch        %zu\n", program, batchsize);
+        lverbosef("%s: factor       %.3lf\n", program, factor);
+
+        sha256_init(&mixer);
+        required = factor * BLOCKSIZE * 8;
+        started = now();
+        reported = started;
+
+        /*
+         * Enter our work loop.
+         */
+
+        xc = 0;
+
+        while (!done) {
+
+            timestamp = now();
+
+            if (report || ((period > 0) && ((timestamp - reported) >= period))) {
+                statistics(nsources, timestamp - started, blocks, batches, output, pending);
+                reported = timestamp;
+                report = 0;
+            }
+
+            for (ii = 0; ii < nsources; ++ii) {
+                if ((sources[ii].fd < 0) && (timestamp >= sources[ii].retry)) {
+                    if (reopen(&sources[ii], efd) < 0) {
+                        sources[ii].retry = timestamp + interval;
+                    }
+                }
+            }
+
+            nevents = epoll_wait(efd, events, SOURCES, 1000);
+            if (nevents < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                lerror("epoll_wait");
+                xc = 2;
+                break;
+            }
+
+            for (jj = 0; jj < nevents; ++jj) {
+
+                sp = (source_t *)events[jj].data.ptr;
+                if (sp->fd < 0) {
+                    continue;
+                }
+
+                bytes = read(sp->fd, buffer, sizeof(buffer));
+                if (bytes > 0) {
+                    /* Do nothing. */
+                } else if (bytes == 0) {
+                    ++sp->eofs;
+                    shut(sp, efd, now() + interval);
+                    continue;
+                } else if ((errno == EAGAIN) || (errno == EINTR)) {
+                    continue;
+                } else {
+                    ++sp->errors;
+                    lerror(sp->path);
+                    shut(sp, efd, now() + interval);
+                    continue;
+                }
+
+                ++sp->reads;
+                sp->bytes += bytes;
+
+                /*
+                 * Credit the source with the lesser of its configured and
+                 * measured min-entropy, and nothing until it is measured.
+                 */
+
+                measure(sp, buffer, bytes);
+                entropy = (sp->samples < WARMUP) ? 0.0 : (sp->measured < sp->configured) ? sp->measured : sp->configured;
+                credit = bytes * entropy;
+                sp->credit += credit;
+                pending += credit;
+
+                index = sp - sources;
+                timestamp = now();
+                sha256_update(&mixer, &index, sizeof(index));
+                sha256_update(&mixer, &timestamp, sizeof(timestamp));
+                sha256_update(&mixer, buffer, bytes);
+
+                while (pending >= required) {
+
+                    extract(&mixer, batch + batched);
+                    batched += BLOCKSIZE;
+                    pending -= required;
+                    ++blocks;
+
+                    if (batched < batchsize) {
+                        continue;
+                    }
+
+                    /*
+                     * Each block carries full entropy because it was
+                     * extracted from at least FACTOR times its size in
+                     * credit.
+                     */
+
+                    if (path != (const char *)0) {
+                        rc = (write(kfd, batch, batched) == batched) ? 0 : -1;
+                    } else {
+                        info->entropy_count = batched * 8;
+                        info->buf_size = batched;
+                        rc = ioctl(kfd, RNDADDENTROPY, info);
+                    }
+                    if (rc < 0) {
+                        lerror((path != (const char *)0) ? path : "RNDADDENTROPY");
+                        xc = 2;
+                        done = !0;
+                        break;
+                    }
+
+                    output += batched;
+                    ++batches;
+                    batched = 0;
+                    memset(batch, 0, batchsize);
+
+                    if (debug) {
+                        lprintf("%s: batches=%lu bytes=%lu\n", program, batches, output);
+                    }
+
+                }
+
+            }
+
+        }
+
+        statistics(nsources, now() - started, blocks, batches, output, pending);
+
+    } while (0);
+
+    /*
+     * Clean up after ourselves.
+     */
+
+    for (ii = 0; ii < nsources; ++ii) {
+        if (sources[ii].fd >= 0) {
+            close(sources[ii].fd);
+        }
+    }
+
+    if (efd >= 0) {
+        close(efd);
+    }
+
+    if (kfd >= 0) {
+        close(kfd);
+    }
+
+    free(info);
+
+    memset(&mixer, 0, sizeof(mixer));
+
+    if (daemonize) {
+        closelog();
+    }
+
+    return xc;
+}
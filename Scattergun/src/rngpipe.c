@@ -0,0 +1,1421 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Pipeline<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngpipe [ -h ] [ -v ] [ -u ] [ -b BYTES ] [ -n BUFFERS ] [ -p SECONDS ] [ -t BYTES ] [ -f CONFIG ] [ STAGE ... ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Make each buffer this many bytes (default 65536).
+ * -f CONFIG       Read stages from this file, one per line, before those given as arguments.
+ * -h              Display this menu.
+ * -n BUFFERS      Give each link between stages this many buffers (default 16).
+ * -p SECONDS      Report every this many seconds as well as on SIGHUP and at exit.
+ * -t BYTES        Stop after the sink has taken this many bytes (default unlimited).
+ * -u              Leave the stages unpinned instead of pinning each to its own processor.
+ * -v              Report the configuration to stderr.
+ *
+ * STAGES
+ *
+ * Each STAGE is KIND[:ARGUMENT][@CPU], the first a source, the last a sink,
+ * and any between them filters; @CPU pins the stage to that processor.
+ *
+ * rdrand          Source: the rdrand instruction.
+ * rdseed          Source: the rdseed instruction.
+ * getrandom       Source: getrandom(2).
+ * device:PATH     Source: a device node, FIFO, or file, until end of file.
+ * quantis[:BUS:UNIT] Source: a Quantis unit (default USB:0), in the Quantis builds.
+ * health[:BITS]   Filter: SP800-90B repetition count and adaptive proportion
+ *                 tests of byte samples of BITS min-entropy (default 8),
+ *                 dropping every buffer in which either alarms.
+ * vonneumann      Filter: von Neumann debiasing.
+ * hash[:FACTOR]   Filter: SHA-256 of every 32 x FACTOR bytes (default 2).
+ * drbg[:BYTES]    Filter: SP800-90A Hash_DRBG with SHA-256, seeded and
+ *                 reseeded every BYTES of output (default 1048576) from
+ *                 upstream.
+ * file:PATH       Sink: a file or FIFO.
+ * stdout          Sink: standard output.
+ * pool[:BITS]     Sink: the kernel entropy pool, credited BITS per byte
+ *                 (default 0, which needs no privilege).
+ * shm[:NAME]      Sink: a shared memory ring (default /scattergun) for
+ *                 rngshmcat and libsgrandom consumers.
+ *
+ * EXAMPLES
+ *
+ * rngpipe -p 10 rdseed health vonneumann hash drbg:16777216 shm
+ *
+ * rngpipe -t 1000000000 rdrand@2 drbg@3 file:/tmp/drbg.dat@4
+ *
+ * sudo rngpipe device:/dev/TrueRNGpro health:6 hash:4 pool:8
+ *
+ * rngpipe -f /usr/local/etc/scattergun.pipeline
+ *
+ * ABSTRACT
+ *
+ * Runs a chain of entropy stages, a source, filters such as health tests,
+ * extractors, and a DRBG, and a sink, in a single process, each stage on its
+ * own thread pinned to its own processor, handing pooled buffers from one
+ * stage to the next through lock free single producer single consumer rings
+ * rather than through shell pipes, so that a chain that would otherwise be
+ * several programs costs no more than its slowest stage. A report gives for
+ * each stage the buffers and bytes it produced (the sink, those it took),
+ * its throughput, how often and how long it waited for a buffer, and the
+ * occupancy of the link into it, current, peak, and mean; the stage before
+ * the link that stays full, or the one after the link that stays empty, is
+ * the bottleneck. The pipeline ends when the source reaches end of file,
+ * the sink has taken BYTES, a stage fails, or on SIGINT or SIGTERM.
+ *
+ * The health and von Neumann filters work in place on the buffer they are
+ * given, which is then passed on without being copied. The hash filter
+ * writes less than it reads, but may finish a digest begun in a previous
+ * buffer, so it stages its digests and copies them back. The DRBG makes its
+ * own output and draws a buffer from upstream only to instantiate or
+ * reseed, so that the stages before it run only as fast as it needs seed;
+ * it ends rather than outlive its seed when the source ends. The stages
+ * are pinned round robin over the processors that the process may run on
+ * unless -u or @CPU say otherwise.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <linux/random.h>
+#if defined(SCATTERGUN_HAS_QUANTIS)
+#   include "Quantis.h"
+#endif
+#include "pipeline.h"
+#include "sgrandom.h"
+#include "sha256.h"
+#include "output.h"
+#include "rngshm.h"
+#include "sp80090b.h"
+#include "vonneumann.h"
+
+enum {
+    APTWINDOW = 512,            /* SP800-90B window for byte samples. */
+    SEEDLEN = 55,               /* Hash_DRBG seedlen for SHA-256 in bytes. */
+    DIGEST = 32,                /* SHA-256 digest in bytes. */
+    STRENGTH = 32,              /* Security strength in bytes. */
+    NONCE = 16,                 /* Nonce in bytes, half the strength. */
+    REQUEST = 65536,            /* Most bytes per Hash_DRBG request. */
+    SLICE = 100,                /* Longest wait in milliseconds. */
+};
+
+static const double ALPHA = 30.0; /* False alarm probability 2^-ALPHA. */
+
+static const char * program = "rngpipe";
+static volatile int done = 0;
+static volatile int interrupted = 0;
+static volatile int hangup = 0;
+static size_t size = 65536;
+static uint64_t limit = 0;
+static uint64_t drained = 0;
+
+struct Kind;
+
+/**
+ * This is one stage as configured.
+ */
+typedef struct Stage {
+    char * spec;
+    char * words;
+    const char * argument;
+    const struct Kind * kind;
+    int cpu;
+    void * context;
+    uint64_t alarms;
+} stage_t;
+
+/**
+ * This is one kind of stage: its name, its role, how to set it up and tear
+ * it down, and its functions in the pipeline.
+ */
+typedef struct Kind {
+    const char * name;
+    int role;
+    int (*open)(stage_t * sp);
+    void (*close)(stage_t * sp);
+    pipeline_operations_t operations;
+} kind_t;
+
+static void handler(int signum)
+{
+    if (signum == SIGHUP) {
+        hangup = !0;
+    } else {
+        interrupted = !0;
+        done = !0;
+    }
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * SOURCES
+ ******************************************************************************/
+
+static int random_open(stage_t * sp)
+{
+    int requested;
+    int selected;
+
+    requested = (strcmp(sp->kind->name, "rdrand") == 0) ? SG_RANDOM_RDRAND : (strcmp(sp->kind->name, "rdseed") == 0) ? SG_RANDOM_RDSEED : SG_RANDOM_GETRANDOM;
+    selected = sg_random_select(requested);
+    if (selected != requested) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    return 0;
+}
+
+static ssize_t random_fill(void * context, unsigned char * data, size_t length)
+{
+    return sg_random(data, length);
+}
+
+static int device_open(stage_t * sp)
+{
+    int * fdp;
+
+    if (sp->argument == (const char *)0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fdp = (int *)malloc(sizeof(int));
+    if (fdp == (int *)0) {
+        return -1;
+    }
+
+    *fdp = open(sp->argument, O_RDONLY);
+    if (*fdp < 0) {
+        free(fdp);
+        return -1;
+    }
+
+    sp->context = fdp;
+
+    return 0;
+}
+
+static void device_close(stage_t * sp)
+{
+    int * fdp = (int *)sp->context;
+
+    if (fdp != (int *)0) {
+        close(*fdp);
+        free(fdp);
+    }
+}
+
+/**
+ * Fill the whole buffer unless at end of file, since a device like
+ * /dev/hwrng returns a few bytes per read(2) and a buffer is worth a trip
+ * through a ring only if it is full. Waits in slices so that the done flag
+ * is seen even if the device, or the writer of a FIFO, never delivers;
+ * when it is set, what has been read is returned, and none is end of file.
+ */
+static ssize_t device_fill(void * context, unsigned char * data, size_t length)
+{
+    struct pollfd pfd;
+    size_t total = 0;
+    ssize_t rc;
+
+    pfd.fd = *(int *)context;
+    pfd.events = POLLIN;
+
+    while ((total < length) && !done) {
+        pfd.revents = 0;
+        rc = poll(&pfd, 1, SLICE);
+        if (rc == 0) {
+            continue;
+        } else if (rc > 0) {
+            rc = read(pfd.fd, data + total, length - total);
+        } else {
+            /* Do nothing. */
+        }
+        if (rc > 0) {
+            total += rc;
+        } else if (rc == 0) {
+            break;
+        } else if ((errno == EINTR) || (errno == EAGAIN)) {
+            continue;
+        } else if (total > 0) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+
+    return total;
+}
+
+#if defined(SCATTERGUN_HAS_QUANTIS)
+
+static int quantis_open(stage_t * sp)
+{
+    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
+    QuantisDeviceType type = QUANTIS_DEVICE_USB;
+    unsigned int number = 0;
+    char bus[8] = "USB";
+    int rc;
+
+    if ((sp->argument != (const char *)0) && ((sscanf(sp->argument, "%7[A-Za-z]:%u", bus, &number) != 2))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (strcasecmp(bus, "PCI") == 0) {
+        type = QUANTIS_DEVICE_PCI;
+    } else if (strcasecmp(bus, "USB") == 0) {
+        type = QUANTIS_DEVICE_USB;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    rc = QuantisOpen(type, number, &handle);
+    if (rc != QUANTIS_SUCCESS) {
+        fprintf(stderr, "%s: QuantisOpen(%s,%u)=%d=\"%s\"\n", program, bus, number, rc, QuantisStrError(rc));
+        errno = ENODEV;
+        return -1;
+    }
+
+    sp->context = handle;
+
+    return 0;
+}
+
+static void quantis_close(stage_t * sp)
+{
+    if (sp->context != (void *)0) {
+        QuantisClose((QuantisDeviceHandle *)sp->context);
+    }
+}
+
+/**
+ * Retry a failed read once, as quantistool does.
+ */
+static ssize_t quantis_fill(void * context, unsigned char * data, size_t length)
+{
+    int rc;
+
+    if (length > QUANTIS_MAX_READ_SIZE) {
+        length = QUANTIS_MAX_READ_SIZE;
+    }
+
+    rc = QuantisReadHandled((QuantisDeviceHandle *)context, data, length);
+    if (rc < 0) {
+        rc = QuantisReadHandled((QuantisDeviceHandle *)context, data, length);
+    }
+    if (rc < 0) {
+        errno = EIO;
+        return -1;
+    }
+
+    return rc;
+}
+
+#endif
+
+/*******************************************************************************
+ * HEALTH
+ ******************************************************************************/
+
+typedef struct Health {
+    stage_t * stage;
+    uint64_t rctcutoff;
+    uint64_t aptcutoff;
+    int repeated;
+    uint64_t repeats;
+    int reference;
+    uint64_t matches;
+    unsigned int samples;
+} health_t;
+
+static int health_open(stage_t * sp)
+{
+    health_t * hp;
+    double entropy = 8.0;
+    char * end = (char *)0;
+
+    if (sp->argument != (const char *)0) {
+        entropy = strtod(sp->argument, &end);
+        if ((*end != '\0') || (entropy <= 0.0) || (entropy > 8.0)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    hp = (health_t *)calloc(1, sizeof(*hp));
+    if (hp == (health_t *)0) {
+        return -1;
+    }
+
+    hp->stage = sp;
+    hp->rctcutoff = 1 + (uint64_t)ceil(ALPHA / entropy);
+    hp->aptcutoff = sp80090b_aptcutoff(entropy, ALPHA, APTWINDOW);
+    hp->repeated = -1;
+
+    sp->context = hp;
+
+    return 0;
+}
+
+/**
+ * Run the repetition count and adaptive proportion tests continuously
+ * across buffers, dropping any buffer in which either alarms.
+ */
+static ssize_t health_filter(void * context, unsigned char * data, size_t length)
+{
+    health_t * hp = (health_t *)context;
+    int alarmed = 0;
+    size_t ii;
+    int byte;
+
+    for (ii = 0; ii < length; ++ii) {
+
+        byte = data[ii];
+
+        if (byte == hp->repeated) {
+            if ((++hp->repeats) >= hp->rctcutoff) {
+                alarmed = !0;
+            }
+        } else {
+            hp->repeated = byte;
+            hp->repeats = 1;
+        }
+
+        if (hp->samples == 0) {
+            hp->reference = byte;
+            hp->matches = 0;
+        } else if (byte == hp->reference) {
+            if ((++hp->matches) >= hp->aptcutoff) {
+                alarmed = !0;
+            }
+        } else {
+            /* Do nothing. */
+        }
+        if ((++hp->samples) >= APTWINDOW) {
+            hp->samples = 0;
+        }
+
+    }
+
+    if (alarmed) {
+        __atomic_store_n(&hp->stage->alarms, hp->stage->alarms + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    return length;
+}
+
+/*******************************************************************************
+ * EXTRACTORS
+ ******************************************************************************/
+
+/**
+ * Share the von Neumann extractor of the extract tool.
+ */
+static int vonneumann_open(stage_t * sp)
+{
+    (void)vonneumann_initialize(0);
+
+    sp->context = calloc(1, sizeof(vonneumann_t));
+
+    return (sp->context == (void *)0) ? -1 : 0;
+}
+
+/**
+ * Each byte emits at most four bits, so the output is written over input
+ * already consumed; leftover bits carry to the next buffer.
+ */
+static ssize_t vonneumann_filter(void * context, unsigned char * data, size_t length)
+{
+    return vonneumann_extract((vonneumann_t *)context, data, length);
+}
+
+typedef struct Hash {
+    sha256_t state;
+    size_t block;
+    size_t hashed;
+    unsigned char * staged;
+    size_t held;
+} hash_t;
+
+static int hash_open(stage_t * sp)
+{
+    hash_t * hp;
+    unsigned long factor = 2;
+    char * end = (char *)0;
+
+    if (sp->argument != (const char *)0) {
+        factor = strtoul(sp->argument, &end, 0);
+        if ((*end != '\0') || (factor < 2)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    hp = (hash_t *)calloc(1, sizeof(*hp));
+    if (hp == (hash_t *)0) {
+        return -1;
+    }
+
+    /*
+     * At a FACTOR of two or more the digests made from a buffer, plus those
+     * held over, never exceed half the buffer and a few digests.
+     */
+
+    hp->staged = (unsigned char *)malloc(size + (4 * DIGEST));
+    if (hp->staged == (unsigned char *)0) {
+        free(hp);
+        return -1;
+    }
+
+    hp->block = DIGEST * factor;
+    sha256_init(&hp->state);
+
+    sp->context = hp;
+
+    return 0;
+}
+
+static void hash_close(stage_t * sp)
+{
+    hash_t * hp = (hash_t *)sp->context;
+
+    if (hp != (hash_t *)0) {
+        free(hp->staged);
+        free(hp);
+    }
+}
+
+static ssize_t hash_filter(void * context, unsigned char * data, size_t length)
+{
+    hash_t * hp = (hash_t *)context;
+    size_t ii = 0;
+    size_t part;
+    size_t out;
+
+    while (ii < length) {
+        part = hp->block - hp->hashed;
+        if (part > (length - ii)) {
+            part = length - ii;
+        }
+        sha256_update(&hp->state, data + ii, part);
+        hp->hashed += part;
+        ii += part;
+        if (hp->hashed == hp->block) {
+            sha256_final(&hp->state, hp->staged + hp->held);
+            hp->held += DIGEST;
+            sha256_init(&hp->state);
+            hp->hashed = 0;
+        }
+    }
+
+    out = (hp->held < length) ? hp->held : length;
+    memcpy(data, hp->staged, out);
+    memmove(hp->staged, hp->staged + out, hp->held - out);
+    hp->held -= out;
+
+    return out;
+}
+
+/*******************************************************************************
+ * DRBG
+ ******************************************************************************/
+
+typedef struct Drbg {
+    uint8_t v[SEEDLEN];
+    uint8_t c[SEEDLEN];
+    uint64_t counter;
+    uint64_t interval;
+    uint64_t generated;
+    size_t needed;
+    int instantiated;
+} drbg_t;
+
+/**
+ * Add a big endian number of up to SEEDLEN bytes to another modulo
+ * 2^(8 x SEEDLEN).
+ */
+static void drbg_add(uint8_t * v, const uint8_t * x, size_t length)
+{
+    unsigned int carry = 0;
+    int ii;
+    int jj;
+
+    for (ii = SEEDLEN - 1, jj = (int)length - 1; ii >= 0; --ii, --jj) {
+        carry += v[ii] + ((jj >= 0) ? x[jj] : 0);
+        v[ii] = carry & 0xff;
+        carry >>= 8;
+    }
+}
+
+/**
+ * This is Hash_df of SP800-90A 10.3.1 producing seedlen bits from the
+ * concatenation of a one byte prefix (if not negative) and two strings.
+ */
+static void drbg_df(uint8_t * seed, int prefix, const void * a, size_t alength, const void * b, size_t blength)
+{
+    static const uint8_t BITS[4] = { 0x00, 0x00, (SEEDLEN * 8) >> 8, (SEEDLEN * 8) & 0xff, };
+    uint8_t digest[DIGEST];
+    uint8_t counter;
+    uint8_t byte;
+    size_t length;
+    size_t offset;
+    sha256_t state;
+
+    for (counter = 1, offset = 0; offset < SEEDLEN; ++counter, offset += length) {
+        sha256_init(&state);
+        sha256_update(&state, &counter, sizeof(counter));
+        sha256_update(&state, BITS, sizeof(BITS));
+        if (prefix >= 0) {
+            byte = prefix;
+            sha256_update(&state, &byte, sizeof(byte));
+        }
+        sha256_update(&state, a, alength);
+        if (blength > 0) {
+            sha256_update(&state, b, blength);
+        }
+        sha256_final(&state, digest);
+        length = ((SEEDLEN - offset) < DIGEST) ? (SEEDLEN - offset) : DIGEST;
+        memcpy(seed + offset, digest, length);
+    }
+}
+
+static int drbg_open(stage_t * sp)
+{
+    drbg_t * dp;
+    unsigned long long interval = 1048576;
+    char * end = (char *)0;
+
+    if (sp->argument != (const char *)0) {
+        interval = strtoull(sp->argument, &end, 0);
+        if ((*end != '\0') || (interval == 0)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    dp = (drbg_t *)calloc(1, sizeof(*dp));
+    if (dp == (drbg_t *)0) {
+        return -1;
+    }
+
+    dp->interval = interval;
+    dp->needed = STRENGTH;
+
+    sp->context = dp;
+
+    return 0;
+}
+
+/**
+ * Instantiate with the first buffer, using a nonce of half the security
+ * strength from getrandom(2) (SP800-90A 8.6.7), and reseed with every later
+ * one (SP800-90A 10.1.1.2 and 10.1.1.3).
+ */
+static int drbg_seed(void * context, const unsigned char * data, size_t length)
+{
+    drbg_t * dp = (drbg_t *)context;
+    uint8_t seed[SEEDLEN];
+    uint8_t nonce[NONCE];
+
+    if (!dp->instantiated) {
+        if (getrandom(nonce, sizeof(nonce), 0) != sizeof(nonce)) {
+            return -1;
+        }
+        drbg_df(seed, -1, data, length, nonce, sizeof(nonce));
+        dp->instantiated = !0;
+    } else {
+        drbg_df(seed, 0x01, dp->v, sizeof(dp->v), data, length);
+    }
+
+    memcpy(dp->v, seed, sizeof(dp->v));
+    drbg_df(dp->c, 0x00, dp->v, sizeof(dp->v), (const void *)0, 0);
+    dp->counter = 1;
+    dp->generated = 0;
+    dp->needed = (length < dp->needed) ? (dp->needed - length) : 0;
+
+    return 0;
+}
+
+/**
+ * Generate in requests of no more than REQUEST bytes (SP800-90A 10.1.1.4),
+ * asking for seed when the reseed interval is used up.
+ */
+static ssize_t drbg_generate(void * context, unsigned char * data, size_t length)
+{
+    drbg_t * dp = (drbg_t *)context;
+    uint8_t w[SEEDLEN];
+    uint8_t h[DIGEST];
+    uint8_t digest[DIGEST];
+    uint8_t counter[8];
+    uint8_t one = 0x01;
+    uint8_t three = 0x03;
+    size_t total = 0;
+    size_t request;
+    size_t part;
+    size_t ii;
+    sha256_t state;
+    int bb;
+
+    if ((dp->needed > 0) || (dp->generated >= dp->interval)) {
+        if (dp->needed == 0) {
+            dp->needed = STRENGTH;
+        }
+        return 0;
+    }
+
+    if (length > (dp->interval - dp->generated)) {
+        length = dp->interval - dp->generated;
+    }
+
+    while (total < length) {
+
+        request = ((length - total) < REQUEST) ? (length - total) : REQUEST;
+
+        memcpy(w, dp->v, sizeof(w));
+        for (ii = 0; ii < request; ii += part) {
+            sha256_init(&state);
+            sha256_update(&state, w, sizeof(w));
+            sha256_final(&state, digest);
+            part = ((request - ii) < DIGEST) ? (request - ii) : DIGEST;
+            memcpy(data + total + ii, digest, part);
+            drbg_add(w, &one, sizeof(one));
+        }
+
+        sha256_init(&state);
+        sha256_update(&state, &three, sizeof(three));
+        sha256_update(&state, dp->v, sizeof(dp->v));
+        sha256_final(&state, h);
+
+        for (bb = 0; bb < 8; ++bb) {
+            counter[bb] = (dp->counter >> ((7 - bb) * 8)) & 0xff;
+        }
+
+        drbg_add(dp->v, h, sizeof(h));
+        drbg_add(dp->v, dp->c, sizeof(dp->c));
+        drbg_add(dp->v, counter, sizeof(counter));
+        ++dp->counter;
+
+        total += request;
+
+    }
+
+    dp->generated += total;
+
+    return total;
+}
+
+/*******************************************************************************
+ * SINKS
+ ******************************************************************************/
+
+/**
+ * Trim what a sink takes to the limit, setting *lastp if it is reached.
+ */
+static size_t admit(size_t length, int * lastp)
+{
+    *lastp = 0;
+
+    if (limit > 0) {
+        if (length >= (limit - drained)) {
+            length = limit - drained;
+            *lastp = !0;
+        }
+        drained += length;
+    }
+
+    return length;
+}
+
+typedef struct File {
+    int fd;
+    output_t * output;
+} file_t;
+
+static int file_open(stage_t * sp)
+{
+    file_t * fp;
+
+    if ((strcmp(sp->kind->name, "file") == 0) && (sp->argument == (const char *)0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fp = (file_t *)calloc(1, sizeof(*fp));
+    if (fp == (file_t *)0) {
+        return -1;
+    }
+
+    if (strcmp(sp->kind->name, "stdout") == 0) {
+        fp->fd = STDOUT_FILENO;
+    } else {
+        fp->fd = open(sp->argument, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fp->fd < 0) {
+            free(fp);
+            return -1;
+        }
+    }
+
+    fp->output = output_open(fp->fd, 0, 0, &interrupted);
+    if (fp->output == (output_t *)0) {
+        if (fp->fd != STDOUT_FILENO) {
+            close(fp->fd);
+        }
+        free(fp);
+        return -1;
+    }
+
+    sp->context = fp;
+
+    return 0;
+}
+
+static void file_close(stage_t * sp)
+{
+    file_t * fp = (file_t *)sp->context;
+
+    if (fp != (file_t *)0) {
+        if (output_close(fp->output) < 0) {
+            perror(sp->spec);
+        }
+        if (fp->fd != STDOUT_FILENO) {
+            close(fp->fd);
+        }
+        free(fp);
+    }
+}
+
+static int file_drain(void * context, const unsigned char * data, size_t * lengthp)
+{
+    file_t * fp = (file_t *)context;
+    size_t length;
+    int last;
+    int rc;
+
+    length = *lengthp = admit(*lengthp, &last);
+
+    rc = output_write(fp->output, data, length);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return last ? 1 : 0;
+}
+
+typedef struct Pool {
+    int fd;
+    int bits;
+    struct rand_pool_info * info;
+} pool_t;
+
+static int pool_open(stage_t * sp)
+{
+    pool_t * pp;
+    long bits = 0;
+    char * end = (char *)0;
+
+    if (sp->argument != (const char *)0) {
+        bits = strtol(sp->argument, &end, 0);
+        if ((*end != '\0') || (bits < 0) || (bits > 8)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    pp = (pool_t *)calloc(1, sizeof(*pp));
+    if (pp == (pool_t *)0) {
+        return -1;
+    }
+
+    pp->bits = bits;
+
+    if (bits > 0) {
+        pp->info = (struct rand_pool_info *)malloc(sizeof(*(pp->info)) + size);
+        if (pp->info == (struct rand_pool_info *)0) {
+            free(pp);
+            return -1;
+        }
+    }
+
+    pp->fd = open("/dev/random", O_WRONLY);
+    if (pp->fd < 0) {
+        free(pp->info);
+        free(pp);
+        return -1;
+    }
+
+    sp->context = pp;
+
+    return 0;
+}
+
+static void pool_close(stage_t * sp)
+{
+    pool_t * pp = (pool_t *)sp->context;
+
+    if (pp != (pool_t *)0) {
+        close(pp->fd);
+        free(pp->info);
+        free(pp);
+    }
+}
+
+/**
+ * Mix without credit by writing /dev/random, which needs no privilege, or
+ * with credit by RNDADDENTROPY, which needs CAP_SYS_ADMIN.
+ */
+static int pool_drain(void * context, const unsigned char * data, size_t * lengthp)
+{
+    pool_t * pp = (pool_t *)context;
+    size_t length;
+    ssize_t rc;
+    int last;
+
+    length = *lengthp = admit(*lengthp, &last);
+
+    if (pp->bits == 0) {
+        while (length > 0) {
+            rc = write(pp->fd, data, length);
+            if (rc < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            data += rc;
+            length -= rc;
+        }
+    } else if (length > 0) {
+        pp->info->entropy_count = length * pp->bits;
+        pp->info->buf_size = length;
+        memcpy(pp->info->buf, data, length);
+        if (ioctl(pp->fd, RNDADDENTROPY, pp->info) < 0) {
+            return -1;
+        }
+    } else {
+        /* Do nothing. */
+    }
+
+    return last ? 1 : 0;
+}
+
+static int shm_open_stage(stage_t * sp)
+{
+    rngshm_t * rp;
+
+    rp = rngshm_create((sp->argument != (const char *)0) ? sp->argument : "/scattergun", 1048576, 0666);
+    if (rp == (rngshm_t *)0) {
+        return -1;
+    }
+
+    sp->context = rp;
+
+    return 0;
+}
+
+static void shm_close(stage_t * sp)
+{
+    if (sp->context != (void *)0) {
+        rngshm_detach((rngshm_t *)sp->context);
+    }
+}
+
+/**
+ * Copy into the ring as consumers make room, waiting in slices so that the
+ * done flag is seen.
+ */
+static int shm_drain(void * context, const unsigned char * data, size_t * lengthp)
+{
+    rngshm_t * rp = (rngshm_t *)context;
+    unsigned char * region;
+    size_t length;
+    size_t reserved;
+    int last;
+
+    length = admit(*lengthp, &last);
+    *lengthp = 0;
+
+    while (length > 0) {
+        region = (unsigned char *)rngshm_reserve(rp, length, &reserved);
+        if (reserved == 0) {
+            if (done) {
+                return 1;
+            }
+            if ((rngshm_await(rp, SLICE) < 0) && (errno != ETIMEDOUT) && (errno != EINTR)) {
+                return -1;
+            }
+            continue;
+        }
+        memcpy(region, data, reserved);
+        rngshm_publish(rp, reserved);
+        data += reserved;
+        length -= reserved;
+        *lengthp += reserved;
+    }
+
+    return last ? 1 : 0;
+}
+
+/*******************************************************************************
+ * KINDS
+ ******************************************************************************/
+
+static const kind_t KINDS[] = {
+    { "rdrand",     PIPELINE_SOURCE,    random_open,        0,              { random_fill, }, },
+    { "rdseed",     PIPELINE_SOURCE,    random_open,        0,              { random_fill, }, },
+    { "getrandom",  PIPELINE_SOURCE,    random_open,        0,              { random_fill, }, },
+    { "device",     PIPELINE_SOURCE,    device_open,        device_close,   { device_fill, }, },
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    { "quantis",    PIPELINE_SOURCE,    quantis_open,       quantis_close,  { quantis_fill, }, },
+#endif
+    { "health",     PIPELINE_FILTER,    health_open,        0,              { 0, health_filter, }, },
+    { "vonneumann", PIPELINE_FILTER,    vonneumann_open,    0,              { 0, vonneumann_filter, }, },
+    { "hash",       PIPELINE_FILTER,    hash_open,          hash_close,     { 0, hash_filter, }, },
+    { "drbg",       PIPELINE_GENERATOR, drbg_open,          0,              { 0, 0, drbg_seed, drbg_generate, }, },
+    { "file",       PIPELINE_SINK,      file_open,          file_close,     { 0, 0, 0, 0, file_drain, }, },
+    { "stdout",     PIPELINE_SINK,      file_open,          file_close,     { 0, 0, 0, 0, file_drain, }, },
+    { "pool",       PIPELINE_SINK,      pool_open,          pool_close,     { 0, 0, 0, 0, pool_drain, }, },
+    { "shm",        PIPELINE_SINK,      shm_open_stage,     shm_close,      { 0, 0, 0, 0, shm_drain, }, },
+};
+
+static const char * ROLES[] = { "source", "filter", "generator", "sink", };
+
+/**
+ * Parse KIND[:ARGUMENT][@CPU] into a stage. The stage keeps the whole
+ * specification, as its name, and a copy cut into words, into which its
+ * argument points.
+ * @return 0 for success or <0 with errno set.
+ */
+static int parse(stage_t * sp, const char * spec)
+{
+    char * at;
+    char * colon;
+    char * end = (char *)0;
+    size_t ii;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->cpu = -1;
+
+    sp->spec = strdup(spec);
+    sp->words = strdup(spec);
+    if ((sp->spec == (char *)0) || (sp->words == (char *)0)) {
+        return -1;
+    }
+
+    at = strrchr(sp->words, '@');
+    if (at != (char *)0) {
+        *(at++) = '\0';
+        sp->cpu = strtol(at, &end, 0);
+        if ((*end != '\0') || (sp->cpu < 0) || (sp->cpu >= CPU_SETSIZE)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    colon = strchr(sp->words, ':');
+    if (colon != (char *)0) {
+        *(colon++) = '\0';
+        sp->argument = colon;
+    }
+
+    for (ii = 0; ii < (sizeof(KINDS) / sizeof(KINDS[0])); ++ii) {
+        if (strcmp(sp->words, KINDS[ii].name) == 0) {
+            sp->kind = &KINDS[ii];
+            return 0;
+        }
+    }
+
+    errno = EINVAL;
+
+    return -1;
+}
+
+/**
+ * Add a stage given as a string.
+ * @return 0 for success or <0 for an error.
+ */
+static int add(stage_t ** stagesp, int * nstagesp, const char * spec)
+{
+    stage_t * stages;
+
+    stages = (stage_t *)realloc(*stagesp, (*nstagesp + 1) * sizeof(stage_t));
+    if (stages == (stage_t *)0) {
+        perror("realloc");
+        return -1;
+    }
+    *stagesp = stages;
+
+    if (parse(&stages[*nstagesp], spec) < 0) {
+        perror(spec);
+        free(stages[*nstagesp].spec);
+        free(stages[*nstagesp].words);
+        return -1;
+    }
+
+    ++*nstagesp;
+
+    return 0;
+}
+
+/**
+ * Add the stages in a configuration file, one per line, ignoring blank
+ * lines and those beginning with a #.
+ * @return 0 for success or <0 for an error.
+ */
+static int configure(const char * path, stage_t ** stagesp, int * nstagesp)
+{
+    FILE * fp;
+    char line[512];
+    char * here;
+    char * there;
+    int rc = 0;
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != (char *)0) {
+        for (here = line; isspace((unsigned char)*here); ++here) {
+            /* Do nothing. */
+        }
+        for (there = here; (*there != '\0') && !isspace((unsigned char)*there); ++there) {
+            /* Do nothing. */
+        }
+        *there = '\0';
+        if ((*here == '#') || (*here == '\0')) {
+            continue;
+        }
+        rc = add(stagesp, nstagesp, here);
+        if (rc < 0) {
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return rc;
+}
+
+/*******************************************************************************
+ * REPORT
+ ******************************************************************************/
+
+static void report(pipeline_t * pp, const stage_t * stages, uint64_t start)
+{
+    pipeline_statistics_t statistics;
+    double elapsed;
+    int ii;
+
+    elapsed = (now() - start) / 1000000000.0;
+    if (elapsed <= 0.0) {
+        elapsed = 1e-9;
+    }
+
+    for (ii = 0; ii < pipeline_count(pp); ++ii) {
+        pipeline_statistics(pp, ii, &statistics);
+        fprintf(stderr, "%s: stage=%d spec=\"%s\" role=%s cpu=%d buffers=%llu bytes=%llu bytes/second=%.0f waits=%llu waited=%.3fs queue=%zu/%zu peak=%zu mean=%.2f", program, ii, statistics.name, ROLES[statistics.role], statistics.cpu, (unsigned long long)statistics.buffers, (unsigned long long)statistics.bytes, statistics.bytes / elapsed, (unsigned long long)statistics.waits, statistics.waited / 1000000000.0, statistics.occupancy, statistics.capacity, statistics.peak, statistics.mean);
+        if (stages[ii].kind->operations.filter == health_filter) {
+            fprintf(stderr, " alarms=%llu", (unsigned long long)__atomic_load_n(&stages[ii].alarms, __ATOMIC_RELAXED));
+        }
+        if (statistics.error != 0) {
+            fprintf(stderr, " error=\"%s\"", strerror(statistics.error));
+        }
+        fputc('\n', stderr);
+    }
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+static void usage(void)
+{
+    size_t ii;
+
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -u ] [ -b BYTES ] [ -n BUFFERS ] [ -p SECONDS ] [ -t BYTES ] [ -f CONFIG ] [ STAGE ... ]\n", program);
+    fprintf(stderr, "       -b BYTES        Make each buffer this many bytes (default 65536).\n");
+    fprintf(stderr, "       -f CONFIG       Read stages from this file, one per line.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n BUFFERS      Give each link this many buffers (default 16).\n");
+    fprintf(stderr, "       -p SECONDS      Report every this many seconds.\n");
+    fprintf(stderr, "       -t BYTES        Stop after the sink has taken this many bytes.\n");
+    fprintf(stderr, "       -u              Leave the stages unpinned.\n");
+    fprintf(stderr, "       -v              Report the configuration.\n");
+    fprintf(stderr, "       STAGE is KIND[:ARGUMENT][@CPU] where KIND is");
+    for (ii = 0; ii < (sizeof(KINDS) / sizeof(KINDS[0])); ++ii) {
+        fprintf(stderr, " %s", KINDS[ii].name);
+    }
+    fprintf(stderr, ".\n");
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int unpinned = 0;
+    unsigned long buffers = 16;
+    long period = 0;
+    const char * config = (const char *)0;
+    stage_t * stages = (stage_t *)0;
+    int nstages = 0;
+    int opened = 0;
+    pipeline_t * pp = (pipeline_t *)0;
+    struct sigaction action = { 0 };
+    struct timespec slice = { 0, 100000000L };
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int ncpus = 0;
+    uint64_t start = 0;
+    uint64_t next = 0;
+    pipeline_statistics_t statistics;
+    char * end = (char *)0;
+    int ii;
+    int rc;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:f:hn:p:t:uv")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'f':
+            config = optarg;
+            break;
+
+        case 'n':
+            buffers = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (buffers == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (period < 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'u':
+            unpinned = !0;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage();
+            break;
+        }
+
+        if ((config != (const char *)0) && (configure(config, &stages, &nstages) < 0)) {
+            break;
+        }
+
+        for (ii = optind; ii < argc; ++ii) {
+            if (add(&stages, &nstages, argv[ii]) < 0) {
+                break;
+            }
+        }
+        if (ii < argc) {
+            break;
+        }
+
+        if (nstages < 2) {
+            usage();
+            break;
+        }
+
+        /*
+         * Pin the stages not given a processor round robin over the ones
+         * this process may run on.
+         */
+
+        if (!unpinned && (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)) {
+            for (ii = 0; ii < CPU_SETSIZE; ++ii) {
+                if (CPU_ISSET(ii, &allowed)) {
+                    cpus[ncpus++] = ii;
+                }
+            }
+        }
+
+        for (ii = 0; ii < nstages; ++ii) {
+            if ((stages[ii].cpu < 0) && (ncpus > 0)) {
+                stages[ii].cpu = cpus[ii % ncpus];
+            }
+        }
+
+        action.sa_handler = handler;
+        if ((sigaction(SIGINT, &action, (struct sigaction *)0) < 0) || (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) || (sigaction(SIGHUP, &action, (struct sigaction *)0) < 0)) {
+            perror("sigaction");
+            break;
+        }
+        signal(SIGPIPE, SIG_IGN);
+
+        pp = pipeline_create(buffers, size, &done);
+        if (pp == (pipeline_t *)0) {
+            perror("pipeline_create");
+            break;
+        }
+
+        for (opened = 0; opened < nstages; ++opened) {
+            if ((*(stages[opened].kind->open))(&stages[opened]) < 0) {
+                perror(stages[opened].spec);
+                break;
+            }
+            if (pipeline_append(pp, stages[opened].spec, stages[opened].kind->role, &(stages[opened].kind->operations), stages[opened].context, stages[opened].cpu) < 0) {
+                perror(stages[opened].spec);
+                ++opened;
+                break;
+            }
+        }
+        if (opened < nstages) {
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: buffers=%lu bytes=%zu limit=%llu period=%ld\n", program, buffers, size, (unsigned long long)limit, period);
+            for (ii = 0; ii < nstages; ++ii) {
+                fprintf(stderr, "%s: stage=%d spec=\"%s\" kind=%s role=%s argument=\"%s\" cpu=%d\n", program, ii, stages[ii].spec, stages[ii].kind->name, ROLES[stages[ii].kind->role], (stages[ii].argument != (const char *)0) ? stages[ii].argument : "", stages[ii].cpu);
+                if (stages[ii].kind->operations.filter == health_filter) {
+                    fprintf(stderr, "%s: stage=%d rct=%llu apt=%llu window=%d\n", program, ii, (unsigned long long)((health_t *)stages[ii].context)->rctcutoff, (unsigned long long)((health_t *)stages[ii].context)->aptcutoff, APTWINDOW);
+                }
+            }
+        }
+
+        start = now();
+        next = start + (period * 1000000000ULL);
+
+        if (pipeline_start(pp) < 0) {
+            perror("pipeline_start");
+            break;
+        }
+
+        while (!done) {
+            (void)nanosleep(&slice, (struct timespec *)0);
+            if (hangup) {
+                hangup = 0;
+                report(pp, stages, start);
+            }
+            if ((period > 0) && (now() >= next)) {
+                report(pp, stages, start);
+                next += period * 1000000000ULL;
+            }
+        }
+
+        rc = pipeline_join(pp);
+
+        report(pp, stages, start);
+
+        if (rc < 0) {
+            for (ii = 0; ii < nstages; ++ii) {
+                pipeline_statistics(pp, ii, &statistics);
+                if (statistics.error != 0) {
+                    errno = statistics.error;
+                    perror(statistics.name);
+                }
+            }
+            break;
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    for (ii = 0; ii < opened; ++ii) {
+        if (stages[ii].kind->close != 0) {
+            (*(stages[ii].kind->close))(&stages[ii]);
+        }
+    }
+
+    pipeline_destroy(pp);
+
+    for (ii = 0; ii < nstages; ++ii) {
+        free(stages[ii].spec);
+        free(stages[ii].words);
+    }
+    free(stages);
+
+    return xc;
+}
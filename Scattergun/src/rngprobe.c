@@ -0,0 +1,828 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Probe<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngprobe [ -h ] [ -v ] [ -n ] [ -o PATH ] [ -d MILLISECONDS ] [ -m BYTES ] [ -t THREADS ] [ PATH ... ]
+ *
+ * OPTIONS
+ *
+ * -d MILLISECONDS  Measure each read size and thread count this long (default 500).
+ * -h               Display this menu.
+ * -m BYTES         Try read sizes up to this many bytes (default 65536).
+ * -n               Only list the sources found, without measuring them.
+ * -o PATH          Write the profile here instead of to stdout.
+ * -t THREADS       Try up to this many threads (default one per online processor).
+ * -v               Report every measurement to stderr.
+ *
+ * EXAMPLES
+ *
+ * rngprobe -n
+ *
+ * sudo rngprobe -v -o /usr/local/etc/scattergun.profile
+ *
+ * rngprobe -d 2000 -m 1048576 /var/run/quantis.fifo
+ *
+ * ABSTRACT
+ *
+ * Finds the entropy sources present on this host, measures the throughput
+ * of each over a sweep of read sizes and thread counts, and writes a tuning
+ * profile, one line per source, that rate -F and quantistool -F can load
+ * instead of leaving the read size to a guess. The sources it looks for are
+ * /dev/hwrng, the device nodes that the rules in fs/etc/udev/rules.d
+ * create, the rdrand and rdseed instructions if cpuid says the processor
+ * has them, and, when it is linked with the Quantis library, every PCI and
+ * USB Quantis unit; any other PATHs, like FIFOs fed by a generator, are
+ * measured too. The BitBabbler and Infinite Noise nodes are listed but not
+ * measured, since they are read by their own programs, seedd and infnoise.
+ *
+ * Each source is measured first with one thread at every power of two read
+ * size from 64 bytes (from 512 for a Quantis, whose USB packet size that
+ * is, and 2, 4, and 8 bytes for the 16, 32, and 64-bit instructions) up to
+ * BYTES, and then at the best read size with every power of two number of
+ * threads up to THREADS, each thread opening the source for itself. The
+ * smallest read size, and then the fewest threads, that come within five
+ * percent of the best throughput are chosen, since a larger read or
+ * another thread that gains no more than that only adds latency and load.
+ * A Quantis unit is read by one thread, as quantistool does. A read still
+ * blocked at the end of a measurement is interrupted after a grace period,
+ * so that a source that has stopped cannot hang the probe. The profile is
+ * written under a temporary name and renamed.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(__x86_64__)
+#   include <cpuid.h>
+#   include <immintrin.h>
+#endif
+#if defined(SCATTERGUN_HAS_QUANTIS)
+#   include "Quantis.h"
+#endif
+#include "profile.h"
+
+enum {
+    SMALLEST = 64,              /* Smallest read size tried for a device. */
+    PACKET = 512,               /* Smallest read size tried for a Quantis. */
+    CHECK = 1024,               /* Instructions between looks at the clock. */
+    RDRAND_TRIES = 10,          /* Intel recommends ten retries. */
+    RDSEED_TRIES = 100,
+};
+
+static const double NEAR = 0.95;
+
+enum kind { DEVICE = 0, RDRAND = 1, RDSEED = 2, QUANTIS = 3, };
+
+/**
+ * These are the nodes that the udev rules create, or their patterns.
+ */
+static const char * DEVICES[] = {
+    "/dev/hwrng",
+    "/dev/TrueRNG",
+    "/dev/TrueRNGpro",
+    "/dev/NeuG",
+    "/dev/OneRNG",
+    "/dev/chaoskey*",
+};
+
+/**
+ * These are the nodes that the udev rules create for devices that are read
+ * by their own programs.
+ */
+static const char * DRIVEN[][2] = {
+    { "/dev/BitBabbler", "seedd", },
+    { "/dev/InfiniteNoise", "infnoise", },
+};
+
+static const char * program = "rngprobe";
+static int verbose = 0;
+static long milliseconds = 500;
+static size_t maximum = 65536;
+static long most = 0;
+
+/**
+ * This is one source to be measured.
+ */
+typedef struct Source {
+    char name[PROFILE_SOURCE];
+    enum kind kind;
+    const char * path;
+    int type;
+    unsigned int number;
+} source_t;
+
+/**
+ * This is one thread of a measurement.
+ */
+typedef struct Trial {
+    pthread_t thread;
+    const source_t * sp;
+    pthread_barrier_t * barrier;
+    size_t size;
+    uint64_t start;
+    uint64_t deadline;
+    uint64_t last;              /* Time the last read completed. */
+    uint64_t bytes;
+    int error;
+    int running;
+} trial_t;
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void handler(int signum)
+{
+    /* Do nothing: this only interrupts a read. */
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n ] [ -o PATH ] [ -d MILLISECONDS ] [ -m BYTES ] [ -t THREADS ] [ PATH ... ]\n", program);
+    fprintf(stderr, "       -d MILLISECONDS  Measure each read size and thread count this long.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -m BYTES         Try read sizes up to this many bytes.\n");
+    fprintf(stderr, "       -n               Only list the sources found.\n");
+    fprintf(stderr, "       -o PATH          Write the profile here instead of to stdout.\n");
+    fprintf(stderr, "       -t THREADS       Try up to this many threads.\n");
+    fprintf(stderr, "       -v               Report every measurement.\n");
+}
+
+/*******************************************************************************
+ * READERS
+ ******************************************************************************/
+
+static void device(trial_t * tp)
+{
+    unsigned char * buffer;
+    ssize_t rc;
+    int fd;
+
+    buffer = (unsigned char *)malloc(tp->size);
+    fd = open(tp->sp->path, O_RDONLY);
+    if (fd < 0) {
+        tp->error = errno;
+    } else if (buffer == (unsigned char *)0) {
+        tp->error = ENOMEM;
+    } else {
+        /* Do nothing. */
+    }
+
+    pthread_barrier_wait(tp->barrier);
+    tp->start = now();
+
+    while ((tp->error == 0) && (tp->last < tp->deadline)) {
+        rc = read(fd, buffer, tp->size);
+        if (rc < 0) {
+            tp->error = errno;
+        } else if (rc == 0) {
+            tp->error = ENODATA;
+        } else {
+            tp->bytes += rc;
+            tp->last = now();
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    free(buffer);
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("rdrnd")))
+static void rdrand(trial_t * tp)
+{
+    unsigned short word16;
+    unsigned int word32;
+    unsigned long long word64;
+    unsigned int ii;
+    int tries;
+    int ok;
+
+    pthread_barrier_wait(tp->barrier);
+    tp->start = now();
+
+    while (tp->last < tp->deadline) {
+        for (ii = 0; ii < CHECK; ++ii) {
+            for (tries = 0; tries < RDRAND_TRIES; ++tries) {
+                switch (tp->size) {
+                case sizeof(word16):    ok = _rdrand16_step(&word16);   break;
+                case sizeof(word32):    ok = _rdrand32_step(&word32);   break;
+                default:                ok = _rdrand64_step(&word64);   break;
+                }
+                if (ok) {
+                    break;
+                }
+            }
+            if (tries < RDRAND_TRIES) {
+                tp->bytes += tp->size;
+            }
+        }
+        tp->last = now();
+    }
+}
+
+__attribute__((target("rdseed")))
+static void rdseed(trial_t * tp)
+{
+    unsigned short word16;
+    unsigned int word32;
+    unsigned long long word64;
+    unsigned int ii;
+    int tries;
+    int ok;
+
+    pthread_barrier_wait(tp->barrier);
+    tp->start = now();
+
+    while (tp->last < tp->deadline) {
+        for (ii = 0; ii < CHECK; ++ii) {
+            for (tries = 0; tries < RDSEED_TRIES; ++tries) {
+                switch (tp->size) {
+                case sizeof(word16):    ok = _rdseed16_step(&word16);   break;
+                case sizeof(word32):    ok = _rdseed32_step(&word32);   break;
+                default:                ok = _rdseed64_step(&word64);   break;
+                }
+                if (ok) {
+                    break;
+                }
+                _mm_pause();
+            }
+            if (tries < RDSEED_TRIES) {
+                tp->bytes += tp->size;
+            }
+        }
+        tp->last = now();
+    }
+}
+
+#endif
+
+#if defined(SCATTERGUN_HAS_QUANTIS)
+
+static void quantis(trial_t * tp)
+{
+    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
+    unsigned char * buffer;
+    int rc;
+
+    buffer = (unsigned char *)malloc(tp->size);
+    rc = QuantisOpen((QuantisDeviceType)tp->sp->type, tp->sp->number, &handle);
+    if (rc != QUANTIS_SUCCESS) {
+        tp->error = EIO;
+    } else if (buffer == (unsigned char *)0) {
+        tp->error = ENOMEM;
+    } else {
+        /* Do nothing. */
+    }
+
+    pthread_barrier_wait(tp->barrier);
+    tp->start = now();
+
+    while ((tp->error == 0) && (tp->last < tp->deadline)) {
+        rc = QuantisReadHandled(handle, buffer, tp->size);
+        if (rc < 0) {
+            tp->error = EIO;
+        } else {
+            tp->bytes += rc;
+            tp->last = now();
+        }
+    }
+
+    if (handle != (QuantisDeviceHandle *)0) {
+        QuantisClose(handle);
+    }
+
+    free(buffer);
+}
+
+#endif
+
+static void * reader(void * arg)
+{
+    trial_t * tp = (trial_t *)arg;
+
+    switch (tp->sp->kind) {
+#if defined(__x86_64__)
+    case RDRAND:    rdrand(tp);     break;
+    case RDSEED:    rdseed(tp);     break;
+#endif
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    case QUANTIS:   quantis(tp);    break;
+#endif
+    default:        device(tp);     break;
+    }
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * MEASUREMENT
+ ******************************************************************************/
+
+/**
+ * Measure the throughput of a source at one read size and thread count.
+ * @return bytes per second, or <0 if every thread failed.
+ */
+static double measure(const source_t * sp, size_t size, long threads)
+{
+    trial_t * trials;
+    pthread_barrier_t barrier;
+    struct timespec grace;
+    uint64_t deadline;
+    uint64_t start = 0;
+    uint64_t last = 0;
+    uint64_t bytes = 0;
+    double rate = -1.0;
+    long started;
+    long tt;
+    int rc;
+
+    trials = (trial_t *)calloc(threads, sizeof(trial_t));
+    if (trials == (trial_t *)0) {
+        perror("calloc");
+        return -1.0;
+    }
+
+    /*
+     * Every thread that starts waits at the barrier, so the barrier counts
+     * the threads that are started, and the deadline is set only after.
+     */
+
+    pthread_barrier_init(&barrier, (pthread_barrierattr_t *)0, threads + 1);
+
+    for (started = 0; started < threads; ++started) {
+        trials[started].sp = sp;
+        trials[started].barrier = &barrier;
+        trials[started].size = size;
+        trials[started].deadline = ~(uint64_t)0;
+        rc = pthread_create(&trials[started].thread, (pthread_attr_t *)0, reader, &trials[started]);
+        if (rc != 0) {
+            errno = rc;
+            perror("pthread_create");
+            exit(1);
+        }
+        trials[started].running = !0;
+    }
+
+    deadline = now() + (milliseconds * 1000000ULL);
+    for (tt = 0; tt < threads; ++tt) {
+        trials[tt].deadline = deadline;
+    }
+    pthread_barrier_wait(&barrier);
+
+    /*
+     * Join each thread, interrupting any read that is still blocked well
+     * past the deadline.
+     */
+
+    for (tt = 0; tt < threads; ++tt) {
+        while (trials[tt].running) {
+            clock_gettime(CLOCK_REALTIME, &grace);
+            grace.tv_sec += 1 + (milliseconds / 1000);
+            rc = pthread_timedjoin_np(trials[tt].thread, (void **)0, &grace);
+            if (rc == 0) {
+                trials[tt].running = 0;
+            } else if (rc == ETIMEDOUT) {
+                pthread_kill(trials[tt].thread, SIGALRM);
+            } else {
+                errno = rc;
+                perror("pthread_timedjoin_np");
+                exit(1);
+            }
+        }
+    }
+
+    pthread_barrier_destroy(&barrier);
+
+    for (tt = 0; tt < threads; ++tt) {
+        if ((trials[tt].bytes > 0) && ((start == 0) || (trials[tt].start < start))) {
+            start = trials[tt].start;
+        }
+        if (trials[tt].last > last) {
+            last = trials[tt].last;
+        }
+        bytes += trials[tt].bytes;
+    }
+
+    if (bytes > 0) {
+        rate = bytes / ((last - start) / 1000000000.0);
+    } else {
+        for (tt = 0; tt < threads; ++tt) {
+            if (trials[tt].error != 0) {
+                errno = trials[tt].error;
+                if (verbose) {
+                    perror(sp->name);
+                }
+                break;
+            }
+        }
+    }
+
+    if (verbose) {
+        fprintf(stderr, "%s: source=\"%s\" size=%zu threads=%ld bytes=%llu bytes/second=%.0f\n", program, sp->name, size, threads, (unsigned long long)bytes, rate);
+    }
+
+    free(trials);
+
+    return rate;
+}
+
+/**
+ * Sweep the read sizes and then the thread counts of a source.
+ * @return 0 if the source could be read, <0 otherwise.
+ */
+static int sweep(const source_t * sp, profile_entry_t * ep)
+{
+    double rates[64];
+    size_t sizes[64];
+    long counts[64];
+    size_t size;
+    size_t smallest;
+    size_t largest;
+    long threads;
+    double best;
+    int nn;
+    int ii;
+
+    switch (sp->kind) {
+    case RDRAND:
+    case RDSEED:
+        smallest = sizeof(uint16_t);
+        largest = sizeof(uint64_t);
+        break;
+    case QUANTIS:
+        smallest = PACKET;
+        largest = (maximum > PACKET) ? maximum : PACKET;
+        break;
+    default:
+        smallest = (maximum < SMALLEST) ? maximum : SMALLEST;
+        largest = maximum;
+        break;
+    }
+
+    best = -1.0;
+    for (nn = 0, size = smallest; (size <= largest) && (nn < 64); size *= 2, ++nn) {
+        sizes[nn] = size;
+        rates[nn] = measure(sp, size, 1);
+        if (rates[nn] > best) {
+            best = rates[nn];
+        }
+        if ((nn == 0) && (rates[nn] < 0.0)) {
+            return -1;
+        }
+    }
+
+    if (!(best > 0.0)) {
+        return -1;
+    }
+
+    for (ii = 0; rates[ii] < (NEAR * best); ++ii) {
+        /* Do nothing. */
+    }
+    ep->size = sizes[ii];
+
+    /*
+     * A Quantis unit has one reader, as in quantistool.
+     */
+
+    best = rates[ii];
+    nn = 0;
+    counts[nn] = 1;
+    rates[nn++] = best;
+    if (sp->kind != QUANTIS) {
+        for (threads = 2; (threads <= most) && (nn < 64); threads *= 2, ++nn) {
+            counts[nn] = threads;
+            rates[nn] = measure(sp, ep->size, threads);
+            if (rates[nn] > best) {
+                best = rates[nn];
+            }
+        }
+    }
+
+    for (ii = 0; rates[ii] < (NEAR * best); ++ii) {
+        /* Do nothing. */
+    }
+    ep->threads = counts[ii];
+    ep->rate = rates[ii];
+
+    strncpy(ep->source, sp->name, sizeof(ep->source));
+    ep->source[sizeof(ep->source) - 1] = '\0';
+
+    return 0;
+}
+
+/*******************************************************************************
+ * DISCOVERY
+ ******************************************************************************/
+
+static int add(source_t ** sourcesp, int * nsourcesp, const char * name, enum kind kind, const char * path, int type, unsigned int number)
+{
+    source_t * sources;
+
+    sources = (source_t *)realloc(*sourcesp, (*nsourcesp + 1) * sizeof(source_t));
+    if (sources == (source_t *)0) {
+        perror("realloc");
+        return -1;
+    }
+    *sourcesp = sources;
+
+    memset(&sources[*nsourcesp], 0, sizeof(sources[*nsourcesp]));
+    strncpy(sources[*nsourcesp].name, name, sizeof(sources[*nsourcesp].name) - 1);
+    sources[*nsourcesp].kind = kind;
+    sources[*nsourcesp].path = path;
+    sources[*nsourcesp].type = type;
+    sources[*nsourcesp].number = number;
+    *nsourcesp += 1;
+
+    return 0;
+}
+
+static int discover(source_t ** sourcesp, int * nsourcesp, glob_t * gp)
+{
+    int flags = 0;
+    size_t ii;
+#if defined(__x86_64__)
+    unsigned int a = 0;
+    unsigned int b = 0;
+    unsigned int c = 0;
+    unsigned int d = 0;
+#endif
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    static const QuantisDeviceType TYPES[] = { QUANTIS_DEVICE_PCI, QUANTIS_DEVICE_USB, };
+    static const char * BUSES[] = { "PCI", "USB", };
+    char name[PROFILE_SOURCE];
+    int count;
+    int jj;
+#endif
+
+    for (ii = 0; ii < (sizeof(DEVICES) / sizeof(DEVICES[0])); ++ii) {
+        (void)glob(DEVICES[ii], flags, (int (*)(const char *, int))0, gp);
+        flags = GLOB_APPEND;
+    }
+
+    for (ii = 0; ii < gp->gl_pathc; ++ii) {
+        if (access(gp->gl_pathv[ii], R_OK) < 0) {
+            fprintf(stderr, "%s: source=\"%s\" unreadable\n", program, gp->gl_pathv[ii]);
+        } else if (add(sourcesp, nsourcesp, gp->gl_pathv[ii], DEVICE, gp->gl_pathv[ii], 0, 0) < 0) {
+            return -1;
+        } else {
+            /* Do nothing. */
+        }
+    }
+
+    for (ii = 0; ii < (sizeof(DRIVEN) / sizeof(DRIVEN[0])); ++ii) {
+        if (access(DRIVEN[ii][0], F_OK) == 0) {
+            fprintf(stderr, "%s: source=\"%s\" program=\"%s\"\n", program, DRIVEN[ii][0], DRIVEN[ii][1]);
+        }
+    }
+
+#if defined(__x86_64__)
+    if (__get_cpuid(1, &a, &b, &c, &d) && ((c & bit_RDRND) != 0)) {
+        if (add(sourcesp, nsourcesp, "rdrand", RDRAND, (const char *)0, 0, 0) < 0) {
+            return -1;
+        }
+    }
+
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && ((b & bit_RDSEED) != 0)) {
+        if (add(sourcesp, nsourcesp, "rdseed", RDSEED, (const char *)0, 0, 0) < 0) {
+            return -1;
+        }
+    }
+#endif
+
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    for (ii = 0; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
+        count = QuantisCount(TYPES[ii]);
+        for (jj = 0; jj < count; ++jj) {
+            snprintf(name, sizeof(name), "quantis:%s:%d", BUSES[ii], jj);
+            if (add(sourcesp, nsourcesp, name, QUANTIS, (const char *)0, TYPES[ii], jj) < 0) {
+                return -1;
+            }
+        }
+    }
+#endif
+
+    return 0;
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int listing = 0;
+    const char * path = (const char *)0;
+    char * temporary = (char *)0;
+    source_t * sources = (source_t *)0;
+    int nsources = 0;
+    profile_entry_t entry;
+    glob_t globbed = { 0 };
+    struct sigaction sigalrm = { 0 };
+    char host[256];
+    char stamp[64];
+    time_t clock;
+    struct tm broken;
+    FILE * fp = (FILE *)0;
+    int measured = 0;
+    int ii;
+    char * end = (char *)0;
+    int rc;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "d:hm:no:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            milliseconds = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (milliseconds <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            maximum = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (maximum == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'n':
+            listing = !0;
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 't':
+            most = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (most <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage();
+            break;
+        }
+
+        if (most == 0) {
+            most = sysconf(_SC_NPROCESSORS_ONLN);
+            if (most <= 0) {
+                most = 1;
+            }
+        }
+
+        sigalrm.sa_handler = handler;
+        if (sigaction(SIGALRM, &sigalrm, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        if (discover(&sources, &nsources, &globbed) < 0) {
+            break;
+        }
+
+        for (ii = optind; ii < argc; ++ii) {
+            if (add(&sources, &nsources, argv[ii], DEVICE, argv[ii], 0, 0) < 0) {
+                break;
+            }
+        }
+        if (ii < argc) {
+            break;
+        }
+
+        if (listing) {
+            for (ii = 0; ii < nsources; ++ii) {
+                printf("%s\n", sources[ii].name);
+            }
+            xc = 0;
+            break;
+        }
+
+        if (path == (const char *)0) {
+            fp = stdout;
+        } else if ((temporary = (char *)malloc(strlen(path) + 32)) == (char *)0) {
+            perror("malloc");
+            break;
+        } else {
+            sprintf(temporary, "%s.%d", path, getpid());
+            fp = fopen(temporary, "w");
+            if (fp == (FILE *)0) {
+                perror(temporary);
+                break;
+            }
+        }
+
+        if (gethostname(host, sizeof(host)) < 0) {
+            strcpy(host, "unknown");
+        }
+        host[sizeof(host) - 1] = '\0';
+        clock = time((time_t *)0);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&clock, &broken));
+
+        fprintf(fp, "# %s host=%s time=%s milliseconds=%ld maximum=%zu threads=%ld\n", program, host, stamp, milliseconds, maximum, most);
+        fprintf(fp, "# SOURCE BYTES THREADS BYTES/SECOND\n");
+
+        for (ii = 0; ii < nsources; ++ii) {
+            if (sweep(&sources[ii], &entry) < 0) {
+                fprintf(stderr, "%s: source=\"%s\" failed\n", program, sources[ii].name);
+                continue;
+            }
+            profile_print(fp, &entry);
+            fflush(fp);
+            ++measured;
+        }
+
+        if (fp != stdout) {
+            rc = fclose(fp);
+            fp = (FILE *)0;
+            if (rc == EOF) {
+                perror(temporary);
+                (void)unlink(temporary);
+                break;
+            }
+            if (rename(temporary, path) < 0) {
+                perror(path);
+                (void)unlink(temporary);
+                break;
+            }
+        }
+
+        xc = (measured > 0) ? 0 : 1;
+
+    } while (0);
+
+    if ((fp != (FILE *)0) && (fp != stdout)) {
+        fclose(fp);
+        (void)unlink(temporary);
+    }
+
+    free(temporary);
+    free(sources);
+    globfree(&globbed);
+
+    return xc;
+}
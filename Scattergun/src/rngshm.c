@@ -0,0 +1,556 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Shared Memory Ring<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Each cursor and each futex is on its own cache line, so that consumers
+ * claiming do not slow the producer publishing, and each consumer slot is
+ * on its own cache line, so that consumers counting do not slow each other.
+ * The cursors count bytes and are 64 bits wide, so they never wrap; their
+ * position in the ring is the count modulo the capacity. Futexes are used
+ * without FUTEX_PRIVATE_FLAG since they are shared among processes, and are
+ * woken only when their waiter counts say someone is sleeping, so the fast
+ * paths of both the producer and the consumers have no system calls.
+ * Sleepers wake at least once a second to check that the process at the
+ * other end still exists.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "rngshm.h"
+
+enum {
+    MAGIC = 0x52534847,         /* "GHSR" little endian. */
+    VERSION = 1,
+    LINE = 64,                  /* Bytes in a cache line. */
+    SLICE = 1000,               /* Longest sleep in milliseconds. */
+};
+
+typedef struct Slot {
+    int32_t pid;
+    uint64_t claims;
+    uint64_t bytes;
+    uint64_t waits;
+    uint64_t retries;
+} __attribute__((aligned(LINE))) slot_t;
+
+/**
+ * This is the layout of the shared memory object. The ring itself follows
+ * at offset, which is a multiple of the page size.
+ */
+typedef struct Ring {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t offset;
+    int32_t producer;
+    uint64_t stalls;
+    uint64_t wakes;
+    uint64_t produced __attribute__((aligned(LINE)));
+    uint64_t reserved;
+    uint64_t claimed __attribute__((aligned(LINE)));
+    uint32_t filled __attribute__((aligned(LINE)));
+    uint32_t sleepers;
+    uint32_t emptied __attribute__((aligned(LINE)));
+    uint32_t starving;
+    slot_t slots[RNGSHM_CONSUMERS];
+} ring_t;
+
+struct RngShm {
+    ring_t * ring;
+    unsigned char * data;
+    size_t length;
+    uint64_t mask;
+    slot_t * slot;
+    char * name;
+    int producer;
+};
+
+/*******************************************************************************
+ * HELPERS
+ ******************************************************************************/
+
+static int futex_wait(uint32_t * word, uint32_t expected, int milliseconds)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_nsec = (milliseconds % 1000) * 1000000L;
+
+    return syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, (uint32_t *)0, 0);
+}
+
+static void futex_wake(uint32_t * word)
+{
+    (void)syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, (struct timespec *)0, (uint32_t *)0, 0);
+}
+
+static int64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((int64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static int alive(int32_t pid)
+{
+    return (pid != 0) && ((kill(pid, 0) == 0) || (errno != ESRCH));
+}
+
+static rngshm_t * map(const char * name, int fd, size_t length)
+{
+    rngshm_t * rp;
+    void * pointer;
+
+    pointer = mmap((void *)0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pointer == MAP_FAILED) {
+        return (rngshm_t *)0;
+    }
+
+    rp = (rngshm_t *)calloc(1, sizeof(*rp));
+    if (rp == (rngshm_t *)0) {
+        munmap(pointer, length);
+        return (rngshm_t *)0;
+    }
+
+    rp->name = strdup(name);
+    if (rp->name == (char *)0) {
+        munmap(pointer, length);
+        free(rp);
+        return (rngshm_t *)0;
+    }
+
+    rp->ring = (ring_t *)pointer;
+    rp->length = length;
+
+    return rp;
+}
+
+/*******************************************************************************
+ * PRODUCER
+ ******************************************************************************/
+
+rngshm_t * rngshm_create(const char * name, size_t capacity, mode_t mode)
+{
+    rngshm_t * rp = (rngshm_t *)0;
+    ring_t * ring;
+    size_t offset;
+    size_t size;
+    long page;
+    int fd;
+
+    for (size = LINE; size < capacity; size <<= 1) {
+        if (size > (SIZE_MAX / 4)) {
+            errno = EINVAL;
+            return (rngshm_t *)0;
+        }
+    }
+
+    page = sysconf(_SC_PAGESIZE);
+    offset = ((sizeof(ring_t) + page - 1) / page) * page;
+
+    (void)shm_unlink(name);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd < 0) {
+        return (rngshm_t *)0;
+    }
+
+    do {
+
+        if (fchmod(fd, mode) < 0) {
+            break;
+        }
+
+        if (ftruncate(fd, offset + size) < 0) {
+            break;
+        }
+
+        rp = map(name, fd, offset + size);
+        if (rp == (rngshm_t *)0) {
+            break;
+        }
+
+        ring = rp->ring;
+        ring->version = VERSION;
+        ring->capacity = size;
+        ring->offset = offset;
+        ring->producer = getpid();
+        rp->data = (unsigned char *)ring + offset;
+        rp->mask = size - 1;
+        rp->producer = !0;
+
+        __atomic_store_n(&ring->magic, MAGIC, __ATOMIC_RELEASE);
+
+    } while (0);
+
+    if (rp == (rngshm_t *)0) {
+        (void)shm_unlink(name);
+    }
+
+    close(fd);
+
+    return rp;
+}
+
+void * rngshm_reserve(rngshm_t * rp, size_t want, size_t * lengthp)
+{
+    ring_t * ring = rp->ring;
+    uint64_t produced = ring->produced;
+    uint64_t claimed = __atomic_load_n(&ring->claimed, __ATOMIC_ACQUIRE);
+    uint64_t position = produced & rp->mask;
+    size_t length;
+
+    length = ring->capacity - (produced - claimed);
+    if (length > (ring->capacity - position)) {
+        length = ring->capacity - position;
+    }
+    if (length > want) {
+        length = want;
+    }
+
+    /*
+     * The region may hold bytes that consumers have claimed but are still
+     * copying. Advancing reserved before writing lets them find out.
+     */
+
+    if (length > 0) {
+        __atomic_store_n(&ring->reserved, produced + length, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    *lengthp = length;
+
+    return rp->data + position;
+}
+
+void rngshm_publish(rngshm_t * rp, size_t length)
+{
+    ring_t * ring = rp->ring;
+
+    __atomic_store_n(&ring->produced, ring->produced + length, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ring->filled, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        futex_wake(&ring->filled);
+        ++ring->wakes;
+    }
+}
+
+int rngshm_await(rngshm_t * rp, int milliseconds)
+{
+    ring_t * ring = rp->ring;
+    uint32_t emptied;
+    int rc = 0;
+
+    ++ring->stalls;
+
+    __atomic_add_fetch(&ring->starving, 1, __ATOMIC_SEQ_CST);
+    emptied = __atomic_load_n(&ring->emptied, __ATOMIC_SEQ_CST);
+
+    if ((ring->produced - __atomic_load_n(&ring->claimed, __ATOMIC_SEQ_CST)) >= ring->capacity) {
+        rc = futex_wait(&ring->emptied, emptied, milliseconds);
+        if ((rc < 0) && (errno == EAGAIN)) {
+            rc = 0;
+        }
+    }
+
+    __atomic_sub_fetch(&ring->starving, 1, __ATOMIC_SEQ_CST);
+
+    return rc;
+}
+
+/*******************************************************************************
+ * CONSUMERS
+ ******************************************************************************/
+
+rngshm_t * rngshm_attach(const char * name)
+{
+    rngshm_t * rp = (rngshm_t *)0;
+    ring_t * ring;
+    struct stat status;
+    int32_t pid = getpid();
+    int32_t expected;
+    int fd;
+    int ii;
+
+    fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return (rngshm_t *)0;
+    }
+
+    do {
+
+        if (fstat(fd, &status) < 0) {
+            break;
+        }
+
+        if (status.st_size < sizeof(ring_t)) {
+            errno = EAGAIN;
+            break;
+        }
+
+        rp = map(name, fd, status.st_size);
+        if (rp == (rngshm_t *)0) {
+            break;
+        }
+
+        ring = rp->ring;
+        if ((__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != MAGIC) || (ring->version != VERSION) || ((ring->offset + ring->capacity) != status.st_size)) {
+            rngshm_detach(rp);
+            rp = (rngshm_t *)0;
+            errno = EPROTO;
+            break;
+        }
+
+        rp->data = (unsigned char *)ring + ring->offset;
+        rp->mask = ring->capacity - 1;
+
+        for (ii = 0; ii < RNGSHM_CONSUMERS; ++ii) {
+            expected = 0;
+            if (__atomic_compare_exchange_n(&ring->slots[ii].pid, &expected, pid, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                rp->slot = &ring->slots[ii];
+                break;
+            }
+        }
+
+        if (rp->slot == (slot_t *)0) {
+            rngshm_detach(rp);
+            rp = (rngshm_t *)0;
+            errno = EBUSY;
+            break;
+        }
+
+        rp->slot->claims = 0;
+        rp->slot->bytes = 0;
+        rp->slot->waits = 0;
+        rp->slot->retries = 0;
+
+    } while (0);
+
+    close(fd);
+
+    return rp;
+}
+
+/**
+ * Sleep until the producer publishes, the time runs out, or the producer
+ * goes away.
+ * @return 0 to try again, or <0 with errno set.
+ */
+static int starve(rngshm_t * rp, uint64_t claimed, int64_t deadline)
+{
+    ring_t * ring = rp->ring;
+    int32_t producer;
+    uint32_t filled;
+    int64_t remaining = SLICE;
+    int rc = 0;
+
+    if (deadline >= 0) {
+        remaining = deadline - now();
+        if (remaining <= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        if (remaining > SLICE) {
+            remaining = SLICE;
+        }
+    }
+
+    __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    filled = __atomic_load_n(&ring->filled, __ATOMIC_SEQ_CST);
+
+    do {
+
+        if (__atomic_load_n(&ring->produced, __ATOMIC_SEQ_CST) != claimed) {
+            break;
+        }
+
+        producer = __atomic_load_n(&ring->producer, __ATOMIC_ACQUIRE);
+        if (!alive(producer)) {
+            errno = EPIPE;
+            rc = -1;
+            break;
+        }
+
+        __atomic_store_n(&rp->slot->waits, rp->slot->waits + 1, __ATOMIC_RELAXED);
+
+        if ((futex_wait(&ring->filled, filled, remaining) < 0) && (errno == EINTR)) {
+            rc = -1;
+        }
+
+    } while (0);
+
+    __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+
+    return rc;
+}
+
+ssize_t rngshm_read(rngshm_t * rp, void * buffer, size_t size, int milliseconds)
+{
+    ring_t * ring = rp->ring;
+    slot_t * sp = rp->slot;
+    unsigned char * here = (unsigned char *)buffer;
+    int64_t deadline = (milliseconds < 0) ? -1 : now() + milliseconds;
+    uint64_t claimed;
+    uint64_t produced;
+    uint64_t position;
+    size_t length = 0;
+    size_t part;
+
+    while (length < size) {
+
+        claimed = __atomic_load_n(&ring->claimed, __ATOMIC_ACQUIRE);
+        produced = __atomic_load_n(&ring->produced, __ATOMIC_ACQUIRE);
+
+        if (produced == claimed) {
+            if (starve(rp, claimed, deadline) < 0) {
+                break;
+            }
+            continue;
+        }
+
+        position = claimed & rp->mask;
+        part = size - length;
+        if (part > (produced - claimed)) {
+            part = produced - claimed;
+        }
+        if (part > (ring->capacity - position)) {
+            part = ring->capacity - position;
+        }
+
+        if (!__atomic_compare_exchange_n(&ring->claimed, &claimed, claimed + part, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        if (__atomic_load_n(&ring->starving, __ATOMIC_SEQ_CST) > 0) {
+            __atomic_add_fetch(&ring->emptied, 1, __ATOMIC_SEQ_CST);
+            futex_wake(&ring->emptied);
+        }
+
+        memcpy(here + length, rp->data + position, part);
+
+        /*
+         * If the producer has reserved past a whole ring beyond where the
+         * claim started, some of what was copied may be its newer bytes,
+         * which another consumer may also be given. Discard the copy.
+         */
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((__atomic_load_n(&ring->reserved, __ATOMIC_RELAXED) - claimed) > ring->capacity) {
+            __atomic_store_n(&sp->retries, sp->retries + 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        length += part;
+        __atomic_store_n(&sp->claims, sp->claims + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&sp->bytes, sp->bytes + part, __ATOMIC_RELAXED);
+
+    }
+
+    if (length > 0) {
+        return length;
+    }
+
+    return (size > 0) ? -1 : 0;
+}
+
+/*******************************************************************************
+ * STATISTICS
+ ******************************************************************************/
+
+void rngshm_statistics(rngshm_t * rp, rngshm_statistics_t * sp)
+{
+    ring_t * ring = rp->ring;
+    int ii;
+
+    sp->capacity = ring->capacity;
+    sp->produced = __atomic_load_n(&ring->produced, __ATOMIC_RELAXED);
+    sp->claimed = __atomic_load_n(&ring->claimed, __ATOMIC_RELAXED);
+    sp->stalls = ring->stalls;
+    sp->wakes = ring->wakes;
+    sp->consumers = 0;
+
+    for (ii = 0; ii < RNGSHM_CONSUMERS; ++ii) {
+        if (__atomic_load_n(&ring->slots[ii].pid, __ATOMIC_RELAXED) != 0) {
+            ++sp->consumers;
+        }
+    }
+}
+
+int rngshm_consumer(rngshm_t * rp, int index, rngshm_consumer_t * cp)
+{
+    slot_t * sp = &rp->ring->slots[index];
+    int32_t pid;
+
+    pid = __atomic_load_n(&sp->pid, __ATOMIC_ACQUIRE);
+    if (pid == 0) {
+        return 0;
+    }
+
+    cp->pid = pid;
+    cp->claims = __atomic_load_n(&sp->claims, __ATOMIC_RELAXED);
+    cp->bytes = __atomic_load_n(&sp->bytes, __ATOMIC_RELAXED);
+    cp->waits = __atomic_load_n(&sp->waits, __ATOMIC_RELAXED);
+    cp->retries = __atomic_load_n(&sp->retries, __ATOMIC_RELAXED);
+
+    if (!alive(pid)) {
+        (void)__atomic_compare_exchange_n(&sp->pid, &pid, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+
+    return !0;
+}
+
+/*******************************************************************************
+ * TEARDOWN
+ ******************************************************************************/
+
+void rngshm_detach(rngshm_t * rp)
+{
+    ring_t * ring;
+
+    if (rp == (rngshm_t *)0) {
+        return;
+    }
+
+    ring = rp->ring;
+
+    if (rp->slot != (slot_t *)0) {
+        __atomic_store_n(&rp->slot->pid, 0, __ATOMIC_RELEASE);
+    } else if (rp->producer) {
+        __atomic_store_n(&ring->producer, 0, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&ring->filled, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&ring->filled);
+        (void)shm_unlink(rp->name);
+    } else {
+        /* Do nothing. */
+    }
+
+    munmap(ring, rp->length);
+    free(rp->name);
+    free(rp);
+}
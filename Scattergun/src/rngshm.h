@@ -0,0 +1,155 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_RNGSHM_
+#define _H_COM_DIAG_SCATTERGUN_RNGSHM_
+
+/**
+ * @file
+ * RNG Shared Memory Ring<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * A ring of random bytes in POSIX shared memory with one producer, the
+ * rngshmd broker, and any number of consumer processes. Three cursors count
+ * bytes since the ring was created: produced, up to which the producer has
+ * filled the ring; reserved, up to which it may be writing; and claimed, up
+ * to which consumers have taken bytes. A consumer claims the next bytes by
+ * advancing claimed with a compare and swap, so no byte is ever claimed by
+ * two consumers, then copies them out of the ring, all without a system
+ * call. The producer never writes more than the capacity of the ring past
+ * claimed, but once bytes are claimed it may overwrite them, so after
+ * copying a consumer checks, as with a sequence lock, that reserved has not
+ * passed the bytes it copied; if it has, the copy is discarded and another
+ * claim made. A consumer that finds the ring empty sleeps on a futex that
+ * the producer advances and wakes, only if someone sleeps, when it
+ * publishes; the producer sleeps on another futex when the ring is full.
+ * Each consumer registers in a slot in the ring where it counts its claims,
+ * bytes, waits, and discarded copies, so that the broker can report them.
+ * The functions return <0 with errno set for an error, like the system
+ * calls they wrap.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+enum {
+    RNGSHM_CONSUMERS = 64,      /* Maximum number of attached consumers. */
+};
+
+/**
+ * This is the opaque process local handle of a ring.
+ */
+typedef struct RngShm rngshm_t;
+
+/**
+ * These are the counters of one consumer, in its slot in the ring.
+ */
+typedef struct RngShmConsumer {
+    int32_t pid;                /* Process, or zero if the slot is free. */
+    uint64_t claims;            /* Successful claims. */
+    uint64_t bytes;             /* Bytes delivered. */
+    uint64_t waits;             /* Times the ring was found empty. */
+    uint64_t retries;           /* Copies discarded as overwritten. */
+} rngshm_consumer_t;
+
+/**
+ * These are the counters of the producer and the state of the ring.
+ */
+typedef struct RngShmStatistics {
+    size_t capacity;            /* Bytes in the ring. */
+    uint64_t produced;          /* Bytes published. */
+    uint64_t claimed;           /* Bytes claimed. */
+    uint64_t stalls;            /* Times the producer found the ring full. */
+    uint64_t wakes;             /* Times the producer woke sleeping consumers. */
+    int consumers;              /* Consumers attached. */
+} rngshm_statistics_t;
+
+/**
+ * Create a ring, replacing any ring of the same name, as its producer.
+ * @param name is the shared memory name, e.g. "/scattergun".
+ * @param capacity is the size of the ring in bytes, rounded up to a power
+ * of two.
+ * @param mode is the permission of the shared memory object; consumers
+ * need read and write permission.
+ * @return a handle or NULL with errno set.
+ */
+extern rngshm_t * rngshm_create(const char * name, size_t capacity, mode_t mode);
+
+/**
+ * Attach to an existing ring as a consumer, taking a free slot.
+ * @param name is the shared memory name.
+ * @return a handle or NULL with errno set (EBUSY if there is no free slot).
+ */
+extern rngshm_t * rngshm_attach(const char * name);
+
+/**
+ * Read random bytes from the ring, sleeping while it is empty. Bytes come
+ * only from regions claimed by this call, so no other consumer sees them.
+ * @param rp points to the handle.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param milliseconds is how long to sleep in all, or <0 to sleep forever.
+ * @return the number of bytes read, which is less than size only if the
+ * time ran out (errno ETIMEDOUT) or the producer went away (errno EPIPE).
+ */
+extern ssize_t rngshm_read(rngshm_t * rp, void * buffer, size_t size, int milliseconds);
+
+/**
+ * Reserve the next contiguous free region of the ring for the producer to
+ * fill in place, without sleeping.
+ * @param rp points to the handle.
+ * @param want is the most bytes wanted.
+ * @param lengthp points to where the size of the region, zero if the ring
+ * is full, is stored.
+ * @return a pointer to the region.
+ */
+extern void * rngshm_reserve(rngshm_t * rp, size_t want, size_t * lengthp);
+
+/**
+ * Publish bytes filled in the reserved region, waking any sleeping
+ * consumers.
+ * @param rp points to the handle.
+ * @param length is the number of bytes filled, no more than were reserved.
+ */
+extern void rngshm_publish(rngshm_t * rp, size_t length);
+
+/**
+ * Sleep until consumers make room in a full ring.
+ * @param rp points to the handle.
+ * @param milliseconds is how long to sleep at most.
+ * @return 0 if there is room, or <0 with errno set (ETIMEDOUT, EINTR).
+ */
+extern int rngshm_await(rngshm_t * rp, int milliseconds);
+
+/**
+ * Get the counters of the producer and the state of the ring.
+ * @param rp points to the handle.
+ * @param sp points to where the counters are stored.
+ */
+extern void rngshm_statistics(rngshm_t * rp, rngshm_statistics_t * sp);
+
+/**
+ * Get the counters of a consumer slot, freeing the slot if its process no
+ * longer exists.
+ * @param rp points to the handle.
+ * @param index is the slot, from 0 to RNGSHM_CONSUMERS - 1.
+ * @param cp points to where the counters are stored.
+ * @return true if the slot is in use, false otherwise.
+ */
+extern int rngshm_consumer(rngshm_t * rp, int index, rngshm_consumer_t * cp);
+
+/**
+ * Detach from a ring. A consumer gives up its slot; the producer marks the
+ * ring as abandoned, wakes all consumers, and removes its name.
+ * @param rp points to the handle, which may be NULL.
+ */
+extern void rngshm_detach(rngshm_t * rp);
+
+#endif
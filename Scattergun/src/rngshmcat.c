@@ -0,0 +1,247 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Shared Memory Cat<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngshmcat [ -h ] [ -v ] [ -n NAME ] [ -b BYTES ] [ -c BYTES ] [ -t MILLISECONDS ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES         Claim at most this many bytes at a time (default 4096).
+ * -c BYTES         Stop after this many bytes (default unlimited).
+ * -h               Display this menu.
+ * -n NAME          Attach to this ring (default /scattergun).
+ * -t MILLISECONDS  Give up if the ring stays empty this long (default never).
+ * -v               Report bytes, calls, and throughput to stderr.
+ *
+ * EXAMPLES
+ *
+ * rngshmcat -c 1000000 > random.dat
+ *
+ * rngshmcat -n /scattergun | scattergun.sh
+ *
+ * ABSTRACT
+ *
+ * Attaches to the shared memory ring of an rngshmd broker as a consumer and
+ * copies what it claims to standard output, so that any program that reads
+ * a pipe can share the broker's source with other consumers, and so that
+ * the broker can be tested and measured. Claims are read directly into the
+ * chunks of the output engine. It exits at end of file when the broker goes
+ * away and the ring is empty.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "output.h"
+#include "rngshm.h"
+
+static const char * program = "rngshmcat";
+static volatile int done = 0;
+
+static void handler(int signum)
+{
+    done = !0;
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n NAME ] [ -b BYTES ] [ -c BYTES ] [ -t MILLISECONDS ]\n", program);
+    fprintf(stderr, "       -b BYTES         Claim at most this many bytes at a time.\n");
+    fprintf(stderr, "       -c BYTES         Stop after this many bytes.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -n NAME          Attach to this ring.\n");
+    fprintf(stderr, "       -t MILLISECONDS  Give up if the ring stays empty this long.\n");
+    fprintf(stderr, "       -v               Report bytes, calls, and throughput.\n");
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    const char * name = "/scattergun";
+    size_t size = 4096;
+    uint64_t limit = ~(uint64_t)0;
+    int milliseconds = -1;
+    rngshm_t * rp = (rngshm_t *)0;
+    output_t * op = (output_t *)0;
+    struct sigaction action = { 0 };
+    uint64_t total = 0;
+    uint64_t calls = 0;
+    uint64_t epoch = 0;
+    uint64_t elapsed = 0;
+    unsigned char * buffer;
+    size_t available;
+    ssize_t bytes;
+    char * end = (char *)0;
+    int rc = 0;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:c:hn:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'c':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'n':
+            name = optarg;
+            break;
+
+        case 't':
+            milliseconds = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (milliseconds < 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage();
+            break;
+        }
+
+        rp = rngshm_attach(name);
+        if (rp == (rngshm_t *)0) {
+            perror(name);
+            break;
+        }
+
+        action.sa_handler = handler;
+        sigaction(SIGINT, &action, (struct sigaction *)0);
+        sigaction(SIGTERM, &action, (struct sigaction *)0);
+        signal(SIGPIPE, SIG_IGN);
+
+        op = output_open(STDOUT_FILENO, 0, 0, &done);
+        if (op == (output_t *)0) {
+            perror("output_open");
+            break;
+        }
+
+        epoch = now();
+
+        while ((!done) && (total < limit)) {
+
+            buffer = (unsigned char *)output_buffer(op, &available);
+            if (available > size) {
+                available = size;
+            }
+            if (available > (limit - total)) {
+                available = limit - total;
+            }
+
+            bytes = rngshm_read(rp, buffer, available, milliseconds);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EPIPE) {
+                break;
+            } else {
+                perror(name);
+                rc = -1;
+                break;
+            }
+
+            total += bytes;
+            ++calls;
+
+            rc = output_commit(op, bytes);
+            if (rc < 0) {
+                perror("output_commit");
+            }
+            if (rc != 0) {
+                break;
+            }
+
+        }
+
+        if (rc == 0) {
+            rc = output_flush(op);
+            if (rc < 0) {
+                perror("output_flush");
+            }
+        }
+
+        elapsed = now() - epoch;
+
+        xc = (rc < 0) ? 1 : 0;
+
+    } while (0);
+
+    output_close(op);
+
+    rngshm_detach(rp);
+
+    if (verbose) {
+        fprintf(stderr, "%s: name %s\n", program, name);
+        fprintf(stderr, "%s: bytes %lu\n", program, total);
+        fprintf(stderr, "%s: calls %lu\n", program, calls);
+        fprintf(stderr, "%s: elapsed %lu nanoseconds\n", program, elapsed);
+        fprintf(stderr, "%s: throughput %lf bytes/second\n", program, (elapsed > 0) ? (total * 1000000000.0 / elapsed) : 0.0);
+    }
+
+    return xc;
+}
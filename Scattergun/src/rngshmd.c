@@ -0,0 +1,528 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * RNG Shared Memory Daemon<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * rngshmd [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -n NAME ] [ -s BYTES ] [ -m MODE ] [ -b BYTES ] [ -r SECONDS ] [ -p SECONDS ] [ SOURCE ]
+ *
+ * EXAMPLES
+ *
+ * rngshmd -D -i rngshmd -v /var/run/rdrand.fifo
+ *
+ * seventool -R | rngshmd -v -p 10 -s 4194304
+ *
+ * ABSTRACT
+ *
+ * Brokers one entropy source among many local consumer processes through
+ * a ring in POSIX shared memory, so that they need not each open the device
+ * or make a system call per request. The broker reads SOURCE, a character
+ * device, FIFO, or file, or standard input if none is given, directly into
+ * the ring, and consumers such as rngshmcat, or any program using the
+ * rngshm functions, claim disjoint regions of it with atomic operations
+ * alone, sleeping on a futex only when the ring is empty. The broker sleeps
+ * on a futex when the ring is full, so it reads the source no faster than
+ * its consumers use it. A SOURCE that fails or reaches end of file is
+ * reopened periodically; standard input at end of file ends the broker.
+ * The broker's counters, the fill of the ring, and the claims, bytes,
+ * waits, and discarded copies of every attached consumer are reported on
+ * SIGHUP, at exit, and optionally periodically; consumers that have exited
+ * without detaching are found then and their slots freed. At exit the ring
+ * is marked abandoned, its consumers are woken and see end of file once
+ * they have drained it, and its name is removed. This is part of the
+ * Scattergun project.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "rngshm.h"
+
+static const char * program = "rngshmd";
+static const char * ident = "rngshmd";
+static int debug = 0;
+static int verbose = 0;
+static volatile int done = 0;
+static volatile int report = 0;
+static int daemonize = 0;
+
+/**
+ * These are the counters of the source.
+ */
+typedef struct Source {
+    const char * path;
+    int fd;
+    int failing;
+    uint64_t opens;
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t eofs;
+    uint64_t retry;
+} source_t;
+
+/**
+ * Emit a formatting string to either the system log or to standard error.
+ * @param format is the printf format.
+ */
+static void lprintf(const char * format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (daemonize) {
+        vsyslog(LOG_DEBUG, format, ap);
+    } else {
+        vfprintf(stderr, format, ap);
+    }
+    va_end(ap);
+}
+
+/**
+ * Emit a formatting string to either the system log or to standard error
+ * if verbosity is enabled.
+ * @param format is the printf format.
+ */
+static void lverbosef(const char * format, ...)
+{
+    if (verbose) {
+        va_list ap;
+        va_start(ap, format);
+        if (daemonize) {
+            vsyslog(LOG_DEBUG, format, ap);
+        } else {
+            vfprintf(stderr, format, ap);
+        }
+        va_end(ap);
+    }
+}
+
+/**
+ * Emit a caller provider string and an error message string corresponding to
+ * the current value of the error number (errno) to either the system log or
+ * to standard error.
+ * @param string is the string.
+ */
+static void lerror(const char * string)
+{
+    if (daemonize) {
+        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
+    } else {
+        fprintf(stderr, "%s: %s\n", string, strerror(errno));
+    }
+}
+
+/**
+ * Handle a signal. In the event of a SIGTERM or a SIGINT, the program shuts
+ * down in an orderly fashion. In the event of a SIGHUP, it emits some
+ * statistics to standard error.
+ * @param signum is the number of the incoming signal.
+ */
+static void handler(int signum)
+{
+    if (signum == SIGTERM) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -n NAME ] [ -s BYTES ] [ -m MODE ] [ -b BYTES ] [ -r SECONDS ] [ -p SECONDS ] [ SOURCE ]\n", program);
+    if (nomenu) { return; }
+    lprintf("       -d            Enable debug mode\n");
+    lprintf("       -v            Enable verbose mode\n");
+    lprintf("       -D            Run as a daemon\n");
+    lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    lprintf("       -n NAME       Name the shared memory ring NAME (default /scattergun)\n");
+    lprintf("       -s BYTES      Make the ring BYTES rounded up to a power of two (default 1048576)\n");
+    lprintf("       -m MODE       Give the ring permissions MODE (default 0666)\n");
+    lprintf("       -b BYTES      Read the source at most BYTES at a time (default 4096)\n");
+    lprintf("       -r SECONDS    Reopen a failed source every SECONDS (default 1)\n");
+    lprintf("       -p SECONDS    Report statistics every SECONDS (default never)\n");
+    lprintf("       -h            Print help menu\n");
+    lprintf("       SOURCE        Read SOURCE instead of standard input\n");
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int reopen(source_t * sp)
+{
+    sp->fd = open(sp->path, O_RDONLY | O_CLOEXEC);
+    if (sp->fd < 0) {
+        if (!sp->failing) {
+            lerror(sp->path);
+            sp->failing = !0;
+        }
+        return -1;
+    }
+
+    ++sp->opens;
+    sp->failing = 0;
+    lverbosef("%s: open         \"%s\"\n", program, sp->path);
+
+    return 0;
+}
+
+static void shut(source_t * sp, uint64_t retry)
+{
+    close(sp->fd);
+    sp->fd = -1;
+    sp->retry = retry;
+    lverbosef("%s: close        \"%s\"\n", program, sp->path);
+}
+
+static void statistics(rngshm_t * rp, const source_t * sp, uint64_t elapsed)
+{
+    double seconds = elapsed / 1000000000.0;
+    rngshm_statistics_t ring;
+    rngshm_consumer_t consumer;
+    int ii;
+
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+
+    lprintf("%s: source=\"%s\" opens=%lu reads=%lu bytes=%lu errors=%lu eofs=%lu bytes/second=%.0lf\n", program, sp->path, sp->opens, sp->reads, sp->bytes, sp->errors, sp->eofs, sp->bytes / seconds);
+
+    for (ii = 0; ii < RNGSHM_CONSUMERS; ++ii) {
+        if (rngshm_consumer(rp, ii, &consumer)) {
+            lprintf("%s: consumer=%d pid=%d claims=%lu bytes=%lu waits=%lu retries=%lu bytes/claim=%.0lf\n", program, ii, consumer.pid, consumer.claims, consumer.bytes, consumer.waits, consumer.retries, (consumer.claims > 0) ? ((double)consumer.bytes / consumer.claims) : 0.0);
+        }
+    }
+
+    rngshm_statistics(rp, &ring);
+
+    lprintf("%s: ring capacity=%zu produced=%lu claimed=%lu fill=%lu stalls=%lu wakes=%lu consumers=%d elapsed=%.3lf\n", program, ring.capacity, ring.produced, ring.claimed, ring.produced - ring.claimed, ring.stalls, ring.wakes, ring.consumers, seconds);
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int rc = 0;
+    const char * name = "/scattergun";
+    size_t capacity = 1048576;
+    mode_t mode = 0666;
+    size_t readsize = 4096;
+    uint64_t interval = 1000000000ULL;
+    uint64_t period = 0;
+    source_t source = { "-", STDIN_FILENO, };
+    rngshm_t * rp = (rngshm_t *)0;
+    struct sigaction sigterm = { 0 };
+    struct sigaction sighup = { 0 };
+    struct sigaction sigint = { 0 };
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "dvDi:n:s:m:b:r:p:h")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'i':
+            ident = optarg;
+            break;
+
+        case 'n':
+            name = optarg;
+            if (name[0] != '/') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            capacity = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (capacity == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'm':
+            mode = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || ((mode & ~0777) != 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'b':
+            readsize = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (readsize == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            interval = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtoul(optarg, &end, 0) * 1000000000ULL;
+            if (*end != '\0') {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    if ((!error) && (optind < argc) && (strcmp(argv[optind], "-") != 0)) {
+        source.path = argv[optind];
+        source.fd = -1;
+    }
+
+    if ((!error) && ((argc - optind) > 1)) {
+        error = !0;
+    }
+
+    do {
+        uint64_t started = 0;
+        uint64_t reported = 0;
+        uint64_t timestamp = 0;
+        unsigned char * buffer = (unsigned char *)0;
+        size_t length = 0;
+        ssize_t bytes = 0;
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        if (daemonize) {
+            if (daemon(0, 0) < 0) {
+                perror("daemon");
+                break;
+            }
+            openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
+            lverbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        /*
+         * Install our signal handlers.
+         */
+
+        signal(SIGPIPE, SIG_IGN);
+
+        sigterm.sa_handler = handler;
+        sigterm.sa_flags = 0;
+        rc = sigaction(SIGTERM, &sigterm, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sighup.sa_handler = handler;
+        sighup.sa_flags = 0;
+        rc = sigaction(SIGHUP, &sighup, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        sigint.sa_handler = handler;
+        sigint.sa_flags = 0;
+        rc = sigaction(SIGINT, &sigint, (struct sigaction *)0);
+        if (rc < 0) {
+            lerror("sigaction");
+            break;
+        }
+
+        /*
+         * Create the ring and open the source.
+         */
+
+        rp = rngshm_create(name, capacity, mode);
+        if (rp == (rngshm_t *)0) {
+            lerror(name);
+            break;
+        }
+
+        lverbosef("%s: name         \"%s\"\n", program, name);
+        lverbosef("%s: capacity     %zu\n", program, capacity);
+        lverbosef("%s: mode         0%03o\n", program, mode);
+        lverbosef("%s: read         %zu\n", program, readsize);
+        lverbosef("%s: source       \"%s\"\n", program, source.path);
+
+        if ((source.fd < 0) && (reopen(&source) < 0)) {
+            source.retry = now() + interval;
+        }
+
+        started = now();
+        reported = started;
+
+        /*
+         * Enter our work loop. The source is read directly into the ring,
+         * a contiguous region at a time.
+         */
+
+        xc = 0;
+
+        while (!done) {
+
+            timestamp = now();
+
+            if (report || ((period > 0) && ((timestamp - reported) >= period))) {
+                statistics(rp, &source, timestamp - started);
+                reported = timestamp;
+                report = 0;
+            }
+
+            if (source.fd < 0) {
+                if ((timestamp < source.retry) || (reopen(&source) < 0)) {
+                    source.retry = (timestamp < source.retry) ? source.retry : timestamp + interval;
+                    usleep(100000);
+                    continue;
+                }
+            }
+
+            buffer = (unsigned char *)rngshm_reserve(rp, readsize, &length);
+            if (length == 0) {
+                if ((rngshm_await(rp, 1000) < 0) && (errno != ETIMEDOUT) && (errno != EINTR)) {
+                    lerror("rngshm_await");
+                    xc = 2;
+                    break;
+                }
+                continue;
+            }
+
+            bytes = read(source.fd, buffer, length);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (bytes == 0) {
+                ++source.eofs;
+                if (source.fd == STDIN_FILENO) {
+                    break;
+                }
+                shut(&source, now() + interval);
+                continue;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                ++source.errors;
+                lerror(source.path);
+                if (source.fd == STDIN_FILENO) {
+                    xc = 2;
+                    break;
+                }
+                shut(&source, now() + interval);
+                continue;
+            }
+
+            rngshm_publish(rp, bytes);
+
+            ++source.reads;
+            source.bytes += bytes;
+
+            if (debug) {
+                lprintf("%s: reads=%lu bytes=%lu\n", program, source.reads, source.bytes);
+            }
+
+        }
+
+        statistics(rp, &source, now() - started);
+
+    } while (0);
+
+    /*
+     * Clean up after ourselves.
+     */
+
+    rngshm_detach(rp);
+
+    if (source.fd > STDIN_FILENO) {
+        close(source.fd);
+    }
+
+    if (daemonize) {
+        closelog();
+    }
+
+    return xc;
+}
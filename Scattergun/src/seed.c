@@ -12,23 +12,65 @@
  *
  * USAGE
  *
- * seed [ -i | -l ]
+ * seed [ -h ] [ -v ] [ -i | -l | -c [ -n BYTES ] | -B [ -s SAMPLES ] ] [ -o OSR ] [ -m BYTES ]
  *
  * OPTIONS
  *
+ * -B              Benchmark the collector on this host and exit.
+ * -c              Continuously emit conditioned output to standard output.
+ * -h              Display this menu.
  * -i              Generate an unsigned integer seed.
- * -l              Generate an unsigned long seed.
+ * -l              Generate an unsigned long seed (default).
+ * -m BYTES        Walk a buffer of this many bytes per sample (default 262144).
+ * -n BYTES        Stop continuous output after this many bytes.
+ * -o OSR          Collect OSR raw samples per output bit (default 3).
+ * -s SAMPLES      Benchmark this many raw samples (default 1048576).
+ * -v              Display verbose output to stderr.
  *
  * EXAMPLES
  *
  * seed -l > LONG
  * seed -i > INTEGER
  *
+ * seed -B > $(hostname)-jitter.csv
+ *
+ * seed -c -o 4 | rate
+ *
  * ABSTRACT
  *
  * Generates an unsigned long or an unsigned integer seed (one some platforms
  * this might be the same bit-size, on others not so much) and prints it to
- * standard output.
+ * standard output, or continuously emits conditioned random bytes. The seed
+ * once came from a single reading of CLOCK_MONOTONIC_RAW, which anyone who
+ * knows roughly when the program ran can guess; it now comes from a CPU
+ * timing jitter collector, the only entropy source that needs no hardware
+ * beyond the processor.
+ *
+ * Each raw sample is the time taken by a walk through a buffer larger than
+ * the level one cache, repeated a number of times chosen by the low bits of
+ * the previous timestamp, so that cache, memory, pipeline, and interrupt
+ * timing variations all show up in the difference between successive
+ * timestamps. Every sample goes through the SP800-90B health tests before it
+ * counts: a sample whose first, second, or third difference is zero is
+ * "stuck" and is absorbed but not counted, a Repetition Count Test watches
+ * for repeated differences, and an Adaptive Proportion Test watches the low
+ * byte of the differences, both with cutoffs derived from the entropy
+ * assumed by the oversampling rate, one bit per OSR samples. A thirty-two
+ * byte output block is the SHA-256 conditioned hash of 256 times OSR
+ * counted samples and a chaining value; a block during which a health test
+ * fails is discarded, and too many failed blocks in a row are an error.
+ *
+ * The benchmark measures the raw sample rate, the fraction of stuck
+ * samples, and the SP800-90B most common value min-entropy of the low byte
+ * of the differences on this host, and emits a CSV line for each candidate
+ * oversampling rate giving the output rate and whether the input to the
+ * conditioner carries at least sixty-four bits more entropy than its
+ * output, which is what SP800-90B requires to claim full entropy. Since a
+ * single estimator over the low byte flatters a timer whose low bits merely
+ * count, no sample is credited with more than one bit however high the
+ * estimate. The smallest sufficient rate is recommended on standard error,
+ * which is how to choose -o for, say, a Raspberry Pi as opposed to an x86
+ * NUC.
  */
 
 #include <unistd.h>
@@ -36,9 +78,357 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
 #include <time.h>
+#include <math.h>
+#include <sys/utsname.h>
+#include "sha256.h"
+#include "output.h"
+#include "sp80090b.h"
+
+enum {
+    ALPHA = 30,                 /* False alarm probability is 2^-ALPHA. */
+    APTWINDOW = 512,            /* Adaptive Proportion Test window. */
+    WARMUP = 64,                /* Samples discarded at startup. */
+    FAILURES = 16,              /* Consecutive failed blocks allowed. */
+    ACCESSES = 64,              /* Buffer accesses per loop. */
+    STRIDE = 4093,              /* Prime distance between accesses. */
+    MARGIN = 64,                /* Extra input entropy for full entropy. */
+    CEILING = 1,                /* Most bits credited to a raw sample. */
+};
+
+/**
+ * This is the state of the collector, its health tests, and its counters.
+ */
+typedef struct Collector {
+    volatile uint8_t * memory;
+    size_t size;
+    size_t index;
+    uint64_t previous;
+    uint64_t delta;
+    uint64_t delta2;
+    uint64_t rctlast;
+    uint64_t rctcount;
+    uint64_t rctcutoff;
+    uint8_t aptsymbol;
+    uint64_t aptcount;
+    uint64_t aptseen;
+    uint64_t aptcutoff;
+    uint8_t chain[SHA256_DIGEST];
+    uint64_t samples;
+    uint64_t stuck;
+    uint64_t rctfailures;
+    uint64_t aptfailures;
+    uint64_t blocks;
+    uint64_t discarded;
+} collector_t;
 
 static const char * program = "seed";
+static volatile int done = 0;
+
+static void handler(int signum)
+{
+    done = !0;
+}
+
+static uint64_t ticks(void)
+{
+    struct timespec spec = { 0 };
+    uint64_t result;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
+    result = spec.tv_sec;
+    result *= 1000000000;
+    result += spec.tv_nsec;
+
+    return result;
+}
+
+/**
+ * Take one raw sample: walk the buffer a variable number of times and
+ * return the time it took since the previous sample ended.
+ * @param cp points to the collector.
+ * @return the difference between successive timestamps.
+ */
+static uint64_t sample(collector_t * cp)
+{
+    uint64_t now;
+    uint64_t delta;
+    int loops;
+    int ii;
+    int jj;
+
+    loops = 1 + (cp->previous & 0x7);
+
+    for (ii = 0; ii < loops; ++ii) {
+        for (jj = 0; jj < ACCESSES; ++jj) {
+            cp->memory[cp->index] += 1;
+            cp->index = (cp->index + STRIDE) % cp->size;
+        }
+    }
+
+    now = ticks();
+    delta = now - cp->previous;
+    cp->previous = now;
+
+    return delta;
+}
+
+/**
+ * Run the health tests on a sample.
+ * @param cp points to the collector.
+ * @param delta is the sample.
+ * @param stuckp points to where true is stored if the sample is stuck.
+ * @return 0 if the tests pass, <0 if a test fails.
+ */
+static int health(collector_t * cp, uint64_t delta, int * stuckp)
+{
+    uint64_t delta2 = delta - cp->delta;
+    uint64_t delta3 = delta2 - cp->delta2;
+    uint8_t symbol = delta;
+    int rc = 0;
+
+    ++cp->samples;
+
+    *stuckp = (delta == 0) || (delta2 == 0) || (delta3 == 0);
+    if (*stuckp) {
+        ++cp->stuck;
+    }
+    cp->delta = delta;
+    cp->delta2 = delta2;
+
+    if (delta != cp->rctlast) {
+        cp->rctlast = delta;
+        cp->rctcount = 1;
+    } else if ((++cp->rctcount) >= cp->rctcutoff) {
+        ++cp->rctfailures;
+        cp->rctcount = 1;
+        rc = -1;
+    } else {
+        /* Do nothing. */
+    }
+
+    if (cp->aptseen == 0) {
+        cp->aptsymbol = symbol;
+        cp->aptcount = 0;
+    } else if (symbol != cp->aptsymbol) {
+        /* Do nothing. */
+    } else if ((++cp->aptcount) >= cp->aptcutoff) {
+        ++cp->aptfailures;
+        cp->aptseen = APTWINDOW - 1;
+        rc = -1;
+    } else {
+        /* Do nothing. */
+    }
+    cp->aptseen = (cp->aptseen + 1) % APTWINDOW;
+
+    return rc;
+}
+
+/**
+ * Initialize a collector and warm it up.
+ * @param cp points to the collector.
+ * @param size is the size of the buffer walked per sample.
+ * @param osr is the oversampling rate.
+ * @return 0 for success, <0 for error.
+ */
+static int initialize(collector_t * cp, size_t size, int osr)
+{
+    int stuck;
+    int ii;
+
+    memset(cp, 0, sizeof(*cp));
+
+    cp->memory = (volatile uint8_t *)calloc(size, 1);
+    if (cp->memory == (volatile uint8_t *)0) {
+        return -1;
+    }
+    cp->size = size;
+
+    cp->rctcutoff = 1 + ((uint64_t)ALPHA * osr);
+    cp->aptcutoff = sp80090b_aptcutoff(1.0 / osr, ALPHA, APTWINDOW);
+
+    cp->previous = ticks();
+    for (ii = 0; ii < WARMUP; ++ii) {
+        (void)health(cp, sample(cp), &stuck);
+    }
+    cp->samples = 0;
+    cp->stuck = 0;
+    cp->rctfailures = 0;
+    cp->aptfailures = 0;
+
+    return 0;
+}
+
+/**
+ * Collect and condition one output block.
+ * @param cp points to the collector.
+ * @param osr is the oversampling rate.
+ * @param block points to where the SHA256_DIGEST byte block is stored.
+ * @return 0 for success, <0 with errno set if the health tests keep failing.
+ */
+static int generate(collector_t * cp, int osr, uint8_t * block)
+{
+    static const uint8_t OUTPUT = 0x01;
+    static const uint8_t CHAIN = 0x00;
+    uint8_t state[SHA256_DIGEST];
+    uint64_t needed = (uint64_t)SHA256_DIGEST * 8 * osr;
+    uint64_t counted;
+    uint64_t delta;
+    sha256_t context;
+    int failures = 0;
+    int stuck;
+    int rc;
+
+    while (!0) {
+
+        sha256_init(&context);
+        sha256_update(&context, cp->chain, sizeof(cp->chain));
+
+        rc = 0;
+        counted = 0;
+        while (counted < needed) {
+            delta = sample(cp);
+            sha256_update(&context, &delta, sizeof(delta));
+            rc = health(cp, delta, &stuck);
+            if (rc < 0) {
+                break;
+            }
+            if (!stuck) {
+                ++counted;
+            }
+        }
+
+        sha256_final(&context, state);
+
+        if (rc == 0) {
+            break;
+        }
+
+        ++cp->discarded;
+        if ((++failures) >= FAILURES) {
+            memset(state, 0, sizeof(state));
+            errno = EIO;
+            return -1;
+        }
+
+    }
+
+    sha256_init(&context);
+    sha256_update(&context, &OUTPUT, sizeof(OUTPUT));
+    sha256_update(&context, state, sizeof(state));
+    sha256_final(&context, block);
+
+    sha256_init(&context);
+    sha256_update(&context, &CHAIN, sizeof(CHAIN));
+    sha256_update(&context, state, sizeof(state));
+    sha256_final(&context, cp->chain);
+
+    memset(state, 0, sizeof(state));
+    ++cp->blocks;
+
+    return 0;
+}
+
+/**
+ * Measure the collector and emit a CSV line per candidate oversampling rate.
+ * @param cp points to the collector.
+ * @param samples is the number of raw samples to measure.
+ * @return 0 for success, <0 for error.
+ */
+static int benchmark(collector_t * cp, uint64_t samples)
+{
+    static uint64_t histogram[256];
+    struct utsname uts;
+    uint64_t epoch;
+    uint64_t elapsed;
+    uint64_t counted = 0;
+    uint64_t maximum = 0;
+    uint64_t delta;
+    double p;
+    double entropy;
+    double rate;
+    double fraction;
+    double credit;
+    int recommended = 0;
+    int sufficient;
+    int stuck;
+    int osr;
+    uint64_t index;
+    int ii;
+
+    if (uname(&uts) < 0) {
+        perror("uname");
+        return -1;
+    }
+
+    epoch = ticks();
+    for (index = 0; index < samples; ++index) {
+        delta = sample(cp);
+        (void)health(cp, delta, &stuck);
+        if (!stuck) {
+            ++histogram[delta & 0xff];
+            ++counted;
+        }
+    }
+    elapsed = ticks() - epoch;
+
+    for (ii = 0; ii < 256; ++ii) {
+        if (histogram[ii] > maximum) {
+            maximum = histogram[ii];
+        }
+    }
+
+    if (counted < 2) {
+        entropy = 0.0;
+    } else {
+        p = (double)maximum / counted;
+        p += 2.576 * sqrt((p * (1.0 - p)) / (counted - 1));
+        entropy = (p < 1.0) ? -log2(p) : 0.0;
+    }
+
+    rate = (elapsed > 0) ? (samples * 1000000000.0 / elapsed) : 0.0;
+    fraction = (samples > 0) ? ((double)counted / samples) : 0.0;
+
+    printf("%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
+        "Host", "Machine", "Memory", "Samples", "Stuck", "Entropy",
+        "SampleRate", "OSR", "Credit", "OutputRate", "Sufficient");
+
+    for (osr = 1; (osr <= 16) || ((recommended == 0) && (entropy > 0.0) && (osr <= 256)); ++osr) {
+        credit = ((entropy < CEILING) ? entropy : CEILING) * osr;
+        sufficient = ((credit * SHA256_DIGEST * 8) >= ((SHA256_DIGEST * 8) + MARGIN));
+        if (sufficient && (recommended == 0)) {
+            recommended = osr;
+        }
+        printf("%s,%s,%zu,%lu,%lu,%.6lf,%.0lf,%d,%.6lf,%.0lf,%d\n",
+            uts.nodename, uts.machine, cp->size, samples, samples - counted, entropy,
+            rate, osr, credit, (rate * fraction) / (8.0 * osr), sufficient);
+    }
+
+    if (recommended > 0) {
+        fprintf(stderr, "%s: recommended -o %d\n", program, recommended);
+    } else {
+        fprintf(stderr, "%s: no oversampling rate is sufficient\n", program);
+    }
+
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -i | -l | -c [ -n BYTES ] | -B [ -s SAMPLES ] ] [ -o OSR ] [ -m BYTES ]\n", program);
+    fprintf(stderr, "       -B              Benchmark the collector on this host and exit.\n");
+    fprintf(stderr, "       -c              Continuously emit conditioned output.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -i              Generate an unsigned integer seed.\n");
+    fprintf(stderr, "       -l              Generate an unsigned long seed.\n");
+    fprintf(stderr, "       -m BYTES        Walk a buffer of this many bytes per sample.\n");
+    fprintf(stderr, "       -n BYTES        Stop continuous output after this many bytes.\n");
+    fprintf(stderr, "       -o OSR          Collect OSR raw samples per output bit.\n");
+    fprintf(stderr, "       -s SAMPLES      Benchmark this many raw samples.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
 
 /**
  * This is the main program.
@@ -47,54 +437,206 @@ static const char * program = "seed";
  */
 int main(int argc, char * argv[])
 {
-    int dolong = !0;
-    int rc;
-    uint64_t ticks = ~0;
-    struct timespec spec = { 0 };
+    enum { LONG, INTEGER, CONTINUOUS, BENCHMARK, } mode = LONG;
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int osr = 3;
+    size_t size = 256 * 1024;
+    uint64_t limit = ~(uint64_t)0;
+    uint64_t samples = 1024 * 1024;
+    uint64_t total = 0;
+    uint8_t block[SHA256_DIGEST];
+    collector_t collector;
+    output_t * op = (output_t *)0;
+    struct sigaction action = { 0 };
+    char * end = (char *)0;
     unsigned long ll;
     unsigned int ii;
+    size_t length;
+    int initialized = 0;
+    int rc = 0;
     int opt;
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "il")) >= 0) {
+    while ((opt = getopt(argc, argv, "Bchilm:n:o:s:v")) >= 0) {
 
         switch (opt) {
 
+        case 'B':
+            mode = BENCHMARK;
+            break;
+
+        case 'c':
+            mode = CONTINUOUS;
+            break;
+
         case 'i':
-            dolong = 0;
+            mode = INTEGER;
             break;
 
         case 'l':
-            dolong = !0;
+            mode = LONG;
+            break;
+
+        case 'm':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
             break;
 
+        case 'n':
+            limit = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            osr = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (osr <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            samples = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (samples == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'h':
         default:
-            fprintf(stderr, "%s: [ -l | -i ]\n", program);
-            exit(1);
+            error = !0;
             break;
 
         }
 
     }
 
-    rc = clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
-    if (rc == 0) {
-        ticks = spec.tv_sec;
-        ticks *= 1000000000;
-        ticks += spec.tv_nsec;
-    } else {
-        perror("clock_gettime");
-        exit(1);
+    do {
+
+        if (error) {
+            usage();
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: memory %zu bytes\n", program, size);
+            fprintf(stderr, "%s: osr %d\n", program, osr);
+        }
+
+        if (initialize(&collector, size, osr) < 0) {
+            perror("calloc");
+            break;
+        }
+        initialized = !0;
+
+        if (verbose) {
+            fprintf(stderr, "%s: rct %lu\n", program, collector.rctcutoff);
+            fprintf(stderr, "%s: apt %lu\n", program, collector.aptcutoff);
+        }
+
+        if (mode == BENCHMARK) {
+
+            if (benchmark(&collector, samples) < 0) {
+                break;
+            }
+
+        } else if (mode == CONTINUOUS) {
+
+            action.sa_handler = handler;
+            sigaction(SIGINT, &action, (struct sigaction *)0);
+            sigaction(SIGTERM, &action, (struct sigaction *)0);
+            signal(SIGPIPE, SIG_IGN);
+
+            op = output_open(STDOUT_FILENO, 0, 0, &done);
+            if (op == (output_t *)0) {
+                perror("output_open");
+                break;
+            }
+
+            while ((!done) && (total < limit)) {
+                rc = generate(&collector, osr, block);
+                if (rc < 0) {
+                    perror("health");
+                    break;
+                }
+                length = ((limit - total) < sizeof(block)) ? (limit - total) : sizeof(block);
+                rc = output_write(op, block, length);
+                if (rc < 0) {
+                    perror("output_write");
+                }
+                if (rc != 0) {
+                    break;
+                }
+                total += length;
+            }
+
+            if (rc == 0) {
+                rc = output_flush(op);
+                if (rc < 0) {
+                    perror("output_flush");
+                }
+            }
+
+            if (rc < 0) {
+                break;
+            }
+
+        } else {
+
+            if (generate(&collector, osr, block) < 0) {
+                perror("health");
+                break;
+            }
+
+            if (mode == LONG) {
+                memcpy(&ll, block, sizeof(ll));
+                printf("%lu\n", ll);
+            } else {
+                memcpy(&ii, block, sizeof(ii));
+                printf("%u\n", ii);
+            }
+
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    output_close(op);
+
+    if (verbose && initialized) {
+        fprintf(stderr, "%s: samples %lu\n", program, collector.samples);
+        fprintf(stderr, "%s: stuck %lu\n", program, collector.stuck);
+        fprintf(stderr, "%s: rctfailures %lu\n", program, collector.rctfailures);
+        fprintf(stderr, "%s: aptfailures %lu\n", program, collector.aptfailures);
+        fprintf(stderr, "%s: blocks %lu\n", program, collector.blocks);
+        fprintf(stderr, "%s: discarded %lu\n", program, collector.discarded);
+        fprintf(stderr, "%s: total %lu bytes\n", program, total);
     }
 
-    if (dolong) {
-        ll = ticks;
-        printf("%lu\n", ll);
-    } else {
-        ii = ticks;
-        printf("%u\n", ii);
+    if (initialized) {
+        free((void *)collector.memory);
     }
 
-    exit(0);
+    memset(block, 0, sizeof(block));
+
+    exit(xc);
 }
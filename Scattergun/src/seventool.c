@@ -12,10 +12,12 @@
  *
  * USAGE
  *
- * seventool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o PATH ]
+ * seventool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -T RESTARTS [ -M SAMPLES ] [ -L PATH ] ] [ -o PATH ] [ -E PATH ] [ -P NAME ]
  *
  * EXAMPLES
  *
+ * seventool -v -R -T 1000 -M 1000 -L latency.csv -o restart.dat
+ *
  * ABSTRACT
  *
  * Continuously reads thirty-two bits of entropy using the rdrand or rdseed
@@ -25,6 +27,27 @@
  * read by another program, like rngd. Optionally does some other useful stuff
  * regarding examining the capabilities of the host processor. This is part of
  * the Scattergun project.
+ *
+ * With -T, instead writes the restart matrix needed by SP800-90B section 3.1.4:
+ * for each of RESTARTS rows, the generator is restarted and the first SAMPLES
+ * eight-bit samples after the restart are written, row after row, so that the
+ * output can be handed directly to the NIST ea_restart tool. For rdrand the
+ * restart forces the DRNG to reseed; rdseed draws on the conditioner and has
+ * nothing to restart, so its rows are simply consecutive. The time taken by
+ * each restart and by the collection of its row, in nanoseconds, can be
+ * written to a CSV file with -L, and their extremes and mean are reported
+ * in verbose mode.
+ *
+ * With -E, the time spent backing off after each failed instruction, and
+ * the duration of each write or stall of the output, is recorded in a
+ * binary trace file that can be analyzed with tracereport. Successful
+ * instructions are not traced, since they take less time than reading the
+ * clock would.
+ *
+ * With -P, its counters, and those of its output, are published in a page
+ * of shared memory that rngmetrics can read at any time, and export for
+ * Prometheus, without disturbing it. The page is updated every thousand or
+ * so instructions, and whenever an instruction fails.
  */
 
 #include <stdlib.h>
@@ -42,18 +65,37 @@
 #include <sys/stat.h>
 #define  __RDRND__
 #include <immintrin.h>
+#include "output.h"
+#include "trace.h"
+#include "metrics.h"
 
 static const char * program = "seventool";
 static const char * ident = "seventool";
 static int debug = 0;
 static int verbose = 0;
-static int done = 0;
+static volatile int done = 0;
 static int report = 0;
 static int daemonize = 0;
 
 enum mode { FAIL=0, RDRAND=1, RDSEED=2, };
 static const char * MODE[] = { "fail", "rdrand", "rdseed", };
 
+enum { RESEED = ((511 * 2 * 64) / sizeof(uint32_t)) + 1, };
+
+enum { PUBLISH = 1024, };
+
+/**
+ * These are the indices of the metrics in the page.
+ */
+enum metric {
+    TRIES = 0, READS, BYTES, UNDERFLOWS,
+    WRITES, SPLICES, WRITTEN, STALLS, STALLED,
+    METRICS,
+};
+
+static metrics_t * mp = (metrics_t *)0;
+static int metric[METRICS];
+
 /**
  * Emit a formatting string to either the system log or to standard error.
  * @param format is the printf format.
@@ -129,7 +171,7 @@ static void handler(int signum)
  */
 static void usage(int nomenu)
 {
-    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o PATH ]\n", program);
+    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -T RESTARTS [ -M SAMPLES ] [ -L PATH ] ] [ -o PATH ] [ -E PATH ] [ -P NAME ]\n", program);
     if (nomenu) { return; }
     lprintf("       -d            Enable debug mode\n");
     lprintf("       -v            Enable verbose mode\n");
@@ -140,7 +182,12 @@ static void usage(int nomenu)
     lprintf("       -S            Use the rdseed instruction\n");
     lprintf("       -c            Check for instruction, exit if unimplemented\n");
     lprintf("       -x            Perform check only, exit afterwards\n");
+    lprintf("       -T RESTARTS   Write a restart matrix of RESTARTS rows and exit\n");
+    lprintf("       -M SAMPLES    Write SAMPLES samples per row (default 1000)\n");
+    lprintf("       -L PATH       Write the latency of each restart to PATH as CSV\n");
     lprintf("       -o PATH       Write to PATH (which may be a fifo) instead of stdout\n");
+    lprintf("       -E PATH       Trace the timing of backoffs and writes to PATH\n");
+    lprintf("       -P NAME       Publish metrics in the shared memory page NAME\n");
     lprintf("       -h            Print help menu\n");
 }
 
@@ -257,22 +304,19 @@ static int query(void)
 }
 
 /**
- * Force the rdrand mechanism to reseed. We do this by calling rdrand just
- * one more time than its reseed cycle. The rdrand DRNG is guaranteed to
- * produce no more than (511 * 2) or 1022 64-bit results using the same seed.
- * Where exactly in this loop the rdrand reseeds is transparent and unknowable.
- * @return true if the all of the rdrand calls succeeded, false otherwise.
+ * Run rdrand one more time than its reseed cycle. The rdrand DRNG is
+ * guaranteed to produce no more than (511 * 2) or 1022 64-bit results using
+ * the same seed. Where exactly in this loop the rdrand reseeds is transparent
+ * and unknowable.
+ * @return the number of rdrand calls that succeeded.
  */
-static int reseed(void)
+static int cycle(void)
 {
-    static const int RESEED = ((511 * 2 * 64) / sizeof(uint32_t)) + 1;
     int count = 0;
     uint32_t word = 0;
     uint8_t carry = 1;
     int ii;
 
-    lverbosef("%s: reseeding    %d\n", program, RESEED);
-
     for (ii = 0; ii < RESEED; ++ii) {
         carry = rdrand(&word);
         if (carry) {
@@ -280,11 +324,201 @@ static int reseed(void)
         }
     }
 
+    return count;
+}
+
+/**
+ * Force the rdrand mechanism to reseed. We do this by calling rdrand just
+ * one more time than its reseed cycle.
+ * @return true if the all of the rdrand calls succeeded, false otherwise.
+ */
+static int reseed(void)
+{
+    int count = 0;
+
+    lverbosef("%s: reseeding    %d\n", program, RESEED);
+
+    count = cycle();
+
     lverbosef("%s: reseeded     %d\n", program, count);
 
     return (count == RESEED);
 }
 
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/**
+ * Write an SP800-90B restart matrix: restart the generator, collect a row of
+ * eight-bit samples, write the row, and repeat, recording how long each
+ * restart and each row took.
+ * @param op points to the output.
+ * @param lp points to the latency CSV file or is NULL.
+ * @param mode selects rdrand or rdseed.
+ * @param restarts is the number of rows.
+ * @param samples is the number of samples in each row.
+ * @return 0 for success, >0 for end of file, <0 for error.
+ */
+static int matrix(output_t * op, FILE * lp, enum mode mode, size_t restarts, size_t samples)
+{
+    static const size_t CONSECUTIVE = 10;
+    static const struct timespec request = { 0, 1000000 };
+    unsigned char * row = (unsigned char *)0;
+    uint64_t then = 0;
+    uint64_t latency = 0;
+    uint64_t duration = 0;
+    uint64_t minimum = ~(uint64_t)0;
+    uint64_t maximum = 0;
+    uint64_t sum = 0;
+    uint64_t epoch = 0;
+    size_t consecutive = 0;
+    size_t rows = 0;
+    size_t jj;
+    uint32_t word;
+    uint8_t carry;
+    int rc = 0;
+
+    row = (unsigned char *)malloc(samples + sizeof(word));
+    if (row == (unsigned char *)0) {
+        lerror("malloc");
+        return -1;
+    }
+
+    if (lp != (FILE *)0) {
+        fprintf(lp, "Restart,Latency,Duration\n");
+    }
+
+    epoch = now();
+
+    while ((!done) && (rows < restarts)) {
+
+        then = now();
+        if (mode != RDRAND) {
+            /* Do nothing. */
+        } else if (cycle() == RESEED) {
+            /* Do nothing. */
+        } else {
+            errno = EBUSY;
+            lerror("reseed");
+            rc = -1;
+            break;
+        }
+        latency = now() - then;
+
+        then = now();
+        for (jj = 0; (!done) && (jj < samples); ) {
+            carry = (mode == RDRAND) ? rdrand(&word) : rdseed(&word);
+            if (carry) {
+                memcpy(row + jj, &word, sizeof(word));
+                jj += sizeof(word);
+                consecutive = 0;
+            } else if ((++consecutive) >= CONSECUTIVE) {
+                errno = EBUSY;
+                lerror("carry");
+                rc = -1;
+                break;
+            } else {
+                nanosleep(&request, (struct timespec *)0);
+            }
+        }
+        duration = now() - then;
+
+        if ((rc != 0) || (jj < samples)) {
+            break;
+        }
+
+        rc = output_write(op, row, samples);
+        if (rc < 0) {
+            lerror("output_write");
+        }
+        if (rc != 0) {
+            break;
+        }
+
+        if (lp != (FILE *)0) {
+            fprintf(lp, "%zu,%lu,%lu\n", rows, latency, duration);
+        }
+
+        if (latency < minimum) {
+            minimum = latency;
+        }
+        if (latency > maximum) {
+            maximum = latency;
+        }
+        sum += latency;
+        ++rows;
+
+        if (debug) {
+            lprintf("%s: restart=%zu latency=%lu duration=%lu\n", program, rows, latency, duration);
+        }
+
+    }
+
+    lverbosef("%s: restarts=%zu samples=%zu elapsed=%lu\n", program, rows, samples, now() - epoch);
+    if (rows > 0) {
+        lverbosef("%s: latency minimum=%lu mean=%lu maximum=%lu\n", program, minimum, sum / rows, maximum);
+    }
+
+    free(row);
+
+    return rc;
+}
+
+/**
+ * Create the metrics page and describe its metrics.
+ * @param name is the shared memory name of the page.
+ * @return 0 for success or <0 with errno set.
+ */
+static int describe(const char * name)
+{
+    mp = metrics_create(name, program, 0644);
+    if (mp == (metrics_t *)0) {
+        return -1;
+    }
+
+    metric[TRIES] = metrics_define(mp, "tries_total", (const char *)0, "Instructions executed.", METRICS_COUNTER, 1);
+    metric[READS] = metrics_define(mp, "reads_total", (const char *)0, "Instructions that returned data.", METRICS_COUNTER, 1);
+    metric[BYTES] = metrics_define(mp, "bytes_total", (const char *)0, "Bytes of data returned.", METRICS_COUNTER, 1);
+    metric[UNDERFLOWS] = metrics_define(mp, "underflows_total", (const char *)0, "Instructions that returned no data.", METRICS_COUNTER, 1);
+    metric[WRITES] = metrics_define(mp, "output_calls_total", (const char *)0, "Successful writes and splices to the output.", METRICS_COUNTER, 1);
+    metric[SPLICES] = metrics_define(mp, "output_splices_total", (const char *)0, "Of those, splices.", METRICS_COUNTER, 1);
+    metric[WRITTEN] = metrics_define(mp, "output_bytes_total", (const char *)0, "Bytes delivered to the output.", METRICS_COUNTER, 1);
+    metric[STALLS] = metrics_define(mp, "output_stalls_total", (const char *)0, "Times the output was full.", METRICS_COUNTER, 1);
+    metric[STALLED] = metrics_define(mp, "output_stall_seconds_total", (const char *)0, "Time spent waiting for the output to drain.", METRICS_COUNTER, 1000000000ULL);
+
+    return 0;
+}
+
+/**
+ * Update the metrics page. This makes no system call.
+ * @param op points to the output.
+ * @param tries is the number of instructions executed.
+ * @param reads is the number that returned data.
+ * @param total is the number of bytes returned.
+ */
+static void publish(const output_t * op, size_t tries, size_t reads, size_t total)
+{
+    output_statistics_t statistics;
+
+    output_statistics(op, &statistics);
+
+    metrics_set(mp, metric[TRIES], tries);
+    metrics_set(mp, metric[READS], reads);
+    metrics_set(mp, metric[BYTES], total);
+    metrics_set(mp, metric[UNDERFLOWS], tries - reads);
+    metrics_set(mp, metric[WRITES], statistics.calls);
+    metrics_set(mp, metric[SPLICES], statistics.splices);
+    metrics_set(mp, metric[WRITTEN], statistics.bytes);
+    metrics_set(mp, metric[STALLS], statistics.stalls);
+    metrics_set(mp, metric[STALLED], statistics.stalled);
+}
+
 /**
  * This is the main program.
  * @param argc is the count of command line arguments.
@@ -295,10 +529,11 @@ int main(int argc, char * argv[])
     int xc = 1;
     int error = 0;
     unsigned int unit = 0;
-    size_t written = 0;
     char * end = (char *)0;
     int rc = 0;
     FILE * fp = stdout;
+    output_t * op = (output_t *)0;
+    output_statistics_t statistics = { 0 };
     uintptr_t offset = 0;
     struct sigaction sigpipe = { 0 };
     struct sigaction sighup = { 0 };
@@ -309,6 +544,13 @@ int main(int argc, char * argv[])
     size_t reads = 0;
     size_t consecutive = 0;
     const char * path = (const char *)0;
+    const char * latencies = (const char *)0;
+    const char * trace = (const char *)0;
+    const char * name = (const char *)0;
+    uint64_t start = 0;
+    FILE * lp = (FILE *)0;
+    size_t restarts = 0;
+    size_t samples = 1000;
     enum mode mode = FAIL;
     int doreseed = 0;
     int docheck = 0;
@@ -328,7 +570,7 @@ int main(int argc, char * argv[])
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "dvDo:i:hRrScx")) >= 0) {
+    while ((opt = getopt(argc, argv, "dvDo:i:hRrScxT:M:L:E:P:")) >= 0) {
 
         switch (opt) {
 
@@ -378,6 +620,36 @@ int main(int argc, char * argv[])
             doexit = !0;
             break;
 
+        case 'T':
+            restarts = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (restarts == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'M':
+            samples = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (samples == 0)) {
+                errno = EINVAL;
+                lerror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'L':
+            latencies = optarg;
+            break;
+
+        case 'E':
+            trace = optarg;
+            break;
+
+        case 'P':
+            name = optarg;
+            break;
+
         default:
             error = !0;
             break;
@@ -454,15 +726,81 @@ int main(int argc, char * argv[])
 
         if (path != (const char *)0) {
             lverbosef("%s: path         \"%s\"\n", program, path);
-            fp = fopen(path, "a");
+            fp = fopen(path, (restarts > 0) ? "w" : "a");
             if (fp == (FILE *)0) {
                 lerror(path);
                 break;
             }
         }
 
+        /*
+         * Keep the output chunk as small as the stdio buffer was, since
+         * rdseed can be slow enough that a larger one would hold back its
+         * output for seconds.
+         */
+
+        op = output_open(fileno(fp), 0, 4096, &done);
+        if (op == (output_t *)0) {
+            lerror("output_open");
+            break;
+        }
+
         lverbosef("%s: mode         %s\n", program, MODE[mode]);
 
+        /*
+         * Trace the output, and later the backoffs, if requested.
+         */
+
+        if (trace != (const char *)0) {
+            lverbosef("%s: trace        \"%s\"\n", program, trace);
+            if (trace_open(trace, program) < 0) {
+                lerror(trace);
+                break;
+            }
+            output_observe(op, trace_output);
+        }
+
+        /*
+         * Publish metrics if requested.
+         */
+
+        if (name != (const char *)0) {
+            lverbosef("%s: metrics      \"%s\"\n", program, name);
+            if (describe(name) < 0) {
+                lerror(name);
+                break;
+            }
+        }
+
+        /*
+         * Write the restart matrix instead of a continuous stream if
+         * requested.
+         */
+
+        if (restarts > 0) {
+            lverbosef("%s: restarts     %zu\n", program, restarts);
+            lverbosef("%s: samples      %zu\n", program, samples);
+            if (mode == FAIL) {
+                errno = EINVAL;
+                lerror("mode");
+                break;
+            }
+            if (latencies != (const char *)0) {
+                lverbosef("%s: latencies    \"%s\"\n", program, latencies);
+                lp = fopen(latencies, "w");
+                if (lp == (FILE *)0) {
+                    lerror(latencies);
+                    break;
+                }
+            }
+            rc = matrix(op, lp, mode, restarts, samples);
+            if (lp != (FILE *)0) {
+                fclose(lp);
+            }
+            xc = (rc < 0) ? 2 : 0;
+            break;
+        }
+
         /*
          * Force a reseed if requested and if using rdrand.
          */
@@ -495,6 +833,10 @@ int main(int argc, char * argv[])
                 report = 0;
             }
 
+            if ((mp != (metrics_t *)0) && ((tries % PUBLISH) == 0)) {
+                publish(op, tries, reads, total);
+            }
+
             ++tries;
 
             if (mode == RDRAND) {
@@ -515,11 +857,16 @@ int main(int argc, char * argv[])
                 lerror("carry");
                 xc = 2;
                 break;
-            } else if ((rc = nanosleep(&request, (struct timespec *)0)) >= 0) {
-                continue;
-            } else if (errno == EINTR) {
-                continue;
             } else {
+                if (mp != (metrics_t *)0) {
+                    publish(op, tries, reads, total);
+                }
+                start = trace_start();
+                rc = nanosleep(&request, (struct timespec *)0);
+                trace_event(TRACE_READ, sizeof(word), -EBUSY, start);
+                if ((rc >= 0) || (errno == EINTR)) {
+                    continue;
+                }
                 lerror("nanosleep");
                 xc = 2;
                 break;
@@ -528,16 +875,13 @@ int main(int argc, char * argv[])
             ++reads;
             total += sizeof(word);
 
-            written = fwrite(&word, sizeof(word), 1, fp);
-            if (written >= 1) {
+            rc = output_write(op, &word, sizeof(word));
+            if (rc == 0) {
                 /* Do nothing: nominal. */
-            } else if (!ferror(fp)) {
-                break;
-            } else if (errno == EPIPE) {
-                lerror("fwrite");
+            } else if (rc > 0) {
                 break;
             } else {
-                lerror("fwrite");
+                lerror("output_write");
                 xc = 2;
                 break;
             }
@@ -554,6 +898,22 @@ int main(int argc, char * argv[])
      * Clean up after ourselves.
      */
 
+    if (op == (output_t *)0) {
+        /* Do nothing. */
+    } else if (output_flush(op) >= 0) {
+        output_statistics(op, &statistics);
+        lverbosef("%s: pipe=%zu writes=%lu splices=%lu stalls=%lu stalled=%lu\n", program, statistics.pipesize, statistics.calls, statistics.splices, statistics.stalls, statistics.stalled);
+    } else {
+        lerror("output_flush");
+        xc = 2;
+    }
+
+    output_close(op);
+
+    trace_close();
+
+    metrics_detach(mp);
+
     if (fp != (FILE *)0) {
         fclose(fp);
     }
@@ -0,0 +1,266 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Scattergun Random<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The buffer lives in thread local storage, so the fast path needs neither
+ * a lock nor an atomic. The instructions are compiled with target attributes
+ * so that the library needs no special compiler flags, and are used only if
+ * cpuid says the processor has them. Both instructions may fail, rdseed
+ * often, when the hardware cannot keep up; a word is tried a few times
+ * before the refill falls back to getrandom(2). An all ones result is also
+ * treated as a failure, since that is what some AMD processors return from
+ * rdrand after a suspend and resume.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include "sgrandom.h"
+#if defined(__x86_64__)
+#   include <cpuid.h>
+#   include <immintrin.h>
+#endif
+
+enum {
+    BUFFER = 2048,              /* Bytes in each thread's buffer. */
+    RDRAND_TRIES = 10,          /* Intel recommends ten retries. */
+    RDSEED_TRIES = 100,
+};
+
+typedef struct Cache {
+    unsigned char data[BUFFER];
+    size_t head;
+} __attribute__((aligned(64))) cache_t;
+
+static const char * NAMES[] = { "automatic", "rdrand", "rdseed", "getrandom", };
+
+static __thread cache_t cache = { { 0 }, BUFFER };
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static int rdrand = 0;
+static int rdseed = 0;
+static int source = SG_RANDOM_GETRANDOM; /* Shared by every thread. */
+
+/*******************************************************************************
+ * INSTRUCTIONS
+ ******************************************************************************/
+
+#if defined(__x86_64__)
+
+__attribute__((target("rdrnd")))
+static size_t fill_rdrand(unsigned char * buffer, size_t size)
+{
+    unsigned long long word;
+    size_t length = 0;
+    size_t part;
+    int tries;
+
+    while (length < size) {
+        for (tries = 0; tries < RDRAND_TRIES; ++tries) {
+            if (_rdrand64_step(&word) && (word != ~0ULL)) {
+                break;
+            }
+        }
+        if (tries >= RDRAND_TRIES) {
+            break;
+        }
+        part = ((size - length) < sizeof(word)) ? (size - length) : sizeof(word);
+        memcpy(buffer + length, &word, part);
+        length += part;
+    }
+
+    word = 0;
+
+    return length;
+}
+
+__attribute__((target("rdseed")))
+static size_t fill_rdseed(unsigned char * buffer, size_t size)
+{
+    unsigned long long word;
+    size_t length = 0;
+    size_t part;
+    int tries;
+
+    while (length < size) {
+        for (tries = 0; tries < RDSEED_TRIES; ++tries) {
+            if (_rdseed64_step(&word) && (word != ~0ULL)) {
+                break;
+            }
+            _mm_pause();
+        }
+        if (tries >= RDSEED_TRIES) {
+            break;
+        }
+        part = ((size - length) < sizeof(word)) ? (size - length) : sizeof(word);
+        memcpy(buffer + length, &word, part);
+        length += part;
+    }
+
+    word = 0;
+
+    return length;
+}
+
+#endif
+
+/*******************************************************************************
+ * INITIALIZATION
+ ******************************************************************************/
+
+/**
+ * Discard the buffer the child inherited from the thread that forked it.
+ */
+static void child(void)
+{
+    memset(cache.data, 0, sizeof(cache.data));
+    cache.head = BUFFER;
+}
+
+static void initialize(void)
+{
+#if defined(__x86_64__)
+    unsigned int a = 0;
+    unsigned int b = 0;
+    unsigned int c = 0;
+    unsigned int d = 0;
+
+    if (__get_cpuid(1, &a, &b, &c, &d) && ((c & bit_RDRND) != 0)) {
+        rdrand = !0;
+    }
+
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && ((b & bit_RDSEED) != 0)) {
+        rdseed = !0;
+    }
+#endif
+
+    __atomic_store_n(&source, rdrand ? SG_RANDOM_RDRAND : SG_RANDOM_GETRANDOM, __ATOMIC_RELAXED);
+
+    (void)pthread_atfork((void (*)(void))0, (void (*)(void))0, child);
+}
+
+int sg_random_select(int requested)
+{
+    int selected;
+
+    pthread_once(&once, initialize);
+
+    if ((requested == SG_RANDOM_AUTOMATIC) && rdrand) {
+        selected = SG_RANDOM_RDRAND;
+    } else if ((requested == SG_RANDOM_RDRAND) && rdrand) {
+        selected = SG_RANDOM_RDRAND;
+    } else if ((requested == SG_RANDOM_RDSEED) && rdseed) {
+        selected = SG_RANDOM_RDSEED;
+    } else {
+        selected = SG_RANDOM_GETRANDOM;
+    }
+
+    __atomic_store_n(&source, selected, __ATOMIC_RELAXED);
+
+    return selected;
+}
+
+const char * sg_random_name(int which)
+{
+    return ((0 <= which) && (which < (sizeof(NAMES) / sizeof(NAMES[0])))) ? NAMES[which] : "unknown";
+}
+
+/*******************************************************************************
+ * SLOW PATH
+ ******************************************************************************/
+
+/**
+ * Fill a buffer from the selected source, falling back to getrandom(2)
+ * for whatever the instruction could not provide.
+ * @return 0 for success, <0 with errno set for error.
+ */
+static int fill(unsigned char * buffer, size_t size)
+{
+    size_t length = 0;
+    ssize_t rc;
+    int selected;
+
+    pthread_once(&once, initialize);
+
+    selected = __atomic_load_n(&source, __ATOMIC_RELAXED);
+
+#if defined(__x86_64__)
+    if (selected == SG_RANDOM_RDRAND) {
+        length = fill_rdrand(buffer, size);
+    } else if (selected == SG_RANDOM_RDSEED) {
+        length = fill_rdseed(buffer, size);
+    } else {
+        /* Do nothing. */
+    }
+#endif
+
+    while (length < size) {
+        rc = getrandom(buffer + length, size - length, 0);
+        if (rc > 0) {
+            length += rc;
+        } else if ((rc < 0) && (errno == EINTR)) {
+            /* Do nothing. */
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Serve a request that does not fit in what is left of the buffer.
+ */
+static ssize_t refill(unsigned char * buffer, size_t size)
+{
+    size_t left = BUFFER - cache.head;
+
+    if (size >= (BUFFER / 2)) {
+        return (fill(buffer, size) < 0) ? -1 : size;
+    }
+
+    memcpy(buffer, cache.data + cache.head, left);
+    memset(cache.data + cache.head, 0, left);
+    cache.head = BUFFER;
+
+    if (fill(cache.data, BUFFER) < 0) {
+        return -1;
+    }
+
+    memcpy(buffer + left, cache.data, size - left);
+    memset(cache.data, 0, size - left);
+    cache.head = size - left;
+
+    return size;
+}
+
+/*******************************************************************************
+ * FAST PATH
+ ******************************************************************************/
+
+ssize_t sg_random(void * buffer, size_t size)
+{
+    cache_t * cp = &cache;
+
+    if (size <= (BUFFER - cp->head)) {
+        memcpy(buffer, cp->data + cp->head, size);
+        memset(cp->data + cp->head, 0, size);
+        cp->head += size;
+        return size;
+    }
+
+    return refill((unsigned char *)buffer, size);
+}
@@ -0,0 +1,67 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SGRANDOM_
+#define _H_COM_DIAG_SCATTERGUN_SGRANDOM_
+
+/**
+ * @file
+ * Scattergun Random<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Serves small requests for random bytes, such as nonces, from a per-thread
+ * cache line aligned buffer that is refilled in bulk using the rdrand or
+ * rdseed instruction, the same ones seventool uses, or, on processors that
+ * have neither, or if the instruction keeps failing, the getrandom(2)
+ * system call. A request that fits in what is left of the buffer is a copy
+ * with no system call and no lock. Bytes are erased from the buffer as they
+ * are served, and a child process discards the buffer it inherits from fork(2),
+ * so that no two callers are ever given the same bytes. Requests of half the
+ * buffer or more bypass it. This is built as libsgrandom.a and libsgrandom.so.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * These are the sources from which the buffers are refilled.
+ */
+enum SgRandomSource {
+    SG_RANDOM_AUTOMATIC = 0,    /* rdrand if available, else getrandom(2). */
+    SG_RANDOM_RDRAND = 1,       /* rdrand, the DRNG. */
+    SG_RANDOM_RDSEED = 2,       /* rdseed, the conditioned entropy source. */
+    SG_RANDOM_GETRANDOM = 3,    /* getrandom(2) with no flags. */
+};
+
+/**
+ * Choose the source from which the buffers are refilled. This should be
+ * called before any thread calls sg_random(); bytes already buffered are
+ * still served. A source the processor lacks is replaced by getrandom(2).
+ * @param source is the requested source.
+ * @return the source in effect.
+ */
+extern int sg_random_select(int source);
+
+/**
+ * Return the name of a source.
+ * @param source is the source.
+ * @return the name.
+ */
+extern const char * sg_random_name(int source);
+
+/**
+ * Fill a buffer with random bytes. Unlike getrandom(2) it never returns
+ * fewer bytes than requested.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return size or <0 with errno set on error.
+ */
+extern ssize_t sg_random(void * buffer, size_t size);
+
+#endif
@@ -0,0 +1,126 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * SHA-256<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * This follows FIPS 180-4 directly, one sixty-four byte block at a time,
+ * and has been checked against sha256sum(1).
+ */
+
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(_X_, _N_) (((_X_) >> (_N_)) | ((_X_) << (32 - (_N_))))
+
+static void compress(sha256_t * sp, const uint8_t * block)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    uint32_t t1, t2;
+    int ii;
+
+    for (ii = 0; ii < 16; ++ii) {
+        w[ii] = ((uint32_t)block[(ii * 4) + 0] << 24) | ((uint32_t)block[(ii * 4) + 1] << 16) | ((uint32_t)block[(ii * 4) + 2] << 8) | (uint32_t)block[(ii * 4) + 3];
+    }
+    for (ii = 16; ii < 64; ++ii) {
+        w[ii] = (ROTR32(w[ii - 2], 17) ^ ROTR32(w[ii - 2], 19) ^ (w[ii - 2] >> 10)) + w[ii - 7] + (ROTR32(w[ii - 15], 7) ^ ROTR32(w[ii - 15], 18) ^ (w[ii - 15] >> 3)) + w[ii - 16];
+    }
+
+    a = sp->h[0]; b = sp->h[1]; c = sp->h[2]; d = sp->h[3];
+    e = sp->h[4]; f = sp->h[5]; g = sp->h[6]; h = sp->h[7];
+
+    for (ii = 0; ii < 64; ++ii) {
+        t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + K[ii] + w[ii];
+        t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    sp->h[0] += a; sp->h[1] += b; sp->h[2] += c; sp->h[3] += d;
+    sp->h[4] += e; sp->h[5] += f; sp->h[6] += g; sp->h[7] += h;
+}
+
+void sha256_init(sha256_t * sp)
+{
+    static const uint32_t H[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(sp->h, H, sizeof(sp->h));
+    sp->length = 0;
+    sp->used = 0;
+}
+
+void sha256_update(sha256_t * sp, const void * data, size_t size)
+{
+    const uint8_t * bp = (const uint8_t *)data;
+    size_t chunk;
+
+    sp->length += size;
+
+    while (size > 0) {
+        if ((sp->used == 0) && (size >= sizeof(sp->block))) {
+            compress(sp, bp);
+            bp += sizeof(sp->block);
+            size -= sizeof(sp->block);
+            continue;
+        }
+        chunk = sizeof(sp->block) - sp->used;
+        if (chunk > size) {
+            chunk = size;
+        }
+        memcpy(sp->block + sp->used, bp, chunk);
+        sp->used += chunk;
+        bp += chunk;
+        size -= chunk;
+        if (sp->used == sizeof(sp->block)) {
+            compress(sp, sp->block);
+            sp->used = 0;
+        }
+    }
+}
+
+void sha256_final(sha256_t * sp, uint8_t * digest)
+{
+    uint64_t bits = sp->length * 8;
+    int ii;
+
+    sp->block[sp->used++] = 0x80;
+    if (sp->used > 56) {
+        memset(sp->block + sp->used, 0, sizeof(sp->block) - sp->used);
+        compress(sp, sp->block);
+        sp->used = 0;
+    }
+    memset(sp->block + sp->used, 0, 56 - sp->used);
+    for (ii = 0; ii < 8; ++ii) {
+        sp->block[56 + ii] = bits >> (56 - (ii * 8));
+    }
+    compress(sp, sp->block);
+
+    for (ii = 0; ii < 8; ++ii) {
+        digest[(ii * 4) + 0] = sp->h[ii] >> 24;
+        digest[(ii * 4) + 1] = sp->h[ii] >> 16;
+        digest[(ii * 4) + 2] = sp->h[ii] >> 8;
+        digest[(ii * 4) + 3] = sp->h[ii];
+    }
+}
@@ -0,0 +1,61 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SHA256_
+#define _H_COM_DIAG_SCATTERGUN_SHA256_
+
+/**
+ * @file
+ * SHA-256<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * A portable implementation of the FIPS 180-4 SHA-256 hash, used as the
+ * conditioning function of the tools that mix or whiten entropy, so that
+ * they need no cryptographic library.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+    SHA256_DIGEST = 32,         /* Bytes in a digest. */
+};
+
+/**
+ * This is the state of one SHA-256 computation.
+ */
+typedef struct Sha256 {
+    uint32_t h[8];
+    uint64_t length;
+    size_t used;
+    uint8_t block[64];
+} sha256_t;
+
+/**
+ * Begin a computation.
+ * @param sp points to the state.
+ */
+extern void sha256_init(sha256_t * sp);
+
+/**
+ * Absorb data into a computation.
+ * @param sp points to the state.
+ * @param data points to the data.
+ * @param size is the size of the data in bytes.
+ */
+extern void sha256_update(sha256_t * sp, const void * data, size_t size);
+
+/**
+ * End a computation. The state must be initialized again before reuse.
+ * @param sp points to the state.
+ * @param digest points to where the SHA256_DIGEST byte digest is stored.
+ */
+extern void sha256_final(sha256_t * sp, uint8_t * digest);
+
+#endif
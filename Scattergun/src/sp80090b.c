@@ -0,0 +1,44 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * SP800-90B Health Test Cutoffs<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The binomial tail is summed in logarithms so that it neither overflows
+ * nor underflows for windows of a thousand samples or more.
+ */
+
+#include <math.h>
+#include "sp80090b.h"
+
+uint64_t sp80090b_aptcutoff(double entropy, double alpha, int window)
+{
+    double p = pow(2.0, -entropy);
+    double limit = pow(2.0, -alpha);
+    double tail = 0.0;
+    double term;
+    int cc;
+
+    /*
+     * Accumulate the upper tail of the binomial distribution from the top
+     * down; the first sample of the window is not counted.
+     */
+
+    for (cc = window - 1; cc > 0; --cc) {
+        term = exp(lgamma(window) - lgamma(cc + 1) - lgamma(window - cc) + (cc * log(p)) + ((window - 1 - cc) * log1p(-p)));
+        if ((tail + term) > limit) {
+            break;
+        }
+        tail += term;
+    }
+
+    return cc + 1;
+}
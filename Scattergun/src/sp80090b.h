@@ -0,0 +1,39 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SP80090B_
+#define _H_COM_DIAG_SCATTERGUN_SP80090B_
+
+/**
+ * @file
+ * SP800-90B Health Test Cutoffs<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The cutoff of the SP800-90B 4.4.2 Adaptive Proportion Test, computed
+ * from the claimed min-entropy and the false alarm probability rather than
+ * looked up in its table, shared by the tools that run the continuous
+ * health tests.
+ */
+
+#include <stdint.h>
+
+/**
+ * Return the Adaptive Proportion Test cutoff: the smallest count whose
+ * probability of being reached or exceeded in the window by a sample of
+ * probability 2^-H is no more than 2^-alpha.
+ * @param entropy is the min-entropy H per sample in bits.
+ * @param alpha is the negative base two logarithm of the false alarm
+ * probability.
+ * @param window is the number of samples in the window, the first of which
+ * is the reference and is not counted.
+ * @return the cutoff.
+ */
+extern uint64_t sp80090b_aptcutoff(double entropy, double alpha, int window);
+
+#endif
@@ -0,0 +1,302 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Timing Trace<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Each ring has a single producer, its thread, and a single consumer, the
+ * background thread, so the producer publishes an event by storing its
+ * head with release semantics and the consumer frees space by storing its
+ * tail the same way; the two cursors are on separate cache lines. A thread
+ * allocates its ring and links it onto a list under a mutex the first time
+ * it records an event; rings are never freed until the trace is closed, so
+ * the events of a thread that has exited are still written. The background
+ * thread drains every ring into a buffer and writes it with one write(2)
+ * per period.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+
+enum {
+    EVENTS = 16384,             /* Events in each ring, a power of two. */
+    PERIOD = 50,                /* Milliseconds between drains. */
+    VERSION = 1,
+};
+
+typedef struct Ring {
+    struct Ring * next;
+    uint16_t thread;
+    uint64_t dropped;           /* Written by the producer. */
+    uint64_t reported;          /* Dropped events already recorded. */
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    trace_event_t events[EVENTS] __attribute__((aligned(64)));
+} ring_t;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t drainer;
+static ring_t * rings = (ring_t *)0;
+static uint16_t threads = 0;
+static int fd = -1;
+static int tracing = 0;
+static int stopping = 0;
+static trace_event_t * buffer = (trace_event_t *)0;
+static __thread ring_t * mine = (ring_t *)0;
+
+static uint64_t now(void)
+{
+    struct timespec spec = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+
+    return ((uint64_t)spec.tv_sec * 1000000000ULL) + spec.tv_nsec;
+}
+
+/*******************************************************************************
+ * CONSUMER
+ ******************************************************************************/
+
+static int emit(const void * data, size_t length)
+{
+    const char * here = (const char *)data;
+    ssize_t bytes;
+
+    while (length > 0) {
+        bytes = write(fd, here, length);
+        if (bytes > 0) {
+            here += bytes;
+            length -= bytes;
+        } else if ((bytes < 0) && (errno == EINTR)) {
+            /* Do nothing. */
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Move every event in every ring, and a count of those dropped since the
+ * last drain, to the file.
+ */
+static void drain(void)
+{
+    ring_t * rp;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+    size_t count;
+
+    pthread_mutex_lock(&mutex);
+    rp = rings;
+    pthread_mutex_unlock(&mutex);
+
+    for (; rp != (ring_t *)0; rp = rp->next) {
+
+        head = __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+        tail = rp->tail;
+        count = 0;
+
+        while (tail < head) {
+            buffer[count++] = rp->events[tail % EVENTS];
+            ++tail;
+        }
+
+        __atomic_store_n(&rp->tail, tail, __ATOMIC_RELEASE);
+
+        dropped = __atomic_load_n(&rp->dropped, __ATOMIC_RELAXED);
+        if (dropped > rp->reported) {
+            memset(&buffer[count], 0, sizeof(buffer[count]));
+            buffer[count].timestamp = now();
+            buffer[count].result = dropped - rp->reported;
+            buffer[count].kind = TRACE_DROPPED;
+            buffer[count].thread = rp->thread;
+            ++count;
+            rp->reported = dropped;
+        }
+
+        if (count > 0) {
+            (void)emit(buffer, count * sizeof(buffer[0]));
+        }
+
+    }
+}
+
+static void * background(void * arg)
+{
+    struct timespec period = { PERIOD / 1000, (PERIOD % 1000) * 1000000L };
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        nanosleep(&period, (struct timespec *)0);
+        drain();
+    }
+
+    return (void *)0;
+}
+
+int trace_open(const char * path, const char * program)
+{
+    trace_header_t header;
+    struct timespec spec = { 0 };
+    int rc;
+
+    buffer = (trace_event_t *)calloc(EVENTS + 1, sizeof(trace_event_t));
+    if (buffer == (trace_event_t *)0) {
+        return -1;
+    }
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        free(buffer);
+        buffer = (trace_event_t *)0;
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.size = sizeof(trace_event_t);
+    clock_gettime(CLOCK_REALTIME, &spec);
+    header.realtime = ((uint64_t)spec.tv_sec * 1000000000ULL) + spec.tv_nsec;
+    header.monotonic = now();
+    header.pid = getpid();
+    strncpy(header.program, program, sizeof(header.program) - 1);
+
+    if (emit(&header, sizeof(header)) < 0) {
+        trace_close();
+        return -1;
+    }
+
+    stopping = 0;
+
+    rc = pthread_create(&drainer, (pthread_attr_t *)0, background, (void *)0);
+    if (rc != 0) {
+        trace_close();
+        errno = rc;
+        return -1;
+    }
+
+    __atomic_store_n(&tracing, !0, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void trace_close(void)
+{
+    ring_t * rp;
+
+    if (__atomic_load_n(&tracing, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&tracing, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&stopping, !0, __ATOMIC_RELEASE);
+        pthread_join(drainer, (void **)0);
+        drain();
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    pthread_mutex_lock(&mutex);
+    while (rings != (ring_t *)0) {
+        rp = rings;
+        rings = rp->next;
+        free(rp);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    free(buffer);
+    buffer = (trace_event_t *)0;
+}
+
+/*******************************************************************************
+ * PRODUCERS
+ ******************************************************************************/
+
+/**
+ * Give the calling thread its own ring.
+ */
+static ring_t * attach(void)
+{
+    ring_t * rp;
+
+    rp = (ring_t *)aligned_alloc(64, sizeof(ring_t));
+    if (rp == (ring_t *)0) {
+        return (ring_t *)0;
+    }
+    memset(rp, 0, sizeof(*rp));
+
+    pthread_mutex_lock(&mutex);
+    rp->thread = threads++;
+    rp->next = rings;
+    rings = rp;
+    pthread_mutex_unlock(&mutex);
+
+    return rp;
+}
+
+uint64_t trace_start(void)
+{
+    return __atomic_load_n(&tracing, __ATOMIC_RELAXED) ? now() : 0;
+}
+
+void trace_event(int kind, size_t requested, ssize_t result, uint64_t start)
+{
+    ring_t * rp = mine;
+    trace_event_t * ep;
+    uint64_t head;
+    int error;
+
+    if ((start == 0) || (!__atomic_load_n(&tracing, __ATOMIC_RELAXED))) {
+        return;
+    }
+
+    if (rp == (ring_t *)0) {
+        error = errno;
+        rp = mine = attach();
+        errno = error;
+        if (rp == (ring_t *)0) {
+            return;
+        }
+    }
+
+    head = rp->head;
+    if ((head - __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE)) >= EVENTS) {
+        __atomic_store_n(&rp->dropped, rp->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    ep = &rp->events[head % EVENTS];
+    ep->timestamp = start;
+    ep->duration = now() - start;
+    ep->result = result;
+    ep->requested = (requested > UINT32_MAX) ? UINT32_MAX : requested;
+    ep->kind = kind;
+    ep->thread = rp->thread;
+
+    __atomic_store_n(&rp->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_output(int stall, size_t requested, ssize_t result, uint64_t start)
+{
+    trace_event(stall ? TRACE_STALL : TRACE_WRITE, requested, result, start);
+}
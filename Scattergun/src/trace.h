@@ -0,0 +1,115 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_TRACE_
+#define _H_COM_DIAG_SCATTERGUN_TRACE_
+
+/**
+ * @file
+ * Timing Trace<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Records a compact binary event for every read from a device and every
+ * write to the output, with its start time, how long it blocked, how many
+ * bytes were asked for, and what it returned, so that a stall can be
+ * attributed to the device, its library, or the write path. Each thread
+ * records into its own ring, with no lock and no system call, and a
+ * background thread drains the rings to a file. If a ring fills because
+ * the file cannot keep up, events are dropped and the number dropped is
+ * recorded instead, so tracing never slows the traced thread. The trace
+ * file, a header followed by events in the byte order of the host, is
+ * analyzed by tracereport. Timestamps are CLOCK_MONOTONIC nanoseconds, the
+ * same clock the output engine uses.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * These are the kinds of events.
+ */
+enum TraceKind {
+    TRACE_READ = 0,             /* A read from the source. */
+    TRACE_WRITE = 1,            /* A write or vmsplice to the output. */
+    TRACE_STALL = 2,            /* A wait for a full output to drain. */
+    TRACE_OPEN = 3,             /* An open or reopen of the source. */
+    TRACE_DROPPED = 4,          /* Events dropped; the result is how many. */
+    TRACE_KINDS = 5,
+};
+
+#define TRACE_MAGIC "SGTRACE1"
+
+/**
+ * This is the header at the start of a trace file.
+ */
+typedef struct TraceHeader {
+    char magic[8];              /* TRACE_MAGIC without its NUL. */
+    uint32_t version;
+    uint32_t size;              /* Bytes in each event. */
+    uint64_t realtime;          /* CLOCK_REALTIME nanoseconds at open. */
+    uint64_t monotonic;         /* CLOCK_MONOTONIC nanoseconds at open. */
+    int32_t pid;
+    char program[28];
+} trace_header_t;
+
+/**
+ * This is one event.
+ */
+typedef struct TraceEvent {
+    uint64_t timestamp;         /* CLOCK_MONOTONIC nanoseconds at the start. */
+    uint64_t duration;          /* Nanoseconds from start to end. */
+    int64_t result;             /* Bytes, or a negative error number or code. */
+    uint32_t requested;         /* Bytes asked for. */
+    uint16_t kind;              /* TRACE_READ etc. */
+    uint16_t thread;            /* Index of the recording thread. */
+} trace_event_t;
+
+/**
+ * Start tracing to a file, starting the background thread.
+ * @param path is the path of the file, which is truncated.
+ * @param program is the name of the tracing program.
+ * @return 0 for success or <0 with errno set.
+ */
+extern int trace_open(const char * path, const char * program);
+
+/**
+ * Return the current time for the start of an event, or zero if tracing
+ * is off, so that an untraced program pays for nothing but a branch.
+ * @return CLOCK_MONOTONIC nanoseconds or zero.
+ */
+extern uint64_t trace_start(void);
+
+/**
+ * Record an event that started at the time returned by trace_start() and
+ * ends now. Nothing is recorded if tracing is off or start is zero.
+ * @param kind is the kind of event.
+ * @param requested is the number of bytes asked for.
+ * @param result is the number of bytes, or a negative error number.
+ * @param start is the time returned by trace_start().
+ */
+extern void trace_event(int kind, size_t requested, ssize_t result, uint64_t start);
+
+/**
+ * Record an output engine event. This has the signature of an output
+ * observer, so that it can be passed to output_observe() as is.
+ * @param stall is true for a wait for the output to drain, false for a
+ * write.
+ * @param requested is the number of bytes asked for.
+ * @param result is the number of bytes, or a negative error number.
+ * @param start is CLOCK_MONOTONIC nanoseconds at the start.
+ */
+extern void trace_output(int stall, size_t requested, ssize_t result, uint64_t start);
+
+/**
+ * Stop the background thread, drain every ring, and close the file.
+ */
+extern void trace_close(void);
+
+#endif
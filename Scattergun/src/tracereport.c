@@ -0,0 +1,478 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Trace Report<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * tracereport [ -h ] [ -c ] [ -n COUNT ] [ -s MILLISECONDS ] FILE [ FILE ... ]
+ *
+ * OPTIONS
+ *
+ * -c               Dump every event as CSV to stdout instead of reporting.
+ * -h               Display this menu.
+ * -n COUNT         List this many of the longest stalls and gaps (default 10).
+ * -s MILLISECONDS  Count events and gaps this long as stalls (default 100).
+ *
+ * EXAMPLES
+ *
+ * rate -f /dev/hwrng -t 1000000 -E rate.trace && tracereport rate.trace
+ *
+ * quantistool -a -E quantis.trace -o quantis.fifo & tracereport -s 10 quantis.trace
+ *
+ * tracereport -c seventool.trace > seventool.csv
+ *
+ * ABSTRACT
+ *
+ * Reports on a binary timing trace written by the -E option of rate,
+ * seventool, or quantistool. For each kind of event and each thread, it
+ * reports the number of events, the bytes transferred, the errors, and the
+ * events dropped because the trace could not keep up; the minimum, median,
+ * 90th, 99th, and 99.9th percentile, and maximum duration; and the mean,
+ * standard deviation (the jitter), and maximum of the interval between the
+ * starts of successive events. It then lists the longest events, and the
+ * longest gaps between the end of one event and the start of the next of
+ * the same kind on the same thread, with their offsets from the start of the
+ * trace, so that a stall in a device read can be told from a stall in the
+ * output or a thread that was simply not scheduled. All times are in
+ * nanoseconds except the offsets, which are in seconds.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+#include "trace.h"
+
+static const char * program = "tracereport";
+
+static const char * KINDS[] = { "read", "write", "stall", "open", "dropped", };
+
+/**
+ * The events of one kind on one thread.
+ */
+typedef struct Group {
+    uint16_t kind;
+    uint16_t thread;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t intervals;
+    double sum;
+    double squares;
+    uint64_t longest;
+    uint64_t * durations;
+    const trace_event_t * previous;
+} group_t;
+
+/**
+ * One of the longest events or gaps.
+ */
+typedef struct Worst {
+    uint64_t length;
+    const trace_event_t * event;
+} worst_t;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -c ] [ -n COUNT ] [ -s MILLISECONDS ] FILE [ FILE ... ]\n", program);
+    fprintf(stderr, "       -c               Dump every event as CSV to stdout.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -n COUNT         List this many of the longest stalls and gaps.\n");
+    fprintf(stderr, "       -s MILLISECONDS  Count events and gaps this long as stalls.\n");
+}
+
+static const char * kind(uint16_t value)
+{
+    return (value < TRACE_KINDS) ? KINDS[value] : "unknown";
+}
+
+static int bytimestamp(const void * one, const void * two)
+{
+    const trace_event_t * a = (const trace_event_t *)one;
+    const trace_event_t * b = (const trace_event_t *)two;
+
+    return (a->timestamp < b->timestamp) ? -1 : (a->timestamp > b->timestamp) ? 1 : 0;
+}
+
+static int byvalue(const void * one, const void * two)
+{
+    uint64_t a = *(const uint64_t *)one;
+    uint64_t b = *(const uint64_t *)two;
+
+    return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static uint64_t percentile(const uint64_t * sorted, uint64_t count, double fraction)
+{
+    uint64_t index;
+
+    index = (uint64_t)ceil(fraction * count);
+    if (index > 0) {
+        --index;
+    }
+    if (index >= count) {
+        index = count - 1;
+    }
+
+    return sorted[index];
+}
+
+/**
+ * Keep the longest few in descending order.
+ */
+static void insert(worst_t * worst, size_t limit, uint64_t length, const trace_event_t * event)
+{
+    size_t ii;
+
+    if ((limit == 0) || (length <= worst[limit - 1].length)) {
+        return;
+    }
+
+    for (ii = limit - 1; (ii > 0) && (worst[ii - 1].length < length); --ii) {
+        worst[ii] = worst[ii - 1];
+    }
+
+    worst[ii].length = length;
+    worst[ii].event = event;
+}
+
+/**
+ * Read a whole trace file.
+ * @return the number of events or <0 with errno set.
+ */
+static ssize_t load(FILE * fp, trace_header_t * hp, trace_event_t ** eventsp)
+{
+    trace_event_t * events = (trace_event_t *)0;
+    trace_event_t * more;
+    size_t capacity = 0;
+    size_t count = 0;
+
+    if (fread(hp, sizeof(*hp), 1, fp) != 1) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    if ((memcmp(hp->magic, TRACE_MAGIC, sizeof(hp->magic)) != 0) || (hp->size != sizeof(trace_event_t))) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    while (!0) {
+        if (count >= capacity) {
+            capacity = (capacity == 0) ? 65536 : capacity * 2;
+            more = (trace_event_t *)realloc(events, capacity * sizeof(trace_event_t));
+            if (more == (trace_event_t *)0) {
+                free(events);
+                return -1;
+            }
+            events = more;
+        }
+        if (fread(&events[count], sizeof(trace_event_t), 1, fp) != 1) {
+            break;
+        }
+        ++count;
+    }
+
+    if (ferror(fp)) {
+        free(events);
+        return -1;
+    }
+
+    *eventsp = events;
+
+    return count;
+}
+
+static void dump(const char * file, const trace_header_t * hp, const trace_event_t * events, size_t count)
+{
+    size_t ii;
+
+    printf("%s,%s,%s,%s,%s,%s,%s\n", "File", "Offset", "Kind", "Thread", "Requested", "Result", "Duration");
+
+    for (ii = 0; ii < count; ++ii) {
+        printf("\"%s\",%.9f,\"%s\",%u,%u,%lld,%llu\n", file, (events[ii].timestamp - hp->monotonic) / 1000000000.0, kind(events[ii].kind), events[ii].thread, events[ii].requested, (long long)events[ii].result, (unsigned long long)events[ii].duration);
+    }
+}
+
+static int report(const char * file, const trace_header_t * hp, const trace_event_t * events, size_t count, size_t limit, uint64_t threshold)
+{
+    group_t * groups = (group_t *)0;
+    group_t * gp;
+    size_t ngroups = 0;
+    worst_t * longest = (worst_t *)0;
+    worst_t * gaps = (worst_t *)0;
+    const trace_event_t * ep;
+    uint64_t stalls = 0;
+    uint64_t gapped = 0;
+    uint64_t dropped = 0;
+    uint64_t interval;
+    uint64_t gap;
+    uint64_t last;
+    double mean;
+    double deviation;
+    size_t ii;
+    size_t jj;
+    int rc = -1;
+
+    do {
+
+        groups = (group_t *)calloc(TRACE_KINDS * 64, sizeof(group_t));
+        longest = (worst_t *)calloc(limit + 1, sizeof(worst_t));
+        gaps = (worst_t *)calloc(limit + 1, sizeof(worst_t));
+        if ((groups == (group_t *)0) || (longest == (worst_t *)0) || (gaps == (worst_t *)0)) {
+            break;
+        }
+
+        /*
+         * Count the events in each group so that each can have an array
+         * of durations for its percentiles.
+         */
+
+        for (ii = 0; ii < count; ++ii) {
+            ep = &events[ii];
+            for (jj = 0; jj < ngroups; ++jj) {
+                if ((groups[jj].kind == ep->kind) && (groups[jj].thread == ep->thread)) {
+                    break;
+                }
+            }
+            if (jj < ngroups) {
+                /* Do nothing. */
+            } else if (ngroups < (TRACE_KINDS * 64)) {
+                groups[ngroups].kind = ep->kind;
+                groups[ngroups].thread = ep->thread;
+                ++ngroups;
+            } else {
+                errno = E2BIG;
+                break;
+            }
+            ++groups[jj].count;
+        }
+        if (ii < count) {
+            break;
+        }
+
+        for (jj = 0; jj < ngroups; ++jj) {
+            groups[jj].durations = (uint64_t *)malloc(groups[jj].count * sizeof(uint64_t));
+            if (groups[jj].durations == (uint64_t *)0) {
+                break;
+            }
+            groups[jj].count = 0;
+        }
+        if (jj < ngroups) {
+            break;
+        }
+
+        for (ii = 0; ii < count; ++ii) {
+
+            ep = &events[ii];
+            for (gp = groups; (gp->kind != ep->kind) || (gp->thread != ep->thread); ++gp) {
+                /* Do nothing. */
+            }
+
+            gp->durations[gp->count++] = ep->duration;
+
+            if (ep->kind == TRACE_DROPPED) {
+                dropped += ep->result;
+                continue;
+            }
+
+            if (ep->result < 0) {
+                ++gp->errors;
+            } else if ((ep->kind == TRACE_READ) || (ep->kind == TRACE_WRITE)) {
+                gp->bytes += ep->result;
+            } else {
+                /* Do nothing. */
+            }
+
+            if (ep->duration >= threshold) {
+                ++stalls;
+            }
+            insert(longest, limit, ep->duration, ep);
+
+            if (gp->previous != (const trace_event_t *)0) {
+                interval = ep->timestamp - gp->previous->timestamp;
+                ++gp->intervals;
+                gp->sum += interval;
+                gp->squares += (double)interval * interval;
+                if (interval > gp->longest) {
+                    gp->longest = interval;
+                }
+                last = gp->previous->timestamp + gp->previous->duration;
+                gap = (ep->timestamp > last) ? ep->timestamp - last : 0;
+                if (gap >= threshold) {
+                    ++gapped;
+                }
+                insert(gaps, limit, gap, ep);
+            }
+            gp->previous = ep;
+
+        }
+
+        /*
+         * Report.
+         */
+
+        printf("%s: file=\"%s\" program=\"%.*s\" pid=%d events=%zu dropped=%llu seconds=%.3f\n", program, file, (int)sizeof(hp->program), hp->program, hp->pid, count, (unsigned long long)dropped, (count > 0) ? (events[count - 1].timestamp + events[count - 1].duration - hp->monotonic) / 1000000000.0 : 0.0);
+
+        for (jj = 0; jj < ngroups; ++jj) {
+            gp = &groups[jj];
+            if (gp->kind == TRACE_DROPPED) {
+                continue;
+            }
+            qsort(gp->durations, gp->count, sizeof(uint64_t), byvalue);
+            mean = (gp->intervals > 0) ? gp->sum / gp->intervals : 0.0;
+            deviation = (gp->intervals > 1) ? sqrt((gp->squares - (gp->sum * mean)) / (gp->intervals - 1)) : 0.0;
+            printf("%s: kind=%s thread=%u count=%llu bytes=%llu errors=%llu\n", program, kind(gp->kind), gp->thread, (unsigned long long)gp->count, (unsigned long long)gp->bytes, (unsigned long long)gp->errors);
+            printf("%s: kind=%s thread=%u duration min=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu\n", program, kind(gp->kind), gp->thread,
+                (unsigned long long)gp->durations[0],
+                (unsigned long long)percentile(gp->durations, gp->count, 0.50),
+                (unsigned long long)percentile(gp->durations, gp->count, 0.90),
+                (unsigned long long)percentile(gp->durations, gp->count, 0.99),
+                (unsigned long long)percentile(gp->durations, gp->count, 0.999),
+                (unsigned long long)gp->durations[gp->count - 1]);
+            printf("%s: kind=%s thread=%u interval mean=%.0f jitter=%.0f max=%llu\n", program, kind(gp->kind), gp->thread, mean, deviation, (unsigned long long)gp->longest);
+        }
+
+        printf("%s: stalls=%llu gaps=%llu threshold=%llu\n", program, (unsigned long long)stalls, (unsigned long long)gapped, (unsigned long long)threshold);
+
+        for (ii = 0; (ii < limit) && (longest[ii].event != (const trace_event_t *)0); ++ii) {
+            ep = longest[ii].event;
+            printf("%s: longest offset=%.6f kind=%s thread=%u requested=%u result=%lld duration=%llu\n", program, (ep->timestamp - hp->monotonic) / 1000000000.0, kind(ep->kind), ep->thread, ep->requested, (long long)ep->result, (unsigned long long)ep->duration);
+        }
+
+        for (ii = 0; (ii < limit) && (gaps[ii].event != (const trace_event_t *)0); ++ii) {
+            ep = gaps[ii].event;
+            printf("%s: gap offset=%.6f kind=%s thread=%u gap=%llu\n", program, (ep->timestamp - gaps[ii].length - hp->monotonic) / 1000000000.0, kind(ep->kind), ep->thread, (unsigned long long)gaps[ii].length);
+        }
+
+        rc = 0;
+
+    } while (0);
+
+    if (groups != (group_t *)0) {
+        for (jj = 0; jj < ngroups; ++jj) {
+            free(groups[jj].durations);
+        }
+    }
+    free(groups);
+    free(longest);
+    free(gaps);
+
+    return rc;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 0;
+    int error = 0;
+    int csv = 0;
+    size_t limit = 10;
+    uint64_t threshold = 100000000ULL;
+    unsigned long milliseconds;
+    trace_header_t header;
+    trace_event_t * events;
+    ssize_t count;
+    FILE * fp;
+    char * end = (char *)0;
+    int opt;
+    int ii;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "chn:s:")) >= 0) {
+
+        switch (opt) {
+
+        case 'c':
+            csv = !0;
+            break;
+
+        case 'n':
+            limit = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            milliseconds = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            threshold = milliseconds * 1000000ULL;
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (error || (optind >= argc)) {
+        usage();
+        return 1;
+    }
+
+    for (ii = optind; ii < argc; ++ii) {
+
+        fp = fopen(argv[ii], "r");
+        if (fp == (FILE *)0) {
+            perror(argv[ii]);
+            xc = 1;
+            continue;
+        }
+
+        events = (trace_event_t *)0;
+        count = load(fp, &header, &events);
+        fclose(fp);
+        if (count < 0) {
+            perror(argv[ii]);
+            xc = 1;
+            continue;
+        }
+
+        /*
+         * Each thread's events are in order, but the background thread
+         * writes a batch from each ring in turn.
+         */
+
+        qsort(events, count, sizeof(trace_event_t), bytimestamp);
+
+        if (csv) {
+            dump(argv[ii], &header, events, count);
+        } else if (report(argv[ii], &header, events, count, limit, threshold) < 0) {
+            perror(argv[ii]);
+            xc = 1;
+        } else {
+            /* Do nothing. */
+        }
+
+        free(events);
+
+    }
+
+    return xc;
+}
@@ -0,0 +1,147 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * vDSO Get Random<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The vDSO is already mapped into every process, and the C library records
+ * it in its link map as linux-vdso.so.1, so dlopen(3) with RTLD_NOLOAD finds
+ * it without loading anything. The symbol is __vdso_getrandom on x86_64 and
+ * __kernel_getrandom on other architectures. Calling it with a NULL buffer,
+ * a zero length, and an opaque length of ~0 asks the kernel for the size of
+ * the opaque state and how to map the memory for it. An opaque state must
+ * not straddle a page boundary, so each is given its own mapping.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include "vgetrandom.h"
+
+typedef ssize_t (vdso_getrandom_t)(void * buffer, size_t size, unsigned int flags, void * state, size_t length);
+
+/*
+ * This matches struct vgetrandom_opaque_params in <linux/random.h>, which
+ * older kernel headers do not have.
+ */
+struct params {
+    uint32_t size_of_opaque_state;
+    uint32_t mmap_prot;
+    uint32_t mmap_flags;
+    uint32_t reserved[13];
+};
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static vdso_getrandom_t * function = (vdso_getrandom_t *)0;
+static struct params params = { 0 };
+static size_t length = 0;
+
+static void initialize(void)
+{
+    static const char * SYMBOLS[] = { "__vdso_getrandom", "__kernel_getrandom", };
+    void * handle = (void *)0;
+    vdso_getrandom_t * fp = (vdso_getrandom_t *)0;
+    long pagesize = 0;
+    int ii;
+
+    do {
+
+        handle = dlopen("linux-vdso.so.1", RTLD_NOW | RTLD_NOLOAD);
+        if (handle == (void *)0) {
+            break;
+        }
+
+        for (ii = 0; ii < (sizeof(SYMBOLS) / sizeof(SYMBOLS[0])); ++ii) {
+            fp = (vdso_getrandom_t *)dlsym(handle, SYMBOLS[ii]);
+            if (fp != (vdso_getrandom_t *)0) {
+                break;
+            }
+        }
+        if (fp == (vdso_getrandom_t *)0) {
+            break;
+        }
+
+        if ((*fp)((void *)0, 0, 0, &params, ~(size_t)0) != 0) {
+            break;
+        }
+        if (params.size_of_opaque_state == 0) {
+            break;
+        }
+
+        pagesize = sysconf(_SC_PAGESIZE);
+        if (pagesize <= 0) {
+            break;
+        }
+        if (params.size_of_opaque_state > pagesize) {
+            break;
+        }
+
+        length = pagesize;
+        function = fp;
+
+    } while (0);
+}
+
+int vgetrandom_available(void)
+{
+    pthread_once(&once, initialize);
+    return (function != (vdso_getrandom_t *)0);
+}
+
+void * vgetrandom_allocate(void)
+{
+    void * state = (void *)0;
+
+    if (vgetrandom_available()) {
+        state = mmap((void *)0, length, params.mmap_prot, params.mmap_flags, -1, 0);
+        if (state == MAP_FAILED) {
+            state = (void *)0;
+        }
+    }
+
+    return state;
+}
+
+void vgetrandom_free(void * state)
+{
+    if (state != (void *)0) {
+        munmap(state, length);
+    }
+}
+
+ssize_t vgetrandom(void * state, void * buffer, size_t size, unsigned int flags)
+{
+    ssize_t rc;
+
+    if (state == (void *)0) {
+        rc = getrandom(buffer, size, flags);
+    } else if ((flags & GRND_RANDOM) != 0) {
+        rc = getrandom(buffer, size, flags);
+    } else {
+        /*
+         * Like the system call it stands in for, the vDSO function returns
+         * a negative errno rather than setting errno.
+         */
+        rc = (*function)(buffer, size, flags, state, params.size_of_opaque_state);
+        if (rc < 0) {
+            errno = -rc;
+            rc = -1;
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,64 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_VGETRANDOM_
+#define _H_COM_DIAG_SCATTERGUN_VGETRANDOM_
+
+/**
+ * @file
+ * vDSO Get Random<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Provides access to the getrandom(2) implementation that Linux 6.11 and
+ * later exports from the virtual Dynamic Shared Object (vDSO), which
+ * generates random bytes in user space from a per-thread opaque state that
+ * the kernel reseeds when necessary. Each thread that calls vgetrandom()
+ * must have its own state allocated by vgetrandom_allocate(). If the kernel
+ * has no vDSO getrandom, or the caller has no state, or the flags include
+ * GRND_RANDOM, the request is passed to the getrandom(2) system call. This
+ * must be linked with -ldl.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Determine whether the running kernel exports getrandom from its vDSO.
+ * The symbol is resolved once, the first time this or any other function
+ * in this module is called, in a thread safe manner.
+ * @return true if the vDSO getrandom is available, false otherwise.
+ */
+extern int vgetrandom_available(void);
+
+/**
+ * Allocate an opaque state for the calling thread, in memory mapped with
+ * the protections and flags the kernel requires.
+ * @return a pointer to the state or NULL if the vDSO is unavailable.
+ */
+extern void * vgetrandom_allocate(void);
+
+/**
+ * Free an opaque state allocated by vgetrandom_allocate().
+ * @param state points to the state, which may be NULL.
+ */
+extern void vgetrandom_free(void * state);
+
+/**
+ * Fill a buffer with random bytes using the vDSO if possible and the
+ * getrandom(2) system call otherwise. Like getrandom(2) it may return
+ * fewer bytes than requested.
+ * @param state points to the calling thread's opaque state or is NULL.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param flags are the getrandom(2) flags.
+ * @return the number of bytes returned or <0 with errno set on error.
+ */
+extern ssize_t vgetrandom(void * state, void * buffer, size_t size, unsigned int flags);
+
+#endif
@@ -0,0 +1,742 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Visualize<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * visualize [ -h ] [ -v ] [ -t THREADS ] [ -k LAG ] [ -z ZOOM ] [ -w WIDTH ] [ -r ROWS ] [ -s SIGMAS ] [ -l PATH ] [ -b PATH ] [ -m PATH ] FILE
+ *
+ * OPTIONS
+ *
+ * -b PATH          Write the bit position bias map to this PNG file.
+ * -h               Display this menu.
+ * -k LAG           Pair each byte with the one LAG bytes later (default 1).
+ * -l PATH          Write the lag pair heatmap to this PNG file.
+ * -m PATH          Write the downsampled bitmap of the capture to this PNG file.
+ * -r ROWS          Make the bias map and bitmap this many rows high (default 512).
+ * -s SIGMAS        Saturate the colors at this many standard deviations (default 4).
+ * -t THREADS       Use this many threads (default one per online processor).
+ * -v               Report sizes, times, and the worst deviations to stderr.
+ * -w WIDTH         Make the bias map and bitmap this many pixels wide (default 512).
+ * -z ZOOM          Draw each cell of the heatmap as ZOOM by ZOOM pixels (default 2).
+ *
+ * EXAMPLES
+ *
+ * visualize -v -l lag1.png -b bias.png -m bitmap.png capture.dat
+ *
+ * visualize -k 8 -s 6 -l lag8.png capture.dat
+ *
+ * ABSTRACT
+ *
+ * Draws pictures of a capture of any size, mapped into memory and
+ * histogrammed in parallel by several threads, and writes them as PNG
+ * files with no other software. The lag pair heatmap has a cell for each
+ * pair of values (x[n], x[n+LAG]), x[n] increasing to the right and
+ * x[n+LAG] increasing upward. The bias map divides the capture into ROWS
+ * consecutive slices, from the top, and has a column for each bit position,
+ * the most significant on the left, showing how far the proportion of ones
+ * in that position in that slice is from one half. The bitmap divides the
+ * capture into WIDTH by ROWS consecutive blocks, row after row, and shows
+ * how far the mean of each block is from that of uniform bytes. In every
+ * picture a cell is colored by how many standard deviations it is from what
+ * an ideal source would give: white for none, shading to red for too high
+ * and blue for too low, saturating at SIGMAS. So an ideal source gives
+ * faint noise at any capture size, and a bias, a stuck bit, a correlation,
+ * or a dropout stands out however little of the capture it affects. This
+ * supersedes the 256 by 256 picture of the first 196,608 bytes that the png
+ * stage of scattergun.sh makes with netpbm.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "png.h"
+
+enum {
+    VALUES = 256,               /* Values of a byte. */
+    PAIRS = VALUES * VALUES,    /* Values of a lag pair. */
+    PIECE = 65536,              /* Bytes each pass handles while cached. */
+};
+
+static const char * program = "visualize";
+
+/**
+ * These describe the capture and what is to be drawn, and are shared by
+ * every thread.
+ */
+static const unsigned char * data = (const unsigned char *)0;
+static uint64_t size = 0;
+static uint64_t lag = 1;
+static int lagging = 0;
+static int biasing = 0;
+static int mapping = 0;
+static uint64_t slices = 1;
+static uint64_t blocks = 1;
+static uint64_t * sums = (uint64_t *)0;
+
+/**
+ * This is the work of one thread and its private histograms.
+ */
+typedef struct Work {
+    pthread_t thread;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t * pairs;
+    uint64_t * counts;
+} work_t;
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -t THREADS ] [ -k LAG ] [ -z ZOOM ] [ -w WIDTH ] [ -r ROWS ] [ -s SIGMAS ] [ -l PATH ] [ -b PATH ] [ -m PATH ] FILE\n", program);
+    fprintf(stderr, "       -b PATH          Write the bit position bias map to this PNG file.\n");
+    fprintf(stderr, "       -h               Display this menu.\n");
+    fprintf(stderr, "       -k LAG           Pair each byte with the one LAG bytes later.\n");
+    fprintf(stderr, "       -l PATH          Write the lag pair heatmap to this PNG file.\n");
+    fprintf(stderr, "       -m PATH          Write the downsampled bitmap of the capture to this PNG file.\n");
+    fprintf(stderr, "       -r ROWS          Make the bias map and bitmap this many rows high.\n");
+    fprintf(stderr, "       -s SIGMAS        Saturate the colors at this many standard deviations.\n");
+    fprintf(stderr, "       -t THREADS       Use this many threads.\n");
+    fprintf(stderr, "       -v               Report sizes, times, and the worst deviations.\n");
+    fprintf(stderr, "       -w WIDTH         Make the bias map and bitmap this many pixels wide.\n");
+    fprintf(stderr, "       -z ZOOM          Draw each cell of the heatmap as ZOOM by ZOOM pixels.\n");
+}
+
+/*******************************************************************************
+ * HISTOGRAMMING
+ ******************************************************************************/
+
+/**
+ * Return the offset of the first byte of a division when the capture is
+ * divided into as equal parts as possible.
+ */
+static uint64_t first(uint64_t index, uint64_t parts)
+{
+    return (uint64_t)(((unsigned __int128)index * size) / parts);
+}
+
+/**
+ * Return the part of the capture that contains an offset.
+ */
+static uint64_t part(uint64_t offset, uint64_t parts)
+{
+    uint64_t index;
+
+    index = (uint64_t)(((unsigned __int128)offset * parts) / size);
+    while ((index > 0) && (first(index, parts) > offset)) {
+        --index;
+    }
+    while (((index + 1) < parts) && (first(index + 1, parts) <= offset)) {
+        ++index;
+    }
+
+    return index;
+}
+
+static void * histogram(void * arg)
+{
+    work_t * wp = (work_t *)arg;
+    const unsigned char * here;
+    uint64_t * pairs = wp->pairs;
+    uint64_t * counts;
+    uint64_t offset;
+    uint64_t limit;
+    uint64_t stop;
+    uint64_t block;
+    uint64_t slice;
+    uint64_t sum;
+    uint64_t ii;
+
+    offset = wp->begin;
+    block = part(offset, blocks);
+    slice = part(offset, slices);
+
+    while (offset < wp->end) {
+
+        /*
+         * Each piece lies within one block and one slice, and is small
+         * enough that the passes after the first find it in the cache.
+         */
+
+        limit = wp->end;
+        if (mapping && (first(block + 1, blocks) < limit)) {
+            limit = first(block + 1, blocks);
+        }
+        if (biasing && (first(slice + 1, slices) < limit)) {
+            limit = first(slice + 1, slices);
+        }
+        if ((offset + PIECE) < limit) {
+            limit = offset + PIECE;
+        }
+
+        if (lagging) {
+            stop = ((size - lag) < limit) ? (size - lag) : limit;
+            for (ii = offset, here = &data[offset]; ii < stop; ++ii, ++here) {
+                ++pairs[(here[0] << 8) | here[lag]];
+            }
+        }
+
+        if (biasing) {
+            counts = &wp->counts[slice * VALUES];
+            for (ii = offset, here = &data[offset]; ii < limit; ++ii, ++here) {
+                ++counts[*here];
+            }
+        }
+
+        if (mapping) {
+            sum = 0;
+            for (ii = offset, here = &data[offset]; ii < limit; ++ii, ++here) {
+                sum += *here;
+            }
+            __atomic_fetch_add(&sums[block], sum, __ATOMIC_RELAXED);
+        }
+
+        offset = limit;
+
+        if (mapping && (offset >= first(block + 1, blocks))) {
+            ++block;
+        }
+        if (biasing && (offset >= first(slice + 1, slices))) {
+            ++slice;
+        }
+
+    }
+
+    return (void *)0;
+}
+
+/*******************************************************************************
+ * DRAWING
+ ******************************************************************************/
+
+/**
+ * Color a pixel by its deviation: white for none, shading to red for
+ * positive and blue for negative, saturating at the limit.
+ */
+static void color(unsigned char * pixel, double z, double sigmas)
+{
+    double t;
+
+    t = z / sigmas;
+    if (t > 1.0) {
+        t = 1.0;
+    } else if (t < -1.0) {
+        t = -1.0;
+    } else if (t != t) {
+        t = 0.0;
+    } else {
+        /* Do nothing. */
+    }
+
+    if (t >= 0.0) {
+        pixel[0] = 255;
+        pixel[1] = pixel[2] = (unsigned char)(255.0 * (1.0 - t) + 0.5);
+    } else {
+        pixel[0] = pixel[1] = (unsigned char)(255.0 * (1.0 + t) + 0.5);
+        pixel[2] = 255;
+    }
+}
+
+static int draw(const char * path, const unsigned char * rgb, unsigned int width, unsigned int height)
+{
+    FILE * fp;
+    int rc;
+
+    fp = fopen(path, "w");
+    if (fp == (FILE *)0) {
+        return -1;
+    }
+
+    rc = png_write(fp, rgb, width, height);
+
+    if ((fclose(fp) == EOF) && (rc == 0)) {
+        rc = -1;
+    }
+
+    return rc;
+}
+
+/**
+ * The count of each pair is binomial with the expected count its mean.
+ */
+static unsigned char * heatmap(const uint64_t * pairs, unsigned int zoom, double sigmas, double * worstp, double * chisquarep)
+{
+    unsigned char * rgb;
+    double expected;
+    double deviation;
+    double z;
+    unsigned int side = VALUES * zoom;
+    unsigned int row;
+    unsigned int column;
+    unsigned int x;
+    unsigned int y;
+
+    rgb = (unsigned char *)malloc((size_t)side * side * 3);
+    if (rgb == (unsigned char *)0) {
+        return rgb;
+    }
+
+    expected = (double)(size - lag) / PAIRS;
+    deviation = sqrt(expected * (1.0 - (1.0 / PAIRS)));
+    *worstp = 0.0;
+    *chisquarep = 0.0;
+
+    for (x = 0; x < VALUES; ++x) {
+        for (y = 0; y < VALUES; ++y) {
+            z = (pairs[(x << 8) | y] - expected) / deviation;
+            if (fabs(z) > fabs(*worstp)) {
+                *worstp = z;
+            }
+            *chisquarep += z * z;
+        }
+    }
+
+    for (row = 0; row < side; ++row) {
+        y = (VALUES - 1) - (row / zoom);
+        for (column = 0; column < side; ++column) {
+            x = column / zoom;
+            z = (pairs[(x << 8) | y] - expected) / deviation;
+            color(&rgb[(((size_t)row * side) + column) * 3], z, sigmas);
+        }
+    }
+
+    return rgb;
+}
+
+/**
+ * The ones in each bit position of a slice are binomial with a mean of
+ * half the bytes in the slice.
+ */
+static unsigned char * biasmap(const uint64_t * counts, unsigned int width, double sigmas, double * worstp)
+{
+    unsigned char * rgb;
+    double z[8];
+    uint64_t ones[8];
+    uint64_t bytes;
+    uint64_t slice;
+    unsigned int column;
+    int bit;
+    int value;
+
+    rgb = (unsigned char *)malloc((size_t)width * slices * 3);
+    if (rgb == (unsigned char *)0) {
+        return rgb;
+    }
+
+    *worstp = 0.0;
+
+    for (slice = 0; slice < slices; ++slice) {
+        memset(ones, 0, sizeof(ones));
+        for (value = 0; value < VALUES; ++value) {
+            for (bit = 0; bit < 8; ++bit) {
+                if ((value & (1 << bit)) != 0) {
+                    ones[bit] += counts[(slice * VALUES) + value];
+                }
+            }
+        }
+        bytes = first(slice + 1, slices) - first(slice, slices);
+        for (bit = 0; bit < 8; ++bit) {
+            z[bit] = (ones[bit] - (bytes / 2.0)) / sqrt(bytes / 4.0);
+            if (fabs(z[bit]) > fabs(*worstp)) {
+                *worstp = z[bit];
+            }
+        }
+        for (column = 0; column < width; ++column) {
+            bit = 7 - ((column * 8) / width);
+            color(&rgb[((slice * width) + column) * 3], z[bit], sigmas);
+        }
+    }
+
+    return rgb;
+}
+
+/**
+ * The sum of a block of uniform bytes has a mean of 127.5 and a variance
+ * of (256 * 256 - 1) / 12 for each byte.
+ */
+static unsigned char * bitmap(double sigmas, double * worstp)
+{
+    unsigned char * rgb;
+    uint64_t bytes;
+    uint64_t block;
+    double z;
+
+    rgb = (unsigned char *)malloc(blocks * 3);
+    if (rgb == (unsigned char *)0) {
+        return rgb;
+    }
+
+    *worstp = 0.0;
+
+    for (block = 0; block < blocks; ++block) {
+        bytes = first(block + 1, blocks) - first(block, blocks);
+        z = (sums[block] - (127.5 * bytes)) / sqrt(bytes * (((VALUES * VALUES) - 1) / 12.0));
+        if (fabs(z) > fabs(*worstp)) {
+            *worstp = z;
+        }
+        color(&rgb[block * 3], z, sigmas);
+    }
+
+    return rgb;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    const char * lagpath = (const char *)0;
+    const char * biaspath = (const char *)0;
+    const char * mappath = (const char *)0;
+    long threads = 0;
+    long started = 0;
+    unsigned long zoom = 2;
+    unsigned long width = 512;
+    unsigned long rows = 512;
+    double sigmas = 4.0;
+    work_t * works = (work_t *)0;
+    uint64_t * pairs = (uint64_t *)0;
+    uint64_t * counts = (uint64_t *)0;
+    unsigned char * rgb = (unsigned char *)0;
+    double worst = 0.0;
+    double chisquare = 0.0;
+    uint64_t epoch;
+    uint64_t elapsed;
+    struct stat status;
+    void * pointer = MAP_FAILED;
+    char * end = (char *)0;
+    long ii;
+    uint64_t jj;
+    int fd = -1;
+    int rc = 0;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:hk:l:m:r:s:t:vw:z:")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            biaspath = optarg;
+            break;
+
+        case 'k':
+            lag = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (lag == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'l':
+            lagpath = optarg;
+            break;
+
+        case 'm':
+            mappath = optarg;
+            break;
+
+        case 'r':
+            rows = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (rows == 0) || (rows > 65536)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            sigmas = strtod(optarg, &end);
+            if ((*end != '\0') || (!(sigmas > 0.0))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads <= 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'w':
+            width = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (width == 0) || (width > 65536)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'z':
+            zoom = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (zoom == 0) || (zoom > 64)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    lagging = (lagpath != (const char *)0);
+    biasing = (biaspath != (const char *)0);
+    mapping = (mappath != (const char *)0);
+
+    do {
+
+        if (error || ((optind + 1) != argc) || (!(lagging || biasing || mapping))) {
+            usage();
+            break;
+        }
+
+        /*
+         * Map the capture.
+         */
+
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[optind]);
+            break;
+        }
+
+        if (fstat(fd, &status) < 0) {
+            perror(argv[optind]);
+            break;
+        }
+
+        size = status.st_size;
+        if (size <= lag) {
+            errno = ENODATA;
+            perror(argv[optind]);
+            break;
+        }
+
+        pointer = mmap((void *)0, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (pointer == MAP_FAILED) {
+            perror("mmap");
+            break;
+        }
+        (void)madvise(pointer, size, MADV_SEQUENTIAL);
+        data = (const unsigned char *)pointer;
+
+        /*
+         * A capture too small for the pictures gets smaller pictures, so
+         * that every slice and block has at least one byte.
+         */
+
+        if (biasing) {
+            slices = (rows < size) ? rows : size;
+        }
+
+        if (!mapping) {
+            /* Do nothing. */
+        } else if ((width * rows) <= size) {
+            blocks = width * rows;
+        } else if (width <= size) {
+            rows = size / width;
+            blocks = width * rows;
+        } else {
+            width = size;
+            rows = 1;
+            blocks = size;
+        }
+
+        if (threads == 0) {
+            threads = sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads <= 0) {
+                threads = 1;
+            }
+        }
+        if ((uint64_t)threads > (size / PIECE)) {
+            threads = (size / PIECE) + 1;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: file=\"%s\" bytes=%llu threads=%ld lag=%llu slices=%llu blocks=%llu width=%lu rows=%lu\n", program, argv[optind], (unsigned long long)size, threads, (unsigned long long)lag, (unsigned long long)slices, (unsigned long long)blocks, width, rows);
+        }
+
+        /*
+         * Histogram in parallel, each thread with its own pairs and
+         * counts, and sums shared since each thread adds to a block at
+         * most once per piece.
+         */
+
+        works = (work_t *)calloc(threads, sizeof(work_t));
+        pairs = (uint64_t *)calloc(PAIRS, sizeof(uint64_t));
+        counts = (uint64_t *)calloc(slices * VALUES, sizeof(uint64_t));
+        sums = (uint64_t *)calloc(blocks, sizeof(uint64_t));
+        if ((works == (work_t *)0) || (pairs == (uint64_t *)0) || (counts == (uint64_t *)0) || (sums == (uint64_t *)0)) {
+            perror("calloc");
+            break;
+        }
+
+        for (ii = 0; ii < threads; ++ii) {
+            works[ii].begin = first(ii, threads);
+            works[ii].end = first(ii + 1, threads);
+            if (lagging) {
+                works[ii].pairs = (uint64_t *)calloc(PAIRS, sizeof(uint64_t));
+                if (works[ii].pairs == (uint64_t *)0) {
+                    break;
+                }
+            }
+            if (biasing) {
+                works[ii].counts = (uint64_t *)calloc(slices * VALUES, sizeof(uint64_t));
+                if (works[ii].counts == (uint64_t *)0) {
+                    break;
+                }
+            }
+        }
+        if (ii < threads) {
+            perror("calloc");
+            break;
+        }
+
+        epoch = now();
+
+        for (started = 0; started < threads; ++started) {
+            rc = pthread_create(&works[started].thread, (pthread_attr_t *)0, histogram, &works[started]);
+            if (rc != 0) {
+                errno = rc;
+                perror("pthread_create");
+                break;
+            }
+        }
+
+        for (ii = 0; ii < started; ++ii) {
+            pthread_join(works[ii].thread, (void **)0);
+            for (jj = 0; lagging && (jj < PAIRS); ++jj) {
+                pairs[jj] += works[ii].pairs[jj];
+            }
+            for (jj = 0; biasing && (jj < (slices * VALUES)); ++jj) {
+                counts[jj] += works[ii].counts[jj];
+            }
+        }
+
+        elapsed = now() - epoch;
+
+        if (rc != 0) {
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: seconds=%.3f bytes/second=%.0f\n", program, elapsed / 1000000000.0, size / (elapsed / 1000000000.0));
+        }
+
+        /*
+         * Draw.
+         */
+
+        xc = 0;
+
+        if (lagging) {
+            rgb = heatmap(pairs, zoom, sigmas, &worst, &chisquare);
+            if ((rgb == (unsigned char *)0) || (draw(lagpath, rgb, VALUES * zoom, VALUES * zoom) < 0)) {
+                perror(lagpath);
+                xc = 1;
+            } else if (verbose) {
+                fprintf(stderr, "%s: heatmap=\"%s\" worst=%.2f chisquare=%.1f degrees=%d\n", program, lagpath, worst, chisquare, PAIRS - 1);
+            } else {
+                /* Do nothing. */
+            }
+            free(rgb);
+        }
+
+        if (biasing) {
+            rgb = biasmap(counts, width, sigmas, &worst);
+            if ((rgb == (unsigned char *)0) || (draw(biaspath, rgb, width, slices) < 0)) {
+                perror(biaspath);
+                xc = 1;
+            } else if (verbose) {
+                fprintf(stderr, "%s: biasmap=\"%s\" worst=%.2f\n", program, biaspath, worst);
+            } else {
+                /* Do nothing. */
+            }
+            free(rgb);
+        }
+
+        if (mapping) {
+            rgb = bitmap(sigmas, &worst);
+            if ((rgb == (unsigned char *)0) || (draw(mappath, rgb, width, rows) < 0)) {
+                perror(mappath);
+                xc = 1;
+            } else if (verbose) {
+                fprintf(stderr, "%s: bitmap=\"%s\" worst=%.2f\n", program, mappath, worst);
+            } else {
+                /* Do nothing. */
+            }
+            free(rgb);
+        }
+
+    } while (0);
+
+    if (works != (work_t *)0) {
+        for (ii = 0; ii < threads; ++ii) {
+            free(works[ii].pairs);
+            free(works[ii].counts);
+        }
+    }
+    free(works);
+    free(pairs);
+    free(counts);
+    free(sums);
+
+    if (pointer != MAP_FAILED) {
+        munmap(pointer, size);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return xc;
+}
@@ -0,0 +1,133 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Von Neumann Extractor<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Within a byte only the sixteen masks made of even bits can occur, so the
+ * table of the portable kernel is small.
+ */
+
+#include <string.h>
+#include "vonneumann.h"
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#endif
+
+static const uint64_t EVEN = 0x5555555555555555ULL;
+
+static uint8_t gather[16][256];
+static vonneumann_compress_t * compress = (vonneumann_compress_t *)0;
+
+/**
+ * Gather the bits of a word selected by a mask of even bits into the low
+ * order bits of the result, a byte at a time.
+ */
+static uint64_t compress_portable(uint64_t word, uint64_t mask)
+{
+    uint64_t result = 0;
+    int shift = 0;
+    int ii;
+    unsigned int mm;
+    unsigned int index;
+
+    for (ii = 0; ii < 64; ii += 8) {
+        mm = (mask >> ii) & 0x55;
+        index = (mm & 0x01) | ((mm >> 1) & 0x02) | ((mm >> 2) & 0x04) | ((mm >> 3) & 0x08);
+        result |= (uint64_t)gather[index][(word >> ii) & 0xff] << shift;
+        shift += __builtin_popcount(mm);
+    }
+
+    return result;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2")))
+static uint64_t compress_bmi2(uint64_t word, uint64_t mask)
+{
+    return _pext_u64(word, mask);
+}
+#endif
+
+vonneumann_compress_t * vonneumann_initialize(int portable)
+{
+    unsigned int index;
+    unsigned int value;
+    unsigned int mask;
+    unsigned int result;
+    int shift;
+    int bb;
+
+    for (index = 0; index < 16; ++index) {
+        mask = (index & 0x01) | ((index & 0x02) << 1) | ((index & 0x04) << 2) | ((index & 0x08) << 3);
+        for (value = 0; value < 256; ++value) {
+            result = 0;
+            shift = 0;
+            for (bb = 0; bb < 8; ++bb) {
+                if ((mask & (1 << bb)) != 0) {
+                    result |= ((value >> bb) & 1) << shift;
+                    ++shift;
+                }
+            }
+            gather[index][value] = result;
+        }
+    }
+
+    compress = &compress_portable;
+
+#if defined(__x86_64__)
+    if (!portable && __builtin_cpu_supports("bmi2")) {
+        compress = &compress_bmi2;
+    }
+#endif
+
+    return compress;
+}
+
+const char * vonneumann_kernel(void)
+{
+    return (compress == &compress_portable) ? "portable" : "bmi2";
+}
+
+size_t vonneumann_extract(vonneumann_t * vp, unsigned char * data, size_t length)
+{
+    uint64_t bits = vp->bits;
+    int count = vp->count;
+    uint64_t word;
+    uint64_t even;
+    uint64_t mask;
+    size_t out = 0;
+    size_t ii;
+
+    for (ii = 0; ii < length; ii += sizeof(word)) {
+        if ((length - ii) >= sizeof(word)) {
+            memcpy(&word, data + ii, sizeof(word));
+            even = EVEN;
+        } else {
+            word = 0;
+            memcpy(&word, data + ii, length - ii);
+            even = EVEN & ((1ULL << ((length - ii) * 8)) - 1);
+        }
+        mask = (word ^ (word >> 1)) & even;
+        bits |= (*compress)(word, mask) << count;
+        count += __builtin_popcountll(mask);
+        while (count >= 8) {
+            data[out++] = bits & 0xff;
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    vp->bits = bits;
+    vp->count = count;
+
+    return out;
+}
@@ -0,0 +1,69 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_VONNEUMANN_
+#define _H_COM_DIAG_SCATTERGUN_VONNEUMANN_
+
+/**
+ * @file
+ * Von Neumann Extractor<BR>
+ * Copyright 2020 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * The von Neumann extractor of the extract tool, shared with the tools that
+ * debias in line. Bits are taken least significant bit first, sixty-four at
+ * a time: the pairs of a word whose bits differ are found with one shift
+ * and one exclusive OR, and the first bit of each is gathered with a single
+ * parallel bit extract (PEXT) where the processor has BMI2, and with a
+ * table lookup per byte otherwise.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * This is a kernel that gathers the bits of a word selected by a mask of
+ * even bits into the low order bits of the result.
+ */
+typedef uint64_t (vonneumann_compress_t)(uint64_t word, uint64_t mask);
+
+/**
+ * This is the state of an extraction that continues across buffers: the
+ * bits emitted that do not yet make a whole byte.
+ */
+typedef struct VonNeumann {
+    uint64_t bits;
+    int count;
+} vonneumann_t;
+
+/**
+ * Build the tables and select the kernel. This must be called, from one
+ * thread, before any other function.
+ * @param portable if true selects the table kernel even if BMI2 is there.
+ * @return the kernel selected.
+ */
+extern vonneumann_compress_t * vonneumann_initialize(int portable);
+
+/**
+ * Return the name of the kernel selected.
+ * @return "portable" or "bmi2".
+ */
+extern const char * vonneumann_kernel(void);
+
+/**
+ * Extract a buffer in place. Each byte emits at most four bits, so each
+ * output byte is written over input already consumed; the bits that do
+ * not make a whole byte carry over to the next buffer.
+ * @param vp points to the state, which starts zeroed.
+ * @param data points to the buffer.
+ * @param length is the length of the buffer in bytes.
+ * @return the number of bytes of output at the start of the buffer.
+ */
+extern size_t vonneumann_extract(vonneumann_t * vp, unsigned char * data, size_t length);
+
+#endif